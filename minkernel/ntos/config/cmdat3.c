@@ -77,6 +77,9 @@ extern ULONG ExpAdditionalDelayedWorkerThreads;
 extern ULONG MmProductType;
 extern ULONG IopLargeIrpStackLocations;
 extern ULONG MmZeroPageFile;
+extern ULONG MmSizeOfCompressedStoreInBytes;
+extern ULONG MmWriteClusterGrowLatency;
+extern ULONG MmWriteClusterShrinkLatency;
 extern ULONG ExpNtExpirationData[3];
 extern ULONG ExpNtExpirationDataLength;
 extern ULONG ExpMaxTimeSeperationBeforeCorrect;
@@ -94,6 +97,8 @@ extern ULONG KiMaximumDpcQueueDepth;
 extern ULONG KiMinimumDpcRate;
 extern ULONG KiAdjustDpcThreshold;
 extern ULONG KiIdealDpcRate;
+extern ULONG KiWaitSpinLimit;
+extern ULONG KiWaitLatencyHistogram;
 extern LARGE_INTEGER ExpLastShutDown;
 ULONG shutdownlength;
 
@@ -244,6 +249,27 @@ CM_SYSTEM_CONTROL_VECTOR   CmControlVector[] = {
       NULL
     },
 
+    { L"Session Manager\\Memory Management",
+      L"CompressedStoreSize",
+      &MmSizeOfCompressedStoreInBytes,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Memory Management",
+      L"WriteClusterGrowLatency",
+      &MmWriteClusterGrowLatency,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Memory Management",
+      L"WriteClusterShrinkLatency",
+      &MmWriteClusterShrinkLatency,
+      NULL,
+      NULL
+    },
+
 #if DBG
     { L"Session Manager\\Memory Management",
       L"PoolTag",
@@ -303,6 +329,20 @@ CM_SYSTEM_CONTROL_VECTOR   CmControlVector[] = {
       NULL
     },
 
+    { L"Session Manager\\Kernel",
+      L"WaitSpinLimit",
+      &KiWaitSpinLimit,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Kernel",
+      L"WaitLatencyHistogram",
+      &KiWaitLatencyHistogram,
+      NULL,
+      NULL
+    },
+
     { L"Session Manager\\I/O System",
       L"LargeIrpStackLocations",
       &IopLargeIrpStackLocations,
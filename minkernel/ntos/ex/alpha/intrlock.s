@@ -1211,6 +1211,58 @@
         br      zero, 10b               // retry
 
         .end    ExpInterlockedPushEntrySList
+
+        SBTTL("Interlocked Flush Sequenced List")
+//++
+//
+// PSINGLE_LIST_ENTRY
+// ExpInterlockedFlushSList (
+//    IN PSLIST_HEADER ListHead
+//    )
+//
+// Routine Description:
+//
+//    This function removes all entries from a sequenced singly linked list
+//    so that access to the list is synchronized in an MP system. If there
+//    are no entries in the list, then a value of NULL is returned. Otherwise,
+//    the address of the first entry that was removed is returned as the
+//    function value.
+//
+//    The list depth is set to zero, but the sequence number is not changed.
+//
+// Arguments:
+//
+//    ListHead (a0) - Supplies a pointer to the sequenced listhead which is
+//       to be flushed.
+//
+// Return Value:
+//
+//    The address of the first entry removed from the list, or NULL if the
+//    list is empty.
+//
+//--
+
+        LEAF_ENTRY(ExpInterlockedFlushSList)
+
+10:
+        ldq_l   t0, 0(a0)               // get next entry address and sequence
+        addl    t0, zero, v0            // sign extend next entry address
+        beq     v0, 30f                 // if eq, list is empty
+        srl     t0, 48, t1              // isolate sequence number
+        sll     t1, 48, t1              // clear depth and next entry address
+        stq_c   t1, 0(a0)               // store empty list and sequence
+        beq     t1, 15f                 // if eq, store conditional failed
+
+30:
+#if !defined(NT_UP)
+        mb                              // ensure consistent view of memory
+#endif
+        ret     zero, (ra)
+
+15:
+        br      zero, 10b               // retry
+
+        .end    ExpInterlockedFlushSList
 
         SBTTL("Interlocked Compare Exchange 64-bits")
 //++
@@ -303,6 +303,12 @@ Return Value:
 
     ExInitializeFastMutex(&ExpEnvironmentLock);
 
+    //
+    // Initialize the lock profiling synchronization fast mutex.
+    //
+
+    ExInitializeFastMutex(&ExpLockProfileLock);
+
     //
     // Initialize the paged and nonpaged small pool lookaside structures.
     //
@@ -1078,6 +1084,20 @@ Return Value:
 
     RtlInitializeAtomPackage( 'motA' );
 
+    //
+    // Allocate the per processor small pool lookaside lists now that all
+    // processors have been started.
+    //
+
+    ExpInitializePerProcessorLookaside();
+
+    //
+    // Allocate the per processor pool tracker tables if pool tagging is
+    // enabled.
+    //
+
+    ExpInitializePerProcessorPoolTracker();
+
     //
     // Initialize the worker thread.
     //
@@ -88,6 +88,77 @@ ExpResourceInitialization (
     VOID
     );
 
+VOID
+ExpInitializePerProcessorLookaside (
+    VOID
+    );
+
+VOID
+ExpInitializePerProcessorPoolTracker (
+    VOID
+    );
+
+NTSTATUS
+ExpGetWorkerQueueInformation(
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+//
+// Lock profiling routines.
+//
+
+typedef struct _LOCK_PROFILE_SITE *PLOCK_PROFILE_SITE;
+
+//
+// The call site of a profiled acquire is the return address of the
+// acquire routine, which is available on all processors and whether or
+// not frame pointers are omitted.
+//
+
+PVOID
+_ReturnAddress (
+    VOID
+    );
+
+#pragma intrinsic(_ReturnAddress)
+
+PLOCK_PROFILE_SITE
+ExpLockProfileAcquire (
+    IN PVOID Lock,
+    IN ULONG LockType,
+    IN PVOID CallSite
+    );
+
+VOID
+ExpLockProfileContention (
+    IN PLOCK_PROFILE_SITE Site,
+    IN PLARGE_INTEGER WaitStart
+    );
+
+VOID
+ExpLockProfileHoldStart (
+    IN PLOCK_PROFILE_SITE Site
+    );
+
+VOID
+ExpLockProfileHoldEnd (
+    IN PVOID Lock
+    );
+
+NTSTATUS
+ExpGetLockProfileInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+NTSTATUS
+ExpSetLockProfileInformation (
+    IN BOOLEAN Enable
+    );
+
 BOOLEAN
 ExpInitSystemPhase0 (
     VOID
@@ -229,6 +300,7 @@ extern EXP_INITIALIZE_GLOBAL_CALLBACKS  ExpInitializeCallback[];
 #endif // _PNP_POWER_
 
 extern FAST_MUTEX       ExpEnvironmentLock;
+extern FAST_MUTEX       ExpLockProfileLock;
 
 extern SMALL_POOL_LOOKASIDE ExpSmallPagedPoolLookasideLists[POOL_SMALL_LISTS];
 extern SMALL_POOL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[POOL_SMALL_LISTS];
@@ -10,6 +10,13 @@ Abstract:
 
     This module implements a set of functions for supporting handles.
 
+    Handle entries are kept in a three level table. The low level pages
+    hold handle entries and the mid and high level pages hold pointers to
+    the next lower level. Pages are added as the table grows and are never
+    moved or freed until the table is destroyed, so a handle can be mapped
+    to its entry without locking the handle table. A mapped entry is locked
+    individually by clearing the high bit of its object field.
+
 Author:
 
     Steve Wood (stevewo) 25-Apr-1989
@@ -23,12 +30,31 @@ Revision History:
 #pragma hdrstop
 
 //
-// Define global values for the default initial handle entry table size and
-// the default size to grow the handle entry table.
+// Define the number of entries in each level of a handle table. A handle
+// index is split into a high level index, a mid level index, and a low
+// level index.
 //
 
-USHORT ExpDefaultHandleTableSize;
-USHORT ExpDefaultHandleTableGrowth;
+#define LOWLEVEL_COUNT 256
+#define MIDLEVEL_COUNT 256
+#define HIGHLEVEL_COUNT 256
+
+#define LOWLEVEL_SIZE (LOWLEVEL_COUNT * sizeof(HANDLE_ENTRY))
+#define MIDLEVEL_SIZE (MIDLEVEL_COUNT * sizeof(PHANDLE_ENTRY))
+#define HIGHLEVEL_SIZE (HIGHLEVEL_COUNT * sizeof(PHANDLE_ENTRY *))
+
+#define MAX_HANDLES (LOWLEVEL_COUNT * MIDLEVEL_COUNT * HIGHLEVEL_COUNT)
+
+#define LOWLEVEL_INDEX(i) ((i) & (LOWLEVEL_COUNT - 1))
+#define MIDLEVEL_INDEX(i) (((i) / LOWLEVEL_COUNT) & (MIDLEVEL_COUNT - 1))
+#define HIGHLEVEL_INDEX(i) ((i) / (LOWLEVEL_COUNT * MIDLEVEL_COUNT))
+
+//
+// Define the time to wait for a locked handle entry before checking it
+// again. The timeout covers a release that races with the wait.
+//
+
+LARGE_INTEGER ExpHandleContentionTimeout;
 
 //
 // Decline global structures that link all handle tables together.
@@ -43,16 +69,31 @@ LIST_ENTRY HandleTableListHead;
 
 PHANDLE_TABLE
 ExpAllocateHandleTable(
-    IN PEPROCESS Process,
-    IN ULONG CountToGrowBy
+    IN PEPROCESS Process
     );
 
-PHANDLE_ENTRY
+BOOLEAN
 ExpAllocateHandleTableEntries(
+    IN PHANDLE_TABLE HandleTable
+    );
+
+VOID
+ExpFreeHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry,
+    IN ULONG TableIndex
+    );
+
+PHANDLE_ENTRY
+ExpLookupHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN HANDLE Handle
+    );
+
+BOOLEAN
+ExpLockHandleTableEntry(
     IN PHANDLE_TABLE HandleTable,
-    IN PVOID OldTableEntries,
-    IN ULONG OldCountEntries,
-    IN ULONG NewCountEntries
+    IN PHANDLE_ENTRY HandleEntry
     );
 
 #ifdef ALLOC_PRAGMA
@@ -67,10 +108,14 @@ ExpAllocateHandleTableEntries(
 #pragma alloc_text(PAGE, ExMapHandleToPointer)
 #pragma alloc_text(PAGE, ExRemoveHandleTable)
 #pragma alloc_text(PAGE, ExSnapShotHandleTables)
+#pragma alloc_text(PAGE, ExUnlockHandleTableEntry)
 #pragma alloc_text(PAGE, ExpAllocateHandleTable)
 #pragma alloc_text(PAGE, ExpAllocateHandleTableEntries)
+#pragma alloc_text(PAGE, ExpFreeHandleTableEntry)
+#pragma alloc_text(PAGE, ExpLookupHandleTableEntry)
+#pragma alloc_text(PAGE, ExpLockHandleTableEntry)
 #endif
-
+
 VOID
 ExInitializeHandleTablePackage(
     VOID
@@ -95,25 +140,11 @@ Return Value:
 
 {
 
-    MM_SYSTEMSIZE SystemSize;
-
-    //
-    // Get the configuration size of the host system and set the initial
-    // and growth default sizes for handle table as appropriate.
     //
-    // N.B. The initial sizes are set such that otimal use of pool block
-    //      storage can be obtained.
+    // Set the handle entry contention timeout to 10ms.
     //
 
-    SystemSize = MmQuerySystemSize();
-    if (SystemSize == MmSmallSystem) {
-        ExpDefaultHandleTableSize = 7;
-        ExpDefaultHandleTableGrowth = 8;
-
-    } else {
-        ExpDefaultHandleTableSize = 15;
-        ExpDefaultHandleTableGrowth = 16;
-    }
+    ExpHandleContentionTimeout.QuadPart = -10 * 1000 * 10;
 
     //
     // Initialize the handle table synchronization resource and listhead.
@@ -472,6 +503,9 @@ Routine Description:
     This function provides the capability to change the contents of the
     handle entry corrsponding to the specified handle.
 
+    N.B. The change routine is called with the handle entry locked and
+         must not set the high bit of the object field.
+
 Arguments:
 
     HandleTable - Supplies a pointer to a handle table.
@@ -495,37 +529,23 @@ Return Value:
 
     PHANDLE_ENTRY HandleEntry;
     BOOLEAN ReturnValue;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
-    ULONG TableIndex;
 
     PAGED_CODE();
 
     ASSERT(HandleTable != NULL);
 
     //
-    // Lock the handle table exclusive and check if the handle is valid.
+    // Map and lock the handle entry and call the change handle function
+    // if the handle entry is not free.
     //
 
     ReturnValue = FALSE;
-    TableIndex = HANDLE_TO_INDEX(Handle);
-    ExLockHandleTableExclusive(HandleTable);
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-
-        //
-        // Compute the address of the handle entry and call the change
-        // handle function if the handle entry is not free.
-        //
-
-        HandleEntry = &TableEntries[TableIndex];
-        if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-            ReturnValue = (*ChangeRoutine)(HandleEntry, Parameter);
-        }
+    HandleEntry = ExMapHandleToPointer(HandleTable, Handle);
+    if (HandleEntry != NULL) {
+        ReturnValue = (*ChangeRoutine)(HandleEntry, Parameter);
+        ExUnlockHandleTableEntry(HandleTable, HandleEntry);
     }
 
-    ExUnlockHandleTableExclusive(HandleTable);
     return ReturnValue;
 }
 
@@ -549,7 +569,8 @@ Arguments:
     HandleTable - Supplies a pointer to a handle table
 
     HandleEntry - Supplies a poiner to the handle entry for which a
-        handle entry is created.
+        handle entry is created. The high bit of the object field must
+        be set.
 
 Return Value:
 
@@ -561,43 +582,34 @@ Return Value:
 
 {
 
-    PLIST_ENTRY FreeEntry;
-    ULONG NewCountEntries;
     PHANDLE_ENTRY NewEntry;
-    ULONG OldCountEntries;
-    PHANDLE_ENTRY TableEntries;
     ULONG TableIndex;
 
     PAGED_CODE();
 
     ASSERT(HandleTable != NULL);
     ASSERT(HandleEntry != NULL);
+    ASSERT(((ULONG)HandleEntry->Object & EX_HANDLE_ENTRY_LOCK_BIT) != 0);
+    ASSERT((ULONG)HandleEntry->Object != EX_HANDLE_ENTRY_LOCK_BIT);
 
     //
     // Lock the handle table exclusive and allocate a free handle entry.
     //
 
     ExLockHandleTableExclusive(HandleTable);
-    TableEntries = HandleTable->TableEntries;
-    if (IsListEmpty(&TableEntries->ListEntry)) {
+    if (HandleTable->FirstFreeTableEntry == 0) {
 
         //
-        // There are no free entries in the handle entry table. Attempt
-        // to grow the size of the handle entry table.
+        // There are no free entries in the handle table. Attempt to add
+        // another page of handle entries to the handle table.
+        //
+        // N.B. Existing handle entries are not moved and may be mapped
+        //      while the handle table is extended.
         //
 
-        OldCountEntries = HandleTable->TableBound - TableEntries;
-        NewCountEntries = OldCountEntries + HandleTable->CountToGrowBy;
-        if (ExpAllocateHandleTableEntries(HandleTable,
-                                          TableEntries,
-                                          OldCountEntries,
-                                          NewCountEntries) == NULL) {
-
+        if (ExpAllocateHandleTableEntries(HandleTable) == FALSE) {
             ExUnlockHandleTableExclusive(HandleTable);
             return NULL;
-
-        } else {
-            TableEntries = HandleTable->TableEntries;
         }
     }
 
@@ -608,42 +620,45 @@ Return Value:
     // N.B. The LIFO/FIFO discipline for handle table entires is maintained
     //      at the point handles are destroyed.
     //
+    // N.B. The object field is stored last since a nonzero object field
+    //      makes the handle entry visible to lookups that do not lock the
+    //      handle table.
+    //
+
+    TableIndex = HandleTable->FirstFreeTableEntry;
+    NewEntry = ExpLookupHandleTableEntry(HandleTable, INDEX_TO_HANDLE(TableIndex));
+
+    ASSERT(NewEntry->Object == NULL);
+
+    HandleTable->FirstFreeTableEntry = NewEntry->NextFreeTableEntry;
+    if (HandleTable->FirstFreeTableEntry == 0) {
+        HandleTable->LastFreeTableEntry = 0;
+    }
 
-    FreeEntry = TableEntries->ListEntry.Flink;
-    RemoveEntryList(FreeEntry);
-    NewEntry = CONTAINING_RECORD(FreeEntry, HANDLE_ENTRY, ListEntry);
     HandleTable->HandleCount += 1;
-    NewEntry->Object = HandleEntry->Object;
     NewEntry->Attributes = HandleEntry->Attributes;
+    InterlockedExchange((PLONG)&NewEntry->Object, (LONG)HandleEntry->Object);
     ExUnlockHandleTableExclusive(HandleTable);
-    TableIndex = NewEntry - TableEntries;
     return INDEX_TO_HANDLE(TableIndex);
 }
 
 PHANDLE_TABLE
 ExCreateHandleTable(
-    IN PEPROCESS Process OPTIONAL,
-    IN ULONG CountEntries,
-    IN ULONG CountToGrowBy
+    IN PEPROCESS Process OPTIONAL
     )
 
 /*++
 
 Routine Description:
 
-    This function creates a handle table and allocates the specified count
-    of initial handle entries.
+    This function creates a handle table. Handle entries are allocated
+    a page at a time as handles are created.
 
 Arguments:
 
     Process - Supplies an optional pointer to the process against which quota
         will be charged.
 
-    CountEntries - Supplies the initial number of handle entries to allocate.
-
-    CountToGrowBy - Supplies the number of handle entries to grow the handle
-        entry table by when it becomes full.
-
 Return Value:
 
     If a handle table is successfully created, then the address of the
@@ -654,53 +669,20 @@ Return Value:
 
 {
 
-    PHANDLE_TABLE HandleTable;
-
     PAGED_CODE();
 
-    //
-    // If the number of initial handle entries or the number to grow by
-    // are not specified, then use the system default value.
-    //
-
-    if ((CountEntries <= 1) || (CountEntries > MAXUSHORT)) {
-        CountEntries = ExpDefaultHandleTableSize;
-    }
-
-    if ((CountToGrowBy <= 1) || (CountToGrowBy > MAXUSHORT)) {
-        CountToGrowBy = ExpDefaultHandleTableGrowth;
-    }
-
     //
     // Allocate and initialize a handle table descriptor.
     //
 
-    HandleTable = ExpAllocateHandleTable(Process, CountToGrowBy);
-
-    //
-    // If the handle table descriptor was successfully allocated, then
-    // allocate the initial handle entry table.
-    //
-
-    if (HandleTable != NULL) {
-        if (ExpAllocateHandleTableEntries(HandleTable,
-                                          NULL,
-                                          0,
-                                          CountEntries) == NULL) {
-
-            ExDestroyHandleTable(HandleTable, NULL);
-            HandleTable = NULL;
-        }
-    }
-
-    return HandleTable;
+    return ExpAllocateHandleTable(Process);
 }
 
 BOOLEAN
 ExDestroyHandle(
     IN PHANDLE_TABLE HandleTable,
     IN HANDLE Handle,
-    IN BOOLEAN TableLocked
+    IN PHANDLE_ENTRY HandleEntry OPTIONAL
     )
 
 /*++
@@ -715,8 +697,10 @@ Arguments:
 
     Handle - Supplies the handle value of the entry to remove.
 
-    TableLocked - Supplies a boolean value that determines whether the
-        handle table is already locked.
+    HandleEntry - Supplies an optional pointer to the handle entry for
+        the handle. If specified, the handle entry was returned by a call
+        to ExMapHandleToPointer and is still locked. The handle entry is
+        unlocked when it is freed.
 
 Return Value:
 
@@ -727,66 +711,50 @@ Return Value:
 
 {
 
-    PHANDLE_ENTRY HandleEntry;
-    BOOLEAN ResultValue;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
-    ULONG TableIndex;
-
     PAGED_CODE();
 
     ASSERT(HandleTable != NULL);
 
     //
-    // If the handle table is not already locked, then lock the handle
-    // table exclussive.
+    // If the handle entry is not already locked, then map and lock the
+    // handle entry.
     //
 
-    ResultValue = FALSE;
-    TableIndex = HANDLE_TO_INDEX(Handle);
-    if (TableLocked == FALSE) {
-        ExLockHandleTableExclusive(HandleTable);
+    if (ARGUMENT_PRESENT(HandleEntry) == FALSE) {
+        HandleEntry = ExMapHandleToPointer(HandleTable, Handle);
+        if (HandleEntry == NULL) {
+            return FALSE;
+        }
     }
 
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-
-        //
-        // Compute the address of the handle entry and check if the handle
-        // is is use.
-        //
-
-        HandleEntry = &TableEntries[TableIndex];
-        if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-
-            //
-            // Insert the handle entry in the free list according to the
-            // discipline associated with the handle table and decrement
-            // the number of handles.
-            //
-
-            HandleTable->HandleCount -= 1;
-            if (HandleTable->LifoOrder != FALSE) {
-                InsertHeadList(&TableEntries->ListEntry, &HandleEntry->ListEntry);
+    ASSERT(HandleEntry == ExpLookupHandleTableEntry(HandleTable, Handle));
+    ASSERT((LONG)HandleEntry->Object > 0);
 
-            } else {
-                InsertTailList(&TableEntries->ListEntry, &HandleEntry->ListEntry);
-            }
+    //
+    // Lock the handle table exclusive, insert the handle entry in the free
+    // list according to the discipline associated with the handle table,
+    // and decrement the number of handles.
+    //
+    // N.B. Freeing the handle entry releases the handle entry lock. Any
+    //      thread waiting for the handle entry finds it free.
+    //
 
-            ResultValue = TRUE;
-        }
-    }
+    ExLockHandleTableExclusive(HandleTable);
+    HandleTable->HandleCount -= 1;
+    ExpFreeHandleTableEntry(HandleTable, HandleEntry, HANDLE_TO_INDEX(Handle));
+    ExUnlockHandleTableExclusive(HandleTable);
 
     //
-    // Unlock the handle table if is was locked.
+    // Leave the critical region entered when the handle entry was mapped
+    // and wake any threads waiting for a handle entry.
     //
 
-    if (TableLocked == FALSE) {
-        ExUnlockHandleTableExclusive(HandleTable);
+    KeLeaveCriticalRegion();
+    if (IsListEmpty(&HandleTable->HandleContentionEvent.Header.WaitListHead) == FALSE) {
+        KePulseEvent(&HandleTable->HandleContentionEvent, 0, FALSE);
     }
 
-    return ResultValue;
+    return TRUE;
 }
 
 VOID
@@ -860,11 +828,13 @@ Return Value:
 
 {
 
-    ULONG CountEntries;
+    ULONG CountBytes;
     PHANDLE_ENTRY HandleEntry;
+    ULONG HighIndex;
+    PHANDLE_ENTRY LowLevel;
+    ULONG MidIndex;
+    PHANDLE_ENTRY *MidLevel;
     PEPROCESS Process;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
     ULONG TableIndex;
 
     PAGED_CODE();
@@ -878,35 +848,57 @@ Return Value:
     ExRemoveHandleTable(HandleTable);
 
     //
-    // If a handle entry table has been allocated, then scan all of
-    // handle entries, call the destroy handle function, if specfied,
-    // free the allocated pool, and return pool quota as appropriate.
+    // If a destroy handle function is specified, then scan all of the
+    // handle entries and call the function for each handle entry that is
+    // in use.
+    //
+    // N.B. The destroy handle function may close the handle, which frees
+    //      the handle entry, so no page is freed until the scan is done.
     //
 
-    Process = HandleTable->QuotaProcess;
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    if (TableEntries != NULL) {
-        if (ARGUMENT_PRESENT(DestroyHandleProcedure)) {
-            HandleEntry = &TableEntries[1];
-            while (HandleEntry < TableBound) {
-                if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-                    TableIndex = HandleEntry - TableEntries;
-                    (*DestroyHandleProcedure)(INDEX_TO_HANDLE(TableIndex),
-                                              HandleEntry);
-                }
+    if (ARGUMENT_PRESENT(DestroyHandleProcedure)) {
+        for (TableIndex = 1;
+             TableIndex < HandleTable->NextHandleNeedingPool;
+             TableIndex += 1) {
+
+            HandleEntry = ExpLookupHandleTableEntry(HandleTable,
+                                                    INDEX_TO_HANDLE(TableIndex));
 
-                HandleEntry += 1;
+            if (HandleEntry->Object != NULL) {
+                (*DestroyHandleProcedure)(INDEX_TO_HANDLE(TableIndex),
+                                          HandleEntry);
             }
         }
+    }
+
+    //
+    // Free the allocated pages of handle entries and return pool quota as
+    // appropriate.
+    //
+
+    Process = HandleTable->QuotaProcess;
+    CountBytes = HIGHLEVEL_SIZE;
+    for (HighIndex = 0; HighIndex < HIGHLEVEL_COUNT; HighIndex += 1) {
+        MidLevel = HandleTable->Table[HighIndex];
+        if (MidLevel == NULL) {
+            continue;
+        }
 
-        ExFreePool(TableEntries);
-        if (Process != NULL) {
-            CountEntries = TableBound - TableEntries;
-            PsReturnPoolQuota(Process,
-                              PagedPool,
-                              CountEntries * sizeof(HANDLE_ENTRY));
+        for (MidIndex = 0; MidIndex < MIDLEVEL_COUNT; MidIndex += 1) {
+            LowLevel = MidLevel[MidIndex];
+            if (LowLevel != NULL) {
+                ExFreePool(LowLevel);
+                CountBytes += LOWLEVEL_SIZE;
+            }
         }
+
+        ExFreePool(MidLevel);
+        CountBytes += MIDLEVEL_SIZE;
+    }
+
+    ExFreePool(HandleTable->Table);
+    if (Process != NULL) {
+        PsReturnPoolQuota(Process, PagedPool, CountBytes);
     }
 
     //
@@ -956,14 +948,11 @@ Return Value:
 
 {
 
-    PLIST_ENTRY FreeHead;
     PHANDLE_TABLE NewHandleTable;
     PHANDLE_ENTRY NewHandleEntry;
-    PHANDLE_ENTRY NewTableEntries;
+    PVOID Object;
     PHANDLE_ENTRY OldHandleEntry;
-    ULONG OldCountEntries;
-    PHANDLE_ENTRY OldTableBound;
-    PHANDLE_ENTRY OldTableEntries;
+    ULONG TableIndex;
 
     PAGED_CODE();
 
@@ -975,59 +964,71 @@ Return Value:
     //
 
     ExLockHandleTableExclusive(OldHandleTable);
-    NewHandleTable = ExpAllocateHandleTable(Process,
-                                            OldHandleTable->CountToGrowBy);
+    NewHandleTable = ExpAllocateHandleTable(Process);
 
     //
     // If the new handle table descriptor was successfully allocated, then
-    // the allocate the handle entry table.
+    // allocate as many pages of handle entries as the old handle table
+    // has before any handles are duplicated.
     //
 
     if (NewHandleTable != NULL) {
-        OldTableBound = OldHandleTable->TableBound;
-        OldTableEntries = OldHandleTable->TableEntries;
-        OldCountEntries = OldTableBound - OldTableEntries;
-        if (ExpAllocateHandleTableEntries(NewHandleTable,
-                                          OldTableEntries,
-                                          0,
-                                          OldCountEntries) == NULL) {
+        while (NewHandleTable->NextHandleNeedingPool <
+               OldHandleTable->NextHandleNeedingPool) {
 
-            ExDestroyHandleTable(NewHandleTable, NULL);
-            NewHandleTable = NULL;
+            if (ExpAllocateHandleTableEntries(NewHandleTable) == FALSE) {
+                ExDestroyHandleTable(NewHandleTable, NULL);
+                NewHandleTable = NULL;
+                break;
+            }
+        }
+    }
 
-        } else {
+    if (NewHandleTable != NULL) {
 
-            //
-            // Scan through the old handle table and either duplicate the
-            // associated entry or insert it in the free list.
-            //
+        //
+        // Scan through the old handle table and either duplicate the
+        // associated entry or insert it in the free list.
+        //
+        // N.B. Handle entries in the old handle table may be locked by
+        //      threads mapping handles. The new handle entries are stored
+        //      unlocked.
+        //
 
-            NewTableEntries = NewHandleTable->TableEntries;
-            FreeHead = &NewTableEntries->ListEntry;
-            OldHandleEntry = &OldTableEntries[1];
-            NewHandleEntry = &NewTableEntries[1];
-            while (OldHandleEntry < OldTableBound) {
-                if (ExIsEntryFree(OldTableEntries, OldTableBound, OldHandleEntry)) {
-                    InsertTailList(FreeHead, &NewHandleEntry->ListEntry);
+        NewHandleTable->FirstFreeTableEntry = 0;
+        NewHandleTable->LastFreeTableEntry = 0;
+        for (TableIndex = 1;
+             TableIndex < OldHandleTable->NextHandleNeedingPool;
+             TableIndex += 1) {
 
-                } else {
-                    NewHandleEntry->Object = OldHandleEntry->Object;
-                    NewHandleEntry->Attributes = OldHandleEntry->Attributes;
-                    if (ARGUMENT_PRESENT(DupHandleProcedure)) {
-                        if ((*DupHandleProcedure)(Process, NewHandleEntry)) {
-                            NewHandleTable->HandleCount += 1;
+            OldHandleEntry = ExpLookupHandleTableEntry(OldHandleTable,
+                                                       INDEX_TO_HANDLE(TableIndex));
 
-                        } else {
-                            InsertTailList(FreeHead, &NewHandleEntry->ListEntry);
-                        }
+            NewHandleEntry = ExpLookupHandleTableEntry(NewHandleTable,
+                                                       INDEX_TO_HANDLE(TableIndex));
 
-                    } else {
+            Object = *((PVOID volatile *)&OldHandleEntry->Object);
+            if (Object == NULL) {
+                ExpFreeHandleTableEntry(NewHandleTable, NewHandleEntry, TableIndex);
+
+            } else {
+                NewHandleEntry->Object =
+                    (PVOID)((ULONG)Object | EX_HANDLE_ENTRY_LOCK_BIT);
+
+                NewHandleEntry->Attributes = OldHandleEntry->Attributes;
+                if (ARGUMENT_PRESENT(DupHandleProcedure)) {
+                    if ((*DupHandleProcedure)(Process, NewHandleEntry)) {
                         NewHandleTable->HandleCount += 1;
+
+                    } else {
+                        ExpFreeHandleTableEntry(NewHandleTable,
+                                                NewHandleEntry,
+                                                TableIndex);
                     }
-                }
 
-                NewHandleEntry += 1;
-                OldHandleEntry += 1;
+                } else {
+                    NewHandleTable->HandleCount += 1;
+                }
             }
         }
     }
@@ -1055,6 +1056,10 @@ Routine Description:
     caller via the optional Handle parameter, and this function returns
     TRUE to indicated that the enumeration stopped at a specific handle.
 
+    N.B. The handle entries are not locked and may be locked by another
+         thread that has mapped the handle. The object field of a locked
+         handle entry has the high bit clear.
+
 Arguments:
 
     HandleTable - Supplies a pointer to a handle table.
@@ -1080,8 +1085,6 @@ Return Value:
 
     PHANDLE_ENTRY HandleEntry;
     BOOLEAN ResultValue;
-    PHANDLE_ENTRY TableEntries;
-    PHANDLE_ENTRY TableBound;
     ULONG TableIndex;
 
     PAGED_CODE();
@@ -1089,17 +1092,19 @@ Return Value:
     ASSERT(HandleTable != NULL);
 
     //
-    // Lock the handle table exclusive and enumerate the handle entries.
+    // Lock the handle table shared and enumerate its handle entries.
     //
 
     ResultValue = FALSE;
     ExLockHandleTableShared(HandleTable);
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    HandleEntry = &TableEntries[1];
-    while (HandleEntry < TableBound) {
-        if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-            TableIndex = HandleEntry - TableEntries;
+    for (TableIndex = 1;
+         TableIndex < HandleTable->NextHandleNeedingPool;
+         TableIndex += 1) {
+
+        HandleEntry = ExpLookupHandleTableEntry(HandleTable,
+                                                INDEX_TO_HANDLE(TableIndex));
+
+        if (HandleEntry->Object != NULL) {
             if ((*EnumHandleProcedure)(HandleEntry,
                                         INDEX_TO_HANDLE(TableIndex),
                                         EnumParameter)) {
@@ -1112,8 +1117,6 @@ Return Value:
                 break;
             }
         }
-
-        HandleEntry += 1;
     }
 
     ExUnlockHandleTableShared(HandleTable);
@@ -1123,8 +1126,7 @@ Return Value:
 PHANDLE_ENTRY
 ExMapHandleToPointer(
     IN PHANDLE_TABLE HandleTable,
-    IN HANDLE Handle,
-    IN BOOLEAN Shared
+    IN HANDLE Handle
     )
 
 /*++
@@ -1133,7 +1135,10 @@ Routine Description:
 
     This function maps a handle to a pointer to a handle entry. If the
     map operation is successful, then this function returns with the
-    handle table locked.
+    handle entry locked.
+
+    N.B. The handle table is not locked. The caller is in a critical
+         region until the handle entry is unlocked.
 
 Arguments:
 
@@ -1141,59 +1146,89 @@ Arguments:
 
     Handle - Supplies the handle to be mapped to a handle entry.
 
-    Shared - Supplies a boolean value that determines whether the handle
-        table is locked for shared (TRUE) or exclusive (FALSE) access.
-
 Return Value:
 
     If the handle was successfully mapped to a pointer to a handle entry,
     then the address of the handle entry is returned as the function value
-    with the handle table locked. Otherwise, a value of NULL is returned with
-    the handle table unlocked.
+    with the handle entry locked. The handle entry is unlocked by calling
+    ExUnlockHandleTableEntry. Otherwise, a value of NULL is returned.
 
 --*/
 
 {
 
     PHANDLE_ENTRY HandleEntry;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
-    ULONG TableIndex;
 
     PAGED_CODE();
 
     ASSERT(HandleTable != NULL);
 
     //
-    // Lock the handle table exclusive or shared and check if the handle
-    // if valid.
+    // Look up the handle entry and lock it if it is in use.
     //
 
-    TableIndex = HANDLE_TO_INDEX(Handle);
-    if (Shared != FALSE) {
-        ExLockHandleTableShared(HandleTable);
-
-    } else {
-        ExLockHandleTableExclusive(HandleTable);
+    KeEnterCriticalRegion();
+    HandleEntry = ExpLookupHandleTableEntry(HandleTable, Handle);
+    if ((HandleEntry != NULL) &&
+        (ExpLockHandleTableEntry(HandleTable, HandleEntry) != FALSE)) {
+        return HandleEntry;
     }
 
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-        HandleEntry = &TableEntries[TableIndex];
-        if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-            return HandleEntry;
-        }
-    }
+    KeLeaveCriticalRegion();
+    return NULL;
+}
+
+VOID
+ExUnlockHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
+    )
+
+/*++
 
-    if (Shared != FALSE) {
-        ExUnlockHandleTableShared(HandleTable);
+Routine Description:
 
-    } else {
-        ExUnlockHandleTableExclusive(HandleTable);
+    This function unlocks a handle entry that was locked by a call to
+    ExMapHandleToPointer.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to a handle table.
+
+    HandleEntry - Supplies a pointer to the locked handle entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    ASSERT(HandleTable != NULL);
+    ASSERT((LONG)HandleEntry->Object > 0);
+
+    //
+    // Set the high bit of the object field to unlock the handle entry,
+    // leave the critical region, and wake any threads waiting for a
+    // handle entry.
+    //
+    // N.B. The wait list is checked without synchronization. A waiter
+    //      that is missed checks the handle entry again when its wait
+    //      times out.
+    //
+
+    InterlockedExchange((PLONG)&HandleEntry->Object,
+                        (LONG)HandleEntry->Object | EX_HANDLE_ENTRY_LOCK_BIT);
+
+    KeLeaveCriticalRegion();
+    if (IsListEmpty(&HandleTable->HandleContentionEvent.Header.WaitListHead) == FALSE) {
+        KePulseEvent(&HandleTable->HandleContentionEvent, 0, FALSE);
     }
 
-    return NULL;
+    return;
 }
 
 NTSTATUS
@@ -1228,8 +1263,6 @@ Return Value:
     PHANDLE_TABLE HandleTable;
     PLIST_ENTRY NextEntry;
     NTSTATUS Status;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
     ULONG TableIndex;
 
     PAGED_CODE();
@@ -1253,16 +1286,16 @@ Return Value:
 
             HandleTable = CONTAINING_RECORD(NextEntry, HANDLE_TABLE, ListEntry);
             ExLockHandleTableExclusive(HandleTable);
-            TableBound = HandleTable->TableBound;
-            TableEntries = HandleTable->TableEntries;
-            HandleEntry = &TableEntries[1];
             try {
-                for (HandleEntry = &TableEntries[1];
-                     HandleEntry < TableBound;
-                     HandleEntry++) {
-                    if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
+                for (TableIndex = 1;
+                     TableIndex < HandleTable->NextHandleNeedingPool;
+                     TableIndex += 1) {
+
+                    HandleEntry = ExpLookupHandleTableEntry(HandleTable,
+                                                            INDEX_TO_HANDLE(TableIndex));
+
+                    if (HandleEntry->Object != NULL) {
                         HandleInformation->NumberOfHandles += 1;
-                        TableIndex = HandleEntry - TableEntries;
                         Status = (*SnapShotHandleEntry)(&HandleEntryInfo,
                                                         HandleTable->UniqueProcessId,
                                                         HandleEntry,
@@ -1289,24 +1322,21 @@ Return Value:
 
 PHANDLE_TABLE
 ExpAllocateHandleTable(
-    IN PEPROCESS Process OPTIONAL,
-    IN ULONG CountToGrowBy
+    IN PEPROCESS Process OPTIONAL
     )
 
 /*++
 
 Routine Description:
 
-    This function allocates and initializes a new handle table descriptor.
+    This function allocates and initializes a new handle table descriptor
+    and the high level page of the handle table.
 
 Arguments:
 
     Process - Supplies an optional pointer to a process to charge quota
         against.
 
-    CountToGrowBy - Supplies the number of handle entries to grow the
-        handle table by.
-
 Return Value:
 
     If a handle is successfully allocated, then the address of the handle
@@ -1317,11 +1347,13 @@ Return Value:
 {
 
     PHANDLE_TABLE HandleTable;
+    PHANDLE_ENTRY **Table;
 
     PAGED_CODE();
 
     //
-    // Allocate handle table from nonpaged pool.
+    // Allocate handle table from nonpaged pool and the high level page
+    // from paged pool.
     //
 
     HandleTable =
@@ -1329,192 +1361,441 @@ Return Value:
                                              sizeof(HANDLE_TABLE),
                                              'btbO');
 
+    if (HandleTable == NULL) {
+        return NULL;
+    }
+
+    Table = (PHANDLE_ENTRY **)ExAllocatePoolWithTag(PagedPool,
+                                                    HIGHLEVEL_SIZE,
+                                                    'btbO');
+
+    if (Table == NULL) {
+        ExFreePool(HandleTable);
+        return NULL;
+    }
+
     //
-    // If the allocation is successful, then attempt to charge quota as
-    // appropriate and initialize the handle tabel descriptor.
+    // Attempt to charge quota as appropriate and initialize the handle
+    // tabel descriptor.
     //
 
-    if (HandleTable != NULL) {
-        if (ARGUMENT_PRESENT(Process)) {
-            try {
-                PsChargePoolQuota(Process,
-                                  NonPagedPool,
-                                  sizeof(HANDLE_TABLE));
+    if (ARGUMENT_PRESENT(Process)) {
+        try {
+            PsChargePoolQuota(Process,
+                              NonPagedPool,
+                              sizeof(HANDLE_TABLE));
 
-            } except (EXCEPTION_EXECUTE_HANDLER) {
-                ExFreePool(HandleTable);
-                return NULL;
-            }
+        } except (EXCEPTION_EXECUTE_HANDLER) {
+            ExFreePool(Table);
+            ExFreePool(HandleTable);
+            return NULL;
         }
 
-        //
-        // Initialize the handle table access synchronization information.
-        //
+        try {
+            PsChargePoolQuota(Process, PagedPool, HIGHLEVEL_SIZE);
 
-        HandleTable->State.u.OwnerCount = 0;
-        HandleTable->State.u.NumberOfSharedWaiters = 0;
-        HandleTable->State.u.NumberOfExclusiveWaiters = 0;
-        KeInitializeSpinLock(&HandleTable->SpinLock);
-        KeInitializeSemaphore(&HandleTable->SharedWaiters, 0, MAXLONG);
-        KeInitializeEvent(&HandleTable->ExclusiveWaiters,
-                          SynchronizationEvent,
-                          FALSE);
+        } except (EXCEPTION_EXECUTE_HANDLER) {
+            PsReturnPoolQuota(Process, NonPagedPool, sizeof(HANDLE_TABLE));
+            ExFreePool(Table);
+            ExFreePool(HandleTable);
+            return NULL;
+        }
+    }
 
-        //
-        // Initialize the handle table descriptor.
-        //
+    //
+    // Initialize the handle table access synchronization information.
+    //
 
-        HandleTable->LifoOrder = FALSE;
-        HandleTable->UniqueProcessId = PsGetCurrentProcess()->UniqueProcessId;
-        HandleTable->TableEntries = NULL;
-        HandleTable->TableBound = NULL;
-        HandleTable->QuotaProcess = Process;
-        HandleTable->HandleCount = 0;
-        HandleTable->CountToGrowBy = (USHORT)CountToGrowBy;
+    HandleTable->State.u.OwnerCount = 0;
+    HandleTable->State.u.NumberOfSharedWaiters = 0;
+    HandleTable->State.u.NumberOfExclusiveWaiters = 0;
+    KeInitializeSpinLock(&HandleTable->SpinLock);
+    KeInitializeSemaphore(&HandleTable->SharedWaiters, 0, MAXLONG);
+    KeInitializeEvent(&HandleTable->ExclusiveWaiters,
+                      SynchronizationEvent,
+                      FALSE);
 
-        //
-        // Insert the handle table in the handle table list.
-        //
+    KeInitializeEvent(&HandleTable->HandleContentionEvent,
+                      NotificationEvent,
+                      FALSE);
 
-        KeEnterCriticalRegion();
-        ExAcquireResourceExclusive(&HandleTableListLock, TRUE);
-        InsertTailList(&HandleTableListHead, &HandleTable->ListEntry);
-        ExReleaseResource(&HandleTableListLock);
-        KeLeaveCriticalRegion();
-    }
+    //
+    // Initialize the handle table descriptor.
+    //
+
+    RtlZeroMemory(Table, HIGHLEVEL_SIZE);
+    HandleTable->Table = Table;
+    HandleTable->NextHandleNeedingPool = 0;
+    HandleTable->FirstFreeTableEntry = 0;
+    HandleTable->LastFreeTableEntry = 0;
+    HandleTable->LifoOrder = FALSE;
+    HandleTable->UniqueProcessId = PsGetCurrentProcess()->UniqueProcessId;
+    HandleTable->QuotaProcess = Process;
+    HandleTable->HandleCount = 0;
+
+    //
+    // Insert the handle table in the handle table list.
+    //
 
+    KeEnterCriticalRegion();
+    ExAcquireResourceExclusive(&HandleTableListLock, TRUE);
+    InsertTailList(&HandleTableListHead, &HandleTable->ListEntry);
+    ExReleaseResource(&HandleTableListLock);
+    KeLeaveCriticalRegion();
     return HandleTable;
 }
 
-PHANDLE_ENTRY
+BOOLEAN
 ExpAllocateHandleTableEntries(
-    IN PHANDLE_TABLE HandleTable,
-    IN PHANDLE_ENTRY OldTableEntries,
-    IN ULONG OldCountEntries,
-    IN ULONG NewCountEntries
+    IN PHANDLE_TABLE HandleTable
     )
 
 /*++
 
 Routine Description:
 
-    This function allocates and initializes a new set of free handle
-    table entries.
+    This function allocates and initializes the next page of free handle
+    table entries and, if necessary, the mid level page that refers to
+    it. The new handle entries are appended to the free list.
+
+    N.B. The handle table must be locked exclusive by the caller or not
+         yet visible to other threads. Existing handle entries are not
+         moved.
 
 Arguments:
 
     HandleTable - Supplies a pointer to a handle table descriptor.
 
-    OldTableEntries - Supplies a pointer to the old set of handle table
-        entries.
-
-    OldCountEntries - Supplies the previous count of table entries.
-
-    NewCountEntries - Supplies the desired count of table entries.
-
 Return Value:
 
-    If a new set of handle entries is successfully allocated, then the
-    address of the handle entries is returned as the function value.
-    Otherwise, NULL is returned.
+    If a new page of handle entries is successfully allocated, then a
+    value of TRUE is returned. Otherwise, a value of FALSE is returned.
 
 --*/
 
 {
 
+    ULONG CountBytes;
     PHANDLE_ENTRY FreeEntry;
-    PLIST_ENTRY FreeHead;
-    ULONG NewCountBytes;
-    PHANDLE_ENTRY NewTableBound;
-    PHANDLE_ENTRY NewTableEntries;
-    LONG OldCountBytes;
+    ULONG FirstIndex;
+    PHANDLE_ENTRY LowLevel;
+    PHANDLE_ENTRY *MidLevel;
+    PHANDLE_ENTRY *NewMidLevel;
+    ULONG PageIndex;
     PEPROCESS Process;
-    BOOLEAN Status;
+    ULONG TableIndex;
 
     PAGED_CODE();
 
-    ASSERT(NewCountEntries > OldCountEntries);
+    //
+    // If the handle table has reached its maximum size, then no more
+    // handle entries can be allocated.
+    //
+
+    TableIndex = HandleTable->NextHandleNeedingPool;
+    if (TableIndex >= MAX_HANDLES) {
+        return FALSE;
+    }
 
     //
-    // Compute the old and new sizes for the handle entry table and
-    // allocate a new handle entry table.
+    // Allocate the low level page and, if the mid level page does not
+    // exist, a mid level page.
     //
 
-    OldCountBytes = OldCountEntries * sizeof(HANDLE_ENTRY);
-    NewCountBytes = NewCountEntries * sizeof(HANDLE_ENTRY);
-    NewTableEntries = (PHANDLE_ENTRY)ExAllocatePoolWithTag(PagedPool,
-                                                           NewCountBytes,
-                                                           'btbO');
+    LowLevel = (PHANDLE_ENTRY)ExAllocatePoolWithTag(PagedPool,
+                                                    LOWLEVEL_SIZE,
+                                                    'btbO');
+
+    if (LowLevel == NULL) {
+        return FALSE;
+    }
+
+    CountBytes = LOWLEVEL_SIZE;
+    NewMidLevel = NULL;
+    MidLevel = HandleTable->Table[HIGHLEVEL_INDEX(TableIndex)];
+    if (MidLevel == NULL) {
+        NewMidLevel = (PHANDLE_ENTRY *)ExAllocatePoolWithTag(PagedPool,
+                                                             MIDLEVEL_SIZE,
+                                                             'btbO');
+
+        if (NewMidLevel == NULL) {
+            ExFreePool(LowLevel);
+            return FALSE;
+        }
+
+        RtlZeroMemory(NewMidLevel, MIDLEVEL_SIZE);
+        MidLevel = NewMidLevel;
+        CountBytes += MIDLEVEL_SIZE;
+    }
 
     //
-    // If the allocation is successful, then attempt to charge quota as
-    // appropriate and initialize the free list of handle entries.
+    // Attempt to charge quota as appropriate.
     //
 
-    if (NewTableEntries != NULL) {
-        Process = HandleTable->QuotaProcess;
-        if (Process != NULL) {
-            try {
-                PsChargePoolQuota(Process,
-                                  PagedPool,
-                                  NewCountBytes - OldCountBytes);
+    Process = HandleTable->QuotaProcess;
+    if (Process != NULL) {
+        try {
+            PsChargePoolQuota(Process, PagedPool, CountBytes);
 
-            } except (EXCEPTION_EXECUTE_HANDLER) {
-                ExFreePool(NewTableEntries);
-                return NULL;
+        } except (EXCEPTION_EXECUTE_HANDLER) {
+            if (NewMidLevel != NULL) {
+                ExFreePool(NewMidLevel);
             }
+
+            ExFreePool(LowLevel);
+            return FALSE;
         }
+    }
 
-        //
-        // Initialize the free listhead.
-        //
+    //
+    // Initialize the new handle entries as a chain of free entries in
+    // ascending order.
+    //
+    // N.B. Handle index zero is never used and is not put on the free
+    //      list.
+    //
 
-        FreeHead = &NewTableEntries->ListEntry;
-        InitializeListHead(FreeHead);
+    PageIndex = TableIndex;
+    for (FreeEntry = &LowLevel[0];
+         FreeEntry < &LowLevel[LOWLEVEL_COUNT];
+         FreeEntry += 1) {
 
-        //
-        // If a new handle table is being created or an existing handle
-        // table is being extended, then initialize the free entry list
-        // allocated in the extension.
-        //
+        FreeEntry->Object = NULL;
+        FreeEntry->NextFreeTableEntry = TableIndex + 1;
+        TableIndex += 1;
+    }
 
-        NewTableBound = &NewTableEntries[NewCountEntries];
-        if ((OldTableEntries == NULL) || (OldCountEntries != 0)) {
-            if (OldCountEntries == 0) {
-                FreeEntry = &NewTableEntries[1];
+    LowLevel[LOWLEVEL_COUNT - 1].NextFreeTableEntry = 0;
+    FirstIndex = (PageIndex == 0) ? 1 : PageIndex;
 
-            } else {
-                FreeEntry = &NewTableEntries[OldCountEntries];
-            }
+    //
+    // Publish the new pages before the handle table bound is raised so
+    // lookups that do not lock the handle table never find a partially
+    // initialized page.
+    //
+
+    if (NewMidLevel != NULL) {
+        InterlockedExchange((PLONG)&HandleTable->Table[HIGHLEVEL_INDEX(PageIndex)],
+                            (LONG)NewMidLevel);
+    }
 
-            do {
-                InsertTailList(FreeHead, &FreeEntry->ListEntry);
-                FreeEntry += 1;
-            } while (FreeEntry < NewTableBound);
+    InterlockedExchange((PLONG)&MidLevel[MIDLEVEL_INDEX(PageIndex)],
+                        (LONG)LowLevel);
 
-            //
-            // If there is an old handle entry table, then move the old
-            // handle entires to the new handle entry table and free the
-            // old handle entry table.
-            //
+    InterlockedExchange((PLONG)&HandleTable->NextHandleNeedingPool,
+                        (LONG)TableIndex);
 
-            if (OldTableEntries != NULL) {
-                RtlMoveMemory(&NewTableEntries[1],
-                              &OldTableEntries[1],
-                              OldCountBytes - sizeof(HANDLE_ENTRY));
+    //
+    // Append the new handle entries to the free list.
+    //
 
-                ExFreePool(OldTableEntries);
-            }
+    if (HandleTable->LastFreeTableEntry != 0) {
+        FreeEntry = ExpLookupHandleTableEntry(HandleTable,
+                                              INDEX_TO_HANDLE(HandleTable->LastFreeTableEntry));
+
+        FreeEntry->NextFreeTableEntry = FirstIndex;
+
+    } else {
+        HandleTable->FirstFreeTableEntry = FirstIndex;
+    }
+
+    HandleTable->LastFreeTableEntry = TableIndex - 1;
+    return TRUE;
+}
+
+VOID
+ExpFreeHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry,
+    IN ULONG TableIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts a handle entry in the free list of a handle
+    table according to the discipline associated with the handle table.
+
+    N.B. The handle table must be locked exclusive by the caller or not
+         yet visible to other threads.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to a handle table descriptor.
+
+    HandleEntry - Supplies a pointer to the handle entry to free.
+
+    TableIndex - Supplies the index of the handle entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PHANDLE_ENTRY LastEntry;
+
+    PAGED_CODE();
+
+    //
+    // Link the handle entry in the free list and then clear the object
+    // field, which makes the handle entry free to lookups that do not
+    // lock the handle table.
+    //
+
+    if (HandleTable->LifoOrder != FALSE) {
+        HandleEntry->NextFreeTableEntry = HandleTable->FirstFreeTableEntry;
+        InterlockedExchange((PLONG)&HandleEntry->Object, 0);
+        HandleTable->FirstFreeTableEntry = TableIndex;
+        if (HandleTable->LastFreeTableEntry == 0) {
+            HandleTable->LastFreeTableEntry = TableIndex;
+        }
+
+    } else {
+        HandleEntry->NextFreeTableEntry = 0;
+        InterlockedExchange((PLONG)&HandleEntry->Object, 0);
+        if (HandleTable->LastFreeTableEntry != 0) {
+            LastEntry = ExpLookupHandleTableEntry(HandleTable,
+                                                  INDEX_TO_HANDLE(HandleTable->LastFreeTableEntry));
+
+            LastEntry->NextFreeTableEntry = TableIndex;
+
+        } else {
+            HandleTable->FirstFreeTableEntry = TableIndex;
         }
 
+        HandleTable->LastFreeTableEntry = TableIndex;
+    }
+
+    return;
+}
+
+PHANDLE_ENTRY
+ExpLookupHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN HANDLE Handle
+    )
+
+/*++
+
+Routine Description:
+
+    This function computes the address of the handle entry for a handle
+    without locking the handle table.
+
+    N.B. The returned handle entry may be free or locked.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to a handle table descriptor.
+
+    Handle - Supplies the handle to look up.
+
+Return Value:
+
+    If the handle is within the allocated pages of the handle table, then
+    the address of the handle entry is returned as the function value.
+    Otherwise, a value of NULL is returned.
+
+--*/
+
+{
+
+    PHANDLE_ENTRY LowLevel;
+    PHANDLE_ENTRY *MidLevel;
+    ULONG TableIndex;
+
+    PAGED_CODE();
+
+    //
+    // Handle index zero is never valid. Pages below the handle table bound
+    // are published before the bound is raised and are never freed while
+    // the handle table exists.
+    //
+
+    TableIndex = HANDLE_TO_INDEX(Handle);
+    if ((TableIndex == 0) ||
+        (TableIndex >= *((ULONG volatile *)&HandleTable->NextHandleNeedingPool))) {
+        return NULL;
+    }
+
+    MidLevel = *((PHANDLE_ENTRY * volatile *)&HandleTable->Table[HIGHLEVEL_INDEX(TableIndex)]);
+    if (MidLevel == NULL) {
+        return NULL;
+    }
+
+    LowLevel = *((PHANDLE_ENTRY volatile *)&MidLevel[MIDLEVEL_INDEX(TableIndex)]);
+    if (LowLevel == NULL) {
+        return NULL;
+    }
+
+    return &LowLevel[LOWLEVEL_INDEX(TableIndex)];
+}
+
+BOOLEAN
+ExpLockHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This function locks a handle entry. An in use handle entry has the
+    high bit of its object field set since the field holds a system space
+    address. The handle entry is locked by clearing the bit. A free handle
+    entry has an object field of zero.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to a handle table descriptor.
+
+    HandleEntry - Supplies a pointer to the handle entry to lock.
+
+Return Value:
+
+    If the handle entry is in use and was locked, then a value of TRUE is
+    returned. If the handle entry is free, then a value of FALSE is returned.
+
+--*/
+
+{
+
+    LONG CurrentValue;
+
+    PAGED_CODE();
+
+    do {
+
         //
-        // Set the new count of table entries, the new table bound, and
-        // the address of the new table entries.
+        // If the handle entry is in use and not locked, then attempt to
+        // lock it. If the handle entry is free, then fail. Otherwise, the
+        // handle entry is locked by another thread; wait for it to be
+        // unlocked and try again.
         //
 
-        HandleTable->TableBound = NewTableBound;
-        HandleTable->TableEntries = NewTableEntries;
-    }
+        CurrentValue = *((LONG volatile *)&HandleEntry->Object);
+        if (CurrentValue < 0) {
+            if ((LONG)InterlockedCompareExchange((PVOID *)&HandleEntry->Object,
+                                                 (PVOID)(CurrentValue & ~EX_HANDLE_ENTRY_LOCK_BIT),
+                                                 (PVOID)CurrentValue) == CurrentValue) {
+                return TRUE;
+            }
+
+        } else if (CurrentValue == 0) {
+            return FALSE;
+
+        } else {
+            KeWaitForSingleObject(&HandleTable->HandleContentionEvent,
+                                  Executive,
+                                  KernelMode,
+                                  FALSE,
+                                  &ExpHandleContentionTimeout);
+        }
 
-    return NewTableEntries;
+    } while (TRUE);
 }
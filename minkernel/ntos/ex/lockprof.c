@@ -0,0 +1,1178 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    lockprof.c
+
+Abstract:
+
+    This module implements lock profiling for executive resources, fast
+    mutexes, and executive spin locks.
+
+    When lock profiling is enabled, each acquire of a profiled lock is
+    recorded in a table of call sites, which is keyed by the address of
+    the lock and the address the lock was acquired from. Each call site
+    entry holds the number of acquires, the number of acquires that had
+    to wait for the lock, and the total time spent waiting for the lock
+    and holding it exclusive. The call site entries are summarized by lock
+    when the profile is queried.
+
+    The tables are allocated the first time profiling is enabled and are
+    never freed, so the profiling routines do not take any locks and may
+    be called at any IRQL. Each entry is tagged with the epoch it was
+    claimed in, and each enable of profiling starts a new epoch. Entries
+    of earlier epochs are free and are claimed again by the locks and call
+    sites of the new profile, so locks that come and go do not use up the
+    tables. The entries are never cleared in place, since an acquire that
+    is waiting for a resource may hold a pointer to a call site entry
+    across the wait. If a table fills up within an epoch, further acquires
+    of new locks or from new call sites are only counted as dropped.
+
+    Spin locks and fast mutexes are profiled through the executive macros
+    that acquire and release them, which call the routines in this module
+    when profiling is enabled. Executive resources are profiled by the
+    resource package itself.
+
+    N.B. Lock profiling is only supported on MP systems.
+
+Environment:
+
+    Kernel mode only.
+
+Revision History:
+
+--*/
+
+#include "exp.h"
+#pragma hdrstop
+
+//
+// The profiling routines call the fast mutex routines directly.
+//
+
+#undef ExAcquireFastMutex
+#undef ExReleaseFastMutex
+
+//
+// Define the size of the lock and call site tables and the number of
+// entries that are probed to find an entry.
+//
+// N.B. The table sizes must be a power of two.
+//
+
+#define LOCK_PROFILE_LOCKS 1024
+#define LOCK_PROFILE_SITES 4096
+#define LOCK_PROFILE_PROBES 32
+
+//
+// The hash multiplies the address by the golden ratio so that locks and
+// call sites at nearby addresses are spread over the tables instead of
+// clustering within the probe distance.
+//
+
+#define LOCK_PROFILE_HASH(Address) \
+    ((((ULONG)(Address) >> 3) * 0x9E3779B1) >> 16)
+
+//
+// Define the epoch of an entry that is being claimed.
+//
+// N.B. The profile epoch is never zero or the claiming epoch.
+//
+
+#define LOCK_PROFILE_CLAIMING 0xffffffff
+
+//
+// Define lock and call site table entry structures.
+//
+
+typedef struct _LOCK_PROFILE_LOCK {
+    ULONG Epoch;
+    PVOID Lock;
+    ULONG LockType;
+    PLOCK_PROFILE_SITE Holder;
+    LARGE_INTEGER HoldStart;
+} LOCK_PROFILE_LOCK, *PLOCK_PROFILE_LOCK;
+
+typedef struct _LOCK_PROFILE_SITE {
+    ULONG Epoch;
+    PVOID Lock;
+    PVOID CallSite;
+    PLOCK_PROFILE_LOCK LockEntry;
+    ULONG AcquireCount;
+    ULONG ContentionCount;
+    LARGE_INTEGER WaitTime;
+    LARGE_INTEGER HoldTime;
+} LOCK_PROFILE_SITE;
+
+//
+// Define macro to rank the call sites of a lock by contention and then by
+// the number of acquires.
+//
+
+#define RanksAbove(a, b)                                                  \
+    (((a)->ContentionCount > (b)->ContentionCount) ||                     \
+     (((a)->ContentionCount == (b)->ContentionCount) &&                   \
+      ((a)->AcquireCount > (b)->AcquireCount)))
+
+//
+// Define forward referenced prototypes.
+//
+
+VOID
+ExpLockProfileAcquired (
+    IN PVOID Lock,
+    IN ULONG LockType,
+    IN PVOID CallSite,
+    IN PLARGE_INTEGER WaitStart OPTIONAL
+    );
+
+VOID
+ExpLockProfileAddTime (
+    IN PLARGE_INTEGER Time,
+    IN PLARGE_INTEGER StartTime,
+    IN PLARGE_INTEGER EndTime
+    );
+
+PLOCK_PROFILE_LOCK
+ExpLockProfileLookupLock (
+    IN PVOID Lock,
+    IN ULONG LockType,
+    IN BOOLEAN Insert
+    );
+
+PLOCK_PROFILE_SITE
+ExpLockProfileLookupSite (
+    IN PLOCK_PROFILE_LOCK LockEntry,
+    IN PVOID CallSite
+    );
+
+VOID
+ExpSummarizeLockProfile (
+    IN PLOCK_PROFILE_LOCK LockEntry,
+    OUT PSYSTEM_LOCK_PROFILE_ENTRY Summary
+    );
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, ExpGetLockProfileInformation)
+#pragma alloc_text(PAGE, ExpSetLockProfileInformation)
+#pragma alloc_text(PAGE, ExpSummarizeLockProfile)
+#endif
+
+//
+// Lock profiling state.
+//
+
+BOOLEAN ExpLockProfileEnabled;
+ULONG ExpLockProfileEpoch;
+FAST_MUTEX ExpLockProfileLock;
+PLOCK_PROFILE_LOCK ExpLockProfileLocks;
+PLOCK_PROFILE_SITE ExpLockProfileSites;
+ULONG ExpLockProfileDropped;
+
+PLOCK_PROFILE_SITE
+ExpLockProfileAcquire (
+    IN PVOID Lock,
+    IN ULONG LockType,
+    IN PVOID CallSite
+    )
+
+/*++
+
+Routine Description:
+
+    This function records an acquire of the specified lock from the
+    specified call site.
+
+Arguments:
+
+    Lock - Supplies the address of the lock.
+
+    LockType - Supplies the type of the lock.
+
+    CallSite - Supplies the address the lock is acquired from.
+
+Return Value:
+
+    A pointer to the call site entry is returned as the function value if
+    the acquire is recorded. Otherwise, NULL is returned.
+
+--*/
+
+{
+
+    PLOCK_PROFILE_LOCK LockEntry;
+    PLOCK_PROFILE_SITE Site;
+
+    Site = NULL;
+    LockEntry = ExpLockProfileLookupLock(Lock, LockType, TRUE);
+    if (LockEntry != NULL) {
+        Site = ExpLockProfileLookupSite(LockEntry, CallSite);
+    }
+
+    if (Site == NULL) {
+        InterlockedIncrement((PLONG)&ExpLockProfileDropped);
+        return NULL;
+    }
+
+    InterlockedIncrement((PLONG)&Site->AcquireCount);
+    return Site;
+}
+
+VOID
+ExpLockProfileContention (
+    IN PLOCK_PROFILE_SITE Site,
+    IN PLARGE_INTEGER WaitStart
+    )
+
+/*++
+
+Routine Description:
+
+    This function records an acquire that had to wait for the lock.
+
+Arguments:
+
+    Site - Supplies a pointer to the call site entry of the acquire.
+
+    WaitStart - Supplies the performance counter value when the wait
+        started.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LARGE_INTEGER CurrentTime;
+
+    //
+    // If the call site entry was claimed again by a new profile while the
+    // acquire waited, then the wait is not recorded.
+    //
+
+    if (Site->Epoch != ExpLockProfileEpoch) {
+        return;
+    }
+
+    CurrentTime = KeQueryPerformanceCounter(NULL);
+    InterlockedIncrement((PLONG)&Site->ContentionCount);
+    ExpLockProfileAddTime(&Site->WaitTime, WaitStart, &CurrentTime);
+    return;
+}
+
+VOID
+ExpLockProfileHoldStart (
+    IN PLOCK_PROFILE_SITE Site
+    )
+
+/*++
+
+Routine Description:
+
+    This function records that the lock of the specified call site entry
+    was acquired exclusive.
+
+    N.B. This function is called with the lock held exclusive, which
+         synchronizes access to the hold time fields of the lock entry.
+
+Arguments:
+
+    Site - Supplies a pointer to the call site entry of the acquire.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLOCK_PROFILE_LOCK LockEntry;
+
+    //
+    // If the call site entry does not describe the lock, then the hold is
+    // not recorded.
+    //
+
+    LockEntry = Site->LockEntry;
+    if ((LockEntry == NULL) ||
+        (LockEntry->Epoch != Site->Epoch) ||
+        (LockEntry->Lock != Site->Lock)) {
+        return;
+    }
+
+    LockEntry->HoldStart = KeQueryPerformanceCounter(NULL);
+    LockEntry->Holder = Site;
+    return;
+}
+
+VOID
+ExpLockProfileHoldEnd (
+    IN PVOID Lock
+    )
+
+/*++
+
+Routine Description:
+
+    This function records that an exclusive hold of the specified lock
+    is ending and charges the hold time to the call site that acquired
+    the lock.
+
+    N.B. This function is called before the lock is released.
+
+Arguments:
+
+    Lock - Supplies the address of the lock.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LARGE_INTEGER CurrentTime;
+    PLOCK_PROFILE_LOCK LockEntry;
+    PLOCK_PROFILE_SITE Site;
+
+    LockEntry = ExpLockProfileLookupLock(Lock, 0, FALSE);
+    if (LockEntry != NULL) {
+        Site = LockEntry->Holder;
+        LockEntry->Holder = NULL;
+        if ((Site != NULL) &&
+            (Site->Epoch == LockEntry->Epoch) &&
+            (Site->LockEntry == LockEntry)) {
+            CurrentTime = KeQueryPerformanceCounter(NULL);
+            ExpLockProfileAddTime(&Site->HoldTime,
+                                  &LockEntry->HoldStart,
+                                  &CurrentTime);
+        }
+    }
+
+    return;
+}
+
+VOID
+FASTCALL
+ExpProfileAcquireSpinLock (
+    IN PKSPIN_LOCK SpinLock,
+    OUT PKIRQL OldIrql
+    )
+
+/*++
+
+Routine Description:
+
+    This function acquires the specified spin lock and raises IRQL to
+    dispatch level, and records the acquire.
+
+Arguments:
+
+    SpinLock - Supplies a pointer to the spin lock.
+
+    OldIrql - Supplies a pointer to a variable that receives the previous
+        IRQL.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOLEAN Contended;
+    LARGE_INTEGER WaitStart;
+
+    Contended = (BOOLEAN)(*((volatile KSPIN_LOCK *)SpinLock) != 0);
+    if (Contended != FALSE) {
+        WaitStart = KeQueryPerformanceCounter(NULL);
+    }
+
+    KeAcquireSpinLock(SpinLock, OldIrql);
+    ExpLockProfileAcquired(SpinLock,
+                           LOCK_PROFILE_SPIN_LOCK,
+                           _ReturnAddress(),
+                           Contended ? &WaitStart : NULL);
+
+    return;
+}
+
+VOID
+FASTCALL
+ExpProfileReleaseSpinLock (
+    IN PKSPIN_LOCK SpinLock,
+    IN KIRQL OldIrql
+    )
+
+/*++
+
+Routine Description:
+
+    This function records the end of the hold of the specified spin lock,
+    releases the spin lock, and lowers IRQL to its previous value.
+
+Arguments:
+
+    SpinLock - Supplies a pointer to the spin lock.
+
+    OldIrql - Supplies the previous IRQL.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ExpLockProfileHoldEnd(SpinLock);
+    KeReleaseSpinLock(SpinLock, OldIrql);
+    return;
+}
+
+VOID
+FASTCALL
+ExpProfileAcquireSpinLockAtDpcLevel (
+    IN PKSPIN_LOCK SpinLock
+    )
+
+/*++
+
+Routine Description:
+
+    This function acquires the specified spin lock at dispatch level or
+    above, and records the acquire.
+
+Arguments:
+
+    SpinLock - Supplies a pointer to the spin lock.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOLEAN Contended;
+    LARGE_INTEGER WaitStart;
+
+    Contended = (BOOLEAN)(*((volatile KSPIN_LOCK *)SpinLock) != 0);
+    if (Contended != FALSE) {
+        WaitStart = KeQueryPerformanceCounter(NULL);
+    }
+
+    KeAcquireSpinLockAtDpcLevel(SpinLock);
+    ExpLockProfileAcquired(SpinLock,
+                           LOCK_PROFILE_SPIN_LOCK,
+                           _ReturnAddress(),
+                           Contended ? &WaitStart : NULL);
+
+    return;
+}
+
+VOID
+FASTCALL
+ExpProfileReleaseSpinLockFromDpcLevel (
+    IN PKSPIN_LOCK SpinLock
+    )
+
+/*++
+
+Routine Description:
+
+    This function records the end of the hold of the specified spin lock
+    and releases the spin lock without lowering IRQL.
+
+Arguments:
+
+    SpinLock - Supplies a pointer to the spin lock.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ExpLockProfileHoldEnd(SpinLock);
+    KeReleaseSpinLockFromDpcLevel(SpinLock);
+    return;
+}
+
+VOID
+FASTCALL
+ExpProfileAcquireFastMutex (
+    IN PFAST_MUTEX FastMutex
+    )
+
+/*++
+
+Routine Description:
+
+    This function acquires the specified fast mutex and records the
+    acquire.
+
+Arguments:
+
+    FastMutex - Supplies a pointer to the fast mutex.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOLEAN Contended;
+    LARGE_INTEGER WaitStart;
+
+    Contended = (BOOLEAN)(*((volatile LONG *)&FastMutex->Count) != 1);
+    if (Contended != FALSE) {
+        WaitStart = KeQueryPerformanceCounter(NULL);
+    }
+
+    ExAcquireFastMutex(FastMutex);
+    ExpLockProfileAcquired(FastMutex,
+                           LOCK_PROFILE_FAST_MUTEX,
+                           _ReturnAddress(),
+                           Contended ? &WaitStart : NULL);
+
+    return;
+}
+
+VOID
+FASTCALL
+ExpProfileReleaseFastMutex (
+    IN PFAST_MUTEX FastMutex
+    )
+
+/*++
+
+Routine Description:
+
+    This function records the end of the hold of the specified fast mutex
+    and releases the fast mutex.
+
+Arguments:
+
+    FastMutex - Supplies a pointer to the fast mutex.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ExpLockProfileHoldEnd(FastMutex);
+    ExReleaseFastMutex(FastMutex);
+    return;
+}
+
+NTSTATUS
+ExpGetLockProfileInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the lock profile. Each lock that was acquired
+    while profiling was enabled is described by the totals of all of its
+    call sites and by the call sites with the most contention.
+
+Arguments:
+
+    SystemInformation - Supplies a pointer to the buffer which receives the
+        lock profile information.
+
+    SystemInformationLength - Supplies the length of the buffer in bytes.
+
+    Length - Supplies a pointer to a variable that receives the length of
+        the information required.
+
+Return Value:
+
+    STATUS_SUCCESS if the information is returned. Otherwise,
+    STATUS_INFO_LENGTH_MISMATCH if the buffer is too small.
+
+--*/
+
+{
+
+    PSYSTEM_LOCK_PROFILE_ENTRY Entry;
+    ULONG Epoch;
+    LARGE_INTEGER Frequency;
+    ULONG Index;
+    PSYSTEM_LOCK_PROFILE_INFORMATION Information;
+    PLOCK_PROFILE_LOCK LockEntry;
+    ULONG Probe;
+    NTSTATUS Status;
+    SYSTEM_LOCK_PROFILE_ENTRY Summary;
+
+    PAGED_CODE();
+
+    *Length = FIELD_OFFSET(SYSTEM_LOCK_PROFILE_INFORMATION, Locks);
+    if (SystemInformationLength < *Length) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    KeQueryPerformanceCounter(&Frequency);
+    Information = (PSYSTEM_LOCK_PROFILE_INFORMATION)SystemInformation;
+    Status = STATUS_SUCCESS;
+    ExAcquireFastMutex(&ExpLockProfileLock);
+    try {
+        Information->Enabled = ExpLockProfileEnabled;
+        Information->NumberOfLocks = 0;
+        Information->DroppedAcquires = ExpLockProfileDropped;
+        Information->Frequency = Frequency;
+        if (ExpLockProfileLocks != NULL) {
+            Entry = &Information->Locks[0];
+            Epoch = ExpLockProfileEpoch;
+            for (Index = 0; Index < LOCK_PROFILE_LOCKS; Index += 1) {
+                LockEntry = &ExpLockProfileLocks[Index];
+                if (LockEntry->Epoch != Epoch) {
+                    continue;
+                }
+
+                //
+                // If two processors claimed an entry for the same lock at
+                // the same time, then the lock has two entries. Only the
+                // first entry in probe order is returned, since the call
+                // sites of both entries are summarized by lock address.
+                //
+
+                Probe = LOCK_PROFILE_HASH(LockEntry->Lock) & (LOCK_PROFILE_LOCKS - 1);
+                while ((Probe != Index) &&
+                       ((ExpLockProfileLocks[Probe].Epoch != Epoch) ||
+                        (ExpLockProfileLocks[Probe].Lock != LockEntry->Lock))) {
+                    Probe = (Probe + 1) & (LOCK_PROFILE_LOCKS - 1);
+                }
+
+                if (Probe != Index) {
+                    continue;
+                }
+
+                //
+                // Locks that have not been acquired since profiling was
+                // last enabled are not returned.
+                //
+
+                ExpSummarizeLockProfile(LockEntry, &Summary);
+                if (Summary.AcquireCount == 0) {
+                    continue;
+                }
+
+                Information->NumberOfLocks += 1;
+                *Length += sizeof(SYSTEM_LOCK_PROFILE_ENTRY);
+                if (SystemInformationLength < *Length) {
+                    Status = STATUS_INFO_LENGTH_MISMATCH;
+
+                } else {
+                    *Entry = Summary;
+                    Entry += 1;
+                }
+            }
+        }
+
+    } finally {
+        ExReleaseFastMutex(&ExpLockProfileLock);
+    }
+
+    return Status;
+}
+
+NTSTATUS
+ExpSetLockProfileInformation (
+    IN BOOLEAN Enable
+    )
+
+/*++
+
+Routine Description:
+
+    This function enables or disables lock profiling. Enabling profiling
+    discards the current profile. Disabling profiling keeps the current
+    profile so it can be queried.
+
+    N.B. Acquires that are in progress when profiling is enabled or
+         disabled may still be recorded.
+
+    N.B. The profile is discarded by starting a new epoch, which frees
+         all of the table entries at once. The entries are not cleared,
+         since other processors may hold pointers to them, and are reset
+         when they are claimed again.
+
+Arguments:
+
+    Enable - Supplies a boolean value that determines whether profiling
+        is enabled or disabled.
+
+Return Value:
+
+    STATUS_SUCCESS if the operation succeeds. STATUS_NOT_SUPPORTED if
+    the system is not an MP system, or STATUS_INSUFFICIENT_RESOURCES if
+    the profile tables cannot be allocated.
+
+--*/
+
+{
+
+#if defined(NT_UP)
+
+    PAGED_CODE();
+
+    return STATUS_NOT_SUPPORTED;
+
+#else
+
+    PLOCK_PROFILE_LOCK Locks;
+    PLOCK_PROFILE_SITE Sites;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    Status = STATUS_SUCCESS;
+    ExAcquireFastMutex(&ExpLockProfileLock);
+    if (Enable == FALSE) {
+        ExpLockProfileEnabled = FALSE;
+
+    } else {
+
+        //
+        // If the profile tables have not been allocated, then allocate
+        // and zero them. Otherwise, disable profiling while the epoch is
+        // changed.
+        //
+
+        if (ExpLockProfileLocks == NULL) {
+            Locks = ExAllocatePoolWithTag(NonPagedPool,
+                                          LOCK_PROFILE_LOCKS * sizeof(LOCK_PROFILE_LOCK),
+                                          'fPkL');
+
+            Sites = ExAllocatePoolWithTag(NonPagedPool,
+                                          LOCK_PROFILE_SITES * sizeof(LOCK_PROFILE_SITE),
+                                          'fPkL');
+
+            if ((Locks == NULL) || (Sites == NULL)) {
+                if (Locks != NULL) {
+                    ExFreePool(Locks);
+                }
+
+                if (Sites != NULL) {
+                    ExFreePool(Sites);
+                }
+
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+
+            } else {
+                RtlZeroMemory(Locks,
+                              LOCK_PROFILE_LOCKS * sizeof(LOCK_PROFILE_LOCK));
+
+                RtlZeroMemory(Sites,
+                              LOCK_PROFILE_SITES * sizeof(LOCK_PROFILE_SITE));
+
+                ExpLockProfileSites = Sites;
+                ExpLockProfileLocks = Locks;
+            }
+
+        } else {
+            ExpLockProfileEnabled = FALSE;
+        }
+
+        if (NT_SUCCESS(Status)) {
+            ExpLockProfileEpoch += 1;
+            if ((ExpLockProfileEpoch == 0) ||
+                (ExpLockProfileEpoch == LOCK_PROFILE_CLAIMING)) {
+                ExpLockProfileEpoch = 1;
+            }
+
+            ExpLockProfileDropped = 0;
+            ExpLockProfileEnabled = TRUE;
+        }
+    }
+
+    ExReleaseFastMutex(&ExpLockProfileLock);
+    return Status;
+
+#endif
+
+}
+
+VOID
+ExpLockProfileAcquired (
+    IN PVOID Lock,
+    IN ULONG LockType,
+    IN PVOID CallSite,
+    IN PLARGE_INTEGER WaitStart OPTIONAL
+    )
+
+/*++
+
+Routine Description:
+
+    This function records an exclusive acquire of a spin lock or fast
+    mutex after the lock has been acquired.
+
+Arguments:
+
+    Lock - Supplies the address of the lock.
+
+    LockType - Supplies the type of the lock.
+
+    CallSite - Supplies the address the lock was acquired from.
+
+    WaitStart - Supplies an optional pointer to the performance counter
+        value when the acquire started to wait for the lock. If this
+        argument is not specified, the lock was free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLOCK_PROFILE_SITE Site;
+
+    Site = ExpLockProfileAcquire(Lock, LockType, CallSite);
+    if (Site != NULL) {
+        if (ARGUMENT_PRESENT(WaitStart)) {
+            ExpLockProfileContention(Site, WaitStart);
+        }
+
+        ExpLockProfileHoldStart(Site);
+    }
+
+    return;
+}
+
+VOID
+ExpLockProfileAddTime (
+    IN PLARGE_INTEGER Time,
+    IN PLARGE_INTEGER StartTime,
+    IN PLARGE_INTEGER EndTime
+    )
+
+/*++
+
+Routine Description:
+
+    This function adds the interval between the specified performance
+    counter values to the specified time.
+
+    N.B. The performance counter values may have been read on different
+         processors, so a negative interval is ignored.
+
+Arguments:
+
+    Time - Supplies a pointer to the time to add to.
+
+    StartTime - Supplies the performance counter value at the start of the
+        interval.
+
+    EndTime - Supplies the performance counter value at the end of the
+        interval.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LARGE_INTEGER Interval;
+
+    Interval.QuadPart = EndTime->QuadPart - StartTime->QuadPart;
+    if (Interval.QuadPart > 0) {
+        if (Interval.HighPart != 0) {
+            Interval.LowPart = MAXULONG;
+        }
+
+        ExInterlockedAddLargeStatistic(Time, Interval.LowPart);
+    }
+
+    return;
+}
+
+PLOCK_PROFILE_LOCK
+ExpLockProfileLookupLock (
+    IN PVOID Lock,
+    IN ULONG LockType,
+    IN BOOLEAN Insert
+    )
+
+/*++
+
+Routine Description:
+
+    This function finds the lock table entry for the specified lock and
+    optionally claims a free entry if the lock is not in the table.
+
+    An entry is free if it was claimed in an earlier epoch. A free entry
+    is claimed by setting its epoch to the claiming epoch, after which the
+    lock is stored and the epoch is set to the current epoch. An entry
+    that is being claimed by another processor is skipped.
+
+Arguments:
+
+    Lock - Supplies the address of the lock.
+
+    LockType - Supplies the type of the lock.
+
+    Insert - Supplies a boolean value that determines whether a free entry
+        is claimed if the lock is not in the table.
+
+Return Value:
+
+    A pointer to the lock table entry is returned as the function value if
+    the entry is found or claimed. Otherwise, NULL is returned.
+
+--*/
+
+{
+
+    ULONG Epoch;
+    ULONG EntryEpoch;
+    ULONG Hash;
+    PLOCK_PROFILE_LOCK LockEntry;
+    ULONG Probe;
+
+    Epoch = ExpLockProfileEpoch;
+    Hash = LOCK_PROFILE_HASH(Lock);
+    for (Probe = 0; Probe < LOCK_PROFILE_PROBES; Probe += 1) {
+        LockEntry = &ExpLockProfileLocks[(Hash + Probe) & (LOCK_PROFILE_LOCKS - 1)];
+        EntryEpoch = LockEntry->Epoch;
+        if (EntryEpoch == Epoch) {
+            if (LockEntry->Lock == Lock) {
+
+                //
+                // If the lock was freed and its memory was reused for a
+                // lock of another type, then update the type.
+                //
+
+                if ((Insert != FALSE) && (LockEntry->LockType != LockType)) {
+                    LockEntry->LockType = LockType;
+                }
+
+                return LockEntry;
+            }
+
+        } else if (EntryEpoch != LOCK_PROFILE_CLAIMING) {
+            if (Insert == FALSE) {
+                break;
+            }
+
+            if ((ULONG)InterlockedCompareExchange((PVOID *)&LockEntry->Epoch,
+                                                  (PVOID)LOCK_PROFILE_CLAIMING,
+                                                  (PVOID)EntryEpoch) == EntryEpoch) {
+
+                LockEntry->Lock = Lock;
+                LockEntry->LockType = LockType;
+                LockEntry->Holder = NULL;
+                InterlockedExchange((PLONG)&LockEntry->Epoch, (LONG)Epoch);
+                return LockEntry;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+PLOCK_PROFILE_SITE
+ExpLockProfileLookupSite (
+    IN PLOCK_PROFILE_LOCK LockEntry,
+    IN PVOID CallSite
+    )
+
+/*++
+
+Routine Description:
+
+    This function finds the call site table entry for the specified lock
+    and call site, and claims a free entry if the call site is not in the
+    table.
+
+    Call site entries are claimed in the same way as lock entries, and a
+    claimed entry is given the epoch of its lock entry. The counts of a
+    claimed entry are cleared before its epoch is set.
+
+    N.B. If two processors claim an entry for the same lock and call site
+         at the same time, the call site is entered twice. The entries are
+         merged when the profile is summarized.
+
+Arguments:
+
+    LockEntry - Supplies a pointer to the lock table entry of the lock.
+
+    CallSite - Supplies the address the lock was acquired from.
+
+Return Value:
+
+    A pointer to the call site entry is returned as the function value if
+    the entry is found or claimed. Otherwise, NULL is returned.
+
+--*/
+
+{
+
+    ULONG Epoch;
+    ULONG Hash;
+    PVOID Lock;
+    ULONG Probe;
+    PLOCK_PROFILE_SITE Site;
+    ULONG SiteEpoch;
+
+    Epoch = LockEntry->Epoch;
+    Lock = LockEntry->Lock;
+    Hash = LOCK_PROFILE_HASH(Lock) ^ LOCK_PROFILE_HASH(CallSite);
+    for (Probe = 0; Probe < LOCK_PROFILE_PROBES; Probe += 1) {
+        Site = &ExpLockProfileSites[(Hash + Probe) & (LOCK_PROFILE_SITES - 1)];
+        SiteEpoch = Site->Epoch;
+        if (SiteEpoch == Epoch) {
+            if ((Site->LockEntry == LockEntry) && (Site->CallSite == CallSite)) {
+                return Site;
+            }
+
+        } else if (SiteEpoch != LOCK_PROFILE_CLAIMING) {
+            if ((ULONG)InterlockedCompareExchange((PVOID *)&Site->Epoch,
+                                                  (PVOID)LOCK_PROFILE_CLAIMING,
+                                                  (PVOID)SiteEpoch) == SiteEpoch) {
+
+                Site->Lock = Lock;
+                Site->CallSite = CallSite;
+                Site->LockEntry = LockEntry;
+                Site->AcquireCount = 0;
+                Site->ContentionCount = 0;
+                Site->WaitTime.QuadPart = 0;
+                Site->HoldTime.QuadPart = 0;
+                InterlockedExchange((PLONG)&Site->Epoch, (LONG)Epoch);
+                return Site;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+VOID
+ExpSummarizeLockProfile (
+    IN PLOCK_PROFILE_LOCK LockEntry,
+    OUT PSYSTEM_LOCK_PROFILE_ENTRY Summary
+    )
+
+/*++
+
+Routine Description:
+
+    This function sums the call site entries of the specified lock and
+    selects the call sites with the most contention.
+
+Arguments:
+
+    LockEntry - Supplies a pointer to the lock table entry of the lock.
+
+    Summary - Supplies a pointer to a variable that receives the summary
+        of the lock.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSYSTEM_LOCK_PROFILE_CALL_SITE CallSites;
+    ULONG Count;
+    ULONG Index;
+    PLOCK_PROFILE_SITE Site;
+    ULONG Slot;
+    SYSTEM_LOCK_PROFILE_CALL_SITE Swap;
+
+    PAGED_CODE();
+
+    RtlZeroMemory(Summary, sizeof(SYSTEM_LOCK_PROFILE_ENTRY));
+    Summary->Address = LockEntry->Lock;
+    Summary->Type = LockEntry->LockType;
+    CallSites = &Summary->CallSites[0];
+    Count = 0;
+    for (Index = 0; Index < LOCK_PROFILE_SITES; Index += 1) {
+        Site = &ExpLockProfileSites[Index];
+        if ((Site->Epoch != LockEntry->Epoch) || (Site->Lock != LockEntry->Lock)) {
+            continue;
+        }
+
+        Summary->AcquireCount += Site->AcquireCount;
+        Summary->ContentionCount += Site->ContentionCount;
+        Summary->WaitTime.QuadPart += Site->WaitTime.QuadPart;
+        Summary->HoldTime.QuadPart += Site->HoldTime.QuadPart;
+
+        //
+        // If the call site is already among the selected call sites, then
+        // merge the entry into it. Otherwise, select the call site if there
+        // is a free slot or it ranks above the last selected call site.
+        //
+
+        for (Slot = 0; Slot < Count; Slot += 1) {
+            if (CallSites[Slot].CallSite == Site->CallSite) {
+                break;
+            }
+        }
+
+        if (Slot < Count) {
+            CallSites[Slot].AcquireCount += Site->AcquireCount;
+            CallSites[Slot].ContentionCount += Site->ContentionCount;
+            CallSites[Slot].WaitTime.QuadPart += Site->WaitTime.QuadPart;
+            CallSites[Slot].HoldTime.QuadPart += Site->HoldTime.QuadPart;
+
+        } else {
+            Summary->NumberOfCallSites += 1;
+            if (Count < LOCK_PROFILE_CALL_SITES) {
+                Count += 1;
+
+            } else if (RanksAbove(Site, &CallSites[Count - 1])) {
+                Slot = Count - 1;
+
+            } else {
+                continue;
+            }
+
+            CallSites[Slot].CallSite = Site->CallSite;
+            CallSites[Slot].AcquireCount = Site->AcquireCount;
+            CallSites[Slot].ContentionCount = Site->ContentionCount;
+            CallSites[Slot].WaitTime = Site->WaitTime;
+            CallSites[Slot].HoldTime = Site->HoldTime;
+        }
+
+        //
+        // Move the call site up to keep the selected call sites in order.
+        //
+
+        while ((Slot > 0) && RanksAbove(&CallSites[Slot], &CallSites[Slot - 1])) {
+            Swap = CallSites[Slot];
+            CallSites[Slot] = CallSites[Slot - 1];
+            CallSites[Slot - 1] = Swap;
+            Slot -= 1;
+        }
+    }
+
+    return;
+}
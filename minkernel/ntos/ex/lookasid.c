@@ -50,11 +50,10 @@ ExpComputeLookasideDepth (
     IN OUT PUSHORT Depth
     );
 
-PVOID
-ExpDummyAllocate (
-    IN POOL_TYPE PoolType,
-    IN ULONG NumberOfBytes,
-    IN ULONG Tag
+VOID
+ExpFreeLookasideEntries (
+    IN PGENERAL_LOOKASIDE Lookaside,
+    IN PSINGLE_LIST_ENTRY Entry
     );
 
 LOGICAL
@@ -68,6 +67,10 @@ ExpScanPoolLookasideList (
     IN PSMALL_POOL_LOOKASIDE Lookaside
     );
 
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(INIT, ExpInitializePerProcessorLookaside)
+#endif
+
 //
 // Define the global nonpaged and paged lookaside list data.
 //
@@ -109,6 +112,8 @@ Return Value:
 {
 
     LOGICAL Changes;
+    ULONG Index;
+    PKPRCB Prcb;
 
     //
     // Decrement the scan period and check if it is time to dynamically
@@ -141,6 +146,21 @@ Return Value:
 
 #endif
 
+        //
+        // Scan the per processor pool paged and nonpaged lookaside lists.
+        //
+
+        for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+            Prcb = KiProcessorBlock[Index];
+            if (Prcb->NPagedPoolLookaside != NULL) {
+                Changes |= ExpScanPoolLookasideList(Prcb->NPagedPoolLookaside);
+            }
+
+            if (Prcb->PagedPoolLookaside != NULL) {
+                Changes |= ExpScanPoolLookasideList(Prcb->PagedPoolLookaside);
+            }
+        }
+
         //
         // If any changes were made to the depth of any lookaside list during
         // this scan period, then lower the scan period to the minimum value.
@@ -405,6 +425,116 @@ Return Value:
     return Changes;
 }
 
+VOID
+ExpInitializePerProcessorLookaside (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function allocates and initializes the small pool lookaside lists
+    of each processor in a multiprocessor system. Small pool blocks are
+    allocated from and freed to the lists of the current processor before
+    the system lists are used, so most small pool allocations and frees on
+    different processors do not touch the same lookaside list.
+
+    The depth of the per processor lists is adjusted periodically along
+    with the depth of all other lookaside lists.
+
+    N.B. This function is called during phase 1 initialization after all
+         processors have been started. If the lists for a processor cannot
+         be allocated, then that processor uses the system lists only.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    PSMALL_POOL_LOOKASIDE Lookaside;
+    ULONG Number;
+    ULONG NumberOfLists;
+    PKPRCB Prcb;
+
+    //
+    // The system lists are sufficient on a uniprocessor system.
+    //
+
+    if (KeNumberProcessors == 1) {
+        return;
+    }
+
+#if defined(_PPC_)
+
+    NumberOfLists = POOL_SMALL_LISTS;
+
+#else
+
+    NumberOfLists = POOL_SMALL_LISTS * 2;
+
+#endif
+
+    for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+        Prcb = KiProcessorBlock[Number];
+        Lookaside = ExAllocatePoolWithTag(NonPagedPoolCacheAligned,
+                                          NumberOfLists * sizeof(SMALL_POOL_LOOKASIDE),
+                                          'looP');
+
+        if (Lookaside == NULL) {
+            continue;
+        }
+
+        //
+        // Initialize each list with the same maximum depth as the respective
+        // system list.
+        //
+
+        RtlZeroMemory(Lookaside, NumberOfLists * sizeof(SMALL_POOL_LOOKASIDE));
+        for (Index = 0; Index < POOL_SMALL_LISTS; Index += 1) {
+            Lookaside[Index].Depth = 2;
+            Lookaside[Index].MaximumDepth =
+                                ExpSmallNPagedPoolLookasideLists[Index].MaximumDepth;
+
+            KeInitializeSpinLock(&Lookaside[Index].Lock);
+
+#if !defined(_PPC_)
+
+            Lookaside[POOL_SMALL_LISTS + Index].Depth = 2;
+            Lookaside[POOL_SMALL_LISTS + Index].MaximumDepth =
+                                ExpSmallPagedPoolLookasideLists[Index].MaximumDepth;
+
+            KeInitializeSpinLock(&Lookaside[POOL_SMALL_LISTS + Index].Lock);
+
+#endif
+
+        }
+
+        //
+        // Make the lists visible to the pool allocator of the processor.
+        //
+
+#if !defined(_PPC_)
+
+        InterlockedExchange((PLONG)&Prcb->PagedPoolLookaside,
+                            (LONG)&Lookaside[POOL_SMALL_LISTS]);
+
+#endif
+
+        InterlockedExchange((PLONG)&Prcb->NPagedPoolLookaside, (LONG)Lookaside);
+    }
+
+    return;
+}
+
 VOID
 ExInitializeNPagedLookasideList (
     IN PNPAGED_LOOKASIDE_LIST Lookaside,
@@ -515,7 +645,7 @@ Return Value:
 
 {
 
-    PVOID Entry;
+    PSINGLE_LIST_ENTRY Entry;
     KIRQL OldIrql;
 
     //
@@ -532,11 +662,8 @@ Return Value:
     // and free them.
     //
 
-    Lookaside->L.Allocate = ExpDummyAllocate;
-    while ((Entry = ExAllocateFromNPagedLookasideList(Lookaside)) != NULL) {
-        (Lookaside->L.Free)(Entry);
-    }
-
+    Entry = ExInterlockedFlushSList(&Lookaside->L.ListHead, &Lookaside->Lock);
+    ExpFreeLookasideEntries(&Lookaside->L, Entry);
     return;
 }
 
@@ -650,7 +777,7 @@ Return Value:
 
 {
 
-    PVOID Entry;
+    PSINGLE_LIST_ENTRY Entry;
     KIRQL OldIrql;
 
     //
@@ -666,12 +793,26 @@ Return Value:
     // Remove all pool entries from the specified lookaside structure
     // and free them.
     //
+    // N.B. If the host processor does not support the cmpxchg8b
+    //      instruction, then paged lookaside lists are synchronized with
+    //      the fast mutex in the lookaside structure.
+    //
 
-    Lookaside->L.Allocate = ExpDummyAllocate;
-    while ((Entry = ExAllocateFromPagedLookasideList(Lookaside)) != NULL) {
-        (Lookaside->L.Free)(Entry);
+#if !defined(_PPC_)
+
+    if (Isx86FeaturePresent(KF_CMPXCHG8B)) {
+        Entry = ExInterlockedFlushSList(&Lookaside->L.ListHead, NULL);
+        ExpFreeLookasideEntries(&Lookaside->L, Entry);
+        return;
     }
 
+#endif
+
+    ExAcquireFastMutex(&Lookaside->Lock);
+    Entry = Lookaside->L.ListHead.Next.Next;
+    ExInitializeSListHead(&Lookaside->L.ListHead);
+    ExReleaseFastMutex(&Lookaside->Lock);
+    ExpFreeLookasideEntries(&Lookaside->L, Entry);
     return;
 }
 
@@ -807,35 +948,42 @@ Return Value:
 
 #endif
 
-PVOID
-ExpDummyAllocate (
-    IN POOL_TYPE PoolType,
-    IN ULONG NumberOfBytes,
-    IN ULONG Tag
+VOID
+ExpFreeLookasideEntries (
+    IN PGENERAL_LOOKASIDE Lookaside,
+    IN PSINGLE_LIST_ENTRY Entry
     )
 
 /*++
 
 Routine Description:
 
-    This function is a dummy allocation routine which is used to empty
-    a lookaside list.
+    This function frees a chain of entries that has been flushed from a
+    lookaside list using the free function of the lookaside list.
 
 Arguments:
 
-    PoolType - Supplies the type of pool to allocate.
+    Lookaside - Supplies a pointer to the lookaside list structure the
+        entries were removed from.
 
-    NumberOfBytes - supplies the number of bytes to allocate.
-
-    Tag - supplies the pool tag.
+    Entry - Supplies a pointer to the first entry in the chain, or NULL
+        if the chain is empty.
 
 Return Value:
 
-    NULL is returned as the function value.
+    None.
 
 --*/
 
 {
 
-    return NULL;
+    PSINGLE_LIST_ENTRY NextEntry;
+
+    while (Entry != NULL) {
+        NextEntry = Entry->Next;
+        (Lookaside->Free)(Entry);
+        Entry = NextEntry;
+    }
+
+    return;
 }
@@ -935,6 +935,56 @@
         j       ra                      // return
 
         .end    ExpInterlockedPushEntrySList
+
+        SBTTL("Interlocked Flush Sequenced List")
+//++
+//
+// PSINGLE_LIST_ENTRY
+// ExpInterlockedFlushSList (
+//    IN PSLIST_HEADER ListHead
+//    )
+//
+// Routine Description:
+//
+//    This function removes all entries from a sequenced singly linked list
+//    so that access to the list is synchronized in an MP system. If there
+//    are no entries in the list, then a value of NULL is returned. Otherwise,
+//    the address of the first entry that was removed is returned as the
+//    function value.
+//
+//    The list depth is set to zero, but the sequence number is not changed.
+//
+// Arguments:
+//
+//    ListHead (a0) - Supplies a pointer to the sequenced listhead which is
+//       to be flushed.
+//
+// Return Value:
+//
+//    The address of the first entry removed from the list, or NULL if the
+//    list is empty.
+//
+//--
+
+        LEAF_ENTRY(ExpInterlockedFlushSList)
+
+        .set    noreorder
+        .set    noat
+10:     lld     t0,0(a0)                // get next entry address and sequence
+        dsll    v0,t0,32                // sign extend next entry address
+        dsra    v0,v0,32                //
+        beq     zero,v0,20f             // if eq, list is empty
+        dsrl    t1,t0,48                // isolate sequence number
+        dsll    t1,t1,48                // clear depth and next entry address
+        scd     t1,0(a0)                // store empty list and sequence
+        beq     zero,t1,10b             // if eq, store conditional failed
+        nop                             //
+        .set    at
+        .set    reorder
+
+20:     j       ra                      // return
+
+        .end    ExpInterlockedFlushSList
 
         SBTTL("Interlocked Compare Exchange 64-bits")
 //++
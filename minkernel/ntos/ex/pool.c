@@ -63,6 +63,8 @@ ExpSnapShotPoolPages(
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(INIT, InitializePool)
 #pragma alloc_text(INIT, ExpInitializePoolDescriptor)
+#pragma alloc_text(INIT, ExpInitializePerProcessorPoolTracker)
+#pragma alloc_text(PAGE, ExpGetPoolTagCounters)
 #if DBG
 #pragma alloc_text(PAGELK, ExSnapShotPool)
 #pragma alloc_text(PAGELK, ExpSnapShotPoolPages)
@@ -72,10 +74,18 @@ ExpSnapShotPoolPages(
 
 ULONG FirstPrint;
 PPOOL_TRACKER_TABLE PoolTrackTable;
+PPOOL_TRACKER_TABLE PoolTrackTableProcessor[MAXIMUM_PROCESSORS];
 PPOOL_TRACKER_BIG_PAGES PoolBigPageTable;
+ULONG PoolBigPageTableSize;
 
 ULONG PoolHitTag = 0xffffff0f;
 
+ULONG
+ExpLookupPoolTracker (
+    IN ULONG Key,
+    IN BOOLEAN Insert
+    );
+
 USHORT
 ExpInsertPoolTracker (
     ULONG Key,
@@ -247,6 +257,96 @@ SMALL_POOL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[POOL_SMALL_LISTS];
 SMALL_POOL_LOOKASIDE ExpSmallPagedPoolLookasideLists[POOL_SMALL_LISTS];
 
 #endif
+
+//
+// Two routines to allocate and free small pool blocks using the lookaside
+// lists of the current processor and the system lookaside lists.
+//
+// The per processor list is tried first and the system list second, so a
+// block freed on one processor can still be reused on another. There are
+// no per processor lists on a uniprocessor system, or before executive
+// phase 1 initialization has allocated them.
+//
+// N.B. The caller may be switched to another processor after capturing
+//      the address of its per processor lists. This is harmless since the
+//      lists are accessed with interlocked operations. Only the statistics
+//      may be slightly off.
+//
+
+_inline
+PVOID
+ExpAllocateFromPoolLookaside (
+    IN PSMALL_POOL_LOOKASIDE PerProcessorLists,
+    IN PSMALL_POOL_LOOKASIDE SystemLists,
+    IN ULONG Index
+    )
+{
+    PVOID Entry;
+    PSMALL_POOL_LOOKASIDE PerProcessorList;
+    PSMALL_POOL_LOOKASIDE SystemList;
+
+    if (PerProcessorLists != NULL) {
+        PerProcessorList = &PerProcessorLists[Index];
+        PerProcessorList->TotalAllocates += 1;
+        Entry = ExInterlockedPopEntrySList(&PerProcessorList->SListHead,
+                                           &PerProcessorList->Lock);
+
+        if (Entry != NULL) {
+            PerProcessorList->AllocateHits += 1;
+            return Entry;
+        }
+    }
+
+    SystemList = &SystemLists[Index];
+    SystemList->TotalAllocates += 1;
+    Entry = ExInterlockedPopEntrySList(&SystemList->SListHead,
+                                       &SystemList->Lock);
+
+    if (Entry != NULL) {
+        SystemList->AllocateHits += 1;
+    }
+
+    return Entry;
+}
+
+_inline
+BOOLEAN
+ExpFreeToPoolLookaside (
+    IN PSMALL_POOL_LOOKASIDE PerProcessorLists,
+    IN PSMALL_POOL_LOOKASIDE SystemLists,
+    IN ULONG Index,
+    IN PVOID Entry
+    )
+{
+    PSMALL_POOL_LOOKASIDE PerProcessorList;
+    PSMALL_POOL_LOOKASIDE SystemList;
+
+    if (PerProcessorLists != NULL) {
+        PerProcessorList = &PerProcessorLists[Index];
+        PerProcessorList->TotalFrees += 1;
+        if (ExQueryDepthSList(&PerProcessorList->SListHead) < PerProcessorList->Depth) {
+            PerProcessorList->FreeHits += 1;
+            ExInterlockedPushEntrySList(&PerProcessorList->SListHead,
+                                        (PSINGLE_LIST_ENTRY)Entry,
+                                        &PerProcessorList->Lock);
+
+            return TRUE;
+        }
+    }
+
+    SystemList = &SystemLists[Index];
+    SystemList->TotalFrees += 1;
+    if (ExQueryDepthSList(&SystemList->SListHead) < SystemList->Depth) {
+        SystemList->FreeHits += 1;
+        ExInterlockedPushEntrySList(&SystemList->SListHead,
+                                    (PSINGLE_LIST_ENTRY)Entry,
+                                    &SystemList->Lock);
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
 
 //
 // Two routines to check for pool that has been altered after it was freed.
@@ -553,11 +653,23 @@ Return Value:
                                                  sizeof(POOL_TRACKER_TABLE));
 
             RtlZeroMemory(PoolTrackTable, MAX_TRACKER_TABLE * sizeof(POOL_TRACKER_TABLE));
+
+            //
+            // Size the big page table with one entry for every sixteen
+            // physical pages so the table does not fill on large systems.
+            //
+
+            PoolBigPageTableSize = MINIMUM_BIGPAGE_TABLE;
+            while ((PoolBigPageTableSize < MAXIMUM_BIGPAGE_TABLE) &&
+                   (PoolBigPageTableSize < (MmNumberOfPhysicalPages / 16))) {
+                PoolBigPageTableSize <<= 1;
+            }
+
             PoolBigPageTable = MiAllocatePoolPages(NonPagedPool,
-                                                   MAX_BIGPAGE_TABLE *
+                                                   PoolBigPageTableSize *
                                                    sizeof(POOL_TRACKER_BIG_PAGES));
 
-            RtlZeroMemory(PoolBigPageTable, MAX_BIGPAGE_TABLE * sizeof(POOL_TRACKER_BIG_PAGES));
+            RtlZeroMemory(PoolBigPageTable, PoolBigPageTableSize * sizeof(POOL_TRACKER_BIG_PAGES));
 #if !DBG
         }
 #endif  //!DBG
@@ -614,7 +726,7 @@ Return Value:
                                  NonPagedPool);
 
             ExpInsertPoolTracker('looP',
-                                 MAX_BIGPAGE_TABLE * sizeof(POOL_TRACKER_BIG_PAGES),
+                                 PoolBigPageTableSize * sizeof(POOL_TRACKER_BIG_PAGES),
                                  NonPagedPool);
         }
 
@@ -897,7 +1009,6 @@ Return Value:
 
     PVOID Block;
     PPOOL_HEADER Entry;
-    PSMALL_POOL_LOOKASIDE LookasideList;
     PPOOL_HEADER NextEntry;
     PPOOL_HEADER SplitEntry;
     KIRQL LockHandle;
@@ -1089,15 +1200,12 @@ Return Value:
 
 #else
 
-                LookasideList = &ExpSmallPagedPoolLookasideLists[NeededSize - 1];
-                LookasideList->TotalAllocates += 1;
                 if ((Isx86FeaturePresent(KF_CMPXCHG8B)) &&
-                    (Entry = (PPOOL_HEADER)ExInterlockedPopEntrySList(&LookasideList->SListHead,
-                                                                      &LookasideList->Lock)) != NULL) {
-
+                    (Entry = (PPOOL_HEADER)ExpAllocateFromPoolLookaside(Prcb->PagedPoolLookaside,
+                                                                        ExpSmallPagedPoolLookasideLists,
+                                                                        NeededSize - 1)) != NULL) {
 
                     Entry -= 1;
-                    LookasideList->AllocateHits += 1;
 
 #endif
                     NewPoolType = (PoolType & (BASE_POOL_TYPE_MASK | POOL_QUOTA_MASK)) + 1;
@@ -1193,14 +1301,11 @@ PoolLocked:
 #if !defined(CHECK_POOL_TAIL) && (DEADBEEF == 0)
 
             if (NeededSize <= POOL_SMALL_LISTS) {
-                LookasideList = &ExpSmallNPagedPoolLookasideLists[NeededSize - 1];
-                LookasideList->TotalAllocates += 1;
-                if ((Entry = (PPOOL_HEADER)ExInterlockedPopEntrySList(&LookasideList->SListHead,
-                                                                      &LookasideList->Lock)) != NULL) {
-
+                if ((Entry = (PPOOL_HEADER)ExpAllocateFromPoolLookaside(Prcb->NPagedPoolLookaside,
+                                                                        ExpSmallNPagedPoolLookasideLists,
+                                                                        NeededSize - 1)) != NULL) {
 
                     Entry -= 1;
-                    LookasideList->AllocateHits += 1;
                     NewPoolType = (PoolType & (BASE_POOL_TYPE_MASK | POOL_QUOTA_MASK)) + 1;
 #if defined (_ALPHA_)
                     //
@@ -1526,6 +1631,93 @@ PoolLocked:
     }
 }
 
+ULONG
+ExpLookupPoolTracker (
+    IN ULONG Key,
+    IN BOOLEAN Insert
+    )
+
+/*++
+
+Routine Description:
+
+    This function locates the entry for a pool tag in the system tag table
+    and optionally claims a free entry for the tag.
+
+    Entries are claimed with an interlocked compare exchange of the key and
+    a key is never removed from the table, so the table can be searched
+    without holding a lock.
+
+Arguments:
+
+    Key - Supplies the key value used to locate a matching entry in the
+        tag table.
+
+    Insert - Supplies a boolean value that determines whether a free entry
+        is claimed if no matching entry is found.
+
+Return Value:
+
+    The index of the tag table entry is returned as the function value. If
+    the table is full, then the index of the overflow entry is returned. If
+    no entry is found and insert is not specified, then MAX_TRACKER_TABLE
+    is returned.
+
+--*/
+
+{
+
+    ULONG Hash;
+    ULONG Index;
+    ULONG OldKey;
+
+    //
+    // Compute hash index and search for pool tag.
+    //
+
+    Hash = ((40543*((((((((PUCHAR)&Key)[0]<<2)^((PUCHAR)&Key)[1])<<2)^((PUCHAR)&Key)[2])<<2)^((PUCHAR)&Key)[3]))>>2) & TRACKER_TABLE_MASK;
+    Index = Hash;
+    do {
+        OldKey = PoolTrackTable[Hash].Key;
+        if (OldKey == Key) {
+            return Hash;
+        }
+
+        if (OldKey == 0) {
+            if (Insert == FALSE) {
+                KdPrint(("POOL: Unable to find tracker %lx, table corrupted\n", Key));
+                return MAX_TRACKER_TABLE;
+            }
+
+            //
+            // Attempt to claim the free entry. If another processor claims
+            // the entry first for the same tag, then the entry is used.
+            //
+
+            OldKey = (ULONG)InterlockedCompareExchange((PVOID *)&PoolTrackTable[Hash].Key,
+                                                       (PVOID)Key,
+                                                       NULL);
+
+            if ((OldKey == 0) || (OldKey == Key)) {
+                return Hash;
+            }
+        }
+
+        Hash = (Hash + 1) & TRACKER_TABLE_MASK;
+    } while (Hash != Index);
+
+    //
+    // No matching entry and no free entry was found.
+    //
+
+    if (Insert != FALSE) {
+        PoolTrackTable[MAX_TRACKER_TABLE - 1].Key = Key;
+    }
+
+    return MAX_TRACKER_TABLE - 1;
+}
+
+
 USHORT
 ExpInsertPoolTracker (
     ULONG Key,
@@ -1540,6 +1732,10 @@ Routine Description:
     This function insert a pool tag in the tag table and increments the
     number of allocates and updates the total allocation size.
 
+    The counts are updated in the tracker table of the current processor
+    if it has one. Otherwise, the counts are updated in the system table
+    with the tagged pool lock held.
+
 Arguments:
 
     Key - Supplies the key value used to locate a matching entry in the
@@ -1559,8 +1755,8 @@ Return Value:
 
     USHORT Result;
     ULONG Hash;
-    ULONG Index;
     KIRQL OldIrql;
+    PPOOL_TRACKER_TABLE TrackTable;
 
     //
     // Ignore protected pool bit except for returned hash index
@@ -1577,48 +1773,37 @@ Return Value:
         DbgBreakPoint();
     }
 
-    //
-    // Compute hash index and search for pool tag.
-    //
-
-    Hash = ((40543*((((((((PUCHAR)&Key)[0]<<2)^((PUCHAR)&Key)[1])<<2)^((PUCHAR)&Key)[2])<<2)^((PUCHAR)&Key)[3]))>>2) & TRACKER_TABLE_MASK;
-    Index = Hash;
-    ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
-    do {
-        if ((PoolTrackTable[Hash].Key == Key) ||
-            (PoolTrackTable[Hash].Key == 0)) {
-            goto EntryFound;
-        }
-
-        Hash = (Hash + 1) & TRACKER_TABLE_MASK;
-    } while (Hash != Index);
-
-    //
-    // No matching entry and no free entry was found.
-    //
-
-    Hash = MAX_TRACKER_TABLE - 1;
+    Hash = ExpLookupPoolTracker(Key, TRUE);
 
     //
     // Update pool tracker table entry.
     //
 
-EntryFound:
-    PoolTrackTable[Hash].Key = Key;
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+    TrackTable = PoolTrackTableProcessor[KeGetCurrentProcessorNumber()];
+    if (TrackTable == NULL) {
+        TrackTable = PoolTrackTable;
+        ExAcquireSpinLockAtDpcLevel(&ExpTaggedPoolLock);
+    }
+
     if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
-        PoolTrackTable[Hash].PagedAllocs += 1;
-        PoolTrackTable[Hash].PagedBytes += Size;
+        TrackTable[Hash].PagedAllocs += 1;
+        TrackTable[Hash].PagedBytes += Size;
 
     } else {
-        PoolTrackTable[Hash].NonPagedAllocs += 1;
-        PoolTrackTable[Hash].NonPagedBytes += Size;
+        TrackTable[Hash].NonPagedAllocs += 1;
+        TrackTable[Hash].NonPagedBytes += Size;
     }
 
-    ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
+    if (TrackTable == PoolTrackTable) {
+        ExReleaseSpinLockFromDpcLevel(&ExpTaggedPoolLock);
+    }
+
+    KeLowerIrql(OldIrql);
     return (USHORT)Hash | Result;
 }
 
-
+
 VOID
 ExpRemovePoolTracker (
     ULONG Key,
@@ -1633,6 +1818,10 @@ Routine Description:
     This function increments the number of frees and updates the total
     allocation size.
 
+    The counts are updated in the tracker table of the current processor
+    if it has one. Otherwise, the counts are updated in the system table
+    with the tagged pool lock held.
+
 Arguments:
 
     Key - Supplies the key value used to locate a matching entry in the
@@ -1651,8 +1840,8 @@ Return Value:
 {
 
     ULONG Hash;
-    ULONG Index;
     KIRQL OldIrql;
+    PPOOL_TRACKER_TABLE TrackTable;
 
     //
     // Ignore protected pool bit
@@ -1663,53 +1852,147 @@ Return Value:
         DbgBreakPoint();
     }
 
+    Hash = ExpLookupPoolTracker(Key, FALSE);
+    if (Hash == MAX_TRACKER_TABLE) {
+        return;
+    }
+
     //
-    // Compute hash index and search for pool tag.
+    // Update pool tracker table entry.
     //
 
-    Hash = ((40543*((((((((PUCHAR)&Key)[0]<<2)^((PUCHAR)&Key)[1])<<2)^((PUCHAR)&Key)[2])<<2)^((PUCHAR)&Key)[3]))>>2) & TRACKER_TABLE_MASK;
-    Index = Hash;
-    ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
-    do {
-        if (PoolTrackTable[Hash].Key == Key) {
-            goto EntryFound;
-        }
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+    TrackTable = PoolTrackTableProcessor[KeGetCurrentProcessorNumber()];
+    if (TrackTable == NULL) {
+        TrackTable = PoolTrackTable;
+        ExAcquireSpinLockAtDpcLevel(&ExpTaggedPoolLock);
+    }
+
+    if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
+        TrackTable[Hash].PagedBytes -= Size;
+        TrackTable[Hash].PagedFrees += 1;
+
+    } else {
+        TrackTable[Hash].NonPagedBytes -= Size;
+        TrackTable[Hash].NonPagedFrees += 1;
+    }
+
+    if (TrackTable == PoolTrackTable) {
+        ExReleaseSpinLockFromDpcLevel(&ExpTaggedPoolLock);
+    }
+
+    KeLowerIrql(OldIrql);
+    return;
+}
+
+
+VOID
+ExpInitializePerProcessorPoolTracker (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function allocates a pool tracker table for each processor in a
+    multiprocessor system when pool tagging is enabled. Each processor
+    then counts allocations and frees in its own table without acquiring
+    the tagged pool lock.
+
+    N.B. This function is called during phase 1 initialization after all
+         processors have been started. If the table for a processor cannot
+         be allocated, then that processor uses the system table.
+
+Arguments:
+
+    None.
+
+Return Value:
 
-        if (PoolTrackTable[Hash].Key == 0) {
-            KdPrint(("POOL: Unable to find tracker %lx, table corrupted\n", Key));
-            goto ExitRoutine;
+    None.
+
+--*/
+
+{
+
+    ULONG Number;
+    PPOOL_TRACKER_TABLE TrackTable;
+
+    if ((PoolTrackTable == NULL) || (KeNumberProcessors == 1)) {
+        return;
+    }
+
+    for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+        TrackTable = ExAllocatePoolWithTag(NonPagedPoolCacheAligned,
+                                           MAX_TRACKER_TABLE * sizeof(POOL_TRACKER_TABLE),
+                                           'looP');
+
+        if (TrackTable != NULL) {
+            RtlZeroMemory(TrackTable, MAX_TRACKER_TABLE * sizeof(POOL_TRACKER_TABLE));
+            InterlockedExchange((PLONG)&PoolTrackTableProcessor[Number],
+                                (LONG)TrackTable);
         }
+    }
+
+    return;
+}
 
 
-        Hash = (Hash + 1) & TRACKER_TABLE_MASK;
-    } while (Hash != Index);
+VOID
+ExpGetPoolTagCounters (
+    IN ULONG Index,
+    OUT PPOOL_TRACKER_TABLE Tracker
+    )
 
-    //
-    // No matching entry and no free entry was found.
-    //
+/*++
 
-    Hash = MAX_TRACKER_TABLE - 1;
+Routine Description:
 
-    //
-    // Update pool tracker table entry.
-    //
+    This function captures the key and the sum of the allocation counts of
+    a pool tracker table entry over the system table and the tables of all
+    processors.
 
-EntryFound:
-    if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
-        PoolTrackTable[Hash].PagedBytes -= Size;
-        PoolTrackTable[Hash].PagedFrees += 1;
+    N.B. No lock is acquired, so the counts are a snapshot that may lag
+         allocations and frees in progress on other processors.
 
-    } else {
-        PoolTrackTable[Hash].NonPagedBytes -= Size;
-        PoolTrackTable[Hash].NonPagedFrees += 1;
+Arguments:
+
+    Index - Supplies the index of the tracker table entry.
+
+    Tracker - Supplies a pointer to a variable that receives the key and
+        the allocation counts.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Number;
+    PPOOL_TRACKER_TABLE TrackTable;
+
+    PAGED_CODE();
+
+    *Tracker = PoolTrackTable[Index];
+    for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+        TrackTable = PoolTrackTableProcessor[Number];
+        if (TrackTable != NULL) {
+            Tracker->NonPagedAllocs += TrackTable[Index].NonPagedAllocs;
+            Tracker->NonPagedFrees += TrackTable[Index].NonPagedFrees;
+            Tracker->NonPagedBytes += TrackTable[Index].NonPagedBytes;
+            Tracker->PagedAllocs += TrackTable[Index].PagedAllocs;
+            Tracker->PagedFrees += TrackTable[Index].PagedFrees;
+            Tracker->PagedBytes += TrackTable[Index].PagedBytes;
+        }
     }
 
-ExitRoutine:
-    ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
     return;
 }
 
-
+
 PPOOL_TRACKER_BIG_PAGES
 ExpAddTagForBigPages (
     IN PVOID Va,
@@ -1717,26 +2000,22 @@ ExpAddTagForBigPages (
     )
 {
     ULONG Hash;
-    BOOLEAN Inserted = TRUE;
+    ULONG Index;
     KIRQL OldIrql;
 
-    Hash = ((ULONG)Va >> PAGE_SHIFT) & BIGPAGE_TABLE_MASK;
+    Hash = ((ULONG)Va >> PAGE_SHIFT) & (PoolBigPageTableSize - 1);
+    Index = Hash;
     ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
     while (PoolBigPageTable[Hash].Va != NULL) {
-        Hash += 1;
-        if (Hash > MAX_BIGPAGE_TABLE) {
-            if (!Inserted) {
-                if (!FirstPrint) {
-                    KdPrint(("POOL:unable to insert big page slot %lx\n",Key));
-                    FirstPrint = TRUE;
-                }
-
-                ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
-                return NULL;
+        Hash = (Hash + 1) & (PoolBigPageTableSize - 1);
+        if (Hash == Index) {
+            if (!FirstPrint) {
+                KdPrint(("POOL:unable to insert big page slot %lx\n",Key));
+                FirstPrint = TRUE;
             }
 
-            Hash = 0;
-            Inserted = FALSE;
+            ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
+            return NULL;
         }
     }
 
@@ -1746,7 +2025,7 @@ ExpAddTagForBigPages (
     return &PoolBigPageTable[Hash];
 }
 
-
+
 ULONG
 ExpFindAndRemoveTagBigPages (
     IN PVOID Va
@@ -1755,27 +2034,23 @@ ExpFindAndRemoveTagBigPages (
 {
 
     ULONG Hash;
-    BOOLEAN Inserted = TRUE;
+    ULONG Index;
     KIRQL OldIrql;
     ULONG ReturnKey;
 
-    Hash = ((ULONG)Va >> PAGE_SHIFT) & BIGPAGE_TABLE_MASK;
+    Hash = ((ULONG)Va >> PAGE_SHIFT) & (PoolBigPageTableSize - 1);
+    Index = Hash;
     ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
     while (PoolBigPageTable[Hash].Va != Va) {
-        Hash += 1;
-        if (Hash > MAX_BIGPAGE_TABLE) {
-            if (!Inserted) {
-                if (!FirstPrint) {
-                    KdPrint(("POOL:unable to find big page slot %lx\n",Va));
-                    FirstPrint = TRUE;
-                }
-
-                ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
-                return ' GIB';
+        Hash = (Hash + 1) & (PoolBigPageTableSize - 1);
+        if (Hash == Index) {
+            if (!FirstPrint) {
+                KdPrint(("POOL:unable to find big page slot %lx\n",Va));
+                FirstPrint = TRUE;
             }
 
-            Hash = 0;
-            Inserted = FALSE;
+            ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
+            return ' GIB';
         }
     }
 
@@ -2079,7 +2354,6 @@ Return Value:
     PPOOL_HEADER Entry;
     ULONG Index;
     KIRQL LockHandle;
-    PSMALL_POOL_LOOKASIDE LookasideList;
     PPOOL_HEADER NextEntry;
     ULONG PoolIndex;
     POOL_TYPE PoolType;
@@ -2350,15 +2624,11 @@ Return Value:
 
 #else
 
-                LookasideList = &ExpSmallPagedPoolLookasideLists[Index - 1];
-                LookasideList->TotalFrees += 1;
                 if ((Isx86FeaturePresent(KF_CMPXCHG8B)) &&
-                    (ExQueryDepthSList(&LookasideList->SListHead) < LookasideList->Depth)) {
-                    LookasideList->FreeHits += 1;
-                    Entry += 1;
-                    ExInterlockedPushEntrySList(&LookasideList->SListHead,
-                                                (PSINGLE_LIST_ENTRY)Entry,
-                                                &LookasideList->Lock);
+                    (ExpFreeToPoolLookaside(Prcb->PagedPoolLookaside,
+                                            ExpSmallPagedPoolLookasideLists,
+                                            Index - 1,
+                                            Entry + 1) != FALSE)) {
 
 #endif
 
@@ -2368,14 +2638,10 @@ Return Value:
                 PoolIndex = UNPACK_POOL_INDEX(Entry->PoolIndex);
 
             } else {
-                LookasideList = &ExpSmallNPagedPoolLookasideLists[Index - 1];
-                LookasideList->TotalFrees += 1;
-                if (ExQueryDepthSList(&LookasideList->SListHead) < LookasideList->Depth) {
-                    LookasideList->FreeHits += 1;
-                    Entry += 1;
-                    ExInterlockedPushEntrySList(&LookasideList->SListHead,
-                                                (PSINGLE_LIST_ENTRY)Entry,
-                                                &LookasideList->Lock);
+                if (ExpFreeToPoolLookaside(Prcb->NPagedPoolLookaside,
+                                           ExpSmallNPagedPoolLookasideLists,
+                                           Index - 1,
+                                           Entry + 1) != FALSE) {
 
                     return;
                 }
@@ -2702,6 +2968,19 @@ ExQueryPoolUsage(
     // Sum all the lookaside hits for paged and nonpaged pool.
     //
 
+    *PagedPoolLookasideHits = 0;
+    *NonPagedPoolLookasideHits = 0;
+    for (Count = 0; Count < POOL_SMALL_LISTS; Count +=1) {
+
+#if !defined(_PPC_)
+
+        *PagedPoolLookasideHits += ExpSmallPagedPoolLookasideLists[Count].AllocateHits;
+
+#endif
+
+        *NonPagedPoolLookasideHits += ExpSmallNPagedPoolLookasideLists[Count].AllocateHits;
+    }
+
     for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
         Prcb = KiProcessorBlock[Index];
         if (Prcb != NULL) {
@@ -2709,19 +2988,18 @@ ExQueryPoolUsage(
 #if defined(_PPC_)
 
             *PagedPoolLookasideHits += Prcb->PagedPoolLookasideHits;
-            for (Count = 0; Count < POOL_SMALL_LISTS; Count +=1) {
-                *NonPagedPoolLookasideHits += ExpSmallNPagedPoolLookasideLists[Count].AllocateHits;
-            }
 
-#else
+#endif
 
             for (Count = 0; Count < POOL_SMALL_LISTS; Count +=1) {
-                *PagedPoolLookasideHits += ExpSmallPagedPoolLookasideLists[Count].AllocateHits;
-                *NonPagedPoolLookasideHits += ExpSmallNPagedPoolLookasideLists[Count].AllocateHits;
-            }
-
-#endif
+                if (Prcb->PagedPoolLookaside != NULL) {
+                    *PagedPoolLookasideHits += Prcb->PagedPoolLookaside[Count].AllocateHits;
+                }
 
+                if (Prcb->NPagedPoolLookaside != NULL) {
+                    *NonPagedPoolLookasideHits += Prcb->NPagedPoolLookaside[Count].AllocateHits;
+                }
+            }
         }
     }
 
@@ -2820,7 +3098,7 @@ ExpSnapShotPoolPages(
     PPOOL_HEADER p;
 
     if (PAGE_ALIGNED(Address)) {
-        for (i = 0; i < MAX_BIGPAGE_TABLE; i++) {
+        for (i = 0; i < PoolBigPageTableSize; i++) {
             if (PoolBigPageTable[i].NumberOfPages != 0 &&
                 PoolBigPageTable[i].Va == Address
                ) {
@@ -3036,7 +3314,7 @@ ExGetPoolBackTraceIndex(
 
     if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
         if ( PAGE_ALIGNED(P) ) {
-            for (i = 0; i < MAX_BIGPAGE_TABLE; i++) {
+            for (i = 0; i < PoolBigPageTableSize; i++) {
                 if (PoolBigPageTable[i].NumberOfPages != 0 &&
                     PoolBigPageTable[i].Va == P
                    ) {
@@ -1037,6 +1037,75 @@ nullpslist:
 #endif
 
         DUMMY_EXIT(ExInterlockedPushEntrySList)
+
+//      SBTTL("Interlocked Flush Sequenced List")
+//++
+//
+// PSINGLE_LIST_ENTRY
+// ExInterlockedFlushSList (
+//    IN PSLIST_HEADER ListHead,
+//    IN PKSPIN_LOCK Lock
+//    )
+//
+// Routine Description:
+//
+//    This function removes all entries from a sequenced singly linked list
+//    so that access to the list is synchronized in an MP system. If there
+//    are no entries in the list, then a value of NULL is returned. Otherwise,
+//    the address of the first entry that was removed is returned as the
+//    function value.
+//
+//    The list depth is set to zero, but the sequence number is not changed.
+//
+// Arguments:
+//
+//    ListHead (r.3) - Supplies a pointer to the sequenced listhead which is
+//       to be flushed.
+//
+//    Lock (r.4) - Supplies a pointer to a spin lock to be used to synchronize
+//       access to the list.
+//
+// Return Value:
+//
+//    The address of the first entry removed from the list, or NULL if the
+//    list is empty.
+//
+//--
+
+        LEAF_ENTRY(ExInterlockedFlushSList)
+
+        ori     r.6,r.3,0               // move listhead address
+
+        DISABLE_INTERRUPTS(r.8,r.12)    // disable interrupts
+                                        // r.8  <- previous msr value
+                                        // r.12 <- new (disabled) msr
+
+        li      r.0,0                   // zero r.0
+
+#if !defined(NT_UP)
+
+        ACQUIRE_SPIN_LOCK(r.4, r.4, r.9, flushesl, flusheslw)
+#endif
+
+        lwz     r.3,0(r.6)              // get address of first entry (return value also)
+        lwz     r.7,4(r.6)              // get depth and sequence number
+        stw     r.0,0(r.6)              // set list empty
+        rlwinm  r.7,r.7,0,0,15          // clear depth
+        stw     r.7,4(r.6)              // store depth and sequence number
+
+#if !defined(NT_UP)
+        RELEASE_SPIN_LOCK(r.4, r.9)
+#endif
+
+        ENABLE_INTERRUPTS(r.8)          // enable interrupts
+
+        blr                             // return
+
+#if !defined(NT_UP)
+        SPIN_ON_SPIN_LOCK_ENABLED(r.4, r.9, flushesl, flusheslw, flusheslx, r.8, r.12)
+#endif
+
+        DUMMY_EXIT(ExInterlockedFlushSList)
 
 //      SBTTL("Interlocked Compare Exchange 64-bits")
 //++
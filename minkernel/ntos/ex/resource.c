@@ -82,7 +82,8 @@ ExpAssertResource(
 VOID
 ExpWaitForResource (
     IN PERESOURCE Resource,
-    IN PVOID Object
+    IN PVOID Object,
+    IN PLOCK_PROFILE_SITE ProfileSite
     );
 
 POWNER_ENTRY
@@ -130,6 +131,21 @@ RESOURCE_PERFORMANCE_DATA ExpResourcePerformanceData;
 #define ExpIncrementCounter(Member)
 
 #endif
+
+//
+// Define lock profiling macro to record an acquire of a resource by the
+// caller of the current routine.
+//
+
+#define ExpProfileResourceAcquire(Resource, ProfileSite)                   \
+    {                                                                      \
+        ProfileSite = NULL;                                                \
+        if (ExpLockProfileEnabled) {                                       \
+            ProfileSite = ExpLockProfileAcquire((Resource),                \
+                                                LOCK_PROFILE_RESOURCE,     \
+                                                _ReturnAddress());         \
+        }                                                                  \
+    }
 
 //
 // Put code in the appropriate sections.
@@ -409,7 +425,8 @@ BOOLEAN
 FASTCALL
 ExpAcquireResourceExclusiveLite(
     IN PERESOURCE Resource,
-    IN KIRQL OldIrql
+    IN KIRQL OldIrql,
+    IN PLOCK_PROFILE_SITE ProfileSite
     )
 
 /*++
@@ -430,6 +447,9 @@ Arguments:
 
     OldIrql - Supplies the previous IRQL.
 
+    ProfileSite - Supplies a pointer to the lock profile call site entry
+        of the acquire, or NULL if the acquire is not profiled.
+
 Return Value:
 
     BOOLEAN - TRUE if the resource is acquired and FALSE otherwise.
@@ -476,7 +496,7 @@ Return Value:
 
     Resource->NumberOfExclusiveWaiters += 1;
     ExReleaseFastLock(&Resource->SpinLock, OldIrql);
-    ExpWaitForResource(Resource, Resource->ExclusiveWaiters);
+    ExpWaitForResource(Resource, Resource->ExclusiveWaiters, ProfileSite);
 
     //
     // N.B. It is "safe" to store the owner thread without obtaining any
@@ -485,6 +505,10 @@ Return Value:
     //
 
     Resource->OwnerThreads[0].OwnerThread = (ERESOURCE_THREAD)PsGetCurrentThread();
+    if (ProfileSite != NULL) {
+        ExpLockProfileHoldStart(ProfileSite);
+    }
+
     return TRUE;
 }
 
@@ -522,6 +546,7 @@ Return Value:
     ERESOURCE_THREAD CurrentThread;
     PKEVENT Event;
     KIRQL OldIrql = 0;
+    PLOCK_PROFILE_SITE ProfileSite;
     BOOLEAN Result;
 
     ASSERT((Resource->Flag & ResourceNeverExclusive) == 0);
@@ -530,6 +555,7 @@ Return Value:
     // Acquire exclusive access to the specified resource.
     //
 
+    ExpProfileResourceAcquire(Resource, ProfileSite);
     CurrentThread = (ERESOURCE_THREAD)PsGetCurrentThread();
     ExAcquireFastLock(&Resource->SpinLock, &OldIrql);
 
@@ -573,7 +599,7 @@ Return Value:
                 Result = FALSE;
 
             } else {
-                return ExpAcquireResourceExclusiveLite(Resource, OldIrql);
+                return ExpAcquireResourceExclusiveLite(Resource, OldIrql, ProfileSite);
             }
         }
 
@@ -587,6 +613,10 @@ Return Value:
         Resource->OwnerThreads[0].OwnerThread = CurrentThread;
         Resource->OwnerThreads[0].OwnerCount = 1;
         Resource->ActiveCount = 1;
+        if (ProfileSite != NULL) {
+            ExpLockProfileHoldStart(ProfileSite);
+        }
+
         Result = TRUE;
     }
 
@@ -623,6 +653,7 @@ Return Value:
 
     ERESOURCE_THREAD CurrentThread;
     KIRQL OldIrql;
+    PLOCK_PROFILE_SITE ProfileSite;
     BOOLEAN Result;
 
     ASSERT((Resource->Flag & ResourceNeverExclusive) == 0);
@@ -631,6 +662,7 @@ Return Value:
     // Attempt to acquire exclusive access to the specified resource.
     //
 
+    ExpProfileResourceAcquire(Resource, ProfileSite);
     CurrentThread = (ERESOURCE_THREAD)PsGetCurrentThread();
     ExAcquireFastLock(&Resource->SpinLock, &OldIrql);
 
@@ -652,6 +684,10 @@ Return Value:
         Resource->OwnerThreads[0].OwnerThread = CurrentThread;
         Resource->OwnerThreads[0].OwnerCount = 1;
         Resource->ActiveCount = 1;
+        if (ProfileSite != NULL) {
+            ExpLockProfileHoldStart(ProfileSite);
+        }
+
         Result = TRUE;
 
     } else if (IsOwnedExclusive(Resource) &&
@@ -790,12 +826,14 @@ Return Value:
     ERESOURCE_THREAD CurrentThread;
     KIRQL OldIrql;
     POWNER_ENTRY OwnerEntry;
+    PLOCK_PROFILE_SITE ProfileSite;
     PKSEMAPHORE Semaphore;
 
     //
     // Acquire exclusive access to the specified resource.
     //
 
+    ExpProfileResourceAcquire(Resource, ProfileSite);
     CurrentThread = (ERESOURCE_THREAD)PsGetCurrentThread();
     ExAcquireSpinLock(&Resource->SpinLock, &OldIrql);
 
@@ -912,7 +950,7 @@ Return Value:
     OwnerEntry->OwnerCount = 1;
     Resource->NumberOfSharedWaiters += 1;
     ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
-    ExpWaitForResource(Resource, Resource->SharedWaiters);
+    ExpWaitForResource(Resource, Resource->SharedWaiters, ProfileSite);
     return TRUE;
 }
 
@@ -1042,12 +1080,14 @@ Return Value:
     ERESOURCE_THREAD CurrentThread;
     KIRQL OldIrql;
     POWNER_ENTRY OwnerEntry;
+    PLOCK_PROFILE_SITE ProfileSite;
     PKSEMAPHORE Semaphore;
 
     //
     // Acquire exclusive access to the specified resource.
     //
 
+    ExpProfileResourceAcquire(Resource, ProfileSite);
     CurrentThread = (ERESOURCE_THREAD)PsGetCurrentThread();
     ExAcquireSpinLock(&Resource->SpinLock, &OldIrql);
 
@@ -1157,7 +1197,7 @@ Return Value:
     OwnerEntry->OwnerCount = 1;
     Resource->NumberOfSharedWaiters += 1;
     ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
-    ExpWaitForResource(Resource, Resource->SharedWaiters);
+    ExpWaitForResource(Resource, Resource->SharedWaiters, ProfileSite);
     return TRUE;
 }
 
@@ -1193,12 +1233,14 @@ Return Value:
     ERESOURCE_THREAD CurrentThread;
     KIRQL OldIrql;
     POWNER_ENTRY OwnerEntry;
+    PLOCK_PROFILE_SITE ProfileSite;
     PKSEMAPHORE Semaphore;
 
     //
     // Acquire exclusive access to the specified resource.
     //
 
+    ExpProfileResourceAcquire(Resource, ProfileSite);
     CurrentThread = (ERESOURCE_THREAD)PsGetCurrentThread();
     ExAcquireSpinLock(&Resource->SpinLock, &OldIrql);
 
@@ -1300,7 +1342,7 @@ Return Value:
 
             Resource->NumberOfSharedWaiters += 1;
             ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
-            ExpWaitForResource(Resource, Resource->SharedWaiters);
+            ExpWaitForResource(Resource, Resource->SharedWaiters, ProfileSite);
 
             //
             // Reacquire the resource spin lock, allocate an owner entry,
@@ -1380,7 +1422,7 @@ Return Value:
     OwnerEntry->OwnerCount = 1;
     Resource->NumberOfSharedWaiters += 1;
     ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
-    ExpWaitForResource(Resource, Resource->SharedWaiters);
+    ExpWaitForResource(Resource, Resource->SharedWaiters, ProfileSite);
     return TRUE;
 }
 
@@ -1451,10 +1493,13 @@ Return Value:
         }
 
         //
-        // Clear the owner thread.
+        // Clear the owner thread and record the end of the exclusive hold.
         //
 
         Resource->OwnerThreads[0].OwnerThread = 0;
+        if (ExpLockProfileEnabled) {
+            ExpLockProfileHoldEnd(Resource);
+        }
 
         //
         // The thread recursion count reached zero so decrement the resource
@@ -1654,10 +1699,13 @@ Return Value:
         }
 
         //
-        // Clear the owner thread.
+        // Clear the owner thread and record the end of the exclusive hold.
         //
 
         Resource->OwnerThreads[0].OwnerThread = 0;
+        if (ExpLockProfileEnabled) {
+            ExpLockProfileHoldEnd(Resource);
+        }
 
         //
         // The thread recursion count reached zero so decrement the resource
@@ -1959,10 +2007,14 @@ Return Value:
     ASSERT(Resource->OwnerThreads[0].OwnerThread == (ERESOURCE_THREAD)PsGetCurrentThread());
 
     //
-    // Convert the granted access from exclusive to shared.
+    // Convert the granted access from exclusive to shared and record the
+    // end of the exclusive hold.
     //
 
     Resource->Flag &= ~ResourceOwnedExclusive;
+    if (ExpLockProfileEnabled) {
+        ExpLockProfileHoldEnd(Resource);
+    }
 
     //
     // If there are any shared waiters, then grant them shared access.
@@ -2420,7 +2472,8 @@ ExQuerySystemLockInformation(
 VOID
 ExpWaitForResource (
     IN PERESOURCE Resource,
-    IN PVOID Object
+    IN PVOID Object,
+    IN PLOCK_PROFILE_SITE ProfileSite
     )
 /*++
 
@@ -2437,6 +2490,9 @@ Arguments:
     Object - Supplies a pointer to an event (exclusive) or eemaphore
        (shared) to wait for.
 
+    ProfileSite - Supplies a pointer to the lock profile call site entry
+       of the acquire, or NULL if the acquire is not profiled.
+
 Return Value:
 
     None.
@@ -2452,12 +2508,16 @@ Return Value:
     POWNER_ENTRY OwnerEntry;
     PKTHREAD OwnerThread;
     NTSTATUS Status;
+    LARGE_INTEGER WaitStart;
 
     //
     // Increment the contention count for the resource.
     //
 
     Resource->ContentionCount += 1;
+    if (ProfileSite != NULL) {
+        WaitStart = KeQueryPerformanceCounter(NULL);
+    }
 
     //
     // Wait for the specified object to be signalled or a timeout to
@@ -2474,6 +2534,10 @@ Return Value:
                         &ExpTimeout );
 
         if (Status != STATUS_TIMEOUT) {
+            if (ProfileSite != NULL) {
+                ExpLockProfileContention(ProfileSite, &WaitStart);
+            }
+
             break;
         }
 
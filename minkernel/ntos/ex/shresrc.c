@@ -0,0 +1,576 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    shresrc.c
+
+Abstract:
+
+    This module implements the executive functions to acquire and release
+    a shared mostly resource.
+
+    A shared mostly resource is a reader/writer lock for data that is read
+    far more often than it is written. Each processor has its own count of
+    shared owners in a separate cache line, so a shared acquire and release
+    only update the count of the current processor with an interlocked
+    operation and do not acquire a spinlock or write a shared cache line.
+
+    An exclusive acquire marks the resource exclusive, which sends new
+    shared acquires to the slow path, and then waits until the sum of the
+    shared owner counts of all processors drops to zero. Exclusive acquires
+    and shared acquires that must wait are synchronized with a spinlock.
+
+    N.B. A shared owner count is not tied to a thread or a processor. A
+         thread may release the resource on a different processor than it
+         acquired it on, since only the sum of the counts is significant.
+
+    N.B. Unlike an executive resource, the owners of a shared mostly
+         resource are not recorded. A thread that owns the resource shared
+         must not acquire it shared again, since the second acquire waits
+         for any pending exclusive acquire, which in turn waits for the
+         first shared acquire to be released. A thread that owns the
+         resource exclusive may acquire it again either shared or exclusive.
+
+Environment:
+
+    Kernel mode only.
+
+Revision History:
+
+--*/
+
+#include "exp.h"
+#pragma hdrstop
+
+//
+// Define local macros to access the shared owner counts.
+//
+
+#define SHARED_COUNT(Resource) \
+    (&(Resource)->SharedCounts[KeGetCurrentProcessorNumber() & ((Resource)->NumberOfCounts - 1)])
+
+#define IsOwnedExclusive(Resource) ((Resource)->ExclusiveOwner == KeGetCurrentThread())
+
+//
+// Define forward referenced prototypes.
+//
+
+VOID
+ExpReleaseSharedCount (
+    IN PESHARED_RESOURCE Resource,
+    IN PSHARED_RESOURCE_COUNT Count
+    );
+
+VOID
+ExpReleaseSharedResourceExclusive (
+    IN PESHARED_RESOURCE Resource
+    );
+
+LONG
+ExpSumSharedCounts (
+    IN PESHARED_RESOURCE Resource
+    );
+
+NTSTATUS
+ExInitializeSharedResource (
+    IN PESHARED_RESOURCE Resource
+    )
+
+/*++
+
+Routine Description:
+
+    This function initializes a shared mostly resource and allocates the
+    shared owner counts for the processors in the host configuration.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource. The resource
+        must be allocated in nonpaged pool.
+
+Return Value:
+
+    STATUS_SUCCESS if the resource is initialized. Otherwise,
+    STATUS_INSUFFICIENT_RESOURCES.
+
+--*/
+
+{
+
+    ULONG NumberOfCounts;
+
+    ASSERT(MmDeterminePoolType(Resource) != PagedPool);
+
+    //
+    // Round the number of counts up to a power of two so the count of the
+    // current processor can be selected with a mask.
+    //
+
+    NumberOfCounts = 1;
+    while (NumberOfCounts < (ULONG)KeNumberProcessors) {
+        NumberOfCounts <<= 1;
+    }
+
+    RtlZeroMemory(Resource, sizeof(ESHARED_RESOURCE));
+    Resource->SharedCounts = ExAllocatePoolWithTag(NonPagedPoolCacheAligned,
+                                                   NumberOfCounts * sizeof(SHARED_RESOURCE_COUNT),
+                                                   'cSeR');
+
+    if (Resource->SharedCounts == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Resource->SharedCounts, NumberOfCounts * sizeof(SHARED_RESOURCE_COUNT));
+    Resource->NumberOfCounts = NumberOfCounts;
+    KeInitializeSpinLock(&Resource->SpinLock);
+    KeInitializeSemaphore(&Resource->SharedWaiters, 0, MAXLONG);
+    KeInitializeSemaphore(&Resource->ExclusiveWaiters, 0, MAXLONG);
+    KeInitializeEvent(&Resource->DrainEvent, SynchronizationEvent, FALSE);
+    return STATUS_SUCCESS;
+}
+
+VOID
+ExDeleteSharedResource (
+    IN PESHARED_RESOURCE Resource
+    )
+
+/*++
+
+Routine Description:
+
+    This function frees the shared owner counts of a shared mostly resource.
+    The resource must not be owned.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(Resource->ExclusiveState == 0);
+    ASSERT(ExpSumSharedCounts(Resource) == 0);
+
+    ExFreePool(Resource->SharedCounts);
+    Resource->SharedCounts = NULL;
+    return;
+}
+
+BOOLEAN
+ExAcquireSharedResourceShared (
+    IN PESHARED_RESOURCE Resource,
+    IN BOOLEAN Wait
+    )
+
+/*++
+
+Routine Description:
+
+    This function acquires a shared mostly resource for shared access.
+
+    The shared owner count of the current processor is incremented and the
+    resource is then checked for exclusive ownership. If the resource is not
+    owned exclusive and no exclusive acquire is in progress, then access is
+    granted without further synchronization. Otherwise, the count is
+    decremented and the caller waits for the exclusive owner to release the
+    resource if wait is specified.
+
+    N.B. The caller is expected to disable normal kernel APCs with
+         KeEnterCriticalRegion as for an executive resource.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource.
+
+    Wait - Supplies a boolean value that determines whether the caller
+        waits for the resource if it cannot be acquired immediately.
+
+Return Value:
+
+    TRUE if the resource is acquired. Otherwise, FALSE.
+
+--*/
+
+{
+
+    PSHARED_RESOURCE_COUNT Count;
+    KIRQL OldIrql;
+
+    ASSERT(KeGetCurrentIrql() <= APC_LEVEL);
+
+    //
+    // If the current thread owns the resource exclusive, then the shared
+    // acquire is treated as a recursive exclusive acquire.
+    //
+
+    if (IsOwnedExclusive(Resource)) {
+        Resource->ExclusiveCount += 1;
+        return TRUE;
+    }
+
+    do {
+
+        //
+        // Increment the shared owner count of the current processor.
+        //
+        // N.B. The interlocked increment orders the increment before the
+        //      read of the exclusive state. An exclusive acquire sets the
+        //      exclusive state with an interlocked exchange before it sums
+        //      the counts, so either the exclusive acquire sees this count
+        //      or this acquire sees the exclusive state.
+        //
+
+        Count = SHARED_COUNT(Resource);
+        InterlockedIncrement(&Count->SharedCount);
+        if (Resource->ExclusiveState == 0) {
+            return TRUE;
+        }
+
+        //
+        // The resource is owned exclusive or an exclusive acquire is
+        // draining the shared owners. Back out the shared owner count.
+        //
+
+        ExpReleaseSharedCount(Resource, Count);
+        if (Wait == FALSE) {
+            return FALSE;
+        }
+
+        //
+        // Wait for the exclusive owner to release the resource. The state is
+        // checked again with the spinlock held, since the exclusive owner
+        // releases the shared waiters with the spinlock held.
+        //
+
+        ExAcquireSpinLock(&Resource->SpinLock, &OldIrql);
+        if (Resource->ExclusiveState == 0) {
+            ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
+            continue;
+        }
+
+        Resource->ContentionCount += 1;
+        Resource->NumberOfSharedWaiters += 1;
+        ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
+        KeWaitForSingleObject(&Resource->SharedWaiters,
+                              Executive,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+
+    } while (TRUE);
+}
+
+BOOLEAN
+ExAcquireSharedResourceExclusive (
+    IN PESHARED_RESOURCE Resource,
+    IN BOOLEAN Wait
+    )
+
+/*++
+
+Routine Description:
+
+    This function acquires a shared mostly resource for exclusive access.
+
+    The resource is marked exclusive with the spinlock held, which sends new
+    shared acquires to the slow path, and the caller then waits until the
+    current shared owners release the resource. If wait is not specified and
+    the resource has shared owners, then the exclusive mark is removed and
+    the acquire fails.
+
+    N.B. The caller is expected to disable normal kernel APCs with
+         KeEnterCriticalRegion as for an executive resource.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource.
+
+    Wait - Supplies a boolean value that determines whether the caller
+        waits for the resource if it cannot be acquired immediately.
+
+Return Value:
+
+    TRUE if the resource is acquired. Otherwise, FALSE.
+
+--*/
+
+{
+
+    KIRQL OldIrql;
+
+    ASSERT(KeGetCurrentIrql() <= APC_LEVEL);
+
+    //
+    // If the current thread owns the resource exclusive, then increment the
+    // recursion count.
+    //
+
+    if (IsOwnedExclusive(Resource)) {
+        Resource->ExclusiveCount += 1;
+        return TRUE;
+    }
+
+    //
+    // Mark the resource exclusive if it is not owned exclusive. Otherwise,
+    // wait for the exclusive owner to release the resource.
+    //
+
+    do {
+        ExAcquireSpinLock(&Resource->SpinLock, &OldIrql);
+        if (Resource->ExclusiveState == 0) {
+            InterlockedExchange(&Resource->ExclusiveState, 1);
+            ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
+            break;
+        }
+
+        if (Wait == FALSE) {
+            ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
+            return FALSE;
+        }
+
+        Resource->ContentionCount += 1;
+        Resource->NumberOfExclusiveWaiters += 1;
+        ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
+        KeWaitForSingleObject(&Resource->ExclusiveWaiters,
+                              Executive,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+
+    } while (TRUE);
+
+    //
+    // Wait for the shared owners to drain. Each shared release sets the
+    // drain event while the resource is marked exclusive, so the counts are
+    // summed after the event is cleared.
+    //
+
+    do {
+        KeClearEvent(&Resource->DrainEvent);
+        if (ExpSumSharedCounts(Resource) == 0) {
+            break;
+        }
+
+        if (Wait == FALSE) {
+            ExpReleaseSharedResourceExclusive(Resource);
+            return FALSE;
+        }
+
+        KeWaitForSingleObject(&Resource->DrainEvent,
+                              Executive,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+
+    } while (TRUE);
+
+    Resource->ExclusiveOwner = KeGetCurrentThread();
+    Resource->ExclusiveCount = 1;
+    return TRUE;
+}
+
+VOID
+ExReleaseSharedResource (
+    IN PESHARED_RESOURCE Resource
+    )
+
+/*++
+
+Routine Description:
+
+    This function releases a shared mostly resource that was acquired for
+    shared or exclusive access by the current thread.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+
+    //
+    // If the current thread owns the resource exclusive, then decrement
+    // the recursion count and release the resource when the count reaches
+    // zero. Otherwise, release a shared owner count.
+    //
+
+    if (IsOwnedExclusive(Resource)) {
+        Resource->ExclusiveCount -= 1;
+        if (Resource->ExclusiveCount == 0) {
+            Resource->ExclusiveOwner = NULL;
+            ExpReleaseSharedResourceExclusive(Resource);
+        }
+
+    } else {
+        ExpReleaseSharedCount(Resource, SHARED_COUNT(Resource));
+    }
+
+    return;
+}
+
+BOOLEAN
+ExIsSharedResourceAcquiredExclusive (
+    IN PESHARED_RESOURCE Resource
+    )
+
+/*++
+
+Routine Description:
+
+    This function determines whether the current thread owns a shared mostly
+    resource for exclusive access.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource.
+
+Return Value:
+
+    TRUE if the current thread owns the resource exclusive. Otherwise, FALSE.
+
+--*/
+
+{
+
+    return (BOOLEAN)IsOwnedExclusive(Resource);
+}
+
+VOID
+ExpReleaseSharedCount (
+    IN PESHARED_RESOURCE Resource,
+    IN PSHARED_RESOURCE_COUNT Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function decrements a shared owner count and wakes an exclusive
+    acquire that is draining the shared owners.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource.
+
+    Count - Supplies a pointer to the shared owner count to decrement.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    InterlockedDecrement(&Count->SharedCount);
+    if (Resource->ExclusiveState != 0) {
+        KeSetEvent(&Resource->DrainEvent, 0, FALSE);
+    }
+
+    return;
+}
+
+VOID
+ExpReleaseSharedResourceExclusive (
+    IN PESHARED_RESOURCE Resource
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes the exclusive mark from a shared mostly resource
+    and releases all shared waiters and one exclusive waiter.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOLEAN ExclusiveWaiter;
+    KIRQL OldIrql;
+    LONG SharedWaiters;
+
+    ExAcquireSpinLock(&Resource->SpinLock, &OldIrql);
+    InterlockedExchange(&Resource->ExclusiveState, 0);
+    SharedWaiters = Resource->NumberOfSharedWaiters;
+    Resource->NumberOfSharedWaiters = 0;
+    ExclusiveWaiter = FALSE;
+    if (Resource->NumberOfExclusiveWaiters != 0) {
+        Resource->NumberOfExclusiveWaiters -= 1;
+        ExclusiveWaiter = TRUE;
+    }
+
+    ExReleaseSpinLock(&Resource->SpinLock, OldIrql);
+
+    //
+    // The waiters retry the acquire when they run. A released exclusive
+    // waiter competes with the released shared waiters and with new
+    // acquires.
+    //
+
+    if (SharedWaiters != 0) {
+        KeReleaseSemaphore(&Resource->SharedWaiters, 0, SharedWaiters, FALSE);
+    }
+
+    if (ExclusiveWaiter != FALSE) {
+        KeReleaseSemaphore(&Resource->ExclusiveWaiters, 0, 1, FALSE);
+    }
+
+    return;
+}
+
+LONG
+ExpSumSharedCounts (
+    IN PESHARED_RESOURCE Resource
+    )
+
+/*++
+
+Routine Description:
+
+    This function sums the shared owner counts of all processors.
+
+Arguments:
+
+    Resource - Supplies a pointer to a shared mostly resource.
+
+Return Value:
+
+    The number of shared owners of the resource.
+
+--*/
+
+{
+
+    ULONG Index;
+    LONG Sum;
+
+    Sum = 0;
+    for (Index = 0; Index < Resource->NumberOfCounts; Index += 1) {
+        Sum += Resource->SharedCounts[Index].SharedCount;
+    }
+
+    return Sum;
+}
@@ -110,6 +110,13 @@ ExpGetLookasideInformation (
     OUT PULONG Length
     );
 
+VOID
+ExpGetPoolLookasideInformation (
+    OUT PSYSTEM_LOOKASIDE_INFORMATION Lookaside,
+    IN POOL_TYPE PoolType,
+    IN ULONG Index
+    );
+
 NTSTATUS
 ExpGetPoolInformation(
     IN POOL_TYPE PoolType,
@@ -168,6 +175,7 @@ ExpQueryModuleInformation(
 #pragma alloc_text(PAGELK, ExpCopyThreadInfo)
 #pragma alloc_text(PAGELK, ExpGetLockInformation)
 #pragma alloc_text(PAGELK, ExpGetLookasideInformation)
+#pragma alloc_text(PAGELK, ExpGetPoolLookasideInformation)
 #pragma alloc_text(PAGELK, ExpGetPoolInformation)
 #endif
 
@@ -1797,6 +1805,83 @@ Return Value:
 
             break;
 
+        case SystemWorkerQueueInformation:
+            Status = ExpGetWorkerQueueInformation(SystemInformation,
+                                                  SystemInformationLength,
+                                                  &Length);
+
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+
+        case SystemLockProfileInformation:
+            Status = ExpGetLockProfileInformation(SystemInformation,
+                                                  SystemInformationLength,
+                                                  &Length);
+
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+
+        case SystemCompressedStoreInformation:
+            Status = MmGetCompressedStoreInformation(SystemInformation,
+                                                     SystemInformationLength,
+                                                     &Length);
+
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+
+        case SystemZeroPageInformation:
+            Status = MmGetZeroPageInformation(SystemInformation,
+                                              SystemInformationLength,
+                                              &Length);
+
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+
+        case SystemPageFileWriteInformation:
+            Status = MmGetPageFileWriteInformation(SystemInformation,
+                                                   SystemInformationLength,
+                                                   &Length);
+
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+
+        case SystemTbFlushInformation:
+            Status = KeGetTbFlushInformation(SystemInformation,
+                                             SystemInformationLength,
+                                             &Length);
+
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+
+        case SystemWaitSpinInformation:
+            Status = KeGetWaitSpinInformation(SystemInformation,
+                                              SystemInformationLength,
+                                              &Length);
+
+            if (ARGUMENT_PRESENT(ReturnLength)) {
+                *ReturnLength = Length;
+            }
+
+            break;
+
         default:
 
             //
@@ -2297,6 +2382,37 @@ Return Value:
                 KiIdealDpcRate = DpcInfo.IdealDpcRate;
             }
             break;
+
+            //
+            // Enable or disable lock profiling.
+            //
+            // N.B. The caller must have the SeSystemProfile privilege.
+            //
+
+        case SystemLockProfileInformation:
+
+            //
+            // If the system information buffer is not the correct length,
+            // then return an error.
+            //
+
+            if (SystemInformationLength != sizeof( SYSTEM_LOCK_PROFILE_CONTROL )) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            //
+            // If the current thread does not have the privilege to profile
+            // the system, then return an error.
+            //
+
+            if ((PreviousMode != KernelMode) &&
+                (SeSinglePrivilegeCheck(SeSystemProfilePrivilege, PreviousMode) == FALSE)) {
+                return STATUS_PRIVILEGE_NOT_HELD;
+            }
+
+            Enable = ((PSYSTEM_LOCK_PROFILE_CONTROL)SystemInformation)->Enable;
+            Status = ExpSetLockProfileInformation(Enable);
+            break;
 #ifdef _PNP_POWER_
         case SystemPowerInformation:
 
@@ -3114,7 +3230,6 @@ Return Value:
     ULONG Number;
     PNPAGED_LOOKASIDE_LIST NPagedLookaside;
     PPAGED_LOOKASIDE_LIST PagedLookaside;
-    PSMALL_POOL_LOOKASIDE PoolLookaside;
     PKSPIN_LOCK SpinLock;
     NTSTATUS Status;
 
@@ -3147,21 +3262,8 @@ Return Value:
             //
 
             Index = 0;
-            PoolLookaside = &ExpSmallNPagedPoolLookasideLists[0];
             do {
-                Lookaside->CurrentDepth = PoolLookaside->SListHead.Depth;
-                Lookaside->MaximumDepth = PoolLookaside->Depth;
-                Lookaside->TotalAllocates = PoolLookaside->TotalAllocates;
-                Lookaside->AllocateMisses =
-                        PoolLookaside->TotalAllocates - PoolLookaside->AllocateHits;
-
-                Lookaside->TotalFrees = PoolLookaside->TotalFrees;
-                Lookaside->FreeMisses =
-                        PoolLookaside->TotalFrees - PoolLookaside->FreeHits;
-
-                Lookaside->Type = 0;
-                Lookaside->Tag = 'looP';
-                Lookaside->Size = (Index + 1) * 32;
+                ExpGetPoolLookasideInformation(Lookaside, NonPagedPool, Index);
                 Number += 1;
                 if (Number == Limit) {
                     goto Finish2;
@@ -3169,7 +3271,6 @@ Return Value:
 
                 Index += 1;
                 Lookaside += 1;
-                PoolLookaside += 1;
             } while (Index < POOL_SMALL_LISTS);
 
             //
@@ -3179,21 +3280,8 @@ Return Value:
 #if !defined(_PPC_)
 
             Index = 0;
-            PoolLookaside = &ExpSmallPagedPoolLookasideLists[0];
             do {
-                Lookaside->CurrentDepth = PoolLookaside->SListHead.Depth;
-                Lookaside->MaximumDepth = PoolLookaside->Depth;
-                Lookaside->TotalAllocates = PoolLookaside->TotalAllocates;
-                Lookaside->AllocateMisses =
-                        PoolLookaside->TotalAllocates - PoolLookaside->AllocateHits;
-
-                Lookaside->TotalFrees = PoolLookaside->TotalFrees;
-                Lookaside->FreeMisses =
-                        PoolLookaside->TotalFrees - PoolLookaside->FreeHits;
-
-                Lookaside->Type = 1;
-                Lookaside->Tag = 'looP';
-                Lookaside->Size = (Index + 1) * 32;
+                ExpGetPoolLookasideInformation(Lookaside, PagedPool, Index);
                 Number += 1;
                 if (Number == Limit) {
                     goto Finish2;
@@ -3201,7 +3289,6 @@ Return Value:
 
                 Index += 1;
                 Lookaside += 1;
-                PoolLookaside += 1;
             } while (Index < POOL_SMALL_LISTS);
 
 #endif
@@ -3285,6 +3372,106 @@ Return Value:
     return Status;
 }
 
+VOID
+ExpGetPoolLookasideInformation (
+    OUT PSYSTEM_LOOKASIDE_INFORMATION Lookaside,
+    IN POOL_TYPE PoolType,
+    IN ULONG Index
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns information about a small pool lookaside list.
+    The depths are those of the system list, and the allocation and free
+    counts are summed over the system list and the lists of each processor.
+
+Arguments:
+
+    Lookaside - Supplies a pointer to the entry that receives the lookaside
+        information.
+
+    PoolType - Supplies the pool type, which is either NonPagedPool or
+        PagedPool.
+
+    Index - Supplies the index of the small pool list.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG AllocateHits;
+    ULONG FreeHits;
+    ULONG Number;
+    PSMALL_POOL_LOOKASIDE PoolLookaside;
+    PKPRCB Prcb;
+    ULONG TotalAllocates;
+    ULONG TotalFrees;
+
+#if defined(_PPC_)
+
+    PoolLookaside = &ExpSmallNPagedPoolLookasideLists[Index];
+
+#else
+
+    if (PoolType == NonPagedPool) {
+        PoolLookaside = &ExpSmallNPagedPoolLookasideLists[Index];
+
+    } else {
+        PoolLookaside = &ExpSmallPagedPoolLookasideLists[Index];
+    }
+
+#endif
+
+    Lookaside->CurrentDepth = PoolLookaside->SListHead.Depth;
+    Lookaside->MaximumDepth = PoolLookaside->Depth;
+    TotalAllocates = PoolLookaside->TotalAllocates;
+    AllocateHits = PoolLookaside->AllocateHits;
+    TotalFrees = PoolLookaside->TotalFrees;
+    FreeHits = PoolLookaside->FreeHits;
+
+    //
+    // Add the counts of the per processor lists.
+    //
+    // N.B. An allocation that misses a per processor list is attempted
+    //      again from the system list and is already counted there, so
+    //      only the hits of the per processor lists are added. The same
+    //      holds for frees.
+    //
+
+    for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+        Prcb = KiProcessorBlock[Number];
+        if (PoolType == NonPagedPool) {
+            PoolLookaside = Prcb->NPagedPoolLookaside;
+
+        } else {
+            PoolLookaside = Prcb->PagedPoolLookaside;
+        }
+
+        if (PoolLookaside != NULL) {
+            PoolLookaside += Index;
+            TotalAllocates += PoolLookaside->AllocateHits;
+            AllocateHits += PoolLookaside->AllocateHits;
+            TotalFrees += PoolLookaside->FreeHits;
+            FreeHits += PoolLookaside->FreeHits;
+        }
+    }
+
+    Lookaside->TotalAllocates = TotalAllocates;
+    Lookaside->AllocateMisses = TotalAllocates - AllocateHits;
+    Lookaside->TotalFrees = TotalFrees;
+    Lookaside->FreeMisses = TotalFrees - FreeHits;
+    Lookaside->Type = PoolType;
+    Lookaside->Tag = 'looP';
+    Lookaside->Size = (Index + 1) * 32;
+    return;
+}
+
 NTSTATUS
 ExpGetPoolInformation(
     IN POOL_TYPE PoolType,
@@ -3554,6 +3741,7 @@ ExpGetPoolTagInfo (
     NTSTATUS status = STATUS_SUCCESS;
     PSYSTEM_POOLTAG_INFORMATION taginfo;
     PSYSTEM_POOLTAG poolTag;
+    POOL_TRACKER_TABLE Tracker;
 
     PAGED_CODE();
     if (!PoolTrackTable) {
@@ -3571,13 +3759,14 @@ ExpGetPoolTagInfo (
             if (SystemInformationLength < totalBytes) {
                 status = STATUS_INFO_LENGTH_MISMATCH;
             } else {
-                poolTag->TagUlong = PoolTrackTable[i].Key;
-                poolTag->PagedAllocs = PoolTrackTable[i].PagedAllocs;
-                poolTag->PagedFrees = PoolTrackTable[i].PagedFrees;
-                poolTag->PagedUsed = PoolTrackTable[i].PagedBytes;
-                poolTag->NonPagedAllocs = PoolTrackTable[i].NonPagedAllocs;
-                poolTag->NonPagedFrees = PoolTrackTable[i].NonPagedFrees;
-                poolTag->NonPagedUsed = PoolTrackTable[i].NonPagedBytes;
+                ExpGetPoolTagCounters(i, &Tracker);
+                poolTag->TagUlong = Tracker.Key;
+                poolTag->PagedAllocs = Tracker.PagedAllocs;
+                poolTag->PagedFrees = Tracker.PagedFrees;
+                poolTag->PagedUsed = Tracker.PagedBytes;
+                poolTag->NonPagedAllocs = Tracker.NonPagedAllocs;
+                poolTag->NonPagedFrees = Tracker.NonPagedFrees;
+                poolTag->NonPagedUsed = Tracker.NonPagedBytes;
                 poolTag += 1;
             }
         }
@@ -0,0 +1,358 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    lockprof.c
+
+Abstract:
+
+    Test driver for lock profiling. One reader thread runs on each
+    processor and acquires an executive resource shared in a loop while a
+    writer thread acquires it exclusive now and then. The test is run with
+    lock profiling enabled, and the profile of the resource must show
+    every acquire made by the readers and the writer, with the call sites
+    of the acquires.
+
+    The test is then run again against a second resource after profiling
+    is enabled again. The second profile must show the second resource
+    and must not show the first, since enabling profiling discards the
+    previous profile.
+
+    The driver runs the test from its driver entry routine, prints the
+    results to the debugger, and then fails to load so that the test can
+    be run again by starting the driver again.
+
+Environment:
+
+    Kernel mode only.
+
+Revision History:
+
+--*/
+
+#include "ntos.h"
+#include "zwapi.h"
+
+#define BENCH_ITERATIONS 100000
+
+ERESOURCE FirstResource;
+ERESOURCE SecondResource;
+PERESOURCE BenchResource;
+volatile BOOLEAN BenchDone;
+ULONG BenchExclusive;
+ULONG NumberOfProcessors;
+
+NTSTATUS
+DriverEntry (
+    IN PDRIVER_OBJECT DriverObject,
+    IN PUNICODE_STRING RegistryPath
+    );
+
+VOID
+BenchReader (
+    IN PVOID StartContext
+    )
+{
+    ULONG Index;
+
+    KeSetAffinityThread(KeGetCurrentThread(), (KAFFINITY)1 << (ULONG)StartContext);
+    KeEnterCriticalRegion();
+    for (Index = 0; Index < BENCH_ITERATIONS; Index += 1) {
+        ExAcquireResourceShared(BenchResource, TRUE);
+        ExReleaseResource(BenchResource);
+    }
+
+    KeLeaveCriticalRegion();
+    return;
+}
+
+VOID
+BenchWriter (
+    IN PVOID StartContext
+    )
+{
+    LARGE_INTEGER Time;
+
+    Time.QuadPart = -10 * 1000;
+    KeEnterCriticalRegion();
+    while (BenchDone == FALSE) {
+        ExAcquireResourceExclusive(BenchResource, TRUE);
+        BenchExclusive += 1;
+        KeStallExecutionProcessor(10);
+        ExReleaseResource(BenchResource);
+        KeDelayExecutionThread(KernelMode, FALSE, &Time);
+    }
+
+    KeLeaveCriticalRegion();
+    return;
+}
+
+NTSTATUS
+SetLockProfile (
+    IN BOOLEAN Enable
+    )
+{
+    SYSTEM_LOCK_PROFILE_CONTROL Control;
+
+    Control.Enable = Enable;
+    return ZwSetSystemInformation(SystemLockProfileInformation,
+                                  &Control,
+                                  sizeof(Control));
+}
+
+BOOLEAN
+RunResourceBench (
+    IN PERESOURCE Resource
+    )
+{
+    HANDLE Handles[MAXIMUM_PROCESSORS];
+    ULONG Index;
+    ULONG NumberOfReaders;
+    NTSTATUS Status;
+    HANDLE WriterHandle;
+
+    BenchResource = Resource;
+    BenchDone = FALSE;
+    BenchExclusive = 0;
+    Status = PsCreateSystemThread(&WriterHandle,
+                                  THREAD_ALL_ACCESS,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  BenchWriter,
+                                  NULL);
+
+    if (!NT_SUCCESS(Status)) {
+        DbgPrint("Unable to create writer thread, status %08lx\n", Status);
+        return FALSE;
+    }
+
+    for (NumberOfReaders = 0;
+         NumberOfReaders < NumberOfProcessors;
+         NumberOfReaders += 1) {
+
+        Status = PsCreateSystemThread(&Handles[NumberOfReaders],
+                                      THREAD_ALL_ACCESS,
+                                      NULL,
+                                      NULL,
+                                      NULL,
+                                      BenchReader,
+                                      (PVOID)NumberOfReaders);
+
+        if (!NT_SUCCESS(Status)) {
+            DbgPrint("Unable to create reader thread, status %08lx\n", Status);
+            break;
+        }
+    }
+
+    //
+    // Wait for the readers to finish and then stop the writer. The driver
+    // must not return until all of its threads have exited.
+    //
+
+    for (Index = 0; Index < NumberOfReaders; Index += 1) {
+        ZwWaitForSingleObject(Handles[Index], FALSE, NULL);
+        ZwClose(Handles[Index]);
+    }
+
+    BenchDone = TRUE;
+    ZwWaitForSingleObject(WriterHandle, FALSE, NULL);
+    ZwClose(WriterHandle);
+    return (BOOLEAN)NT_SUCCESS(Status);
+}
+
+PSYSTEM_LOCK_PROFILE_INFORMATION
+QueryLockProfile (
+    VOID
+    )
+{
+    PSYSTEM_LOCK_PROFILE_INFORMATION Information;
+    ULONG Length;
+    NTSTATUS Status;
+
+    Length = 0;
+    ZwQuerySystemInformation(SystemLockProfileInformation,
+                             NULL,
+                             0,
+                             &Length);
+
+    Information = ExAllocatePool(NonPagedPool, Length);
+    if (Information == NULL) {
+        DbgPrint("Unable to allocate %d bytes for lock profile\n", Length);
+        return NULL;
+    }
+
+    Status = ZwQuerySystemInformation(SystemLockProfileInformation,
+                                      Information,
+                                      Length,
+                                      &Length);
+
+    if (!NT_SUCCESS(Status)) {
+        DbgPrint("Unable to query lock profile, status %08lx\n", Status);
+        ExFreePool(Information);
+        return NULL;
+    }
+
+    DbgPrint("%d locks profiled, %d acquires dropped\n",
+             Information->NumberOfLocks,
+             Information->DroppedAcquires);
+
+    return Information;
+}
+
+PSYSTEM_LOCK_PROFILE_ENTRY
+FindLockProfile (
+    IN PSYSTEM_LOCK_PROFILE_INFORMATION Information,
+    IN PVOID Lock
+    )
+{
+    ULONG Index;
+
+    for (Index = 0; Index < Information->NumberOfLocks; Index += 1) {
+        if (Information->Locks[Index].Address == Lock) {
+            return &Information->Locks[Index];
+        }
+    }
+
+    return NULL;
+}
+
+BOOLEAN
+CheckLockProfile (
+    IN PSYSTEM_LOCK_PROFILE_INFORMATION Information,
+    IN PERESOURCE Resource
+    )
+{
+    PSYSTEM_LOCK_PROFILE_ENTRY Entry;
+    BOOLEAN Result;
+    ULONG Slot;
+
+    Entry = FindLockProfile(Information, Resource);
+    if (Entry == NULL) {
+        DbgPrint("Resource %lx was not profiled\n", Resource);
+        return FALSE;
+    }
+
+    DbgPrint("Resource %lx: %d acquires, %d contended, %d call sites\n",
+             Entry->Address,
+             Entry->AcquireCount,
+             Entry->ContentionCount,
+             Entry->NumberOfCallSites);
+
+    Result = TRUE;
+    for (Slot = 0; Slot < LOCK_PROFILE_CALL_SITES; Slot += 1) {
+        if (Entry->CallSites[Slot].AcquireCount != 0) {
+            DbgPrint("    %08lx: %d acquires, %d contended\n",
+                     Entry->CallSites[Slot].CallSite,
+                     Entry->CallSites[Slot].AcquireCount,
+                     Entry->CallSites[Slot].ContentionCount);
+
+            if (Entry->CallSites[Slot].CallSite == NULL) {
+                DbgPrint("Call site was not recorded\n");
+                Result = FALSE;
+            }
+        }
+    }
+
+    if (Entry->AcquireCount <
+        (NumberOfProcessors * BENCH_ITERATIONS) + BenchExclusive) {
+        DbgPrint("Resource acquires were not all profiled\n");
+        Result = FALSE;
+    }
+
+    return Result;
+}
+
+NTSTATUS
+DriverEntry (
+    IN PDRIVER_OBJECT DriverObject,
+    IN PUNICODE_STRING RegistryPath
+    )
+{
+    SYSTEM_BASIC_INFORMATION BasicInformation;
+    PSYSTEM_LOCK_PROFILE_INFORMATION Information;
+    BOOLEAN Result;
+    NTSTATUS Status;
+
+    DbgPrint("Start lock profile test...\n");
+    Status = ZwQuerySystemInformation(SystemBasicInformation,
+                                      &BasicInformation,
+                                      sizeof(BasicInformation),
+                                      NULL);
+
+    if (!NT_SUCCESS(Status)) {
+        return Status;
+    }
+
+    NumberOfProcessors = BasicInformation.NumberOfProcessors;
+    ExInitializeResource(&FirstResource);
+    ExInitializeResource(&SecondResource);
+
+    //
+    // Profile the first resource.
+    //
+
+    Result = FALSE;
+    Status = SetLockProfile(TRUE);
+    if (!NT_SUCCESS(Status)) {
+        DbgPrint("Unable to enable lock profiling, status %08lx\n", Status);
+        goto Done;
+    }
+
+    Result = RunResourceBench(&FirstResource);
+    SetLockProfile(FALSE);
+    if (Result == FALSE) {
+        goto Done;
+    }
+
+    Information = QueryLockProfile();
+    if (Information == NULL) {
+        Result = FALSE;
+        goto Done;
+    }
+
+    Result = CheckLockProfile(Information, &FirstResource);
+    ExFreePool(Information);
+    if (Result == FALSE) {
+        goto Done;
+    }
+
+    //
+    // Enable profiling again and profile the second resource. The first
+    // resource must not be in the new profile.
+    //
+
+    SetLockProfile(TRUE);
+    Result = RunResourceBench(&SecondResource);
+    SetLockProfile(FALSE);
+    if (Result == FALSE) {
+        goto Done;
+    }
+
+    Information = QueryLockProfile();
+    if (Information == NULL) {
+        Result = FALSE;
+        goto Done;
+    }
+
+    Result = CheckLockProfile(Information, &SecondResource);
+    if (FindLockProfile(Information, &FirstResource) != NULL) {
+        DbgPrint("Previous profile was not discarded\n");
+        Result = FALSE;
+    }
+
+    ExFreePool(Information);
+
+Done:
+    ExDeleteResource(&FirstResource);
+    ExDeleteResource(&SecondResource);
+    DbgPrint("Lock profile test %s\n", Result ? "passed" : "failed");
+
+    //
+    // Fail to load so the driver is unloaded and the test can be run again.
+    //
+
+    return STATUS_UNSUCCESSFUL;
+}
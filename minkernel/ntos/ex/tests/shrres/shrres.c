@@ -0,0 +1,243 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    shrres.c
+
+Abstract:
+
+    Contention benchmark for executive resources and shared mostly
+    resources. One reader thread runs on each processor and acquires the
+    resource shared in a loop. A writer thread acquires the resource
+    exclusive about once a millisecond and updates a pair of values that
+    the readers check are equal. The benchmark is run against an ERESOURCE
+    and then against an ESHARED_RESOURCE, and the times are printed.
+
+    The driver runs the benchmark from its driver entry routine, prints
+    the results to the debugger, and then fails to load so that the
+    benchmark can be run again by starting the driver again.
+
+Environment:
+
+    Kernel mode only.
+
+Revision History:
+
+--*/
+
+#include "ntos.h"
+#include "zwapi.h"
+
+#define BENCH_ITERATIONS 1000000
+
+ERESOURCE BenchResource;
+ESHARED_RESOURCE BenchSharedResource;
+BOOLEAN BenchShared;
+volatile BOOLEAN BenchDone;
+ULONG BenchValue1;
+ULONG BenchValue2;
+ULONG BenchErrors;
+ULONG NumberOfProcessors;
+
+NTSTATUS
+DriverEntry (
+    IN PDRIVER_OBJECT DriverObject,
+    IN PUNICODE_STRING RegistryPath
+    );
+
+VOID
+BenchReader (
+    IN PVOID StartContext
+    )
+{
+    ULONG Index;
+
+    KeSetAffinityThread(KeGetCurrentThread(), (KAFFINITY)1 << (ULONG)StartContext);
+    KeEnterCriticalRegion();
+    for (Index = 0; Index < BENCH_ITERATIONS; Index += 1) {
+        if (BenchShared) {
+            ExAcquireSharedResourceShared(&BenchSharedResource, TRUE);
+
+        } else {
+            ExAcquireResourceShared(&BenchResource, TRUE);
+        }
+
+        if (BenchValue1 != BenchValue2) {
+            InterlockedIncrement((PLONG)&BenchErrors);
+        }
+
+        if (BenchShared) {
+            ExReleaseSharedResource(&BenchSharedResource);
+
+        } else {
+            ExReleaseResource(&BenchResource);
+        }
+    }
+
+    KeLeaveCriticalRegion();
+    return;
+}
+
+VOID
+BenchWriter (
+    IN PVOID StartContext
+    )
+{
+    LARGE_INTEGER Time;
+
+    Time.QuadPart = -10 * 1000;
+    KeEnterCriticalRegion();
+    while (BenchDone == FALSE) {
+        if (BenchShared) {
+            ExAcquireSharedResourceExclusive(&BenchSharedResource, TRUE);
+
+        } else {
+            ExAcquireResourceExclusive(&BenchResource, TRUE);
+        }
+
+        BenchValue1 += 1;
+        KeStallExecutionProcessor(10);
+        BenchValue2 += 1;
+
+        if (BenchShared) {
+            ExReleaseSharedResource(&BenchSharedResource);
+
+        } else {
+            ExReleaseResource(&BenchResource);
+        }
+
+        KeDelayExecutionThread(KernelMode, FALSE, &Time);
+    }
+
+    KeLeaveCriticalRegion();
+    return;
+}
+
+ULONG
+RunResourceBench (
+    IN BOOLEAN Shared
+    )
+{
+    LARGE_INTEGER EndTime;
+    HANDLE Handles[MAXIMUM_PROCESSORS];
+    ULONG Index;
+    ULONG NumberOfReaders;
+    LARGE_INTEGER StartTime;
+    NTSTATUS Status;
+    HANDLE WriterHandle;
+
+    BenchShared = Shared;
+    BenchDone = FALSE;
+    BenchErrors = 0;
+    BenchValue1 = 0;
+    BenchValue2 = 0;
+    Status = PsCreateSystemThread(&WriterHandle,
+                                  THREAD_ALL_ACCESS,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  BenchWriter,
+                                  NULL);
+
+    if (!NT_SUCCESS(Status)) {
+        DbgPrint("Unable to create writer thread, status %08lx\n", Status);
+        return 0;
+    }
+
+    KeQuerySystemTime(&StartTime);
+    for (NumberOfReaders = 0;
+         NumberOfReaders < NumberOfProcessors;
+         NumberOfReaders += 1) {
+
+        Status = PsCreateSystemThread(&Handles[NumberOfReaders],
+                                      THREAD_ALL_ACCESS,
+                                      NULL,
+                                      NULL,
+                                      NULL,
+                                      BenchReader,
+                                      (PVOID)NumberOfReaders);
+
+        if (!NT_SUCCESS(Status)) {
+            DbgPrint("Unable to create reader thread, status %08lx\n", Status);
+            break;
+        }
+    }
+
+    //
+    // Wait for the readers to finish and then stop the writer. The driver
+    // must not return until all of its threads have exited.
+    //
+
+    for (Index = 0; Index < NumberOfReaders; Index += 1) {
+        ZwWaitForSingleObject(Handles[Index], FALSE, NULL);
+        ZwClose(Handles[Index]);
+    }
+
+    KeQuerySystemTime(&EndTime);
+    BenchDone = TRUE;
+    ZwWaitForSingleObject(WriterHandle, FALSE, NULL);
+    ZwClose(WriterHandle);
+    if (!NT_SUCCESS(Status)) {
+        return 0;
+    }
+
+    if (BenchErrors != 0) {
+        DbgPrint("%s readers saw %d inconsistent values\n",
+                 Shared ? "ESHARED_RESOURCE" : "ERESOURCE",
+                 BenchErrors);
+    }
+
+    return (ULONG)((EndTime.QuadPart - StartTime.QuadPart) / (10 * 1000));
+}
+
+NTSTATUS
+DriverEntry (
+    IN PDRIVER_OBJECT DriverObject,
+    IN PUNICODE_STRING RegistryPath
+    )
+{
+    SYSTEM_BASIC_INFORMATION BasicInformation;
+    NTSTATUS Status;
+    ULONG Time;
+
+    DbgPrint("Start shared resource benchmark...\n");
+    Status = ZwQuerySystemInformation(SystemBasicInformation,
+                                      &BasicInformation,
+                                      sizeof(BasicInformation),
+                                      NULL);
+
+    if (!NT_SUCCESS(Status)) {
+        return Status;
+    }
+
+    NumberOfProcessors = BasicInformation.NumberOfProcessors;
+    Status = ExInitializeSharedResource(&BenchSharedResource);
+    if (!NT_SUCCESS(Status)) {
+        DbgPrint("Unable to initialize shared resource, status %08lx\n", Status);
+        return Status;
+    }
+
+    ExInitializeResource(&BenchResource);
+    DbgPrint("%d processors, %d shared acquires per processor\n",
+             NumberOfProcessors,
+             BENCH_ITERATIONS);
+
+    Time = RunResourceBench(FALSE);
+    DbgPrint("ERESOURCE         %8d ms, %d exclusive acquires\n", Time, BenchValue1);
+
+    Time = RunResourceBench(TRUE);
+    DbgPrint("ESHARED_RESOURCE  %8d ms, %d exclusive acquires\n", Time, BenchValue1);
+
+    ExDeleteResource(&BenchResource);
+    ExDeleteSharedResource(&BenchSharedResource);
+    DbgPrint("Shared resource benchmark done\n");
+
+    //
+    // Fail to load so the driver is unloaded and the benchmark can be run
+    // again.
+    //
+
+    return STATUS_UNSUCCESSFUL;
+}
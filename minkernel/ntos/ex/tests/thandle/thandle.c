@@ -0,0 +1,282 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    thandle.c
+
+Abstract:
+
+    Stress and benchmark program for the executive handle table.  The
+    program fills the process handle table by duplicating an event handle
+    up to a million times, then times lookups of every handle from one or
+    more threads, then times lookups again while another thread keeps
+    creating and closing handles, and finally times closing all of the
+    handles.
+
+    The lookups are done with NtQueryEvent, which maps the handle through
+    ObReferenceObjectByHandle.  Since handle lookups do not take the handle
+    table lock, lookups should not slow down much while the table grows or
+    while other handles are being closed.
+
+    Usage: thandle [ NumberOfThreads [ NumberOfHandles ] ]
+
+Environment:
+
+    User mode.
+
+Revision History:
+
+--*/
+
+#include <nt.h>
+#include <ntrtl.h>
+#include <nturtl.h>
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAXIMUM_THREADS 32
+
+#define CHURN_HANDLES 256
+
+HANDLE EventHandle;
+PHANDLE Handles;
+ULONG NumberOfHandles;
+ULONG NumberOfThreads;
+
+volatile BOOLEAN StopChurn;
+ULONG ChurnCount;
+
+DWORD
+WINAPI
+LookupThread (
+    LPVOID Parameter
+    )
+{
+    EVENT_BASIC_INFORMATION Information;
+    NTSTATUS Status;
+    ULONG i;
+
+    //
+    //  Each thread looks up every handle, starting at a different place
+    //  in the array so that the threads are not in lock step.
+    //
+
+    for (i = 0; i < NumberOfHandles; i += 1) {
+        Status = NtQueryEvent( Handles[ (i + (ULONG)Parameter * 4099) % NumberOfHandles ],
+                               EventBasicInformation,
+                               &Information,
+                               sizeof(Information),
+                               NULL );
+
+        if (!NT_SUCCESS(Status)) {
+            printf("NtQueryEvent failed, status %08lx\n", Status);
+            ExitProcess( 1 );
+        }
+    }
+
+    return 0;
+}
+
+DWORD
+WINAPI
+ChurnThread (
+    LPVOID Parameter
+    )
+{
+    HANDLE ChurnHandles[ CHURN_HANDLES ];
+    NTSTATUS Status;
+    ULONG i;
+
+    //
+    //  Create and close a batch of handles at a time until told to stop.
+    //
+
+    while (!StopChurn) {
+        for (i = 0; i < CHURN_HANDLES; i += 1) {
+            Status = NtDuplicateObject( NtCurrentProcess(),
+                                        EventHandle,
+                                        NtCurrentProcess(),
+                                        &ChurnHandles[ i ],
+                                        0,
+                                        0,
+                                        DUPLICATE_SAME_ACCESS );
+
+            if (!NT_SUCCESS(Status)) {
+                printf("NtDuplicateObject failed, status %08lx\n", Status);
+                ExitProcess( 1 );
+            }
+        }
+
+        for (i = 0; i < CHURN_HANDLES; i += 1) {
+            NtClose( ChurnHandles[ i ] );
+        }
+
+        ChurnCount += CHURN_HANDLES;
+    }
+
+    return 0;
+}
+
+ULONG
+RunLookups (
+    VOID
+    )
+{
+    HANDLE Threads[ MAXIMUM_THREADS ];
+    ULONG i, StartTime;
+    DWORD ThreadId;
+
+    StartTime = GetTickCount();
+
+    for (i = 0; i < NumberOfThreads; i += 1) {
+        Threads[ i ] = CreateThread( NULL, 0, LookupThread, (LPVOID)i, 0, &ThreadId );
+    }
+
+    WaitForMultipleObjects( NumberOfThreads, Threads, TRUE, INFINITE );
+
+    for (i = 0; i < NumberOfThreads; i += 1) {
+        CloseHandle( Threads[ i ] );
+    }
+
+    return GetTickCount() - StartTime;
+}
+
+VOID
+PrintRate (
+    PCHAR Operation,
+    ULONG Count,
+    ULONG Milliseconds
+    )
+{
+    if (Milliseconds == 0) {
+        Milliseconds = 1;
+    }
+
+    printf("%-32s %8d in %6d ms, %8d per second\n",
+           Operation,
+           Count,
+           Milliseconds,
+           (ULONG)(((ULONGLONG)Count * 1000) / Milliseconds));
+}
+
+int
+_CDECL
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    HANDLE ChurnHandle;
+    NTSTATUS Status;
+    ULONG Created, i, Time;
+    DWORD ThreadId;
+
+    NumberOfThreads = 4;
+    NumberOfHandles = 1024 * 1024;
+
+    if (argc > 1) {
+        NumberOfThreads = atoi( argv[1] );
+        if ((NumberOfThreads == 0) || (NumberOfThreads > MAXIMUM_THREADS)) {
+            NumberOfThreads = MAXIMUM_THREADS;
+        }
+    }
+
+    if (argc > 2) {
+        NumberOfHandles = atoi( argv[2] );
+        if (NumberOfHandles == 0) {
+            NumberOfHandles = 1;
+        }
+    }
+
+    Handles = RtlAllocateHeap( RtlProcessHeap(), 0, NumberOfHandles * sizeof(HANDLE) );
+    if (Handles == NULL) {
+        printf("Unable to allocate handle array\n");
+        return 1;
+    }
+
+    Status = NtCreateEvent( &EventHandle, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+    if (!NT_SUCCESS(Status)) {
+        printf("NtCreateEvent failed, status %08lx\n", Status);
+        return 1;
+    }
+
+    //
+    //  Create the handles.  If pool quota runs out first, run the rest of
+    //  the test with the handles that were created.
+    //
+
+    Time = GetTickCount();
+
+    for (Created = 0; Created < NumberOfHandles; Created += 1) {
+        Status = NtDuplicateObject( NtCurrentProcess(),
+                                    EventHandle,
+                                    NtCurrentProcess(),
+                                    &Handles[ Created ],
+                                    0,
+                                    0,
+                                    DUPLICATE_SAME_ACCESS );
+
+        if (!NT_SUCCESS(Status)) {
+            printf("NtDuplicateObject failed after %d handles, status %08lx\n", Created, Status);
+            break;
+        }
+    }
+
+    Time = GetTickCount() - Time;
+    NumberOfHandles = Created;
+
+    if (NumberOfHandles == 0) {
+        return 1;
+    }
+
+    PrintRate( "Create", NumberOfHandles, Time );
+
+    //
+    //  Look up every handle from each thread.
+    //
+
+    Time = RunLookups();
+    printf("%d threads\n", NumberOfThreads);
+    PrintRate( "Lookup", NumberOfHandles * NumberOfThreads, Time );
+
+    //
+    //  Look up every handle again while another thread creates and closes
+    //  handles.
+    //
+
+    StopChurn = FALSE;
+    ChurnHandle = CreateThread( NULL, 0, ChurnThread, NULL, 0, &ThreadId );
+    Time = RunLookups();
+    StopChurn = TRUE;
+    WaitForSingleObject( ChurnHandle, INFINITE );
+    CloseHandle( ChurnHandle );
+
+    PrintRate( "Lookup during create/close", NumberOfHandles * NumberOfThreads, Time );
+    PrintRate( "Create/close during lookup", ChurnCount, Time );
+
+    //
+    //  Close the handles.
+    //
+
+    Time = GetTickCount();
+
+    for (i = 0; i < NumberOfHandles; i += 1) {
+        Status = NtClose( Handles[ i ] );
+        if (!NT_SUCCESS(Status)) {
+            printf("NtClose failed, status %08lx\n", Status);
+            return 1;
+        }
+    }
+
+    Time = GetTickCount() - Time;
+    PrintRate( "Close", NumberOfHandles, Time );
+
+    NtClose( EventHandle );
+    RtlFreeHeap( RtlProcessHeap(), 0, Handles );
+
+    return 0;
+}
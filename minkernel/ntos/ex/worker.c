@@ -42,6 +42,23 @@ Revision History:
 #define MEDIUM_NUMBER_OF_THREADS 3
 #define LARGE_NUMBER_OF_THREADS 5
 
+//
+// Maximum number of dynamic worker threads for each of the critical and
+// delayed work queues, and the time a dynamic worker thread waits for a
+// work item before it exits.
+//
+
+#define MAXIMUM_DYNAMIC_THREADS 16
+
+#define DYNAMIC_THREAD_TIMEOUT (10 * 60)
+
+//
+// Flag passed in the start context of a worker thread that was created
+// because a work queue was backed up.
+//
+
+#define DYNAMIC_WORKER_THREAD 0x80000000
+
 //
 // Queue objects that that are used to hold work queue entries and synchronize
 // worker thread activity.
@@ -60,7 +77,32 @@ ULONG ExCriticalWorkerThreads;
 ULONG ExDelayedWorkerThreads;
 
 //
-// Procedure prototype for the worker thread.
+// Work queue state and statistics. The worker thread balance manager
+// samples each queue once a second. If the work item at the head of a
+// queue has not been removed since the last sample and fewer threads are
+// active than the queue allows, then all of the worker threads are blocked
+// and a dynamic worker thread is created to service the queue.
+//
+
+typedef struct _EX_WORK_QUEUE_STATE {
+    ULONG WorkerThreads;
+    ULONG DynamicThreads;
+    ULONG DynamicThreadsCreated;
+    ULONG WorkItemsProcessed;
+    ULONG WorkItemsProcessedLastPass;
+    PLIST_ENTRY QueueHeadLastPass;
+    ULONG MaximumQueueDepth;
+    ULONG CurrentDelay;
+    ULONG MaximumDelay;
+} EX_WORK_QUEUE_STATE, *PEX_WORK_QUEUE_STATE;
+
+EX_WORK_QUEUE_STATE ExpWorkQueueState[MaximumWorkQueue];
+
+LARGE_INTEGER ExpDynamicThreadTimeout;
+
+//
+// Procedure prototypes for the worker thread and the worker thread balance
+// manager.
 //
 
 VOID
@@ -68,6 +110,22 @@ ExpWorkerThread(
     IN PVOID StartContext
     );
 
+VOID
+ExpWorkerThreadBalanceManager(
+    IN PVOID StartContext
+    );
+
+VOID
+ExpCheckDynamicThreadCount(
+    VOID
+    );
+
+NTSTATUS
+ExpCreateWorkerThread(
+    IN WORK_QUEUE_TYPE QueueType,
+    IN BOOLEAN Dynamic
+    );
+
 #if DBG
 
 EXCEPTION_DISPOSITION
@@ -82,6 +140,10 @@ ExpWorkerThreadFilter(
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(INIT, ExpWorkerInitialization)
+#pragma alloc_text(PAGE, ExpWorkerThreadBalanceManager)
+#pragma alloc_text(PAGE, ExpCheckDynamicThreadCount)
+#pragma alloc_text(PAGE, ExpCreateWorkerThread)
+#pragma alloc_text(PAGE, ExpGetWorkerQueueInformation)
 #endif
 
 BOOLEAN
@@ -154,11 +216,11 @@ ExpWorkerInitialization(
     KeInitializeQueue(&ExWorkerQueue[HyperCriticalWorkQueue], 0);
 
     //
-    // Create the desired number of executive worker threads for each
-    // of the work queues.
+    // Set the time a dynamic worker thread waits for a work item before it
+    // exits.
     //
 
-    InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+    ExpDynamicThreadTimeout.QuadPart = Int32x32To64(DYNAMIC_THREAD_TIMEOUT, -10 * 1000 * 1000);
 
     //
     // Create any builtin critical and delayed worker threads
@@ -170,19 +232,12 @@ ExpWorkerInitialization(
         // Create a worker thread to service the critical work queue.
         //
 
-        Status = PsCreateSystemThread(&Thread,
-                                      THREAD_ALL_ACCESS,
-                                      &ObjectAttributes,
-                                      0L,
-                                      NULL,
-                                      ExpWorkerThread,
-                                      (PVOID)CriticalWorkQueue);
-
+        Status = ExpCreateWorkerThread(CriticalWorkQueue, FALSE);
         if (!NT_SUCCESS(Status)) {
             break;
         }
+
         ExCriticalWorkerThreads++;
-        ZwClose( Thread );
     }
 
 
@@ -192,35 +247,102 @@ ExpWorkerInitialization(
         // Create a worker thread to service the delayed work queue.
         //
 
-        Status = PsCreateSystemThread(&Thread,
-                                      THREAD_ALL_ACCESS,
-                                      &ObjectAttributes,
-                                      0L,
-                                      NULL,
-                                      ExpWorkerThread,
-                                      (PVOID)DelayedWorkQueue);
-
+        Status = ExpCreateWorkerThread(DelayedWorkQueue, FALSE);
         if (!NT_SUCCESS(Status)) {
             break;
         }
 
         ExDelayedWorkerThreads++;
+    }
+
+    Status = ExpCreateWorkerThread(HyperCriticalWorkQueue, FALSE);
+    if (!NT_SUCCESS(Status)) {
+        return FALSE;
+    }
+
+    //
+    // Create the worker thread balance manager which adds worker threads
+    // to the critical and delayed work queues when they back up.
+    //
+
+    InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+    Status = PsCreateSystemThread(&Thread,
+                                  THREAD_ALL_ACCESS,
+                                  &ObjectAttributes,
+                                  0L,
+                                  NULL,
+                                  ExpWorkerThreadBalanceManager,
+                                  NULL);
+
+    if (NT_SUCCESS(Status)) {
         ZwClose( Thread );
     }
 
+    return (BOOLEAN)NT_SUCCESS(Status);
+}
+
+NTSTATUS
+ExpCreateWorkerThread(
+    IN WORK_QUEUE_TYPE QueueType,
+    IN BOOLEAN Dynamic
+    )
+
+/*++
+
+Routine Description:
+
+    This function creates a worker thread to service the specified work
+    queue.
+
+Arguments:
+
+    QueueType - Supplies the type of the work queue the thread services.
+
+    Dynamic - Supplies a boolean value that determines whether the thread
+        exits after it has been idle for the dynamic thread timeout.
+
+Return Value:
+
+    The status of the thread creation is returned as the function value.
+
+--*/
+
+{
+
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    ULONG StartContext;
+    NTSTATUS Status;
+    HANDLE Thread;
+
+    PAGED_CODE();
+
+    StartContext = (ULONG)QueueType;
+    if (Dynamic != FALSE) {
+        StartContext |= DYNAMIC_WORKER_THREAD;
+        InterlockedIncrement((PLONG)&ExpWorkQueueState[QueueType].DynamicThreads);
+    }
+
+    InterlockedIncrement((PLONG)&ExpWorkQueueState[QueueType].WorkerThreads);
+    InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
     Status = PsCreateSystemThread(&Thread,
                                   THREAD_ALL_ACCESS,
                                   &ObjectAttributes,
                                   0L,
                                   NULL,
                                   ExpWorkerThread,
-                                  (PVOID)HyperCriticalWorkQueue);
+                                  (PVOID)StartContext);
 
     if (NT_SUCCESS(Status)) {
         ZwClose( Thread );
+
+    } else {
+        InterlockedDecrement((PLONG)&ExpWorkQueueState[QueueType].WorkerThreads);
+        if (Dynamic != FALSE) {
+            InterlockedDecrement((PLONG)&ExpWorkQueueState[QueueType].DynamicThreads);
+        }
     }
 
-    return (BOOLEAN)NT_SUCCESS(Status);
+    return Status;
 }
 
 VOID
@@ -272,20 +394,35 @@ ExpWorkerThread(
 
 {
 
+    BOOLEAN Dynamic;
     PLIST_ENTRY Entry;
     WORK_QUEUE_TYPE QueueType;
+    PLARGE_INTEGER Timeout;
     PWORK_QUEUE_ITEM WorkItem;
     KPROCESSOR_MODE WaitMode;
 
     WaitMode = UserMode;
 
+    //
+    // A dynamic worker thread waits for work items with a timeout and exits
+    // if no work item arrives before the timeout expires.
+    //
+
+    Dynamic = (BOOLEAN)(((ULONG)StartContext & DYNAMIC_WORKER_THREAD) != 0);
+    if (Dynamic != FALSE) {
+        Timeout = &ExpDynamicThreadTimeout;
+
+    } else {
+        Timeout = NULL;
+    }
+
     //
     // If the thread is a critical worker thread, then set the thread
     // priority to the lowest realtime level. Otherwise, set the base
     // thread priority to time critical.
     //
 
-    QueueType = (WORK_QUEUE_TYPE)StartContext;
+    QueueType = (WORK_QUEUE_TYPE)((ULONG)StartContext & ~DYNAMIC_WORKER_THREAD);
     switch ( QueueType ) {
 
         case HyperCriticalWorkQueue:
@@ -325,8 +462,21 @@ ExpWorkerThread(
         // swappable
         //
 
-        Entry = KeRemoveQueue(&ExWorkerQueue[QueueType], WaitMode, NULL);
+        Entry = KeRemoveQueue(&ExWorkerQueue[QueueType], WaitMode, Timeout);
+        if (Entry == (PLIST_ENTRY)STATUS_TIMEOUT) {
+
+            //
+            // The dynamic worker thread has been idle for the timeout
+            // period. Account for the exit and terminate the thread.
+            //
+
+            InterlockedDecrement((PLONG)&ExpWorkQueueState[QueueType].DynamicThreads);
+            InterlockedDecrement((PLONG)&ExpWorkQueueState[QueueType].WorkerThreads);
+            PsTerminateSystemThread(STATUS_SUCCESS);
+        }
+
         WorkItem = CONTAINING_RECORD(Entry, WORK_QUEUE_ITEM, List);
+        InterlockedIncrement((PLONG)&ExpWorkQueueState[QueueType].WorkItemsProcessed);
 
         //
         // Execute the specified routine.
@@ -369,6 +519,195 @@ ExpWorkerThread(
     } while(TRUE);
 }
 
+VOID
+ExpWorkerThreadBalanceManager(
+    IN PVOID StartContext
+    )
+
+/*++
+
+Routine Description:
+
+    This function is the worker thread balance manager. It runs once a
+    second and adds worker threads to work queues that have backed up.
+
+Arguments:
+
+    StartContext - Not used.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LARGE_INTEGER Interval;
+
+    PAGED_CODE();
+
+    //
+    // Run above the critical worker threads so a queue that is backed up
+    // behind them is still checked.
+    //
+
+    KeSetPriorityThread(KeGetCurrentThread(), LOW_REALTIME_PRIORITY + 1);
+    Interval.QuadPart = -1000 * 1000 * 10;
+    do {
+        KeDelayExecutionThread(KernelMode, FALSE, &Interval);
+        ExpCheckDynamicThreadCount();
+    } while (TRUE);
+}
+
+VOID
+ExpCheckDynamicThreadCount(
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function samples the critical and delayed work queues and creates
+    a dynamic worker thread for each queue that is stalled.
+
+    A queue is stalled if the work item at the head of the queue has not
+    been removed since the last sample, no work item was processed since
+    the last sample, and fewer threads are active than the queue allows.
+    The last condition means the worker threads of the queue are blocked
+    rather than busy, so another thread will make progress. The number of
+    seconds the head work item has waited is recorded as the queue delay.
+
+    N.B. The queue is sampled without acquiring the dispatcher database
+         lock. The head entry is compared but never dereferenced.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Depth;
+    PLIST_ENTRY Head;
+    ULONG Processed;
+    PKQUEUE Queue;
+    WORK_QUEUE_TYPE QueueType;
+    PEX_WORK_QUEUE_STATE State;
+
+    PAGED_CODE();
+
+    for (QueueType = CriticalWorkQueue; QueueType < MaximumWorkQueue; QueueType += 1) {
+        Queue = &ExWorkerQueue[QueueType];
+        State = &ExpWorkQueueState[QueueType];
+        Depth = (ULONG)Queue->Header.SignalState;
+        Head = Queue->EntryListHead.Flink;
+        Processed = State->WorkItemsProcessed;
+        if (Depth > State->MaximumQueueDepth) {
+            State->MaximumQueueDepth = Depth;
+        }
+
+        if ((Depth == 0) ||
+            (Head != State->QueueHeadLastPass) ||
+            (Processed != State->WorkItemsProcessedLastPass)) {
+            State->CurrentDelay = 0;
+
+        } else {
+            State->CurrentDelay += 1;
+            if (State->CurrentDelay > State->MaximumDelay) {
+                State->MaximumDelay = State->CurrentDelay;
+            }
+
+            //
+            // The hyper critical work queue is reserved for system threads
+            // that never block for long and is never extended.
+            //
+
+            if ((QueueType != HyperCriticalWorkQueue) &&
+                (Queue->CurrentCount < Queue->MaximumCount) &&
+                (State->DynamicThreads < MAXIMUM_DYNAMIC_THREADS)) {
+
+                if (NT_SUCCESS(ExpCreateWorkerThread(QueueType, TRUE))) {
+                    State->DynamicThreadsCreated += 1;
+                }
+            }
+        }
+
+        State->QueueHeadLastPass = Head;
+        State->WorkItemsProcessedLastPass = Processed;
+    }
+
+    return;
+}
+
+NTSTATUS
+ExpGetWorkerQueueInformation(
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the thread counts and statistics of each
+    executive work queue.
+
+Arguments:
+
+    SystemInformation - Supplies a pointer to the buffer which receives an
+        array of work queue information structures, one for each work queue.
+
+    SystemInformationLength - Supplies the length of the buffer in bytes.
+
+    Length - Supplies a pointer to a variable that receives the length of
+        the information required.
+
+Return Value:
+
+    STATUS_SUCCESS if the information is returned. Otherwise,
+    STATUS_INFO_LENGTH_MISMATCH if the buffer is too small.
+
+--*/
+
+{
+
+    PSYSTEM_WORKER_QUEUE_INFORMATION Information;
+    WORK_QUEUE_TYPE QueueType;
+    PEX_WORK_QUEUE_STATE State;
+
+    PAGED_CODE();
+
+    *Length = MaximumWorkQueue * sizeof(SYSTEM_WORKER_QUEUE_INFORMATION);
+    if (SystemInformationLength < *Length) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Information = (PSYSTEM_WORKER_QUEUE_INFORMATION)SystemInformation;
+    for (QueueType = CriticalWorkQueue; QueueType < MaximumWorkQueue; QueueType += 1) {
+        State = &ExpWorkQueueState[QueueType];
+        Information->QueueType = QueueType;
+        Information->WorkerThreads = State->WorkerThreads;
+        Information->DynamicThreads = State->DynamicThreads;
+        Information->DynamicThreadsCreated = State->DynamicThreadsCreated;
+        Information->WorkItemsProcessed = State->WorkItemsProcessed;
+        Information->QueueDepth = (ULONG)ExWorkerQueue[QueueType].Header.SignalState;
+        Information->MaximumQueueDepth = State->MaximumQueueDepth;
+        Information->CurrentDelay = State->CurrentDelay;
+        Information->MaximumDelay = State->MaximumDelay;
+        Information += 1;
+    }
+
+    return STATUS_SUCCESS;
+}
+
 #if DBG
 
 EXCEPTION_DISPOSITION
@@ -844,6 +844,105 @@ cPublicFpo 0,0
 
 fstENDP ExInterlockedPushEntrySList
 
+        page , 132
+        subttl  "Interlocked Flush Sequenced List"
+;++
+;
+; PSINGLE_LIST_ENTRY
+; FASTCALL
+; ExInterlockedFlushSList (
+;    IN PSINGLE_LIST_ENTRY ListHead,
+;    IN PKSPIN_LOCK Lock
+;    )
+;
+; Routine Description:
+;
+;    This function removes all entries from a sequenced singly linked list
+;    so that access to the list is synchronized in an MP system. If there
+;    are no entries in the list, then a value of NULL is returned. Otherwise,
+;    the address of the first entry that was removed is returned as the
+;    function value and the entries remain linked to each other.
+;
+;    The list depth is set to zero, but the sequence number is not changed.
+;    A concurrent pop cannot succeed against the emptied listhead, since the
+;    next link can only become nonzero again through a push, and the push
+;    increments the sequence number.
+;
+;    N.B. The cmpxchg8b instruction is only supported on some processors.
+;         If the host processor does not support this instruction, then
+;         then following code is patched to contain a jump to the normal
+;         flush code which has a compatible calling sequence and data
+;         structure.
+;
+; Arguments:
+;
+;    (ecx) = ListHead - Supplies a pointer to the sequenced listhead which
+;         is to be flushed.
+;
+;    (edx) = Lock - Supplies a pointer to a spin lock to be used to synchronize
+;            access to the list.
+;
+; Return Value:
+;
+;    The address of the first entry removed from the list, or NULL if the
+;    list is empty.
+;
+;--
+
+cPublicFastCall ExInterlockedFlushSList, 2
+
+cPublicFpo 0,2
+
+;
+; Save nonvolatile registers and read the listhead sequence number followed
+; by the listhead next link.
+;
+; N.B. These two dwords MUST be read exactly in this order.
+;
+
+        push    ebx                     ; save nonvolatile registers
+        push    ebp                     ;
+        mov     ebp, ecx                ; save listhead address
+        mov     edx,[ebp] + 4           ; get current sequence number
+        mov     eax,[ebp] + 0           ; get current next link
+
+;
+; If the list is empty, then there is nothing that can be removed.
+;
+
+Efls10: or      eax, eax                ; check if list is empty
+        jz      short Efls20            ; if z set, list is empty
+        xor     ebx, ebx                ; set next link to NULL
+        mov     ecx, edx                ; copy sequence number and depth
+        and     ecx, 0FFFF0000H         ; clear depth
+
+.586
+ifndef NT_UP
+
+   lock cmpxchg8b qword ptr [ebp]       ; compare and exchange
+
+else
+
+        cmpxchg8b qword ptr [ebp]       ; compare and exchange
+
+endif
+.386
+
+        jnz     short Efls10            ; if z clear, exchange failed
+
+;
+; Restore nonvolatile registers and return result.
+;
+
+cPublicFpo 0,0
+
+Efls20: pop     ebp                     ; restore nonvolatile registers
+        pop     ebx                     ;
+
+        fstRET    ExInterlockedFlushSList
+
+fstENDP ExInterlockedFlushSList
+
         page , 132
         subttl  "Interlocked Pop Entry SList - Alternate"
 ;++
@@ -1004,6 +1103,82 @@ endif
 
 fstENDP ExfInterlockedPushEntrySList
 
+        page , 132
+        subttl  "Interlocked Flush SList - Alternate"
+;++
+;
+; PSINGLE_LIST_ENTRY
+; FASTCALL
+; ExfInterlockedFlushSList (
+;    IN PSINGLE_LIST_ENTRY ListHead,
+;    IN PKSPIN_LOCK Lock
+;    )
+;
+; Routine Description:
+;
+;    This function removes all entries from a sequenced singly linked list
+;    so that access to the list is synchronized in an MP system. If there
+;    are no entries in the list, then a value of NULL is returned. Otherwise,
+;    the address of the first entry that was removed is returned as the
+;    function value.
+;
+;    N.B. The cmpxchg8b instruction is only supported on some processors.
+;         If the host processor does not support this instruction, then
+;         this function is used inplace of ExInterlockedFlushSList.
+;
+; Arguments:
+;
+;    (ecx) = ListHead - Supplies a pointer to the sequenced listhead which
+;         is to be flushed.
+;
+;    (edx) = Lock - Supplies a pointer to a spin lock to be used to synchronize
+;            access to the list.
+;
+; Return Value:
+;
+;    The address of the first entry removed from the list, or NULL if the
+;    list is empty.
+;
+;--
+
+cPublicFastCall ExfInterlockedFlushSList, 2
+
+cPublicFpo 0,1
+Efpf10: pushfd                          ; save flags
+        cli                             ; disable interrupts
+
+ifndef NT_UP
+
+        ACQUIRE_SPINLOCK edx, <short Efpf30> ; acquire spinlock
+
+endif
+
+        mov     eax, [ecx]              ; get current next link
+        mov     dword ptr [ecx], 0      ; set list empty
+        and     dword ptr [ecx] + 4, 0FFFF0000H ; clear list depth
+
+ifndef NT_UP
+
+        RELEASE_SPINLOCK edx            ; release spinlock
+
+endif
+
+cPublicFpo 0,0
+        popfd                           ; restore flags
+
+        fstRET  ExfInterlockedFlushSList
+
+ifndef NT_UP
+
+cPublicFpo 0,0
+Efpf30: popfd                           ; restore flags
+
+        SPIN_ON_SPINLOCK edx, Efpf10    ; spin until lock is free
+
+endif
+
+fstENDP ExfInterlockedFlushSList
+
         page , 132
         subttl  "Interlocked i386 Increment Long"
 ;++
@@ -1027,11 +1027,18 @@ typedef struct _KPRCB {
     SINGLE_LIST_ENTRY   FsRtlFreeWaitingLockList;
     SINGLE_LIST_ENTRY   FsRtlFreeLockTreeNodeList;
 
+//
+// Executive per processor small pool lookaside lists.
+//
+
+    struct _SMALL_POOL_LOOKASIDE *NPagedPoolLookaside;
+    struct _SMALL_POOL_LOOKASIDE *PagedPoolLookaside;
+
 //
 // Reserved pad.
 //
 
-    ULONG reservedPad[16 * 8];
+    ULONG reservedPad[(16 * 8) - 2];
 
 //
 // MP interprocessor request packet and summary.
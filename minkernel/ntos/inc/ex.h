@@ -342,6 +342,95 @@ ExTryToAcquireFastMutex (
 #endif
 
 // end_ntifs end_ntddk end_nthal
+
+//
+// Lock profiling support.
+//
+// When lock profiling is enabled, executive spin lock and fast mutex
+// acquires made by components of the kernel itself are routed through
+// the profiling routines, which record acquire and contention counts and
+// wait and hold times by lock and call site. Lock profiling is only
+// supported on MP systems.
+//
+
+extern BOOLEAN ExpLockProfileEnabled;
+
+VOID
+FASTCALL
+ExpProfileAcquireSpinLock (
+    IN PKSPIN_LOCK SpinLock,
+    OUT PKIRQL OldIrql
+    );
+
+VOID
+FASTCALL
+ExpProfileReleaseSpinLock (
+    IN PKSPIN_LOCK SpinLock,
+    IN KIRQL OldIrql
+    );
+
+VOID
+FASTCALL
+ExpProfileAcquireSpinLockAtDpcLevel (
+    IN PKSPIN_LOCK SpinLock
+    );
+
+VOID
+FASTCALL
+ExpProfileReleaseSpinLockFromDpcLevel (
+    IN PKSPIN_LOCK SpinLock
+    );
+
+VOID
+FASTCALL
+ExpProfileAcquireFastMutex (
+    IN PFAST_MUTEX FastMutex
+    );
+
+VOID
+FASTCALL
+ExpProfileReleaseFastMutex (
+    IN PFAST_MUTEX FastMutex
+    );
+
+#if !defined(NT_UP) && defined(_NTSYSTEM_) && !defined(_NTDRIVER_)
+
+#undef ExAcquireSpinLock
+#undef ExReleaseSpinLock
+#undef ExAcquireSpinLockAtDpcLevel
+#undef ExReleaseSpinLockFromDpcLevel
+
+#define ExAcquireSpinLock(Lock, OldIrql)                                 \
+    (ExpLockProfileEnabled ?                                             \
+        ExpProfileAcquireSpinLock((Lock), (OldIrql)) :                   \
+        (VOID)(KeAcquireSpinLock((Lock), (OldIrql))))
+
+#define ExReleaseSpinLock(Lock, OldIrql)                                 \
+    (ExpLockProfileEnabled ?                                             \
+        ExpProfileReleaseSpinLock((Lock), (OldIrql)) :                   \
+        KeReleaseSpinLock((Lock), (OldIrql)))
+
+#define ExAcquireSpinLockAtDpcLevel(Lock)                                \
+    (ExpLockProfileEnabled ?                                             \
+        ExpProfileAcquireSpinLockAtDpcLevel(Lock) :                      \
+        KeAcquireSpinLockAtDpcLevel(Lock))
+
+#define ExReleaseSpinLockFromDpcLevel(Lock)                              \
+    (ExpLockProfileEnabled ?                                             \
+        ExpProfileReleaseSpinLockFromDpcLevel(Lock) :                    \
+        KeReleaseSpinLockFromDpcLevel(Lock))
+
+#define ExAcquireFastMutex(FastMutex)                                    \
+    (ExpLockProfileEnabled ?                                             \
+        ExpProfileAcquireFastMutex(FastMutex) :                          \
+        ExAcquireFastMutex(FastMutex))
+
+#define ExReleaseFastMutex(FastMutex)                                    \
+    (ExpLockProfileEnabled ?                                             \
+        ExpProfileReleaseFastMutex(FastMutex) :                          \
+        ExReleaseFastMutex(FastMutex))
+
+#endif
 
 //
 // Interlocked support routine definitions.
@@ -464,6 +553,10 @@ ExInterlockedPushEntryList (
 // The PowerPc, however, must use a spinlock to synchronize access to the
 // list.
 //
+// Flushing a sequenced list removes all of its entries in one operation and
+// returns them still linked together. The depth is cleared, but the sequence
+// number is not changed.
+//
 // N.B. A spinlock must be specified with SLIST operations. However, it may
 //      not actually be used.
 //
@@ -528,6 +621,9 @@ Return Value:
 #define ExInterlockedPushEntrySList(Head, Entry, Lock) \
     ExpInterlockedPushEntrySList(Head, Entry)
 
+#define ExInterlockedFlushSList(Head, Lock) \
+    ExpInterlockedFlushSList(Head)
+
 #define ExQueryDepthSList(_listhead_) (_listhead_)->Depth
 
 NTKERNELAPI
@@ -543,6 +639,12 @@ ExpInterlockedPushEntrySList (
     IN PSINGLE_LIST_ENTRY ListEntry
     );
 
+NTKERNELAPI
+PSINGLE_LIST_ENTRY
+ExpInterlockedFlushSList (
+    IN PSLIST_HEADER ListHead
+    );
+
 #else
 
 NTKERNELAPI
@@ -562,6 +664,14 @@ ExInterlockedPushEntrySList (
     IN PKSPIN_LOCK Lock
     );
 
+NTKERNELAPI
+PSINGLE_LIST_ENTRY
+FASTCALL
+ExInterlockedFlushSList (
+    IN PSLIST_HEADER ListHead,
+    IN PKSPIN_LOCK Lock
+    );
+
 #endif
 
 //
@@ -2043,6 +2153,75 @@ ExIsResourceAcquiredSharedLite (
 #define ExDisableResourceBoost ExDisableResourceBoostLite
 // end_ntifs
 
+//
+// Define shared mostly resource structures.
+//
+// A shared mostly resource is a reader/writer lock with a shared owner count
+// for each processor. Each count is padded to a separate cache line.
+//
+
+typedef struct _SHARED_RESOURCE_COUNT {
+    LONG SharedCount;
+    ULONG Fill[15];
+} SHARED_RESOURCE_COUNT, *PSHARED_RESOURCE_COUNT;
+
+typedef struct _ESHARED_RESOURCE {
+    PSHARED_RESOURCE_COUNT SharedCounts;
+    ULONG NumberOfCounts;
+    LONG ExclusiveState;
+    PKTHREAD ExclusiveOwner;
+    ULONG ExclusiveCount;
+    LONG NumberOfSharedWaiters;
+    LONG NumberOfExclusiveWaiters;
+    ULONG ContentionCount;
+    KSEMAPHORE SharedWaiters;
+    KSEMAPHORE ExclusiveWaiters;
+    KEVENT DrainEvent;
+    KSPIN_LOCK SpinLock;
+} ESHARED_RESOURCE, *PESHARED_RESOURCE;
+
+//
+// Define shared mostly resource function prototypes.
+//
+
+NTKERNELAPI
+NTSTATUS
+ExInitializeSharedResource (
+    IN PESHARED_RESOURCE Resource
+    );
+
+NTKERNELAPI
+VOID
+ExDeleteSharedResource (
+    IN PESHARED_RESOURCE Resource
+    );
+
+NTKERNELAPI
+BOOLEAN
+ExAcquireSharedResourceShared (
+    IN PESHARED_RESOURCE Resource,
+    IN BOOLEAN Wait
+    );
+
+NTKERNELAPI
+BOOLEAN
+ExAcquireSharedResourceExclusive (
+    IN PESHARED_RESOURCE Resource,
+    IN BOOLEAN Wait
+    );
+
+NTKERNELAPI
+VOID
+ExReleaseSharedResource (
+    IN PESHARED_RESOURCE Resource
+    );
+
+NTKERNELAPI
+BOOLEAN
+ExIsSharedResourceAcquiredExclusive (
+    IN PESHARED_RESOURCE Resource
+    );
+
 #if DEVL
 NTKERNELAPI
 NTSTATUS
@@ -2162,17 +2341,23 @@ typedef NTDDK_ERESOURCE *PNTDDK_ERESOURCE;
 //
 
 typedef struct _HANDLE_ENTRY {
+    PVOID Object;
     union {
-        LIST_ENTRY ListEntry;
-        struct {
-            PVOID Object;
-            ULONG Attributes;
-        };
+        ULONG Attributes;
+        ULONG NextFreeTableEntry;
     };
 } HANDLE_ENTRY, *PHANDLE_ENTRY;
 
-#define ExIsEntryFree(base, bound, p) ((p)->Object >= (PVOID)(base) && (p)->Object < (PVOID)(bound))
-#define ExIsEntryUsed(base, bound, p) ((p)->Object < (PVOID)(base) || (p)->Object >= (PVOID)(bound))
+//
+// A free handle entry has an object field of zero. The object field of
+// an in use handle entry is a system space address and has the high bit
+// set, except while the handle entry is locked, when the bit is clear.
+//
+
+#define EX_HANDLE_ENTRY_LOCK_BIT 0x80000000
+
+#define ExGetHandleEntryObject(p) \
+    ((PVOID)((ULONG)(p)->Object | EX_HANDLE_ENTRY_LOCK_BIT))
 
 //
 // Define handle table descriptor structure.
@@ -2193,17 +2378,19 @@ typedef union _HANDLE_SYNCH {
 typedef struct _HANDLE_TABLE {
     HANDLE_SYNCH State;
     KSPIN_LOCK SpinLock;
-    PHANDLE_ENTRY TableEntries;
-    PHANDLE_ENTRY TableBound;
+    PHANDLE_ENTRY **Table;
+    ULONG NextHandleNeedingPool;
+    ULONG FirstFreeTableEntry;
+    ULONG LastFreeTableEntry;
     ULONG HandleCount;
     struct _EPROCESS *QuotaProcess;
     HANDLE UniqueProcessId;
-    USHORT CountToGrowBy;
     BOOLEAN LifoOrder;
-    UCHAR Spare1;
+    UCHAR Spare1[3];
     LIST_ENTRY ListEntry;
     KEVENT ExclusiveWaiters;
     KSEMAPHORE SharedWaiters;
+    KEVENT HandleContentionEvent;
 } HANDLE_TABLE, *PHANDLE_TABLE;
 
 //
@@ -2236,9 +2423,7 @@ ExCreateHandle(
 NTKERNELAPI
 PHANDLE_TABLE
 ExCreateHandleTable(
-    IN struct _EPROCESS *Process OPTIONAL,
-    IN ULONG CountEntries,
-    IN ULONG CountToGrowBy
+    IN struct _EPROCESS *Process OPTIONAL
     );
 
 NTKERNELAPI
@@ -2246,7 +2431,7 @@ BOOLEAN
 ExDestroyHandle(
     IN PHANDLE_TABLE HandleTable,
     IN HANDLE Handle,
-    IN BOOLEAN TableLocked
+    IN PHANDLE_ENTRY HandleEntry OPTIONAL
     );
 
 typedef VOID (*EX_DESTROY_HANDLE_ROUTINE)(
@@ -2343,8 +2528,14 @@ NTKERNELAPI
 PHANDLE_ENTRY
 ExMapHandleToPointer(
     IN PHANDLE_TABLE HandleTable,
-    IN HANDLE Handle,
-    IN BOOLEAN Shared
+    IN HANDLE Handle
+    );
+
+NTKERNELAPI
+VOID
+ExUnlockHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
     );
 
 NTKERNELAPI
@@ -337,7 +337,10 @@ typedef struct _HEAP {
 
     PHEAP_LOCK LockVariable;
     PRTL_HEAP_COMMIT_ROUTINE CommitRoutine;
-    ULONG Reserved[ 2 ];
+    struct _HEAP_LFH *FrontEndHeap;
+    struct _HEAP_FREE_CACHE *FreeCache;
+
+    RTL_HEAP_COUNTERS Counters;
 } HEAP, *PHEAP;
 
 #define HEAP_SIGNATURE                      (ULONG)0xEEFFEEFF
@@ -346,6 +349,87 @@ typedef struct _HEAP {
 #define HEAP_VALIDATE_ALL_ENABLED           (ULONG)0x20000000
 #define HEAP_SKIP_VALIDATION_CHECKS         (ULONG)0x10000000
 
+#define HEAP_MAXIMUM_AFFINITY               8
+
+//
+// The low fragmentation front end is layered in front of the free lists
+// when a heap is created with HEAP_CREATE_LOW_FRAGMENTATION.  Small blocks
+// are carved out of subsegments, which are themselves ordinary busy blocks
+// allocated from the heap.  Each subsegment holds blocks of exactly one
+// size, and is owned by one of several affinity slots so that threads
+// running on different processors do not contend for the same lock.
+//
+// A block handed out by the front end has a normal HEAP_ENTRY header, so
+// RtlSizeHeap and friends work unchanged.  Its SegmentIndex is set to
+// HEAP_LFH_SEGMENT_INDEX and its PreviousSize field gives the distance in
+// granules back to the owning subsegment header.
+//
+
+#define HEAP_LFH_SEGMENT_INDEX              0xFF
+#define HEAP_LFH_SUBSEGMENT_SIZE            0x2000
+#define HEAP_LFH_MINIMUM_BLOCK_COUNT        8
+
+typedef struct _HEAP_SUBSEGMENT {
+    //
+    // Links the subsegment into its bucket's partial list while it is
+    // neither the active subsegment nor completely in use.  The Flink is
+    // NULL when the subsegment is not on the list.
+    //
+
+    LIST_ENTRY PartialList;
+    struct _HEAP_LFH_AFFINITY *Affinity;
+    PHEAP_ENTRY FreeList;
+
+    ULONG Signature;
+    USHORT BlockSize;
+    USHORT BlockCount;
+    USHORT FreeCount;
+    USHORT CarvedCount;
+    ULONG Reserved;
+} HEAP_SUBSEGMENT, *PHEAP_SUBSEGMENT;
+
+#define HEAP_SUBSEGMENT_SIGNATURE           (ULONG)0xFFEEFFDD
+
+typedef struct _HEAP_LFH_BUCKET {
+    PHEAP_SUBSEGMENT ActiveSubsegment;
+    LIST_ENTRY PartialSubsegments;
+} HEAP_LFH_BUCKET, *PHEAP_LFH_BUCKET;
+
+typedef struct _HEAP_LFH_AFFINITY {
+    HEAP_LOCK Lock;
+    HEAP_LFH_BUCKET Buckets[ HEAP_MAXIMUM_FREELISTS ];
+} HEAP_LFH_AFFINITY, *PHEAP_LFH_AFFINITY;
+
+typedef struct _HEAP_LFH {
+    PHEAP Heap;
+    ULONG AffinityMask;
+    HEAP_LFH_AFFINITY Affinity[ 1 ];
+} HEAP_LFH, *PHEAP_LFH;
+
+//
+// Serialized, growable heaps keep a cache of recently freed small blocks
+// per affinity slot.  Cached blocks stay busy, so they are not coalesced
+// with their neighbors, and sit on lock free sequenced lists, one per block
+// size, so that an allocation that matches a recent free never takes the
+// heap lock.  A cached block is marked by an UnusedBytes of zero, which a
+// busy block never has.  When a list is full, the whole list is returned
+// to the free lists in one batch under a single acquisition of the lock.
+//
+
+#define HEAP_FREE_CACHE_BYTES               0x1000
+#define HEAP_FREE_CACHE_MINIMUM_DEPTH       4
+#define HEAP_FREE_CACHE_MAXIMUM_DEPTH       32
+
+typedef struct _HEAP_FREE_CACHE_SLOT {
+    SLIST_HEADER Lists[ HEAP_MAXIMUM_FREELISTS ];
+} HEAP_FREE_CACHE_SLOT, *PHEAP_FREE_CACHE_SLOT;
+
+typedef struct _HEAP_FREE_CACHE {
+    ULONG AffinityMask;
+    ULONG Reserved;
+    HEAP_FREE_CACHE_SLOT Slots[ 1 ];
+} HEAP_FREE_CACHE, *PHEAP_FREE_CACHE;
+
 #define CHECK_HEAP_TAIL_SIZE HEAP_GRANULARITY
 #define CHECK_HEAP_TAIL_FILL 0xAB
 #define FREE_HEAP_FILL 0xFEEEFEEE
@@ -1138,6 +1138,14 @@ KeInsertHeadQueue (
     IN PLIST_ENTRY Entry
     );
 
+NTKERNELAPI
+LONG
+KeInsertQueueMultiple (
+    IN PRKQUEUE Queue,
+    IN PLIST_ENTRY EntryArray[],
+    IN ULONG Count
+    );
+
 NTKERNELAPI
 PLIST_ENTRY
 KeRemoveQueue (
@@ -1146,6 +1154,16 @@ KeRemoveQueue (
     IN PLARGE_INTEGER Timeout OPTIONAL
     );
 
+NTKERNELAPI
+ULONG
+KeRemoveQueueMultiple (
+    IN PRKQUEUE Queue,
+    IN KPROCESSOR_MODE WaitMode,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    OUT PLIST_ENTRY EntryArray[],
+    IN ULONG Count
+    );
+
 PLIST_ENTRY
 KeRundownQueue (
     IN PRKQUEUE Queue
@@ -2209,6 +2227,20 @@ KeFlushSingleTb (
 
 #endif
 
+NTSTATUS
+KeGetTbFlushInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+NTSTATUS
+KeGetWaitSpinInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
 BOOLEAN
 KeFreezeExecution (
     IN PKTRAP_FRAME TrapFrame,
@@ -1286,11 +1286,18 @@ typedef struct _KPRCB {
 
     ULONG ReservedCounter[6];
 
+//
+// Executive per processor small pool lookaside lists.
+//
+
+    struct _SMALL_POOL_LOOKASIDE *NPagedPoolLookaside;
+    struct _SMALL_POOL_LOOKASIDE *PagedPoolLookaside;
+
 //
 // Reserved pad.
 //
 
-    ULONG ReservedPad[16 * 8];
+    ULONG ReservedPad[(16 * 8) - 2];
 
 //
 // MP interprocessor request packet and summary.
@@ -940,6 +940,27 @@ MmGetPageFileInformation(
     OUT PULONG Length
     );
 
+NTSTATUS
+MmGetCompressedStoreInformation(
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+NTSTATUS
+MmGetZeroPageInformation(
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+NTSTATUS
+MmGetPageFileWriteInformation(
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
 NTSTATUS
 MmExtendSection (
     IN PVOID SectionToExtend,
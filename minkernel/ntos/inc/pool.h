@@ -273,6 +273,21 @@ typedef struct _POOL_TRACKER_TABLE {
 
 extern PPOOL_TRACKER_TABLE PoolTrackTable;
 
+//
+// On multiprocessor systems each processor has its own tracker table that
+// is indexed the same as the system tracker table. The keys are only kept
+// in the system table and the allocation counts of a tag are the sum of
+// the counts in the system table and every processor table.
+//
+
+extern PPOOL_TRACKER_TABLE PoolTrackTableProcessor[MAXIMUM_PROCESSORS];
+
+VOID
+ExpGetPoolTagCounters (
+    IN ULONG Index,
+    OUT PPOOL_TRACKER_TABLE Tracker
+    );
+
 typedef struct _POOL_TRACKER_BIG_PAGES {
     PVOID Va;
     ULONG Key;
@@ -282,10 +297,18 @@ typedef struct _POOL_TRACKER_BIG_PAGES {
 #endif
 } POOL_TRACKER_BIG_PAGES, *PPOOL_TRACKER_BIG_PAGES;
 
-#define MAX_BIGPAGE_TABLE 2048
+//
+// The big page table is sized from the amount of physical memory when pool
+// is initialized. The size is a power of two between the minimum and the
+// maximum size.
+//
 
-#define BIGPAGE_TABLE_MASK (MAX_BIGPAGE_TABLE - 1)
+#define MINIMUM_BIGPAGE_TABLE 2048
+
+#define MAXIMUM_BIGPAGE_TABLE (64 * 1024)
 
 extern PPOOL_TRACKER_BIG_PAGES PoolBigPageTable;
 
+extern ULONG PoolBigPageTableSize;
+
 #endif
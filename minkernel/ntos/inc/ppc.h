@@ -1663,12 +1663,19 @@ typedef struct _KPRCB {
 
     ULONG ReservedCounter[12];
 
+//
+// Executive per processor small pool lookaside lists.
+//
+
+    struct _SMALL_POOL_LOOKASIDE *NPagedPoolLookaside;
+    struct _SMALL_POOL_LOOKASIDE *PagedPoolLookaside;
+
 //
 // Reserved pad.
 //
 
     union {
-        ULONG ReservedPad[16 * 8];
+        ULONG ReservedPad[(16 * 8) - 2];
         PVOID PagedFreeEntry[POOL_SMALL_LISTS];
     };
 
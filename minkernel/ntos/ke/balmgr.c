@@ -129,6 +129,7 @@ KiScanReadyQueues (
 //
 
 ULONG KiReadyQueueIndex = 1;
+ULONG KiReadyQueueProcessor = 0;
 
 //
 // Define swap request flag.
@@ -718,107 +719,127 @@ Return Value:
     ULONG Number;
     KIRQL OldIrql;
     PKPROCESS Process;
+    ULONG Processor;
+    PKREADY_QUEUE Queue;
+    ULONG Scanned;
     ULONG Summary;
     PKTHREAD Thread;
     ULONG WaitTime;
 
     //
-    // Lock the dispatcher database and check if there are any ready threads
-    // queued at the scannable priority levels.
+    // Lock the dispatcher database and scan the ready queues of each
+    // processor in turn, starting where the last scan left off, for ready
+    // threads queued at the scannable priority levels.
     //
 
     KiLockDispatcherDatabase(&OldIrql);
-    Summary = KiReadySummary & ((1 << THREAD_BOOST_PRIORITY) - 2);
-    if (Summary != 0) {
-        Count = THREAD_READY_COUNT;
-        CurrentTick = KiQueryLowTickCount();
-        Index = KiReadyQueueIndex;
-        Number = THREAD_SCAN_COUNT;
-        do {
-
-            //
-            // If the current ready queue index is beyond the end of the range
-            // of priorities that are scanned, then wrap back to the beginning
-            // priority.
-            //
+    Count = THREAD_READY_COUNT;
+    CurrentTick = KiQueryLowTickCount();
+    Index = KiReadyQueueIndex;
+    Number = THREAD_SCAN_COUNT;
+    Processor = KiReadyQueueProcessor;
+    Scanned = 0;
+    do {
+        if (Processor >= (ULONG)KeNumberProcessors) {
+            Processor = 0;
+        }
 
-            if (Index > THREAD_SCAN_PRIORITY) {
-                Index = 1;
-            }
+        Queue = &KiReadyQueue[Processor];
+        Summary = Queue->Summary & ((1 << THREAD_BOOST_PRIORITY) - 2);
+        if (Summary != 0) {
+            do {
 
-            //
-            // If there are any ready threads queued at the current priority
-            // level, then attempt to boost the thread priority.
-            //
+                //
+                // If the current ready queue index is beyond the end of the
+                // range of priorities that are scanned, then wrap back to the
+                // beginning priority.
+                //
 
-            if (((Summary >> Index) & 1) != 0) {
-                Summary ^= (1 << Index);
-                ListHead = &KiDispatcherReadyListHead[Index];
-                Entry = ListHead->Flink;
+                if (Index > THREAD_SCAN_PRIORITY) {
+                    Index = 1;
+                }
 
-                ASSERT(Entry != ListHead);
+                //
+                // If there are any ready threads queued at the current
+                // priority level, then attempt to boost the thread priority.
+                //
 
-                do {
-                    Thread = CONTAINING_RECORD(Entry, KTHREAD, WaitListEntry);
+                if (((Summary >> Index) & 1) != 0) {
+                    Summary ^= (1 << Index);
+                    ListHead = &Queue->ListHead[Index];
+                    Entry = ListHead->Flink;
 
-                    //
-                    // If the thread has been waiting for an extended period
-                    // and is not currently running with a boost, then boost
-                    // the priority of the current thread.
-                    //
+                    ASSERT(Entry != ListHead);
 
-                    WaitTime = CurrentTick - Thread->WaitTime;
-                    if ((WaitTime >= READY_WITHOUT_RUNNING) &&
-                        (Thread->PriorityDecrement == 0)) {
+                    do {
+                        Thread = CONTAINING_RECORD(Entry, KTHREAD, WaitListEntry);
 
                         //
-                        // Remove the thread from the respective ready queue.
+                        // If the thread has been waiting for an extended
+                        // period and is not currently running with a boost,
+                        // then boost the priority of the current thread.
                         //
 
-                        Entry = Entry->Blink;
-                        RemoveEntryList(Entry->Flink);
-                        if (IsListEmpty(ListHead) != FALSE) {
-                            ClearMember(Index, KiReadySummary);
+                        WaitTime = CurrentTick - Thread->WaitTime;
+                        if ((WaitTime >= READY_WITHOUT_RUNNING) &&
+                            (Thread->PriorityDecrement == 0)) {
+
+                            //
+                            // Remove the thread from the respective ready
+                            // queue.
+                            //
+
+                            Entry = Entry->Blink;
+                            KiRemoveReadyQueue(Thread, Index);
+
+                            //
+                            // Compute the priority decrement value, set the
+                            // new thread priority, set the decrement count,
+                            // set the thread quantum, and ready the thread
+                            // for execution.
+                            //
+
+                            Thread->PriorityDecrement =
+                                    THREAD_BOOST_PRIORITY - Thread->Priority;
+
+                            Thread->DecrementCount = ROUND_TRIP_DECREMENT_COUNT;
+                            Thread->Priority = THREAD_BOOST_PRIORITY;
+                            Process = Thread->ApcState.Process;
+                            Thread->Quantum = Process->ThreadQuantum * 2;
+                            KiReadyThread(Thread);
+                            Count -= 1;
                         }
 
-                        //
-                        // Compute the priority decrement value, set the new
-                        // thread priority, set the decrement count, set the
-                        // thread quantum, and ready the thread for execution.
-                        //
+                        Entry = Entry->Flink;
+                        Number -= 1;
+                    } while ((Entry != ListHead) & (Number != 0) & (Count != 0));
+                }
 
-                        Thread->PriorityDecrement =
-                                        THREAD_BOOST_PRIORITY - Thread->Priority;
+                Index += 1;
+            } while ((Summary != 0) & (Number != 0) & (Count != 0));
+        }
 
-                        Thread->DecrementCount = ROUND_TRIP_DECREMENT_COUNT;
-                        Thread->Priority = THREAD_BOOST_PRIORITY;
-                        Process = Thread->ApcState.Process;
-                        Thread->Quantum = Process->ThreadQuantum * 2;
-                        KiReadyThread(Thread);
-                        Count -= 1;
-                    }
+        //
+        // If the ready queues of the processor were completely scanned, then
+        // continue with the ready queues of the next processor.
+        //
 
-                    Entry = Entry->Flink;
-                    Number -= 1;
-                } while ((Entry != ListHead) & (Number != 0) & (Count != 0));
-            }
+        if ((Count != 0) && (Number != 0)) {
+            Processor += 1;
+            Index = 1;
+            Scanned += 1;
+        }
 
-            Index += 1;
-        } while ((Summary != 0) & (Number != 0) & (Count != 0));
-    }
+    } while ((Scanned < (ULONG)KeNumberProcessors) &
+             (Number != 0) & (Count != 0));
 
     //
-    // Unlock the dispatcher database and save the last read queue index
-    // for the next scan.
+    // Unlock the dispatcher database and save the last processor and ready
+    // queue index for the next scan.
     //
 
     KiUnlockDispatcherDatabase(OldIrql);
-    if ((Count != 0) && (Number != 0)) {
-        KiReadyQueueIndex = 1;
-
-    } else {
-        KiReadyQueueIndex = Index;
-    }
-
+    KiReadyQueueProcessor = Processor;
+    KiReadyQueueIndex = Index;
     return;
 }
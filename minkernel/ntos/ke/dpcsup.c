@@ -230,6 +230,7 @@ Return Value:
 --*/
 
 {
+    LOGICAL Cascade;
     ULARGE_INTEGER CurrentTime;
     LIST_ENTRY ExpiredListHead;
     LONG HandLimit;
@@ -267,6 +268,7 @@ Return Value:
         HandLimit &= (TIMER_TABLE_SIZE - 1);
     }
 
+    Cascade = FALSE;
     InitializeListHead(&ExpiredListHead);
     do {
         Index = (Index + 1) & (TIMER_TABLE_SIZE - 1);
@@ -279,11 +281,20 @@ Return Value:
                 //
                 // The next timer in the current timer list has expired.
                 // Remove the entry from the timer list and insert the
-                // timer in the expired list.
+                // timer in the expired list. If the timer is the timer
+                // wheel cascade timer, then the timer wheel is cascaded
+                // after the scan instead.
                 //
 
                 RemoveEntryList(&Timer->TimerListEntry);
-                InsertTailList(&ExpiredListHead, &Timer->TimerListEntry);
+                if (Timer == &KiTimerWheelTimer) {
+                    Timer->Header.Inserted = FALSE;
+                    Cascade = TRUE;
+
+                } else {
+                    InsertTailList(&ExpiredListHead, &Timer->TimerListEntry);
+                }
+
                 NextEntry = ListHead->Flink;
 
             } else {
@@ -293,6 +304,16 @@ Return Value:
 
     } while(Index != HandLimit);
 
+    //
+    // If the timer wheel cascade timer has expired, then cascade the timers
+    // that are due in the next trip through the timer table from the timer
+    // wheel into the timer table.
+    //
+
+    if (Cascade != FALSE) {
+        KiCascadeTimerWheel(CurrentTime, &ExpiredListHead);
+    }
+
 #if DBG
 
     if (((ULONG)SystemArgument2 == 0) && (KeNumberProcessors == 1)) {
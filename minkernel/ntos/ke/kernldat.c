@@ -25,15 +25,18 @@ Revision History:
 // performance. The layout of this data is important and must not be
 // changed.
 //
-// KiDispatcherReadyListHead - This is an array of type list entry. The
-//      elements of the array are indexed by priority. Each element is a list
-//      head for a set of threads that are in a ready state for the respective
-//      priority. This array is used by the find next thread code to speed up
-//      search for a ready thread when a thread becomes unrunnable. See also
-//      KiReadySummary.
+// KiReadyQueue - This is an array of dispatcher ready queues indexed by
+//      processor number. Each element contains an array of list heads
+//      indexed by priority, each of which anchors the threads that are in a
+//      ready state for the respective priority and that were placed on the
+//      respective processor, and a summary of the list heads that are not
+//      empty. The summary has a member set for each priority that has one or
+//      more entries in the respective dispatcher ready queue. The ready queues
+//      are used by the find next thread code to speed up search for a ready
+//      thread when a thread becomes unrunnable.
 //
 
-LIST_ENTRY KiDispatcherReadyListHead[MAXIMUM_PRIORITY];
+KREADY_QUEUE KiReadyQueue[MAXIMUM_PROCESSORS];
 
 //
 // KiIdleSummary - This is the set of processors that are idle. It is used by
@@ -44,9 +47,19 @@ LIST_ENTRY KiDispatcherReadyListHead[MAXIMUM_PRIORITY];
 KAFFINITY KiIdleSummary = 0;
 
 //
-// KiReadySummary - This is the set of dispatcher ready queues that are not
-//      empty. A member is set in this set for each priority that has one or
-//      more entries in its respective dispatcher ready queues.
+// KiReadySet - This is an array of processor sets indexed by priority. A
+//      member is set in a set for each processor whose dispatcher ready queue
+//      of the respective priority is not empty. It is used by the find next
+//      thread code to examine only the ready queues of the other processors
+//      that hold higher priority threads when work is stolen.
+//
+
+KAFFINITY KiReadySet[MAXIMUM_PRIORITY];
+
+//
+// KiReadySummary - This is the set of priorities for which the dispatcher
+//      ready queue of any processor is not empty. A member is set in this set
+//      for each priority that has a nonempty set in KiReadySet.
 //
 
 ULONG KiReadySummary = 0;
@@ -58,6 +71,24 @@ ULONG KiReadySummary = 0;
 
 LIST_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
 
+//
+// KiTimerWheelListHead - This is an array of list heads that anchor the
+//      timer wheel slot lists and the overflow list of timers that are due
+//      beyond the ticks that have been cascaded into the timer table.
+//
+// KiTimerWheelTick - This is the first tick that has not been cascaded into
+//      the timer table. A value of zero means the timer wheel has not been
+//      started.
+//
+// KiTimerWheelTimer - This is the timer that causes the timer expiration
+//      DPC to cascade the timer wheel one trip through the timer table
+//      before the next wheel tick.
+//
+
+LIST_ENTRY KiTimerWheelListHead[TIMER_WHEEL_LIST_SIZE];
+ULONGLONG KiTimerWheelTick;
+KTIMER KiTimerWheelTimer;
+
 //
 // KiSwapContextNotifyRoutine - This is the address of a callout routine
 //      which is called at each context switch if the address is not NULL.
@@ -549,6 +580,33 @@ KIPI_COUNTS KiIpiCounts[MAXIMUM_PROCESSORS];
 
 #endif  // NT_INST
 
+//
+// KiTbFlushCounts - Translation buffer flush counters. Each processor has
+//      its own set.
+//
+
+KTB_FLUSH_COUNTS KiTbFlushCounts[MAXIMUM_PROCESSORS];
+
+//
+// KiWaitSpinLimit - This is the maximum number of iterations a thread spins
+//      waiting for a dispatcher object to be signaled by another processor
+//      before it blocks. A value of zero disables adaptive spinning.
+//
+// KiWaitSpinEstimate - This is the running estimate of the number of
+//      iterations a successful spin takes for each type of dispatcher object.
+//
+// KiWaitLatencyHistogram - If nonzero, wait latency histograms are
+//      collected.
+//
+// KiWaitSpinCounts - Adaptive wait spin counters. Each processor has its own
+//      set.
+//
+
+ULONG KiWaitSpinLimit = 0;
+ULONG KiWaitSpinEstimate[SemaphoreObject + 1];
+ULONG KiWaitLatencyHistogram = 0;
+KWAIT_SPIN_COUNTS KiWaitSpinCounts[MAXIMUM_PROCESSORS];
+
 //
 // KiMasterPid - This is the master PID that is used to assign PID's to
 //      processes.
@@ -42,6 +42,24 @@ Revision History:
 //
 
 #define NIL (PVOID)NULL             // Null pointer to void
+
+//
+// Define timer wheel constants.
+//
+// Timers that are due within the ticks that have been cascaded into the
+// timer table are inserted in the timer table. Timers that are due later
+// are inserted in the timer wheel, which has levels of slots that are each
+// TIMER_WHEEL_SIZE times wider than the slots of the previous level. The
+// first level slots are one trip through the timer table wide. Timers that
+// are due beyond the last level are inserted in the overflow list.
+//
+
+#define TIMER_TABLE_SHIFT 7         // log2 of timer table size
+#define TIMER_WHEEL_LEVELS 3        // number of timer wheel levels
+#define TIMER_WHEEL_SHIFT 6         // log2 of timer wheel level size
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_SHIFT)
+#define TIMER_WHEEL_OVERFLOW (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE)
+#define TIMER_WHEEL_LIST_SIZE (TIMER_WHEEL_OVERFLOW + 1)
 
 //
 // Define macros which are used in the kernel only
@@ -216,8 +234,157 @@ KiUnlockDispatcherDatabase (
     InsertTailList(_ListHead, &(_Thread)->WaitListEntry);       \
 }
 
+// VOID
+// KiInsertReadyQueue (
+//    IN PKTHREAD Thread,
+//    IN KPRIORITY Priority,
+//    IN BOOLEAN Preempted
+//    )
+//
+//*++
+//
+// Routine Description:
+//
+//    This function inserts the specified thread in the dispatcher ready
+//    queue selected by the specified priority of the ready queues of the
+//    thread's next processor. If the thread was preempted, then the thread
+//    is inserted at the front of the queue. Otherwise, the thread is
+//    inserted at the tail of the queue. The ready summary of the processor,
+//    the ready set of the priority, and the global ready summary are
+//    updated.
+//
+//    N.B. The next processor of the thread must not be changed while the
+//         thread is in a dispatcher ready queue.
+//
+// Arguments:
+//
+//    Thread - Supplies a pointer to a dispatcher object of type thread.
+//
+//    Priority - Supplies the priority of the thread.
+//
+//    Preempted - Supplies a boolean value that determines whether the
+//        thread is inserted at the front of the queue.
+//
+// Return Value:
+//
+//    None.
+//
+//--*
+
+#define KiInsertReadyQueue(_Thread, _Priority, _Preempted) {            \
+    PKREADY_QUEUE _Queue;                                               \
+    _Queue = &KiReadyQueue[(_Thread)->NextProcessor];                   \
+    if (_Preempted) {                                                   \
+        InsertHeadList(&_Queue->ListHead[(_Priority)],                  \
+                       &(_Thread)->WaitListEntry);                      \
+                                                                        \
+    } else {                                                            \
+        InsertTailList(&_Queue->ListHead[(_Priority)],                  \
+                       &(_Thread)->WaitListEntry);                      \
+    }                                                                   \
+                                                                        \
+    SetMember((_Priority), _Queue->Summary);                            \
+    KiReadySet[(_Priority)] |=                                          \
+                        (KAFFINITY)(1 << (_Thread)->NextProcessor);     \
+    SetMember((_Priority), KiReadySummary);                             \
+}
+
+// VOID
+// KiRemoveReadyQueue (
+//    IN PKTHREAD Thread,
+//    IN KPRIORITY Priority
+//    )
+//
+//*++
+//
+// Routine Description:
+//
+//    This function removes the specified thread from the dispatcher ready
+//    queue selected by the specified priority of the ready queues of the
+//    thread's next processor. If the queue becomes empty, then the ready
+//    summary member of the processor and the ready set member of the
+//    processor are cleared, and the global ready summary member is cleared
+//    if no other processor has a thread ready at the priority.
+//
+// Arguments:
+//
+//    Thread - Supplies a pointer to a dispatcher object of type thread.
+//
+//    Priority - Supplies the priority of the ready queue the thread is in.
+//
+// Return Value:
+//
+//    None.
+//
+//--*
+
+#define KiRemoveReadyQueue(_Thread, _Priority) {                        \
+    PKREADY_QUEUE _Queue;                                               \
+    _Queue = &KiReadyQueue[(_Thread)->NextProcessor];                   \
+    RemoveEntryList(&(_Thread)->WaitListEntry);                         \
+    if (IsListEmpty(&_Queue->ListHead[(_Priority)]) != FALSE) {         \
+        ClearMember((_Priority), _Queue->Summary);                      \
+        KiReadySet[(_Priority)] &=                                      \
+                        ~(KAFFINITY)(1 << (_Thread)->NextProcessor);    \
+        if (KiReadySet[(_Priority)] == 0) {                             \
+            ClearMember((_Priority), KiReadySummary);                   \
+        }                                                               \
+    }                                                                   \
+}
+
 //
 // Private (internal) structure definitions.
+//
+
+//
+// Dispatcher ready queue structure.
+//
+// Each processor has a set of dispatcher ready queues, one per priority, and
+// a summary of the queues that are not empty. A thread that is readied and
+// cannot be run immediately is inserted in the ready queues of the processor
+// that is selected for the thread. A processor that looks for a thread to run
+// searches its own ready queues first and then takes a higher priority thread
+// that can run on the processor from the ready queues of another processor.
+// The global ready summary and ready sets record which processors have threads
+// ready at each priority, so only the queues that hold a higher priority
+// thread are examined.
+//
+
+typedef struct _KREADY_QUEUE {
+    ULONG Summary;
+    LIST_ENTRY ListHead[MAXIMUM_PRIORITY];
+} KREADY_QUEUE, *PKREADY_QUEUE;
+
+//
+// Translation buffer flush counters.
+//
+// Each processor counts the TB flush requests it makes, the flush packets
+// it sends to other processors, the pages in the single and multiple flush
+// packets, and the time it stalls waiting for the target processors. The
+// stall time is in processor cycles and is only counted on processors that
+// have a time stamp counter.
+//
+
+typedef struct _KTB_FLUSH_COUNTS {
+    ULONG FlushSingleTb;
+    ULONG FlushMultipleTb;
+    ULONG FlushEntireTb;
+    ULONG IpisSent;
+    ULONG PagesFlushed;
+    ULONGLONG StallTime;
+} KTB_FLUSH_COUNTS, *PKTB_FLUSH_COUNTS;
+
+//
+// Adaptive wait spin counters.
+//
+
+typedef struct _KWAIT_SPIN_COUNTS {
+    ULONG SpinWaits;
+    ULONG SpinAcquired;
+    ULONG SpinLatency[WAIT_LATENCY_BUCKETS];
+    ULONG BlockLatency[WAIT_LATENCY_BUCKETS];
+} KWAIT_SPIN_COUNTS, *PKWAIT_SPIN_COUNTS;
+
 //
 // APC Parameter structure.
 //
@@ -368,6 +535,13 @@ KiChainedDispatch (
     VOID
     );
 
+VOID
+FASTCALL
+KiCascadeTimerWheel (
+    IN ULARGE_INTEGER CurrentTime,
+    IN PLIST_ENTRY ExpiredListHead
+    );
+
 #if DBG
 
 VOID
@@ -462,6 +636,14 @@ KiFindReadyThread (
     KPRIORITY LowPriority
     );
 
+PKTHREAD
+FASTCALL
+KiSearchReadyQueue (
+    IN PKREADY_QUEUE Queue,
+    IN ULONG Processor,
+    IN KPRIORITY LowPriority
+    );
+
 VOID
 KiFloatingDispatch (
     VOID
@@ -1047,7 +1229,6 @@ extern KSPIN_LOCK KiContextSwapLock;
 extern PKDEBUG_ROUTINE KiDebugRoutine;
 extern PKDEBUG_SWITCH_ROUTINE KiDebugSwitchRoutine;
 extern KSPIN_LOCK KiDispatcherLock;
-extern LIST_ENTRY KiDispatcherReadyListHead[MAXIMUM_PRIORITY];
 extern CCHAR KiFindFirstSetLeft[256];
 extern CCHAR KiFindFirstSetRight[256];
 extern CALL_PERFORMANCE_DATA KiFlushSingleCallData;
@@ -1065,6 +1246,8 @@ extern ULONG KiProfileAlignmentFixupCount;
 extern ULONG KiProfileInterval;
 extern LIST_ENTRY KiProfileListHead;
 extern KSPIN_LOCK KiProfileLock;
+extern KREADY_QUEUE KiReadyQueue[MAXIMUM_PROCESSORS];
+extern KAFFINITY KiReadySet[MAXIMUM_PRIORITY];
 extern ULONG KiReadySummary;
 extern UCHAR KiArgumentTable[];
 extern ULONG KiServiceLimit;
@@ -1074,6 +1257,9 @@ extern ULONG KiTickOffset;
 extern LARGE_INTEGER KiTimeIncrementReciprocal;
 extern CCHAR KiTimeIncrementShiftCount;
 extern LIST_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
+extern LIST_ENTRY KiTimerWheelListHead[TIMER_WHEEL_LIST_SIZE];
+extern ULONGLONG KiTimerWheelTick;
+extern KTIMER KiTimerWheelTimer;
 extern KAFFINITY KiTimeProcessor;
 extern KDPC KiTimerExpireDpc;
 extern KSPIN_LOCK KiFreezeExecutionLock;
@@ -1117,6 +1303,12 @@ extern KIPI_COUNTS KiIpiCounts[MAXIMUM_PROCESSORS];
 
 #endif
 
+extern KTB_FLUSH_COUNTS KiTbFlushCounts[MAXIMUM_PROCESSORS];
+extern ULONG KiWaitLatencyHistogram;
+extern KWAIT_SPIN_COUNTS KiWaitSpinCounts[MAXIMUM_PROCESSORS];
+extern ULONG KiWaitSpinEstimate[SemaphoreObject + 1];
+extern ULONG KiWaitSpinLimit;
+
 extern KSPIN_LOCK KiFreezeLockBackup;
 extern ULONG KiFreezeFlag;
 extern volatile ULONG KiSuspendState;
@@ -116,13 +116,23 @@ Return Value:
 {
 
     ULONG Index;
+    ULONG Number;
 
     //
-    // Initialize dispatcher ready queue listheads.
+    // Initialize the global ready summary, the ready sets, and the
+    // dispatcher ready queue listheads of each processor.
     //
 
+    KiReadySummary = 0;
     for (Index = 0; Index < MAXIMUM_PRIORITY; Index += 1) {
-        InitializeListHead(&KiDispatcherReadyListHead[Index]);
+        KiReadySet[Index] = 0;
+    }
+
+    for (Number = 0; Number < MAXIMUM_PROCESSORS; Number += 1) {
+        KiReadyQueue[Number].Summary = 0;
+        for (Index = 0; Index < MAXIMUM_PRIORITY; Index += 1) {
+            InitializeListHead(&KiReadyQueue[Number].ListHead[Index]);
+        }
     }
 
     //
@@ -161,6 +171,18 @@ Return Value:
         InitializeListHead(&KiTimerTableListHead[Index]);
     }
 
+    //
+    // Initialize the timer wheel and the timer wheel cascade timer. The
+    // timer wheel is started when the first timer that is due beyond the
+    // timer table is inserted.
+    //
+
+    for (Index = 0; Index < TIMER_WHEEL_LIST_SIZE; Index += 1) {
+        InitializeListHead(&KiTimerWheelListHead[Index]);
+    }
+
+    KeInitializeTimer(&KiTimerWheelTimer);
+
     //
     // Initialize the swap event, the process inswap listhead, the
     // process outswap listhead, the kernel stack inswap listhead,
@@ -405,13 +405,19 @@ Return Value:
 
     //
     // Lower IRQL to dispatch level and remove all absolute timers from the
-    // timer queue so their due time can be recomputed.
+    // timer table and the timer wheel so their due time can be recomputed.
     //
 
     KeLowerIrql(OldIrql2);
     InitializeListHead(&AbsoluteListHead);
-    for (Index = 0; Index < TIMER_TABLE_SIZE; Index += 1) {
-        ListHead = &KiTimerTableListHead[Index];
+    for (Index = 0; Index < (TIMER_TABLE_SIZE + TIMER_WHEEL_LIST_SIZE); Index += 1) {
+        if (Index < TIMER_TABLE_SIZE) {
+            ListHead = &KiTimerTableListHead[Index];
+
+        } else {
+            ListHead = &KiTimerWheelListHead[Index - TIMER_TABLE_SIZE];
+        }
+
         NextEntry = ListHead->Flink;
         while (NextEntry != ListHead) {
             Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
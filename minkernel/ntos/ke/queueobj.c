@@ -234,6 +234,71 @@ Return Value:
     return OldState;
 }
 
+LONG
+KeInsertQueueMultiple (
+    IN PRKQUEUE Queue,
+    IN PLIST_ENTRY EntryArray[],
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts the specified entries in the queue object entry
+    list in order and attempts to satisfy the wait of a waiter for each
+    entry. The dispatcher database is locked once for all the entries.
+
+    N.B. The wait discipline for Queue object is LIFO.
+
+Arguments:
+
+    Queue - Supplies a pointer to a dispatcher object of type Queue.
+
+    EntryArray - Supplies a pointer to an array of pointers to list entries
+        that are inserted in the queue object entry list.
+
+    Count - Supplies the number of entries in the array.
+
+Return Value:
+
+    The previous signal state of the Queue object.
+
+--*/
+
+{
+
+    ULONG Index;
+    KIRQL OldIrql;
+    LONG OldState;
+
+    ASSERT_QUEUE(Queue);
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+
+    //
+    // Raise IRQL to dispatcher level and lock dispatcher database.
+    //
+
+    KiLockDispatcherDatabase(&OldIrql);
+
+    //
+    // Insert the specified entries in the queue object entry list.
+    //
+
+    OldState = Queue->Header.SignalState;
+    for (Index = 0; Index < Count; Index += 1) {
+        KiInsertQueue(Queue, EntryArray[Index], FALSE);
+    }
+
+    //
+    // Unlock the dispather database, lower IRQL to the previous level, and
+    // return signal state of Queue object.
+    //
+
+    KiUnlockDispatcherDatabase(OldIrql);
+    return OldState;
+}
+
 PLIST_ENTRY
 KeRemoveQueue (
     IN PRKQUEUE Queue,
@@ -270,11 +335,69 @@ Return Value:
 
 --*/
 
+{
+
+    PLIST_ENTRY Entry;
+
+    KeRemoveQueueMultiple(Queue, WaitMode, Timeout, &Entry, 1);
+    return Entry;
+}
+
+ULONG
+KeRemoveQueueMultiple (
+    IN PRKQUEUE Queue,
+    IN KPROCESSOR_MODE WaitMode,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    OUT PLIST_ENTRY EntryArray[],
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes up to the specified number of entries from the
+    Queue object entry list with a single acquisition of the dispatcher
+    database lock. If no list entry is available, then the calling thread
+    is put in a wait state and a single entry is returned when the wait is
+    satisfied.
+
+    The entries are processed by the calling thread and count as a single
+    active thread against the target maximum number of threads.
+
+    N.B. The wait discipline for Queue object LIFO.
+
+Arguments:
+
+    Queue - Supplies a pointer to a dispatcher object of type Queue.
+
+    WaitMode  - Supplies the processor mode in which the wait is to occur.
+
+    Timeout - Supplies a pointer to an optional absolute of relative time over
+        which the wait is to occur.
+
+    EntryArray - Supplies a pointer to an array that receives the addresses
+        of the entries removed from the Queue object entry list.
+
+    Count - Supplies the number of elements in the entry array.
+
+Return Value:
+
+    The number of entries stored in the entry array. If the wait completes
+    with STATUS_TIMEOUT or STATUS_USER_APC, then the status is stored in the
+    first element of the entry array and a value of one is returned.
+
+    N.B. These values can easily be distinguished by the fact that all
+         addresses in kernel mode have the high order bit set.
+
+--*/
+
 {
 
     LARGE_INTEGER NewTime;
     PLIST_ENTRY Entry;
     PRKTHREAD NextThread;
+    ULONG Number;
     KIRQL OldIrql;
     PRKQUEUE OldQueue;
     PLARGE_INTEGER OriginalTime;
@@ -285,6 +408,7 @@ Return Value:
 
     ASSERT_QUEUE(Queue);
     ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+    ASSERT(Count != 0);
 
     //
     // If the dispatcher database lock is not already held, then set the wait
@@ -367,23 +491,31 @@ Return Value:
             (Queue->CurrentCount < Queue->MaximumCount)) {
 
             //
-            // Decrement the number of entires in the Queue object entry list,
-            // increment the number of active threads, remove the next entry
-            // rom the list, and set the forward link to NULL.
+            // Increment the number of active threads. Then for each entry up
+            // to the specified count, decrement the number of entries in the
+            // Queue object entry list, remove the next entry from the list,
+            // and set the forward link to NULL.
             //
 
-            Queue->Header.SignalState -= 1;
             Queue->CurrentCount += 1;
-            if ((Entry->Flink == NULL) || (Entry->Blink == NULL)) {
-                KeBugCheckEx(INVALID_WORK_QUEUE_ITEM,
-                             (ULONG)Entry,
-                             (ULONG)Queue,
-                             (ULONG)&ExWorkerQueue[0],
-                             (ULONG)((PWORK_QUEUE_ITEM)Entry)->WorkerRoutine);
-            }
+            Number = 0;
+            do {
+                Queue->Header.SignalState -= 1;
+                if ((Entry->Flink == NULL) || (Entry->Blink == NULL)) {
+                    KeBugCheckEx(INVALID_WORK_QUEUE_ITEM,
+                                 (ULONG)Entry,
+                                 (ULONG)Queue,
+                                 (ULONG)&ExWorkerQueue[0],
+                                 (ULONG)((PWORK_QUEUE_ITEM)Entry)->WorkerRoutine);
+                }
+
+                RemoveEntryList(Entry);
+                Entry->Flink = NULL;
+                EntryArray[Number] = Entry;
+                Number += 1;
+                Entry = Queue->EntryListHead.Flink;
+            } while ((Number < Count) && (Entry != &Queue->EntryListHead));
 
-            RemoveEntryList(Entry);
-            Entry->Flink = NULL;
             break;
 
         } else {
@@ -424,7 +556,8 @@ Return Value:
                 //
 
                 if ((WaitMode != KernelMode) && (Thread->ApcState.UserApcPending)) {
-                    Entry = (PLIST_ENTRY)STATUS_USER_APC;
+                    EntryArray[0] = (PLIST_ENTRY)STATUS_USER_APC;
+                    Number = 1;
                     Queue->CurrentCount += 1;
                     break;
                 }
@@ -456,7 +589,8 @@ Return Value:
                     //
 
                     if (!(Timeout->LowPart | Timeout->HighPart)) {
-                        Entry = (PLIST_ENTRY)STATUS_TIMEOUT;
+                        EntryArray[0] = (PLIST_ENTRY)STATUS_TIMEOUT;
+                        Number = 1;
                         Queue->CurrentCount += 1;
                         break;
                     }
@@ -479,7 +613,8 @@ Return Value:
                     WaitBlock->WaitListEntry.Flink = &Timer->Header.WaitListHead;
                     WaitBlock->WaitListEntry.Blink = &Timer->Header.WaitListHead;
                     if (KiInsertTreeTimer(Timer, *Timeout) == FALSE) {
-                        Entry = (PLIST_ENTRY)STATUS_TIMEOUT;
+                        EntryArray[0] = (PLIST_ENTRY)STATUS_TIMEOUT;
+                        Number = 1;
                         Queue->CurrentCount += 1;
                         break;
                     }
@@ -523,12 +658,14 @@ Return Value:
 
                 //
                 // If the thread was not awakened to deliver a kernel mode APC,
-                // then return wait status.
+                // then return wait status. The wait status is either the
+                // address of the entry that satisfied the wait or a status.
                 //
 
                 Thread->WaitReason = 0;
                 if (WaitStatus != STATUS_KERNEL_APC) {
-                    return (PLIST_ENTRY)WaitStatus;
+                    EntryArray[0] = (PLIST_ENTRY)WaitStatus;
+                    return 1;
                 }
 
                 if (ARGUMENT_PRESENT(Timeout)) {
@@ -554,12 +691,12 @@ Return Value:
     } while (TRUE);
 
     //
-    // Unlock the dispatcher database and return the list entry address or a
-    // status of timeout.
+    // Unlock the dispatcher database and return the number of list entry
+    // addresses or status values stored in the entry array.
     //
 
     KiUnlockDispatcherDatabase(Thread->WaitIrql);
-    return Entry;
+    return Number;
 }
 
 PLIST_ENTRY
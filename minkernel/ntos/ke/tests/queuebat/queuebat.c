@@ -0,0 +1,407 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    queuebat.c
+
+Abstract:
+
+    Throughput benchmark for queue objects with single and batch insertion
+    and removal.  The program models a kernel queue object in user mode: a
+    spin lock stands in for the dispatcher database lock, entries are kept
+    in a list, and a thread that finds the queue empty waits LIFO and is
+    handed the next inserted entry directly, the way KiInsertQueue satisfies
+    a waiter.
+
+    For each thread count, the same number of producer and consumer threads
+    move a fixed number of entries through the queue, first one entry per
+    lock acquisition as KeInsertQueue and KeRemoveQueue do, then in batches
+    as KeInsertQueueMultiple and KeRemoveQueueMultiple do.  Consumers spin
+    for a short time on each entry to model processing it.  The program
+    reports the entries moved per second, the lock acquisitions per entry,
+    and the consumer waits per entry.
+
+    The concurrency limit of the queue object is not modeled since the
+    consumers never block on anything other than the queue.
+
+    Usage: queuebat [ MaximumThreads [ EntriesPerThread [ BatchSize [ Work ] ] ] ]
+
+Environment:
+
+    User mode.
+
+Revision History:
+
+--*/
+
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAXIMUM_THREADS 32
+#define MAXIMUM_BATCH 64
+
+typedef struct _SIM_LIST {
+    struct _SIM_LIST *Flink;
+    struct _SIM_LIST *Blink;
+} SIM_LIST, *PSIM_LIST;
+
+typedef struct _BENCH_ENTRY {
+    SIM_LIST ListEntry;
+    BOOLEAN Stop;
+} BENCH_ENTRY, *PBENCH_ENTRY;
+
+typedef struct _BENCH_THREAD {
+    HANDLE Event;
+    PSIM_LIST HandedEntry;
+    PBENCH_ENTRY Entries;
+    ULONG Processed;
+} BENCH_THREAD, *PBENCH_THREAD;
+
+//
+// Queue model. The lock, list, and waiter stack are only touched with the
+// lock held.
+//
+
+volatile LONG QueueLock;
+SIM_LIST EntryListHead;
+PBENCH_THREAD Waiters[ MAXIMUM_THREADS ];
+ULONG NumberOfWaiters;
+ULONG LockAcquires;
+ULONG Waits;
+
+BENCH_THREAD Producers[ MAXIMUM_THREADS ];
+BENCH_THREAD Consumers[ MAXIMUM_THREADS ];
+BENCH_ENTRY StopEntries[ MAXIMUM_THREADS ];
+
+ULONG EntriesPerThread;
+ULONG BatchSize;
+ULONG WorkPerEntry;
+ULONG CurrentBatch;
+volatile ULONG WorkSink;
+
+VOID
+AcquireQueueLock (
+    VOID
+    )
+{
+    while (InterlockedExchange( (PLONG)&QueueLock, 1 ) != 0) {
+        while (QueueLock != 0) {
+        }
+    }
+
+    LockAcquires += 1;
+}
+
+VOID
+ReleaseQueueLock (
+    VOID
+    )
+{
+    InterlockedExchange( (PLONG)&QueueLock, 0 );
+}
+
+VOID
+InsertQueue (
+    PSIM_LIST EntryArray[],
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts entries in the queue with one lock acquisition.
+    Each entry is handed to the most recent waiter if there is one and is
+    otherwise inserted at the tail of the entry list.
+
+--*/
+
+{
+    ULONG Index;
+    ULONG NumberToWake = 0;
+    PBENCH_THREAD Wake[ MAXIMUM_BATCH ];
+    PSIM_LIST Entry;
+
+    AcquireQueueLock();
+    for (Index = 0; Index < Count; Index += 1) {
+        Entry = EntryArray[Index];
+        if (NumberOfWaiters != 0) {
+            NumberOfWaiters -= 1;
+            Wake[NumberToWake] = Waiters[NumberOfWaiters];
+            Wake[NumberToWake]->HandedEntry = Entry;
+            NumberToWake += 1;
+
+        } else {
+            Entry->Flink = &EntryListHead;
+            Entry->Blink = EntryListHead.Blink;
+            EntryListHead.Blink->Flink = Entry;
+            EntryListHead.Blink = Entry;
+        }
+    }
+
+    ReleaseQueueLock();
+
+    for (Index = 0; Index < NumberToWake; Index += 1) {
+        SetEvent( Wake[Index]->Event );
+    }
+}
+
+ULONG
+RemoveQueue (
+    PBENCH_THREAD Thread,
+    PSIM_LIST EntryArray[],
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes up to the specified number of entries from the
+    queue with one lock acquisition, or waits for a single entry if the
+    queue is empty.
+
+Return Value:
+
+    The number of entries removed.
+
+--*/
+
+{
+    PSIM_LIST Entry;
+    ULONG Number = 0;
+
+    AcquireQueueLock();
+    Entry = EntryListHead.Flink;
+    if (Entry == &EntryListHead) {
+        Waiters[NumberOfWaiters] = Thread;
+        NumberOfWaiters += 1;
+        Waits += 1;
+        ReleaseQueueLock();
+        WaitForSingleObject( Thread->Event, INFINITE );
+        EntryArray[0] = Thread->HandedEntry;
+        return 1;
+    }
+
+    do {
+        EntryListHead.Flink = Entry->Flink;
+        Entry->Flink->Blink = &EntryListHead;
+        EntryArray[Number] = Entry;
+        Number += 1;
+        Entry = EntryListHead.Flink;
+    } while ((Number < Count) && (Entry != &EntryListHead));
+
+    ReleaseQueueLock();
+    return Number;
+}
+
+DWORD
+WINAPI
+ProducerThread (
+    LPVOID Context
+    )
+{
+    PBENCH_THREAD Thread = (PBENCH_THREAD)Context;
+    PSIM_LIST EntryArray[ MAXIMUM_BATCH ];
+    ULONG Count;
+    ULONG Index = 0;
+
+    while (Index < EntriesPerThread) {
+        Count = 0;
+        while ((Count < CurrentBatch) && (Index < EntriesPerThread)) {
+            EntryArray[Count] = &Thread->Entries[Index].ListEntry;
+            Count += 1;
+            Index += 1;
+        }
+
+        InsertQueue( EntryArray, Count );
+        Thread->Processed += Count;
+    }
+
+    return 0;
+}
+
+DWORD
+WINAPI
+ConsumerThread (
+    LPVOID Context
+    )
+{
+    PBENCH_THREAD Thread = (PBENCH_THREAD)Context;
+    PSIM_LIST EntryArray[ MAXIMUM_BATCH ];
+    PSIM_LIST ExtraStops[ MAXIMUM_BATCH ];
+    ULONG Count;
+    ULONG Index;
+    ULONG Work;
+    ULONG NumberOfStops;
+
+    do {
+        Count = RemoveQueue( Thread, EntryArray, CurrentBatch );
+        NumberOfStops = 0;
+        for (Index = 0; Index < Count; Index += 1) {
+            if (CONTAINING_RECORD( EntryArray[Index], BENCH_ENTRY, ListEntry )->Stop) {
+                if (NumberOfStops != 0) {
+                    ExtraStops[NumberOfStops - 1] = EntryArray[Index];
+                }
+
+                NumberOfStops += 1;
+
+            } else {
+                for (Work = 0; Work < WorkPerEntry; Work += 1) {
+                    WorkSink += Work;
+                }
+
+                Thread->Processed += 1;
+            }
+        }
+
+        //
+        // Each consumer needs one stop entry.  Give back any others that
+        // were removed in the same batch.
+        //
+
+        if (NumberOfStops > 1) {
+            InsertQueue( ExtraStops, NumberOfStops - 1 );
+        }
+
+    } while (NumberOfStops == 0);
+
+    return 0;
+}
+
+VOID
+RunBenchmark (
+    ULONG NumberOfThreads,
+    ULONG Batch
+    )
+{
+    HANDLE Handles[ MAXIMUM_THREADS * 2 ];
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
+    PSIM_LIST StopArray[ MAXIMUM_THREADS ];
+    ULONG Index;
+    ULONG TotalEntries;
+    ULONG Processed;
+    double Seconds;
+    DWORD ThreadId;
+
+    EntryListHead.Flink = &EntryListHead;
+    EntryListHead.Blink = &EntryListHead;
+    NumberOfWaiters = 0;
+    LockAcquires = 0;
+    Waits = 0;
+    CurrentBatch = Batch;
+
+    for (Index = 0; Index < NumberOfThreads; Index += 1) {
+        Producers[Index].Processed = 0;
+        Consumers[Index].Processed = 0;
+        StopEntries[Index].Stop = TRUE;
+        StopArray[Index] = &StopEntries[Index].ListEntry;
+    }
+
+    QueryPerformanceFrequency( &Frequency );
+    QueryPerformanceCounter( &StartTime );
+
+    for (Index = 0; Index < NumberOfThreads; Index += 1) {
+        Handles[Index] = CreateThread( NULL, 0, ConsumerThread, &Consumers[Index], 0, &ThreadId );
+        Handles[NumberOfThreads + Index] =
+            CreateThread( NULL, 0, ProducerThread, &Producers[Index], 0, &ThreadId );
+    }
+
+    WaitForMultipleObjects( NumberOfThreads, &Handles[NumberOfThreads], TRUE, INFINITE );
+    InsertQueue( StopArray, NumberOfThreads );
+    WaitForMultipleObjects( NumberOfThreads, &Handles[0], TRUE, INFINITE );
+
+    QueryPerformanceCounter( &EndTime );
+
+    for (Index = 0; Index < NumberOfThreads * 2; Index += 1) {
+        CloseHandle( Handles[Index] );
+    }
+
+    Processed = 0;
+    for (Index = 0; Index < NumberOfThreads; Index += 1) {
+        Processed += Consumers[Index].Processed;
+    }
+
+    TotalEntries = NumberOfThreads * EntriesPerThread;
+    if (Processed != TotalEntries) {
+        printf("Lost entries: %d of %d processed\n", Processed, TotalEntries);
+    }
+
+    Seconds = (double)(EndTime.QuadPart - StartTime.QuadPart) / (double)Frequency.QuadPart;
+    printf("%7d %7d %12.0f %11.3f %11.3f\n",
+           NumberOfThreads,
+           Batch,
+           (double)TotalEntries / Seconds,
+           (double)LockAcquires / (double)TotalEntries,
+           (double)Waits / (double)TotalEntries);
+}
+
+int
+_CDECL
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    ULONG Index;
+    ULONG MaximumThreads;
+    ULONG NumberOfThreads;
+
+    MaximumThreads = 8;
+    EntriesPerThread = 100000;
+    BatchSize = 16;
+    WorkPerEntry = 100;
+
+    if (argc > 1) {
+        MaximumThreads = atoi( argv[1] );
+    }
+
+    if (argc > 2) {
+        EntriesPerThread = atoi( argv[2] );
+    }
+
+    if (argc > 3) {
+        BatchSize = atoi( argv[3] );
+    }
+
+    if (argc > 4) {
+        WorkPerEntry = atoi( argv[4] );
+    }
+
+    if ((MaximumThreads == 0) || (MaximumThreads > MAXIMUM_THREADS)) {
+        MaximumThreads = MAXIMUM_THREADS;
+    }
+
+    if (EntriesPerThread == 0) {
+        EntriesPerThread = 1;
+    }
+
+    if ((BatchSize == 0) || (BatchSize > MAXIMUM_BATCH)) {
+        BatchSize = MAXIMUM_BATCH;
+    }
+
+    for (Index = 0; Index < MaximumThreads; Index += 1) {
+        Producers[Index].Entries = calloc( EntriesPerThread, sizeof(BENCH_ENTRY) );
+        Consumers[Index].Event = CreateEvent( NULL, FALSE, FALSE, NULL );
+        if ((Producers[Index].Entries == NULL) || (Consumers[Index].Event == NULL)) {
+            printf("Unable to allocate entries\n");
+            return 1;
+        }
+    }
+
+    printf("%d entries per producer, %d work per entry\n", EntriesPerThread, WorkPerEntry);
+    printf("Threads   Batch  Entries/sec Locks/entry Waits/entry\n");
+
+    for (NumberOfThreads = 1; NumberOfThreads <= MaximumThreads; NumberOfThreads *= 2) {
+        RunBenchmark( NumberOfThreads, 1 );
+        RunBenchmark( NumberOfThreads, BatchSize );
+    }
+
+    return 0;
+}
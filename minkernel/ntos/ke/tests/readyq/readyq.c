@@ -0,0 +1,639 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    readyq.c
+
+Abstract:
+
+    Scheduler simulation for the dispatcher ready queues.  The program
+    replays a trace of ready events against two models of the ready queues
+    and reports the dispatch latency and the cost of the ready queue
+    operations done with the dispatcher lock held.
+
+    The first model is the old single set of ready queues shared by all
+    processors.  A processor that looks for work scans the queues from the
+    highest priority down and skips every thread whose affinity does not
+    include the processor.
+
+    The second model is the per processor ready queues.  A ready thread is
+    placed on an idle processor in its affinity, or on its ideal processor,
+    or on the first processor in its affinity.  A processor that looks for
+    work searches its own queues first and then steals the highest priority
+    thread that may run on it from the other processors.  The global ready
+    summary and the per priority ready sets select the queues of the other
+    processors that hold a higher priority thread, and only those queues
+    are examined.
+
+    Each line of a trace describes one ready event:
+
+        <time> <thread> <priority> <affinity> <runtime>
+
+    where time and runtime are in ticks, affinity is a hex processor mask,
+    and lines that start with '#' are comments.  Events must be in time
+    order.  The thread number selects the ideal processor.  A thread runs
+    for its runtime once dispatched and then waits.  Preemption is not
+    modeled.  If no trace is given, a synthetic trace is generated.
+
+    The lock cost is the number of ready queue entries, per processor
+    queues, and ready summaries examined while the dispatcher lock is held,
+    which is what the hold time of the lock is proportional to.
+
+    Usage: readyq [ NumberOfProcessors [ TraceFile ] ]
+
+Environment:
+
+    User mode.
+
+Revision History:
+
+--*/
+
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAXIMUM_CPUS 32
+#define MAXIMUM_LEVELS 32
+
+#define SYNTHETIC_EVENTS 100000
+#define SYNTHETIC_THREADS 64
+
+typedef struct _SIM_THREAD {
+    LONG Next;
+    ULONG Thread;
+    ULONG Priority;
+    ULONG Affinity;
+    ULONG ReadyTime;
+    ULONG RunTime;
+} SIM_THREAD, *PSIM_THREAD;
+
+typedef struct _SIM_QUEUE {
+    ULONG Summary;
+    LONG Head[ MAXIMUM_LEVELS ];
+    LONG Tail[ MAXIMUM_LEVELS ];
+} SIM_QUEUE, *PSIM_QUEUE;
+
+typedef struct _SIM_RESULTS {
+    ULONG Dispatches;
+    ULONG Steals;
+    ULONG TotalLatency;
+    ULONG MaximumLatency;
+    ULONG TotalCost;
+    ULONG MaximumCost;
+    ULONG Operations;
+    ULONG EndTime;
+} SIM_RESULTS, *PSIM_RESULTS;
+
+PSIM_THREAD Events;
+ULONG NumberOfEvents;
+ULONG NumberOfCpus;
+
+SIM_QUEUE Queues[ MAXIMUM_CPUS ];
+ULONG ReadySet[ MAXIMUM_LEVELS ];
+ULONG ReadySummary;
+LONG Running[ MAXIMUM_CPUS ];
+LONG NextThread[ MAXIMUM_CPUS ];
+ULONG RunEnd[ MAXIMUM_CPUS ];
+
+VOID
+InitializeQueue (
+    PSIM_QUEUE Queue
+    )
+{
+    ULONG Index;
+
+    Queue->Summary = 0;
+    for (Index = 0; Index < MAXIMUM_LEVELS; Index += 1) {
+        Queue->Head[ Index ] = -1;
+        Queue->Tail[ Index ] = -1;
+    }
+}
+
+VOID
+InsertQueue (
+    PSIM_QUEUE Queue,
+    LONG Event
+    )
+{
+    ULONG Priority = Events[ Event ].Priority;
+
+    Events[ Event ].Next = -1;
+    if (Queue->Tail[ Priority ] < 0) {
+        Queue->Head[ Priority ] = Event;
+
+    } else {
+        Events[ Queue->Tail[ Priority ] ].Next = Event;
+    }
+
+    Queue->Tail[ Priority ] = Event;
+    Queue->Summary |= (1 << Priority);
+    ReadySet[ Priority ] |= (1 << (Queue - Queues));
+    ReadySummary |= (1 << Priority);
+}
+
+LONG
+SearchQueue (
+    PSIM_QUEUE Queue,
+    ULONG Cpu,
+    ULONG LowPriority,
+    BOOLEAN Remove,
+    PULONG Cost
+    )
+
+/*++
+
+Routine Description:
+
+    This function searches a set of ready queues from the highest priority
+    down to the low priority for the first thread that may run on the
+    specified processor, and optionally removes it.  The number of entries
+    examined is added to the cost.
+
+Return Value:
+
+    The index of the thread found, or -1 if there is none.
+
+--*/
+
+{
+    LONG Event;
+    LONG Previous;
+    LONG Priority;
+
+    for (Priority = MAXIMUM_LEVELS - 1; Priority >= (LONG)LowPriority; Priority -= 1) {
+        if ((Queue->Summary & (1 << Priority)) == 0) {
+            continue;
+        }
+
+        Previous = -1;
+        Event = Queue->Head[ Priority ];
+        while (Event >= 0) {
+            *Cost += 1;
+            if ((Events[ Event ].Affinity & (1 << Cpu)) != 0) {
+                if (Remove) {
+                    if (Previous < 0) {
+                        Queue->Head[ Priority ] = Events[ Event ].Next;
+
+                    } else {
+                        Events[ Previous ].Next = Events[ Event ].Next;
+                    }
+
+                    if (Queue->Tail[ Priority ] == Event) {
+                        Queue->Tail[ Priority ] = Previous;
+                    }
+
+                    if (Queue->Head[ Priority ] < 0) {
+                        Queue->Summary &= ~(1 << Priority);
+                        ReadySet[ Priority ] &= ~(1 << (Queue - Queues));
+                        if (ReadySet[ Priority ] == 0) {
+                            ReadySummary &= ~(1 << Priority);
+                        }
+                    }
+                }
+
+                return Event;
+            }
+
+            Previous = Event;
+            Event = Events[ Event ].Next;
+        }
+    }
+
+    return -1;
+}
+
+VOID
+ReadyThread (
+    LONG Event,
+    BOOLEAN PerCpu,
+    PULONG Cost
+    )
+
+/*++
+
+Routine Description:
+
+    This function readies a thread.  In both models the thread is handed
+    to an idle processor in its affinity if there is one.  Otherwise it is
+    placed in the ready queues.  With the per processor model, the queues
+    of the processor are chosen the same way that KiReadyThread chooses
+    them.
+
+--*/
+
+{
+    ULONG Affinity = Events[ Event ].Affinity;
+    ULONG Cpu;
+
+    *Cost += 1;
+    for (Cpu = 0; Cpu < NumberOfCpus; Cpu += 1) {
+        if (((Affinity & (1 << Cpu)) != 0) &&
+            (Running[ Cpu ] < 0) &&
+            (NextThread[ Cpu ] < 0)) {
+            NextThread[ Cpu ] = Event;
+            return;
+        }
+    }
+
+    if (PerCpu == FALSE) {
+        InsertQueue( &Queues[ 0 ], Event );
+        return;
+    }
+
+    Cpu = Events[ Event ].Thread % NumberOfCpus;
+    if ((Affinity & (1 << Cpu)) == 0) {
+        for (Cpu = 0; (Affinity & (1 << Cpu)) == 0; Cpu += 1) {
+        }
+    }
+
+    InsertQueue( &Queues[ Cpu ], Event );
+}
+
+LONG
+FindReadyThread (
+    ULONG Cpu,
+    BOOLEAN PerCpu,
+    PULONG Cost,
+    PSIM_RESULTS Results
+    )
+
+/*++
+
+Routine Description:
+
+    This function selects the next thread to run on a processor.  With the
+    per processor model, the local queues are searched first.  Then, from
+    the highest priority down to the priority of the thread found, the
+    queues of the other processors in the ready set of each priority are
+    searched round robin for a thread that may run on this processor, the
+    same way as KiFindReadyThread.
+
+--*/
+
+{
+    LONG Event;
+    LONG Found;
+    ULONG FoundCpu;
+    ULONG LowPriority;
+    ULONG Other;
+    LONG Priority;
+    ULONG PrioritySet;
+    ULONG ProcessorSet;
+
+    if (PerCpu == FALSE) {
+        return SearchQueue( &Queues[ 0 ], Cpu, 0, TRUE, Cost );
+    }
+
+    Found = SearchQueue( &Queues[ Cpu ], Cpu, 0, FALSE, Cost );
+    FoundCpu = Cpu;
+    LowPriority = (Found >= 0) ? Events[ Found ].Priority + 1 : 0;
+
+    *Cost += 1;
+    PrioritySet = 0;
+    if (LowPriority < MAXIMUM_LEVELS) {
+        PrioritySet = ReadySummary & ~((1 << LowPriority) - 1);
+    }
+
+    for (Priority = MAXIMUM_LEVELS - 1; PrioritySet != 0; Priority -= 1) {
+        if ((PrioritySet & (1 << Priority)) == 0) {
+            continue;
+        }
+
+        PrioritySet &= ~(1 << Priority);
+        ProcessorSet = ReadySet[ Priority ] & ~(1 << Cpu);
+        Other = Cpu;
+        while (ProcessorSet != 0) {
+            Other = (Other + 1) % NumberOfCpus;
+            if ((ProcessorSet & (1 << Other)) == 0) {
+                continue;
+            }
+
+            ProcessorSet &= ~(1 << Other);
+            *Cost += 1;
+            for (Event = Queues[ Other ].Head[ Priority ];
+                 Event >= 0;
+                 Event = Events[ Event ].Next) {
+
+                *Cost += 1;
+                if ((Events[ Event ].Affinity & (1 << Cpu)) != 0) {
+                    break;
+                }
+            }
+
+            if (Event >= 0) {
+                Found = Event;
+                FoundCpu = Other;
+                PrioritySet = 0;
+                break;
+            }
+        }
+    }
+
+    if (Found >= 0) {
+        if (FoundCpu != Cpu) {
+            Results->Steals += 1;
+        }
+
+        SearchQueue( &Queues[ FoundCpu ],
+                     Cpu,
+                     Events[ Found ].Priority,
+                     TRUE,
+                     Cost );
+    }
+
+    return Found;
+}
+
+VOID
+RunThread (
+    ULONG Cpu,
+    LONG Event,
+    ULONG Time,
+    PSIM_RESULTS Results
+    )
+{
+    ULONG Latency;
+
+    Running[ Cpu ] = Event;
+    RunEnd[ Cpu ] = Time + Events[ Event ].RunTime;
+    Latency = Time - Events[ Event ].ReadyTime;
+    Results->Dispatches += 1;
+    Results->TotalLatency += Latency;
+    if (Latency > Results->MaximumLatency) {
+        Results->MaximumLatency = Latency;
+    }
+}
+
+VOID
+Simulate (
+    BOOLEAN PerCpu,
+    PSIM_RESULTS Results
+    )
+
+/*++
+
+Routine Description:
+
+    This function replays the trace against one model.  A processor whose
+    thread waits searches the ready queues for the next thread, and goes
+    idle if there is none.  An idle processor does not search the ready
+    queues, it runs the thread that is handed to it when one is readied.
+
+--*/
+
+{
+    ULONG Cost;
+    ULONG Cpu;
+    LONG Event;
+    ULONG NextEvent;
+    ULONG Pending;
+    ULONG Time;
+
+    RtlZeroMemory( Results, sizeof(SIM_RESULTS) );
+    RtlZeroMemory( ReadySet, sizeof(ReadySet) );
+    ReadySummary = 0;
+    for (Cpu = 0; Cpu < NumberOfCpus; Cpu += 1) {
+        InitializeQueue( &Queues[ Cpu ] );
+        Running[ Cpu ] = -1;
+        NextThread[ Cpu ] = -1;
+    }
+
+    NextEvent = 0;
+    Pending = NumberOfEvents;
+    for (Time = 0; Pending != 0; Time += 1) {
+
+        //
+        // Threads that have used up their run time wait, and the processor
+        // selects the next thread to run.
+        //
+
+        for (Cpu = 0; Cpu < NumberOfCpus; Cpu += 1) {
+            if ((Running[ Cpu ] < 0) || (RunEnd[ Cpu ] > Time)) {
+                continue;
+            }
+
+            Running[ Cpu ] = -1;
+            Pending -= 1;
+
+            Cost = 0;
+            Event = FindReadyThread( Cpu, PerCpu, &Cost, Results );
+            Results->TotalCost += Cost;
+            Results->Operations += 1;
+            if (Cost > Results->MaximumCost) {
+                Results->MaximumCost = Cost;
+            }
+
+            if (Event >= 0) {
+                RunThread( Cpu, Event, Time, Results );
+            }
+        }
+
+        //
+        // Ready the threads whose events are due.
+        //
+
+        while ((NextEvent < NumberOfEvents) &&
+               (Events[ NextEvent ].ReadyTime <= Time)) {
+
+            Cost = 0;
+            ReadyThread( NextEvent, PerCpu, &Cost );
+            Results->TotalCost += Cost;
+            Results->Operations += 1;
+            if (Cost > Results->MaximumCost) {
+                Results->MaximumCost = Cost;
+            }
+
+            NextEvent += 1;
+        }
+
+        //
+        // Idle processors run the threads handed to them.
+        //
+
+        for (Cpu = 0; Cpu < NumberOfCpus; Cpu += 1) {
+            if (NextThread[ Cpu ] >= 0) {
+                RunThread( Cpu, NextThread[ Cpu ], Time, Results );
+                NextThread[ Cpu ] = -1;
+            }
+        }
+    }
+
+    Results->EndTime = Time;
+}
+
+BOOLEAN
+ReadTrace (
+    char *FileName
+    )
+{
+    ULONG Affinity;
+    ULONG Allocated;
+    FILE *File;
+    char Line[ 256 ];
+    ULONG Priority;
+    ULONG RunTime;
+    ULONG Thread;
+    ULONG Time;
+    ULONG LastTime = 0;
+    ULONG Mask;
+
+    File = fopen( FileName, "r" );
+    if (File == NULL) {
+        printf("Unable to open %s\n", FileName);
+        return FALSE;
+    }
+
+    Mask = (NumberOfCpus == 32) ? 0xffffffff : ((1 << NumberOfCpus) - 1);
+    Allocated = 0;
+    NumberOfEvents = 0;
+    while (fgets( Line, sizeof(Line), File ) != NULL) {
+        if ((Line[0] == '#') ||
+            (sscanf( Line, "%lu %lu %lu %lx %lu", &Time, &Thread, &Priority, &Affinity, &RunTime ) != 5)) {
+            continue;
+        }
+
+        if ((Time < LastTime) ||
+            (Priority >= MAXIMUM_LEVELS) ||
+            ((Affinity & Mask) == 0)) {
+            printf("Bad trace event: %s", Line);
+            fclose( File );
+            return FALSE;
+        }
+
+        if (NumberOfEvents == Allocated) {
+            Allocated = (Allocated == 0) ? 1024 : Allocated * 2;
+            Events = realloc( Events, Allocated * sizeof(SIM_THREAD) );
+            if (Events == NULL) {
+                printf("Unable to allocate trace events\n");
+                fclose( File );
+                return FALSE;
+            }
+        }
+
+        LastTime = Time;
+        Events[ NumberOfEvents ].Thread = Thread;
+        Events[ NumberOfEvents ].Priority = Priority;
+        Events[ NumberOfEvents ].Affinity = Affinity & Mask;
+        Events[ NumberOfEvents ].ReadyTime = Time;
+        Events[ NumberOfEvents ].RunTime = (RunTime == 0) ? 1 : RunTime;
+        NumberOfEvents += 1;
+    }
+
+    fclose( File );
+    return TRUE;
+}
+
+BOOLEAN
+GenerateTrace (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function generates a trace that keeps the processors about ninety
+    percent busy, with bursts of ready events.  Most threads may run on any
+    processor, one in eight is bound to a single processor.
+
+--*/
+
+{
+    ULONG Index;
+    ULONG Time;
+
+    NumberOfEvents = SYNTHETIC_EVENTS;
+    Events = malloc( NumberOfEvents * sizeof(SIM_THREAD) );
+    if (Events == NULL) {
+        printf("Unable to allocate trace events\n");
+        return FALSE;
+    }
+
+    srand( 1 );
+    Time = 0;
+    for (Index = 0; Index < NumberOfEvents; Index += 1) {
+        Time += rand() % 3;
+        if ((rand() % 10) == 0) {
+            Time += 1;
+        }
+
+        Events[ Index ].Thread = rand() % SYNTHETIC_THREADS;
+        Events[ Index ].Priority = 1 + (rand() % 15);
+        if ((rand() % 8) == 0) {
+            Events[ Index ].Affinity = 1 << (Events[ Index ].Thread % NumberOfCpus);
+
+        } else {
+            Events[ Index ].Affinity = (NumberOfCpus == 32) ?
+                                            0xffffffff : ((1 << NumberOfCpus) - 1);
+        }
+
+        Events[ Index ].ReadyTime = Time;
+        Events[ Index ].RunTime = 1 + (rand() % ((2 * NumberOfCpus) - 1));
+    }
+
+    return TRUE;
+}
+
+VOID
+PrintResults (
+    char *Model,
+    PSIM_RESULTS Results
+    )
+{
+    ULONG Dispatches = (Results->Dispatches == 0) ? 1 : Results->Dispatches;
+    ULONG Operations = (Results->Operations == 0) ? 1 : Results->Operations;
+
+    printf("%-12s %10d %8d %8d.%02d %8d %8d.%02d %8d\n",
+           Model,
+           Results->Dispatches,
+           Results->Steals,
+           Results->TotalLatency / Dispatches,
+           ((Results->TotalLatency % Dispatches) * 100) / Dispatches,
+           Results->MaximumLatency,
+           Results->TotalCost / Operations,
+           ((Results->TotalCost % Operations) * 100) / Operations,
+           Results->MaximumCost);
+}
+
+int
+_CDECL
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    SIM_RESULTS Results;
+
+    NumberOfCpus = 4;
+    if (argc > 1) {
+        NumberOfCpus = atoi( argv[1] );
+        if ((NumberOfCpus == 0) || (NumberOfCpus > MAXIMUM_CPUS)) {
+            NumberOfCpus = MAXIMUM_CPUS;
+        }
+    }
+
+    if (argc > 2) {
+        if (!ReadTrace( argv[2] )) {
+            return 1;
+        }
+
+    } else if (!GenerateTrace()) {
+        return 1;
+    }
+
+    printf("%d processors, %d ready events\n", NumberOfCpus, NumberOfEvents);
+    printf("Latency is in ticks, lock cost in entries examined per operation\n");
+    printf("Model        Dispatches   Steals  Latency  Maximum LockCost  Maximum\n");
+
+    Simulate( FALSE, &Results );
+    PrintResults( "Global", &Results );
+
+    Simulate( TRUE, &Results );
+    PrintResults( "PerProcessor", &Results );
+
+    return 0;
+}
@@ -0,0 +1,459 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    timerwhl.c
+
+Abstract:
+
+    Benchmark for the timer table and the timer wheel.  The program runs a
+    tick by tick simulation of a large number of outstanding timers against
+    two models and reports the cost of the timer expiration DPC and of timer
+    insertion, counted as the number of timer list entries examined or moved
+    with the dispatcher lock held.
+
+    The first model is the flat timer table alone.  Every timer is inserted
+    in sorted order in the timer table list selected by its due tick, so
+    long period timers share the lists with short period timers.
+
+    The second model is the timer table with the timer wheel.  Only timers
+    that are due within the ticks that have been cascaded are inserted in
+    the timer table, other timers are inserted at the tail of a wheel slot
+    list, and the wheel is cascaded one trip through the timer table ahead
+    of the current tick.
+
+    Most of the timers are long period timers, the rest are short timeouts.
+    Every timer is reset with a new interval of its kind when it expires,
+    and a number of short timers are canceled and reset every tick, the way
+    wait timeouts are.  The expiration DPC cost includes reinserting the
+    expired timers.
+
+    Usage: timerwhl [ NumberOfTimers [ NumberOfTicks ] ]
+
+Environment:
+
+    User mode.
+
+Revision History:
+
+--*/
+
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TABLE_SHIFT 7
+#define TABLE_SIZE (1 << TABLE_SHIFT)
+
+#define WHEEL_LEVELS 3
+#define WHEEL_SHIFT 6
+#define WHEEL_SIZE (1 << WHEEL_SHIFT)
+#define WHEEL_OVERFLOW (WHEEL_LEVELS * WHEEL_SIZE)
+#define WHEEL_LIST_SIZE (WHEEL_OVERFLOW + 1)
+
+#define SHORT_PERCENT 30
+#define SHORT_INTERVAL 200
+#define LONG_MINIMUM 3000
+#define LONG_INTERVAL 60000
+#define RESETS_PER_TICK 200
+
+typedef struct _SIM_LIST {
+    struct _SIM_LIST *Flink;
+    struct _SIM_LIST *Blink;
+} SIM_LIST, *PSIM_LIST;
+
+typedef struct _SIM_TIMER {
+    SIM_LIST ListEntry;
+    ULONG DueTick;
+    BOOLEAN Short;
+} SIM_TIMER, *PSIM_TIMER;
+
+typedef struct _SIM_RESULTS {
+    ULONG Inserts;
+    ULONG InsertCost;
+    ULONG MaximumInsertCost;
+    ULONG Expirations;
+    ULONG ExpireCost;
+    ULONG MaximumExpireCost;
+    ULONG CascadeCost;
+} SIM_RESULTS, *PSIM_RESULTS;
+
+PSIM_TIMER Timers;
+ULONG NumberOfTimers;
+ULONG NumberOfTicks;
+
+SIM_LIST TableListHead[ TABLE_SIZE ];
+SIM_LIST WheelListHead[ WHEEL_LIST_SIZE ];
+ULONG WheelTick;
+BOOLEAN UseWheel;
+PSIM_RESULTS Results;
+
+VOID
+InitializeList (
+    PSIM_LIST ListHead
+    )
+{
+    ListHead->Flink = ListHead;
+    ListHead->Blink = ListHead;
+}
+
+VOID
+InsertAfter (
+    PSIM_LIST Entry,
+    PSIM_LIST NewEntry
+    )
+{
+    NewEntry->Flink = Entry->Flink;
+    NewEntry->Blink = Entry;
+    Entry->Flink->Blink = NewEntry;
+    Entry->Flink = NewEntry;
+}
+
+VOID
+RemoveEntry (
+    PSIM_LIST Entry
+    )
+{
+    Entry->Blink->Flink = Entry->Flink;
+    Entry->Flink->Blink = Entry->Blink;
+}
+
+ULONG
+RandomInterval (
+    BOOLEAN Short
+    )
+{
+    ULONG Random = (rand() << 15) | rand();
+
+    if (Short) {
+        return 1 + (Random % SHORT_INTERVAL);
+    }
+
+    return LONG_MINIMUM + (Random % LONG_INTERVAL);
+}
+
+ULONG
+InsertTable (
+    PSIM_TIMER Timer
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts a timer in sorted order in its timer table list,
+    searching from the back of the list forward as KiInsertTimerTable does.
+
+Return Value:
+
+    The number of entries examined.
+
+--*/
+
+{
+    ULONG Cost = 1;
+    PSIM_LIST ListHead = &TableListHead[ Timer->DueTick & (TABLE_SIZE - 1) ];
+    PSIM_LIST NextEntry = ListHead->Blink;
+
+    while (NextEntry != ListHead) {
+        Cost += 1;
+        if (Timer->DueTick >= CONTAINING_RECORD( NextEntry, SIM_TIMER, ListEntry )->DueTick) {
+            break;
+        }
+
+        NextEntry = NextEntry->Blink;
+    }
+
+    InsertAfter( NextEntry, &Timer->ListEntry );
+    return Cost;
+}
+
+ULONG
+InsertTimer (
+    PSIM_TIMER Timer
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts a timer in the timer table, or in the timer wheel
+    if the wheel is used and the timer is due beyond the ticks that have been
+    cascaded, the same way as KiInsertTimerWheel.
+
+Return Value:
+
+    The number of entries examined.
+
+--*/
+
+{
+    ULONG Level;
+    PSIM_LIST ListHead;
+    ULONG Shift;
+
+    if ((UseWheel == FALSE) || (Timer->DueTick < WheelTick)) {
+        return InsertTable( Timer );
+    }
+
+    ListHead = &WheelListHead[ WHEEL_OVERFLOW ];
+    Shift = TABLE_SHIFT;
+    for (Level = 0; Level < WHEEL_LEVELS; Level += 1) {
+        if (((Timer->DueTick >> Shift) - (WheelTick >> Shift)) < WHEEL_SIZE) {
+            ListHead = &WheelListHead[ (Level * WHEEL_SIZE) +
+                                       ((Timer->DueTick >> Shift) & (WHEEL_SIZE - 1)) ];
+            break;
+        }
+
+        Shift += WHEEL_SHIFT;
+    }
+
+    InsertAfter( ListHead->Blink, &Timer->ListEntry );
+    return 1;
+}
+
+VOID
+SetTimer (
+    PSIM_TIMER Timer,
+    ULONG Tick,
+    PULONG Cost
+    )
+{
+    ULONG InsertCost;
+
+    Timer->DueTick = Tick + RandomInterval( Timer->Short );
+    InsertCost = InsertTimer( Timer );
+    Results->Inserts += 1;
+    Results->InsertCost += InsertCost;
+    if (InsertCost > Results->MaximumInsertCost) {
+        Results->MaximumInsertCost = InsertCost;
+    }
+
+    *Cost += InsertCost;
+}
+
+ULONG
+CascadeWheel (
+    ULONG Tick
+    )
+
+/*++
+
+Routine Description:
+
+    This function cascades the timer wheel until the first tick that has not
+    been cascaded is more than one trip through the timer table past the
+    current tick, the same way as KiCascadeTimerWheel.
+
+Return Value:
+
+    The number of entries moved and examined.
+
+--*/
+
+{
+    SIM_LIST CascadeListHead;
+    ULONG Cost = 0;
+    ULONG Level;
+    PSIM_LIST ListHead;
+    ULONG Shift;
+    ULONG Slot;
+
+    while (WheelTick <= Tick + TABLE_SIZE) {
+        InitializeList( &CascadeListHead );
+        Shift = TABLE_SHIFT;
+        Level = 0;
+        do {
+            Slot = (Level * WHEEL_SIZE) + ((WheelTick >> Shift) & (WHEEL_SIZE - 1));
+            ListHead = &WheelListHead[ Slot ];
+            while (ListHead->Flink != ListHead) {
+                PSIM_LIST Entry = ListHead->Flink;
+
+                RemoveEntry( Entry );
+                InsertAfter( CascadeListHead.Blink, Entry );
+            }
+
+            Level += 1;
+            Shift += WHEEL_SHIFT;
+        } while ((Level < WHEEL_LEVELS) && ((WheelTick & ((1 << Shift) - 1)) == 0));
+
+        if ((Level == WHEEL_LEVELS) && ((WheelTick & ((1 << Shift) - 1)) == 0)) {
+            ListHead = &WheelListHead[ WHEEL_OVERFLOW ];
+            while (ListHead->Flink != ListHead) {
+                PSIM_LIST Entry = ListHead->Flink;
+
+                RemoveEntry( Entry );
+                InsertAfter( CascadeListHead.Blink, Entry );
+            }
+        }
+
+        WheelTick += TABLE_SIZE;
+        while (CascadeListHead.Flink != &CascadeListHead) {
+            PSIM_LIST Entry = CascadeListHead.Flink;
+
+            RemoveEntry( Entry );
+            Cost += InsertTimer( CONTAINING_RECORD( Entry, SIM_TIMER, ListEntry ) );
+        }
+    }
+
+    return Cost;
+}
+
+VOID
+Simulate (
+    BOOLEAN Wheel,
+    PSIM_RESULTS SimResults
+    )
+{
+    ULONG Cost;
+    SIM_LIST ExpiredListHead;
+    ULONG Index;
+    PSIM_LIST ListHead;
+    PSIM_TIMER Timer;
+    ULONG Tick;
+
+    UseWheel = Wheel;
+    Results = SimResults;
+    RtlZeroMemory( Results, sizeof(SIM_RESULTS) );
+    for (Index = 0; Index < TABLE_SIZE; Index += 1) {
+        InitializeList( &TableListHead[ Index ] );
+    }
+
+    for (Index = 0; Index < WHEEL_LIST_SIZE; Index += 1) {
+        InitializeList( &WheelListHead[ Index ] );
+    }
+
+    WheelTick = 2 * TABLE_SIZE;
+    srand( 1 );
+    for (Index = 0; Index < NumberOfTimers; Index += 1) {
+        Timers[ Index ].Short = (BOOLEAN)((rand() % 100) < SHORT_PERCENT);
+        Cost = 0;
+        SetTimer( &Timers[ Index ], 0, &Cost );
+    }
+
+    for (Tick = 1; Tick <= NumberOfTicks; Tick += 1) {
+
+        //
+        // Wait timeouts that are satisfied cancel and reset their timers.
+        //
+
+        for (Index = 0; Index < RESETS_PER_TICK; Index += 1) {
+            Timer = &Timers[ ((rand() << 15) | rand()) % NumberOfTimers ];
+            if (Timer->Short) {
+                Cost = 0;
+                RemoveEntry( &Timer->ListEntry );
+                SetTimer( Timer, Tick, &Cost );
+            }
+        }
+
+        //
+        // Run the expiration DPC if the first timer in the current list has
+        // expired or the wheel must be cascaded, as the clock interrupt and
+        // the cascade timer would.
+        //
+
+        ListHead = &TableListHead[ Tick & (TABLE_SIZE - 1) ];
+        if (((ListHead->Flink == ListHead) ||
+             (CONTAINING_RECORD( ListHead->Flink, SIM_TIMER, ListEntry )->DueTick > Tick)) &&
+            ((UseWheel == FALSE) || (Tick < WheelTick - TABLE_SIZE))) {
+            continue;
+        }
+
+        Cost = 0;
+        InitializeList( &ExpiredListHead );
+        while (ListHead->Flink != ListHead) {
+            Cost += 1;
+            Timer = CONTAINING_RECORD( ListHead->Flink, SIM_TIMER, ListEntry );
+            if (Timer->DueTick > Tick) {
+                break;
+            }
+
+            RemoveEntry( &Timer->ListEntry );
+            InsertAfter( ExpiredListHead.Blink, &Timer->ListEntry );
+        }
+
+        if (UseWheel && (Tick >= WheelTick - TABLE_SIZE)) {
+            Index = CascadeWheel( Tick );
+            Results->CascadeCost += Index;
+            Cost += Index;
+        }
+
+        while (ExpiredListHead.Flink != &ExpiredListHead) {
+            Timer = CONTAINING_RECORD( ExpiredListHead.Flink, SIM_TIMER, ListEntry );
+            RemoveEntry( &Timer->ListEntry );
+            Results->Expirations += 1;
+            SetTimer( Timer, Tick, &Cost );
+        }
+
+        Results->ExpireCost += Cost;
+        if (Cost > Results->MaximumExpireCost) {
+            Results->MaximumExpireCost = Cost;
+        }
+    }
+}
+
+VOID
+PrintResults (
+    char *Model,
+    PSIM_RESULTS Results
+    )
+{
+    ULONG Inserts = (Results->Inserts == 0) ? 1 : Results->Inserts;
+
+    printf("%-8s %10d %10d %10d %8d.%02d %8d %10d\n",
+           Model,
+           Results->Expirations,
+           Results->ExpireCost / NumberOfTicks,
+           Results->MaximumExpireCost,
+           Results->InsertCost / Inserts,
+           ((Results->InsertCost % Inserts) * 100) / Inserts,
+           Results->MaximumInsertCost,
+           Results->CascadeCost);
+}
+
+int
+_CDECL
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    SIM_RESULTS SimResults;
+
+    NumberOfTimers = 100000;
+    NumberOfTicks = 5000;
+
+    if (argc > 1) {
+        NumberOfTimers = atoi( argv[1] );
+        if (NumberOfTimers == 0) {
+            NumberOfTimers = 1;
+        }
+    }
+
+    if (argc > 2) {
+        NumberOfTicks = atoi( argv[2] );
+        if (NumberOfTicks == 0) {
+            NumberOfTicks = 1;
+        }
+    }
+
+    Timers = malloc( NumberOfTimers * sizeof(SIM_TIMER) );
+    if (Timers == NULL) {
+        printf("Unable to allocate timers\n");
+        return 1;
+    }
+
+    printf("%d timers, %d ticks, entries examined\n", NumberOfTimers, NumberOfTicks);
+    printf("Model       Expired  DPC/Tick    Maximum   Insert  Maximum    Cascade\n");
+
+    Simulate( FALSE, &SimResults );
+    PrintResults( "Table", &SimResults );
+
+    Simulate( TRUE, &SimResults );
+    PrintResults( "Wheel", &SimResults );
+
+    return 0;
+}
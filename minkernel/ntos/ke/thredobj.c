@@ -1368,12 +1368,8 @@ Return Value:
 
         case Ready:
             if (Thread->ProcessReadyQueue == FALSE) {
-                RemoveEntryList(&Thread->WaitListEntry);
                 ThreadPriority = Thread->Priority;
-                if (IsListEmpty(&KiDispatcherReadyListHead[ThreadPriority]) != FALSE) {
-                    ClearMember(ThreadPriority, KiReadySummary);
-                }
-
+                KiRemoveReadyQueue(Thread, ThreadPriority);
                 KiReadyThread(Thread);
             }
 
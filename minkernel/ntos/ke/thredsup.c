@@ -92,7 +92,8 @@ Return Value:
 
 PKTHREAD
 FASTCALL
-KiFindReadyThread (
+KiSearchReadyQueue (
+    IN PKREADY_QUEUE Queue,
     IN ULONG Processor,
     IN KPRIORITY LowPriority
     )
@@ -101,12 +102,16 @@ KiFindReadyThread (
 
 Routine Description:
 
-    This function searches the dispatcher ready queues from the specified
-    high priority to the specified low priority in an attempt to find a thread
-    that can execute on the specified processor.
+    This function searches the specified set of dispatcher ready queues from
+    the highest priority to the specified low priority in an attempt to find
+    a thread that can execute on the specified processor. The thread is not
+    removed from its ready queue.
 
 Arguments:
 
+    Queue - Supplies a pointer to the set of dispatcher ready queues to
+        search.
+
     Processor - Supplies the number of the processor to find a thread for.
 
     LowPriority - Supplies the lowest priority dispatcher ready queue to
@@ -137,7 +142,10 @@ Return Value:
     // to find a thread that can run on the specified processor.
     //
 
-    PrioritySet = (~((1 << LowPriority) - 1)) & KiReadySummary;
+    PrioritySet = (~((1 << LowPriority) - 1)) & Queue->Summary;
+    if (PrioritySet == 0) {
+        return (PKTHREAD)NULL;
+    }
 
 #if !defined(NT_UP)
 
@@ -146,7 +154,7 @@ Return Value:
 #endif
 
     FindFirstSetLeftMember(PrioritySet, &HighPriority);
-    ListHead = &KiDispatcherReadyListHead[HighPriority];
+    ListHead = &Queue->ListHead[HighPriority];
     PrioritySet <<= (31 - HighPriority);
     while (PrioritySet != 0) {
 
@@ -162,13 +170,7 @@ Return Value:
 
 #if defined(NT_UP)
 
-            Thread = CONTAINING_RECORD(NextEntry, KTHREAD, WaitListEntry);
-            RemoveEntryList(&Thread->WaitListEntry);
-            if (IsListEmpty(ListHead)) {
-                ClearMember(HighPriority, KiReadySummary);
-            }
-
-            return (PKTHREAD)Thread;
+            return CONTAINING_RECORD(NextEntry, KTHREAD, WaitListEntry);
 
 #else
 
@@ -228,23 +230,6 @@ Return Value:
                         }
                     }
 
-                    if (Processor == (ULONG)Thread->IdealProcessor) {
-                        KiIncrementSwitchCounter(FindIdeal);
-
-                    } else if (Processor == (ULONG)Thread->NextProcessor) {
-                        KiIncrementSwitchCounter(FindLast);
-
-                    } else {
-                        KiIncrementSwitchCounter(FindAny);
-                    }
-
-                    Thread->NextProcessor = (CCHAR)Processor;
-
-                    RemoveEntryList(&Thread->WaitListEntry);
-                    if (IsListEmpty(ListHead)) {
-                        ClearMember(HighPriority, KiReadySummary);
-                    }
-
                     return (PKTHREAD)Thread;
                 }
             }
@@ -264,7 +249,161 @@ Return Value:
 
     return (PKTHREAD)NULL;
 }
-
+
+PKTHREAD
+FASTCALL
+KiFindReadyThread (
+    IN ULONG Processor,
+    IN KPRIORITY LowPriority
+    )
+
+/*++
+
+Routine Description:
+
+    This function searches the dispatcher ready queues from the specified
+    high priority to the specified low priority in an attempt to find a thread
+    that can execute on the specified processor.
+
+    The ready queues of the specified processor are searched first. The ready
+    queues of the other processors are then searched for a thread of higher
+    priority than the thread found, or for any thread if no thread was found,
+    that can execute on the specified processor. This lets an idle processor
+    steal work from the other processors while still selecting the highest
+    priority ready thread that can execute on the processor.
+
+    The global ready summary and the ready sets select the priorities and the
+    processors whose ready queues are examined when work is stolen, so the
+    ready queues of the other processors are only examined when they hold a
+    thread of higher priority than the thread found. The time the dispatcher
+    lock is held therefore does not grow with the number of processors when
+    every processor has work of its own.
+
+Arguments:
+
+    Processor - Supplies the number of the processor to find a thread for.
+
+    LowPriority - Supplies the lowest priority dispatcher ready queue to
+        examine.
+
+Return Value:
+
+    If a thread is located that can execute on the specified processor, then
+    the address of the thread object is returned. Otherwise a null pointer is
+    returned.
+
+--*/
+
+{
+
+    ULONG HighPriority;
+    PRLIST_ENTRY ListHead;
+    PRLIST_ENTRY NextEntry;
+    ULONG Number;
+    ULONG PrioritySet;
+    KAFFINITY ProcessorSet;
+    PRKTHREAD Thread;
+    PRKTHREAD Thread1;
+
+    //
+    // Search the ready queues of the specified processor.
+    //
+
+    Thread = KiSearchReadyQueue(&KiReadyQueue[Processor],
+                                Processor,
+                                LowPriority);
+
+#if !defined(NT_UP)
+
+    //
+    // Compute the set of priorities above the priority of the thread found,
+    // or at or above the low priority if no thread was found, at which a
+    // thread is ready on any processor.
+    //
+
+    if (Thread != NULL) {
+        LowPriority = Thread->Priority + 1;
+    }
+
+    PrioritySet = 0;
+    if (LowPriority < MAXIMUM_PRIORITY) {
+        PrioritySet = (~((1 << LowPriority) - 1)) & KiReadySummary;
+    }
+
+    //
+    // Search the ready queues of the other processors from the highest
+    // priority down for a thread that can execute on the specified processor.
+    // At each priority, only the processors whose ready queue of the priority
+    // is not empty are examined, starting with the next processor so the
+    // processors that steal work do not all take it from the same processor.
+    //
+
+    Thread1 = NULL;
+    while ((PrioritySet != 0) && (Thread1 == NULL)) {
+        FindFirstSetLeftMember(PrioritySet, &HighPriority);
+        ClearMember(HighPriority, PrioritySet);
+        ProcessorSet = KiReadySet[HighPriority] & ~(KAFFINITY)(1 << Processor);
+        Number = Processor;
+        while ((ProcessorSet != 0) && (Thread1 == NULL)) {
+            Number += 1;
+            if (Number == (ULONG)KeNumberProcessors) {
+                Number = 0;
+            }
+
+            if ((ProcessorSet & (KAFFINITY)(1 << Number)) == 0) {
+                continue;
+            }
+
+            ClearMember(Number, ProcessorSet);
+            ListHead = &KiReadyQueue[Number].ListHead[HighPriority];
+            NextEntry = ListHead->Flink;
+            while (NextEntry != ListHead) {
+                Thread1 = CONTAINING_RECORD(NextEntry, KTHREAD, WaitListEntry);
+                if ((Thread1->Affinity & (KAFFINITY)(1 << Processor)) != 0) {
+                    break;
+                }
+
+                Thread1 = NULL;
+                NextEntry = NextEntry->Flink;
+            }
+        }
+    }
+
+    if (Thread1 != NULL) {
+        Thread = Thread1;
+    }
+
+#endif
+
+    //
+    // If a thread was found, then remove it from its ready queue and set
+    // its next processor to the specified processor.
+    //
+
+    if (Thread != NULL) {
+        KiRemoveReadyQueue(Thread, Thread->Priority);
+
+#if !defined(NT_UP)
+
+        if (Processor == (ULONG)Thread->IdealProcessor) {
+            KiIncrementSwitchCounter(FindIdeal);
+
+        } else if (Processor == (ULONG)Thread->NextProcessor) {
+            KiIncrementSwitchCounter(FindLast);
+
+        } else {
+            KiIncrementSwitchCounter(FindAny);
+        }
+
+        Thread->NextProcessor = (CCHAR)Processor;
+
+#endif
+
+    }
+
+    return (PKTHREAD)Thread;
+}
+
 VOID
 FASTCALL
 KiReadyThread (
@@ -456,16 +595,7 @@ Return Value:
     //
 
     Thread->State = Ready;
-    if (Preempted != FALSE) {
-        InsertHeadList(&KiDispatcherReadyListHead[ThreadPriority],
-                       &Thread->WaitListEntry);
-
-    } else {
-        InsertTailList(&KiDispatcherReadyListHead[ThreadPriority],
-                       &Thread->WaitListEntry);
-    }
-
-    SetMember(ThreadPriority, KiReadySummary);
+    KiInsertReadyQueue(Thread, ThreadPriority, Preempted);
     return;
 }
 
@@ -633,15 +763,9 @@ Return Value:
 
         case Ready:
             if (Thread->ProcessReadyQueue == FALSE) {
-                RemoveEntryList(&Thread->WaitListEntry);
-                if (IsListEmpty(&KiDispatcherReadyListHead[ThreadPriority])) {
-                    ClearMember(ThreadPriority, KiReadySummary);
-                }
-
+                KiRemoveReadyQueue(Thread, ThreadPriority);
                 if (Priority < ThreadPriority) {
-                    InsertTailList(&KiDispatcherReadyListHead[Priority],
-                                   &Thread->WaitListEntry);
-                    SetMember(Priority, KiReadySummary);
+                    KiInsertReadyQueue(Thread, Priority, FALSE);
 
                 } else {
                     KiReadyThread(Thread);
@@ -832,6 +956,8 @@ Return Value:
 {
 
     ULONG Index;
+    ULONG Number;
+    ULONG QueueSummary;
     ULONG Summary;
     PKTHREAD Thread;
 
@@ -844,18 +970,45 @@ Return Value:
     if (InitializationPhase == 2) {
 
         //
-        // Scan the ready queues and compute the ready summary.
+        // Scan the ready queues of each processor and compute the ready
+        // summary of the processor.
         //
 
         Summary = 0;
-        for (Index = 0; Index < MAXIMUM_PRIORITY; Index += 1) {
-            if (IsListEmpty(&KiDispatcherReadyListHead[Index]) == FALSE) {
-                Summary |= (1 << Index);
+        for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+            QueueSummary = 0;
+            for (Index = 0; Index < MAXIMUM_PRIORITY; Index += 1) {
+                if (IsListEmpty(&KiReadyQueue[Number].ListHead[Index]) == FALSE) {
+                    QueueSummary |= (1 << Index);
+                }
+            }
+
+            //
+            // If the computed summary does not agree with the current ready
+            // summary, then break into the debugger.
+            //
+
+            if (QueueSummary != KiReadyQueue[Number].Summary) {
+                DbgBreakPoint();
+            }
+
+            //
+            // If the ready sets do not agree with the computed summary,
+            // then break into the debugger.
+            //
+
+            for (Index = 0; Index < MAXIMUM_PRIORITY; Index += 1) {
+                if (((KiReadySet[Index] >> Number) & 1) !=
+                    ((QueueSummary >> Index) & 1)) {
+                    DbgBreakPoint();
+                }
             }
+
+            Summary |= QueueSummary;
         }
 
         //
-        // If the computed summary does not agree with the current ready
+        // If the computed summary does not agree with the global ready
         // summary, then break into the debugger.
         //
 
@@ -9,7 +9,8 @@ Module Name:
 Abstract:
 
     This module contains the support routines for the timer object. It
-    contains functions to insert and remove from the timer queue.
+    contains functions to insert and remove from the timer queue and to
+    cascade the timer wheel into the timer table.
 
 Author:
 
@@ -36,6 +37,26 @@ KiInsertTimerTable (
     LARGE_INTEGER CurrentTime,
     IN PRKTIMER Timer
     );
+
+LOGICAL
+FASTCALL
+KiInsertTimerWheel (
+    IN PRKTIMER Timer
+    );
+
+VOID
+KiSetTimerWheelTimer (
+    VOID
+    );
+
+//
+// Define macro to compute the tick at which a time occurs.
+//
+
+#define KiComputeTimerTick(Time)                                            \
+    ((ULONGLONG)RtlExtendedMagicDivide(*(PLARGE_INTEGER)&(Time),            \
+                                       KiTimeIncrementReciprocal,           \
+                                       KiTimeIncrementShiftCount).QuadPart)
 
 LOGICAL
 FASTCALL
@@ -225,6 +246,17 @@ Return Value:
 
     Index = KiComputeTimerTableIndex(Interval, CurrentTime, Timer);
 
+    //
+    // If the timer is due beyond the ticks that have been cascaded into the
+    // timer table, then insert the timer in the timer wheel. Timers in the
+    // timer wheel are not examined by the clock interrupt or the timer
+    // expiration DPC until they are cascaded into the timer table.
+    //
+
+    if (KiInsertTimerWheel(Timer) != FALSE) {
+        return TRUE;
+    }
+
     //
     // If the timer is due before the first entry in the computed list
     // or the computed list is empty, then insert the timer at the front
@@ -304,3 +336,266 @@ Return Value:
 
     return Timer->Header.Inserted;
 }
+
+LOGICAL
+FASTCALL
+KiInsertTimerWheel (
+    IN PRKTIMER Timer
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts a timer object in the timer wheel if the timer is
+    due beyond the ticks that have been cascaded into the timer table. The
+    timer is inserted at the tail of the slot list of the first level that
+    covers the due tick, or in the overflow list.
+
+    If the timer wheel has not been started, then it is started.
+
+    N.B. This routine assumes that the dispatcher data lock has been acquired.
+
+Arguments:
+
+    Timer - Supplies a pointer to a dispatcher object of type timer. The
+        due time of the timer must have been set.
+
+Return Value:
+
+    If the timer is inserted in the timer wheel, then a value of TRUE is
+    returned. Otherwise, a value of FALSE is returned and the timer must
+    be inserted in the timer table.
+
+--*/
+
+{
+
+    LARGE_INTEGER CurrentTime;
+    ULONG Level;
+    ULONG Shift;
+    ULONGLONG Tick;
+
+    //
+    // If the timer wheel has not been started, then start it unless the
+    // timer increment reciprocal has not been computed yet or the timer is
+    // the timer wheel cascade timer.
+    //
+    // The first wheel tick is at least one trip through the timer table
+    // past the current tick so the cascade timer is due in the future.
+    //
+
+    if (KiTimerWheelTick == 0) {
+        if ((KiTimeIncrementReciprocal.QuadPart == 0) ||
+            (Timer == &KiTimerWheelTimer)) {
+            return FALSE;
+        }
+
+        KiQueryInterruptTime(&CurrentTime);
+        Tick = KiComputeTimerTick(CurrentTime);
+        KiTimerWheelTick = ((Tick >> TIMER_TABLE_SHIFT) + 2) << TIMER_TABLE_SHIFT;
+
+        KiSetTimerWheelTimer();
+    }
+
+    //
+    // If the timer is due before the first tick that has not been cascaded
+    // into the timer table, then it belongs in the timer table.
+    //
+
+    Tick = KiComputeTimerTick(Timer->DueTime);
+    if (Tick < KiTimerWheelTick) {
+        return FALSE;
+    }
+
+    //
+    // Insert the timer in the first level whose span from the current wheel
+    // slot covers the due tick, or in the overflow list if no level does.
+    //
+
+    Shift = TIMER_TABLE_SHIFT;
+    for (Level = 0; Level < TIMER_WHEEL_LEVELS; Level += 1) {
+        if (((Tick >> Shift) - (KiTimerWheelTick >> Shift)) < TIMER_WHEEL_SIZE) {
+            InsertTailList(&KiTimerWheelListHead[(Level * TIMER_WHEEL_SIZE) +
+                                ((ULONG)(Tick >> Shift) & (TIMER_WHEEL_SIZE - 1))],
+                           &Timer->TimerListEntry);
+
+            return TRUE;
+        }
+
+        Shift += TIMER_WHEEL_SHIFT;
+    }
+
+    InsertTailList(&KiTimerWheelListHead[TIMER_WHEEL_OVERFLOW],
+                   &Timer->TimerListEntry);
+
+    return TRUE;
+}
+
+VOID
+KiSetTimerWheelTimer (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts the timer wheel cascade timer in the timer table.
+    The timer is due one trip through the timer table before the first tick
+    that has not been cascaded into the timer table. If that time has already
+    passed, then the timer is due at the next tick.
+
+    N.B. This routine assumes that the dispatcher data lock has been acquired.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LARGE_INTEGER CurrentTime;
+    LARGE_INTEGER Interval;
+
+    do {
+        KiTimerWheelTimer.Header.Inserted = TRUE;
+        KiQueryInterruptTime(&CurrentTime);
+        Interval.QuadPart = CurrentTime.QuadPart -
+            (LONGLONG)((KiTimerWheelTick - TIMER_TABLE_SIZE) * KeMaximumIncrement);
+
+        if (Interval.QuadPart >= 0) {
+            Interval.QuadPart = - (LONG)KeMaximumIncrement;
+        }
+
+    } while (KiInsertTimerTable(Interval, CurrentTime, &KiTimerWheelTimer) == FALSE);
+
+    return;
+}
+
+VOID
+FASTCALL
+KiCascadeTimerWheel (
+    IN ULARGE_INTEGER CurrentTime,
+    IN PLIST_ENTRY ExpiredListHead
+    )
+
+/*++
+
+Routine Description:
+
+    This function is called by the timer expiration DPC when the timer wheel
+    cascade timer expires. The timer wheel is cascaded one trip through the
+    timer table at a time until the first tick that has not been cascaded is
+    more than one trip through the timer table past the current tick.
+
+    Each cascade advances the wheel tick by one trip through the timer table
+    and reinserts the timers from the current first level slot, from the
+    current slots of the higher levels whose slot boundary has been reached,
+    and from the overflow list if the last level has wrapped. Reinserted
+    timers move to the timer table or to a lower level, so each timer is
+    reinserted at most once per level.
+
+    N.B. This routine assumes that the dispatcher data lock has been acquired.
+
+Arguments:
+
+    CurrentTime - Supplies the current interrupt time.
+
+    ExpiredListHead - Supplies a pointer to the list of expired timers. Timers
+        that have already expired when they are cascaded are inserted at the
+        tail of this list.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LIST_ENTRY CascadeListHead;
+    ULONGLONG CurrentTick;
+    LARGE_INTEGER Interval;
+    ULONG Level;
+    PLIST_ENTRY ListHead;
+    ULONG Shift;
+    PKTIMER Timer;
+    ULONGLONG WheelTick;
+
+    CurrentTick = KiComputeTimerTick(CurrentTime);
+    InitializeListHead(&CascadeListHead);
+    do {
+
+        //
+        // Move the timers from the current first level slot and from the
+        // current slot of each higher level whose slot boundary has been
+        // reached to the cascade list.
+        //
+
+        WheelTick = KiTimerWheelTick;
+        Shift = TIMER_TABLE_SHIFT;
+        Level = 0;
+        do {
+            ListHead = &KiTimerWheelListHead[(Level * TIMER_WHEEL_SIZE) +
+                            ((ULONG)(WheelTick >> Shift) & (TIMER_WHEEL_SIZE - 1))];
+
+            while (ListHead->Flink != ListHead) {
+                InsertTailList(&CascadeListHead, RemoveHeadList(ListHead));
+            }
+
+            Level += 1;
+            Shift += TIMER_WHEEL_SHIFT;
+        } while ((Level < TIMER_WHEEL_LEVELS) &&
+                 ((WheelTick & ((1 << Shift) - 1)) == 0));
+
+        //
+        // If the last level has wrapped, then move the overflow list to the
+        // cascade list.
+        //
+
+        if ((Level == TIMER_WHEEL_LEVELS) &&
+            ((WheelTick & ((1 << Shift) - 1)) == 0)) {
+            ListHead = &KiTimerWheelListHead[TIMER_WHEEL_OVERFLOW];
+            while (ListHead->Flink != ListHead) {
+                InsertTailList(&CascadeListHead, RemoveHeadList(ListHead));
+            }
+        }
+
+        //
+        // Advance the wheel tick and reinsert the cascaded timers. If a
+        // timer has already expired, then insert the timer in the expired
+        // timer list.
+        //
+
+        KiTimerWheelTick = WheelTick + TIMER_TABLE_SIZE;
+        while (CascadeListHead.Flink != &CascadeListHead) {
+            Timer = CONTAINING_RECORD(RemoveHeadList(&CascadeListHead),
+                                      KTIMER,
+                                      TimerListEntry);
+
+            Interval.QuadPart = CurrentTime.QuadPart - Timer->DueTime.QuadPart;
+            if ((Interval.QuadPart >= 0) ||
+                (KiInsertTimerTable(Interval,
+                                    *(PLARGE_INTEGER)&CurrentTime,
+                                    Timer) == FALSE)) {
+
+                Timer->Header.Inserted = TRUE;
+                InsertTailList(ExpiredListHead, &Timer->TimerListEntry);
+            }
+        }
+
+    } while (KiTimerWheelTick <= (CurrentTick + TIMER_TABLE_SIZE));
+
+    //
+    // Reinsert the timer wheel cascade timer for the next cascade.
+    //
+
+    KiSetTimerWheelTimer();
+    return;
+}
@@ -74,6 +74,82 @@ Revision History:
         WaitStatus = STATUS_USER_APC; \
         break; \
     }
+
+//
+// Test whether a dispatcher object can satisfy a wait without blocking.
+//
+// N.B. This is only used while spinning without the dispatcher database
+//      locked and is therefore only a hint.
+//
+
+#define KiIsObjectAvailable(Objectx, Thread) \
+    ((*((volatile LONG *)&(Objectx)->Header.SignalState) > 0) || \
+     (((Objectx)->Header.Type == MutantObject) && \
+      (*((PKTHREAD volatile *)&(Objectx)->OwnerThread) == (Thread))))
+
+//
+// Test whether adaptive spinning should be attempted before the dispatcher
+// database is locked. Spinning is pointless on a uniprocessor, is not done
+// at DISPATCH_LEVEL, and is not done for a wait with a zero timeout.
+//
+
+#define KiShouldSpinOnWait(Timeout) \
+    ((KiWaitSpinLimit != 0) && (KeNumberProcessors > 1) && \
+     (KeGetCurrentIrql() < DISPATCH_LEVEL) && \
+     ((!ARGUMENT_PRESENT(Timeout)) || \
+      ((Timeout)->LowPart | (Timeout)->HighPart)))
+
+//
+// Record the outcome of a wait that spun or blocked.
+//
+
+#define RecordWaitOutcome() \
+    if (Spun || Blocked) { \
+        KiRecordWaitOutcome(Spun, Blocked, StartTime, WaitStatus); \
+    }
+
+//
+// Test whether a wait status indicates that the wait was satisfied, as
+// opposed to a timeout, an alert, or a user APC.
+//
+
+#define KiIsWaitSatisfied(WaitStatus) ((ULONG)(WaitStatus) < STATUS_USER_APC)
+
+//
+// Query the time used to measure wait latency. The time is always read
+// from the performance counter so the latency histograms are in the same
+// unit on every processor and platform.
+//
+
+#define KiQueryWaitTime() ((ULONGLONG)KeQueryPerformanceCounter(NULL).QuadPart)
+
+BOOLEAN
+KiAreWaitObjectsAvailable (
+    IN ULONG Count,
+    IN PVOID Object[],
+    IN WAIT_TYPE WaitType,
+    IN PRKTHREAD Thread
+    );
+
+BOOLEAN
+KiSpinOnWaitObjects (
+    IN ULONG Count,
+    IN PVOID Object[],
+    IN WAIT_TYPE WaitType,
+    IN PRKTHREAD Thread
+    );
+
+VOID
+KiRecordWaitOutcome (
+    IN BOOLEAN Spun,
+    IN BOOLEAN Blocked,
+    IN ULONGLONG StartTime,
+    IN NTSTATUS WaitStatus
+    );
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, KeGetWaitSpinInformation)
+#endif
 
 NTSTATUS
 KeDelayExecutionThread (
@@ -532,18 +608,45 @@ Return Value:
     BOOLEAN WaitSatisfied;
     NTSTATUS WaitStatus;
     PKWAIT_BLOCK WaitTimer;
+    BOOLEAN Spun;
+    BOOLEAN Blocked;
+    ULONGLONG StartTime;
+
+    //
+    // If wait latency is being measured, then capture the start time.
+    //
+
+    Spun = FALSE;
+    Blocked = FALSE;
+    StartTime = 0;
+    if (KiWaitLatencyHistogram != 0) {
+        StartTime = KiQueryWaitTime();
+    }
 
     //
     // If the dispatcher database lock is not already held, then set the wait
     // IRQL and lock the dispatcher database. Else set boolean wait variable
     // to FALSE.
     //
+    // If adaptive spinning is enabled, then spin briefly before locking the
+    // dispatcher database in case another processor is about to signal the
+    // objects.
+    //
 
     Thread = KeGetCurrentThread();
     if (Thread->WaitNext) {
         Thread->WaitNext = FALSE;
 
     } else {
+
+#if !defined(NT_UP)
+
+        if (KiShouldSpinOnWait(Timeout)) {
+            Spun = KiSpinOnWaitObjects(Count, Object, WaitType, Thread);
+        }
+
+#endif
+
         KiLockDispatcherDatabase(&Thread->WaitIrql);
     }
 
@@ -645,6 +748,7 @@ Return Value:
                                 KiWaitSatisfyMutant(Objectx, Thread);
                                 WaitStatus = (NTSTATUS)(Index) | Thread->WaitStatus;
                                 KiUnlockDispatcherDatabase(Thread->WaitIrql);
+                                RecordWaitOutcome();
                                 return WaitStatus;
 
                             } else {
@@ -660,8 +764,10 @@ Return Value:
 
                     } else if (Objectx->Header.SignalState > 0) {
                         KiWaitSatisfyOther(Objectx);
+                        WaitStatus = (NTSTATUS)(Index);
                         KiUnlockDispatcherDatabase(Thread->WaitIrql);
-                        return (NTSTATUS)(Index);
+                        RecordWaitOutcome();
+                        return WaitStatus;
                     }
 
                 } else {
@@ -814,6 +920,7 @@ Return Value:
             ASSERT(Thread->WaitIrql <= DISPATCH_LEVEL);
 
             WaitStatus = KiSwapThread();
+            Blocked = TRUE;
 
             //
             // If the thread was not awakened to deliver a kernel mode APC,
@@ -821,6 +928,7 @@ Return Value:
             //
 
             if (WaitStatus != STATUS_KERNEL_APC) {
+                RecordWaitOutcome();
                 return WaitStatus;
             }
 
@@ -848,6 +956,7 @@ Return Value:
     //
 
     KiUnlockDispatcherDatabase(Thread->WaitIrql);
+    RecordWaitOutcome();
     return WaitStatus;
 }
 
@@ -910,6 +1019,9 @@ Return Value:
     PKWAIT_BLOCK WaitBlock;
     NTSTATUS WaitStatus;
     PKWAIT_BLOCK WaitTimer;
+    BOOLEAN Spun;
+    BOOLEAN Blocked;
+    ULONGLONG StartTime;
 
     //
     // Collect call data.
@@ -921,17 +1033,41 @@ Return Value:
 
 #endif
 
+    //
+    // If wait latency is being measured, then capture the start time.
+    //
+
+    Spun = FALSE;
+    Blocked = FALSE;
+    StartTime = 0;
+    if (KiWaitLatencyHistogram != 0) {
+        StartTime = KiQueryWaitTime();
+    }
+
     //
     // If the dispatcher database lock is not already held, then set the wait
     // IRQL and lock the dispatcher database. Else set boolean wait variable
     // to FALSE.
     //
+    // If adaptive spinning is enabled, then spin briefly before locking the
+    // dispatcher database in case another processor is about to signal the
+    // object.
+    //
 
     Thread = KeGetCurrentThread();
     if (Thread->WaitNext) {
         Thread->WaitNext = FALSE;
 
     } else {
+
+#if !defined(NT_UP)
+
+        if (KiShouldSpinOnWait(Timeout)) {
+            Spun = KiSpinOnWaitObjects(1, &Object, WaitAny, Thread);
+        }
+
+#endif
+
         KiLockDispatcherDatabase(&Thread->WaitIrql);
     }
 
@@ -1107,6 +1243,7 @@ Return Value:
             ASSERT(Thread->WaitIrql <= DISPATCH_LEVEL);
 
             WaitStatus = KiSwapThread();
+            Blocked = TRUE;
 
             //
             // If the thread was not awakened to deliver a kernel mode APC,
@@ -1114,6 +1251,7 @@ Return Value:
             //
 
             if (WaitStatus != STATUS_KERNEL_APC) {
+                RecordWaitOutcome();
                 return WaitStatus;
             }
 
@@ -1141,6 +1279,7 @@ Return Value:
     //
 
     KiUnlockDispatcherDatabase(Thread->WaitIrql);
+    RecordWaitOutcome();
     return WaitStatus;
 }
 
@@ -1774,3 +1913,324 @@ ContinueWait:
 }
 
 #endif
+
+BOOLEAN
+KiAreWaitObjectsAvailable (
+    IN ULONG Count,
+    IN PVOID Object[],
+    IN WAIT_TYPE WaitType,
+    IN PRKTHREAD Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This function tests whether a wait on the specified objects could be
+    satisfied without blocking. The dispatcher database is not locked and
+    the result is only a hint.
+
+Arguments:
+
+    Count - Supplies the number of objects.
+
+    Object - Supplies a pointer to an array of pointers to dispatcher objects.
+
+    WaitType - Supplies the type of wait to perform (WaitAll, WaitAny).
+
+    Thread - Supplies a pointer to the waiting thread.
+
+Return Value:
+
+    A value of TRUE is returned if the wait appears to be satisfiable.
+    Otherwise, a value of FALSE is returned.
+
+--*/
+
+{
+
+    ULONG Available;
+    ULONG Index;
+
+    Available = 0;
+    for (Index = 0; Index < Count; Index += 1) {
+        if (KiIsObjectAvailable((PKMUTANT)Object[Index], Thread)) {
+            if (WaitType == WaitAny) {
+                return TRUE;
+            }
+
+            Available += 1;
+        }
+    }
+
+    return (BOOLEAN)(Available == Count);
+}
+
+BOOLEAN
+KiSpinOnWaitObjects (
+    IN ULONG Count,
+    IN PVOID Object[],
+    IN WAIT_TYPE WaitType,
+    IN PRKTHREAD Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This function spins briefly waiting for another processor to signal the
+    specified objects so the caller can avoid blocking and paying for two
+    context switches when the objects are held for a short time.
+
+    Spinning is only attempted if every object that cannot satisfy the wait
+    is an event, a semaphore, or a mutant. The spin is bounded by a running
+    estimate of how long successful spins take for the type of object and by
+    the wait spin limit.
+
+    N.B. This function is called without the dispatcher database locked. The
+         caller must lock the dispatcher database and test the objects again.
+
+Arguments:
+
+    Count - Supplies the number of objects.
+
+    Object - Supplies a pointer to an array of pointers to dispatcher objects.
+
+    WaitType - Supplies the type of wait to perform (WaitAll, WaitAny).
+
+    Thread - Supplies a pointer to the waiting thread.
+
+Return Value:
+
+    A value of TRUE is returned if the thread spun. Otherwise, a value of
+    FALSE is returned.
+
+--*/
+
+{
+
+    LONG Estimate;
+    ULONG Index;
+    ULONG Limit;
+    PKMUTANT Objectx;
+    BOOLEAN Satisfied;
+    ULONG SpinCount;
+    ULONG SpinType;
+    ULONG Type;
+
+    //
+    // If the wait can already be satisfied, then there is no need to spin.
+    //
+
+    if (KiAreWaitObjectsAvailable(Count, Object, WaitType, Thread) != FALSE) {
+        return FALSE;
+    }
+
+    //
+    // Determine whether the objects are worth spinning on.
+    //
+    // N.B. The owner of a mutant is not examined since the owner thread
+    //      is not referenced and may be terminated and deleted at any time
+    //      while the dispatcher database is not locked. A mutant owned by
+    //      a thread that is not running only costs a spin bounded by the
+    //      estimate, which decays after failed spins.
+    //
+
+    SpinType = EventNotificationObject;
+    for (Index = 0; Index < Count; Index += 1) {
+        Objectx = (PKMUTANT)Object[Index];
+        if (KiIsObjectAvailable(Objectx, Thread) == FALSE) {
+            Type = Objectx->Header.Type;
+            if ((Type != MutantObject) &&
+                (Type != EventNotificationObject) &&
+                (Type != EventSynchronizationObject) &&
+                (Type != SemaphoreObject)) {
+                return FALSE;
+            }
+
+            SpinType = Type;
+        }
+    }
+
+    //
+    // Spin for at most twice the running estimate plus a small fraction of
+    // the spin limit, which allows the estimate to recover after a run of
+    // failed spins.
+    //
+
+    Estimate = (LONG)KiWaitSpinEstimate[SpinType];
+    Limit = ((ULONG)Estimate * 2) + (KiWaitSpinLimit / 16) + 1;
+    if (Limit > KiWaitSpinLimit) {
+        Limit = KiWaitSpinLimit;
+    }
+
+    Satisfied = FALSE;
+    for (SpinCount = 0; SpinCount < Limit; SpinCount += 1) {
+        if (*((volatile BOOLEAN *)&Thread->ApcState.KernelApcPending) != FALSE) {
+            break;
+        }
+
+        if (KiAreWaitObjectsAvailable(Count, Object, WaitType, Thread) != FALSE) {
+            Satisfied = TRUE;
+            break;
+        }
+    }
+
+    //
+    // Move the estimate an eighth of the way toward the spin count of a
+    // successful spin, or decay it by an eighth after a failed spin.
+    //
+
+    if (Satisfied != FALSE) {
+        Estimate += ((LONG)SpinCount - Estimate) / 8;
+
+    } else {
+        Estimate -= Estimate / 8;
+    }
+
+    //
+    // N.B. The thread may be preempted and resumed on another processor,
+    //      so the counter is incremented with an interlocked operation.
+    //
+
+    KiWaitSpinEstimate[SpinType] = (ULONG)Estimate;
+    InterlockedIncrement((PLONG)&KiWaitSpinCounts[KeGetCurrentPrcb()->Number].SpinWaits);
+    return TRUE;
+}
+
+VOID
+KiRecordWaitOutcome (
+    IN BOOLEAN Spun,
+    IN BOOLEAN Blocked,
+    IN ULONGLONG StartTime,
+    IN NTSTATUS WaitStatus
+    )
+
+/*++
+
+Routine Description:
+
+    This function records the outcome of a wait that spun or blocked and,
+    if wait latency histograms are enabled, the latency of the wait.
+
+Arguments:
+
+    Spun - Supplies a boolean value that specifies whether the thread spun
+        before locking the dispatcher database.
+
+    Blocked - Supplies a boolean value that specifies whether the thread
+        blocked.
+
+    StartTime - Supplies the time at which the wait started, or zero if
+        the start time was not captured.
+
+    WaitStatus - Supplies the completion status of the wait. A spin is
+        only counted as acquiring the objects if the wait was satisfied.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Bucket;
+    ULONGLONG Latency;
+    PKWAIT_SPIN_COUNTS SpinCounts;
+
+    //
+    // N.B. This function is called at the original IRQL of the wait, so the
+    //      thread may be preempted and resumed on another processor. The
+    //      counters are incremented with interlocked operations.
+    //
+
+    SpinCounts = &KiWaitSpinCounts[KeGetCurrentPrcb()->Number];
+    if ((Spun != FALSE) && (Blocked == FALSE) &&
+        KiIsWaitSatisfied(WaitStatus)) {
+        InterlockedIncrement((PLONG)&SpinCounts->SpinAcquired);
+    }
+
+    if ((KiWaitLatencyHistogram != 0) && (StartTime != 0)) {
+
+        //
+        // Bucket N counts latencies from 2**N up to 2**(N + 1) performance
+        // counter ticks.
+        //
+
+        Latency = KiQueryWaitTime() - StartTime;
+        Bucket = 0;
+        while ((Latency > 1) && (Bucket < (WAIT_LATENCY_BUCKETS - 1))) {
+            Latency >>= 1;
+            Bucket += 1;
+        }
+
+        if (Blocked != FALSE) {
+            InterlockedIncrement((PLONG)&SpinCounts->BlockLatency[Bucket]);
+
+        } else {
+            InterlockedIncrement((PLONG)&SpinCounts->SpinLatency[Bucket]);
+        }
+    }
+
+    return;
+}
+
+NTSTATUS
+KeGetWaitSpinInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the adaptive wait spin counters and wait latency
+    histograms summed over all processors.
+
+Arguments:
+
+    SystemInformation - Supplies a pointer to a buffer that receives the
+        wait spin information.
+
+    SystemInformationLength - Supplies the length of the buffer.
+
+    Length - Supplies a pointer to a variable that receives the length of
+        the wait spin information.
+
+Return Value:
+
+    STATUS_INFO_LENGTH_MISMATCH is returned if the buffer is too small.
+    Otherwise, STATUS_SUCCESS is returned.
+
+--*/
+
+{
+
+    ULONG Bucket;
+    PSYSTEM_WAIT_SPIN_INFORMATION Info;
+    ULONG Number;
+
+    PAGED_CODE();
+
+    *Length = sizeof(SYSTEM_WAIT_SPIN_INFORMATION);
+    if (SystemInformationLength < sizeof(SYSTEM_WAIT_SPIN_INFORMATION)) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Info = (PSYSTEM_WAIT_SPIN_INFORMATION)SystemInformation;
+    RtlZeroMemory(Info, sizeof(SYSTEM_WAIT_SPIN_INFORMATION));
+    Info->SpinLimit = KiWaitSpinLimit;
+    for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+        Info->SpinWaits += KiWaitSpinCounts[Number].SpinWaits;
+        Info->SpinAcquired += KiWaitSpinCounts[Number].SpinAcquired;
+        for (Bucket = 0; Bucket < WAIT_LATENCY_BUCKETS; Bucket += 1) {
+            Info->SpinLatency[Bucket] += KiWaitSpinCounts[Number].SpinLatency[Bucket];
+            Info->BlockLatency[Bucket] += KiWaitSpinCounts[Number].BlockLatency[Bucket];
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
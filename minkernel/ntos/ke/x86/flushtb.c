@@ -59,6 +59,11 @@ KiFlushTargetSingleTb (
     IN PVOID Parameter3
     );
 
+VOID
+KiStallOnTbFlushTargets (
+    IN PKPRCB Prcb
+    );
+
 #if defined(NT_UP)
 #undef KeFlushEntireTb
 #endif
@@ -125,6 +130,7 @@ Return Value:
     }
 
     TargetProcessors &= ~Prcb->SetMember;
+    KiTbFlushCounts[Prcb->Number].FlushEntireTb += 1;
     if (TargetProcessors != 0) {
         KiIpiSendPacket(TargetProcessors,
                         KiFlushTargetEntireTb,
@@ -132,6 +138,7 @@ Return Value:
                         NULL,
                         NULL);
 
+        KiTbFlushCounts[Prcb->Number].IpisSent += 1;
         IPI_INSTRUMENT_COUNT (Prcb->Number, FlushEntireTb);
     }
 
@@ -154,7 +161,7 @@ Return Value:
 #else
 
     if (TargetProcessors != 0) {
-        KiIpiStallOnPacketTargets();
+        KiStallOnTbFlushTargets(Prcb);
     }
 
     if (AllProcessors != FALSE) {
@@ -299,6 +306,7 @@ Return Value:
     // packet to the target set of processors.
     //
 
+    KiTbFlushCounts[Prcb->Number].FlushMultipleTb += 1;
     if (TargetProcessors != 0) {
         KiIpiSendPacket(TargetProcessors,
                         KiFlushTargetMultipleTb,
@@ -306,6 +314,8 @@ Return Value:
                         (PVOID)Number,
                         (PVOID)Virtual);
 
+        KiTbFlushCounts[Prcb->Number].IpisSent += 1;
+        KiTbFlushCounts[Prcb->Number].PagesFlushed += Number;
         IPI_INSTRUMENT_COUNT (Prcb->Number, FlushMultipleTb);
     }
 
@@ -322,7 +332,7 @@ Return Value:
     //
 
     if (TargetProcessors != 0) {
-        KiIpiStallOnPacketTargets();
+        KiStallOnTbFlushTargets(Prcb);
     }
 
     //
@@ -480,6 +490,7 @@ Return Value:
     // packet to the target set of processors.
     //
 
+    KiTbFlushCounts[Prcb->Number].FlushSingleTb += 1;
     if (TargetProcessors != 0) {
         KiIpiSendPacket(TargetProcessors,
                         KiFlushTargetSingleTb,
@@ -487,6 +498,8 @@ Return Value:
                         (PVOID)Virtual,
                         NULL);
 
+        KiTbFlushCounts[Prcb->Number].IpisSent += 1;
+        KiTbFlushCounts[Prcb->Number].PagesFlushed += 1;
         IPI_INSTRUMENT_COUNT(Prcb->Number, FlushSingleTb);
     }
 
@@ -502,7 +515,7 @@ Return Value:
     //
 
     if (TargetProcessors != 0) {
-        KiIpiStallOnPacketTargets();
+        KiStallOnTbFlushTargets(Prcb);
     }
 
     //
@@ -562,4 +575,45 @@ Return Value:
     KiFlushSingleTb((BOOLEAN)Invalid, (PVOID)VirtualAddress);
 }
 
+VOID
+KiStallOnTbFlushTargets (
+    IN PKPRCB Prcb
+    )
+
+/*++
+
+Routine Description:
+
+    This function waits until the target processors of a TB flush packet
+    have signaled completion and, if the processor has a time stamp counter,
+    adds the number of cycles spent waiting to the TB flush stall time of
+    the current processor.
+
+Arguments:
+
+    Prcb - Supplies a pointer to the processor control block of the current
+        processor.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LONGLONG StartTime;
+
+    if ((KeFeatureBits & KF_RDTSC) != 0) {
+        StartTime = RDTSC();
+        KiIpiStallOnPacketTargets();
+        KiTbFlushCounts[Prcb->Number].StallTime += RDTSC() - StartTime;
+
+    } else {
+        KiIpiStallOnPacketTargets();
+    }
+
+    return;
+}
+
 #endif
@@ -40,9 +40,11 @@ include callconv.inc
 
         extrn   @ExfInterlockedPopEntrySList@8:DWORD
         extrn   @ExfInterlockedPushEntrySList@12:DWORD
+        extrn   @ExfInterlockedFlushSList@8:DWORD
         extrn   @ExInterlockedCompareExchange64@16:DWORD
         extrn   @ExInterlockedPopEntrySList@8:DWORD
         extrn   @ExInterlockedPushEntrySList@12:DWORD
+        extrn   @ExInterlockedFlushSList@8:DWORD
         extrn   @ExpInterlockedCompareExchange64@16:DWORD
         extrn   _ExInterlockedAddLargeInteger@16:DWORD
         extrn   _ExInterlockedExchangeAddLargeInteger@16:DWORD
@@ -619,6 +621,12 @@ nocx8:
         lea     edx, [eax] + 5          ; get simulated eip value
         sub     ecx, edx                ; compute displacement
         mov     [eax] + 1, ecx          ; set jump displacement value
+        lea     eax, @ExInterlockedFlushSList@8 ; get target address
+        lea     ecx, @ExfInterlockedFlushSList@8 ; get source address
+        mov     byte ptr [eax], 0e9H    ; set jump opcode value
+        lea     edx, [eax] + 5          ; get simulated eip value
+        sub     ecx, edx                ; compute displacement
+        mov     [eax] + 1, ecx          ; set jump displacement value
         lea     eax, _ExInterlockedExchangeAddLargeInteger@16 ; get target address
         lea     ecx, _ExInterlockedAddLargeInteger@16 ; get source address
         mov     byte ptr [eax], 0e9H    ; set jump opcode value
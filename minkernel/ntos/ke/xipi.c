@@ -35,6 +35,10 @@ KiIpiGenericCallTarget (
     IN PVOID Context,
     IN PVOID Parameter3
     );
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, KeGetTbFlushInformation)
+#endif
 
 ULONG
 KiIpiGenericCall (
@@ -242,3 +246,60 @@ Return Value:
 }
 
 #endif
+
+NTSTATUS
+KeGetTbFlushInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the translation buffer flush counters summed over
+    all processors.
+
+Arguments:
+
+    SystemInformation - Supplies a pointer to a buffer that receives the
+        translation buffer flush information.
+
+    SystemInformationLength - Supplies the length of the buffer.
+
+    Length - Supplies a pointer to a variable that receives the length of
+        the translation buffer flush information.
+
+Return Value:
+
+    STATUS_INFO_LENGTH_MISMATCH is returned if the buffer is too small.
+    Otherwise, STATUS_SUCCESS is returned.
+
+--*/
+
+{
+
+    PSYSTEM_TB_FLUSH_INFORMATION Info;
+    ULONG Number;
+
+    PAGED_CODE();
+
+    *Length = sizeof(SYSTEM_TB_FLUSH_INFORMATION);
+    if (SystemInformationLength < sizeof(SYSTEM_TB_FLUSH_INFORMATION)) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Info = (PSYSTEM_TB_FLUSH_INFORMATION)SystemInformation;
+    RtlZeroMemory(Info, sizeof(SYSTEM_TB_FLUSH_INFORMATION));
+    for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+        Info->FlushSingleCount += KiTbFlushCounts[Number].FlushSingleTb;
+        Info->FlushMultipleCount += KiTbFlushCounts[Number].FlushMultipleTb;
+        Info->FlushEntireCount += KiTbFlushCounts[Number].FlushEntireTb;
+        Info->IpisSent += KiTbFlushCounts[Number].IpisSent;
+        Info->PagesFlushed += KiTbFlushCounts[Number].PagesFlushed;
+        Info->StallTime.QuadPart += KiTbFlushCounts[Number].StallTime;
+    }
+
+    return STATUS_SUCCESS;
+}
@@ -56,7 +56,8 @@ Return Value:
     PRKTHREAD Thread;
 
     //
-    // If any other threads are ready, then attempt to yield execution.
+    // If any other threads are ready on any processor, then attempt to
+    // yield execution.
     //
 
     Status = STATUS_NO_YIELD_PERFORMED;
@@ -101,11 +102,7 @@ Return Value:
             }
 
             Thread->Priority = (SCHAR)Priority;
-
-            InsertTailList(&KiDispatcherReadyListHead[Priority],
-                           &Thread->WaitListEntry);
-
-            SetMember(Priority, KiReadySummary);
+            KiInsertReadyQueue(Thread, Priority, FALSE);
             KiSwapThread();
             Status = STATUS_SUCCESS;
 
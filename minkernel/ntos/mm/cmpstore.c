@@ -0,0 +1,946 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+   cmpstore.c
+
+Abstract:
+
+    This module contains the routines which manage the compressed page
+    store.
+
+    When the modified page writer finishes writing a page to a paging
+    file and the page is on its way to the standby list, the page is
+    queued to the compressed store thread.  The thread compresses the
+    page and, if it compresses well enough, keeps the compressed data in
+    nonpaged pool keyed by the paging file and offset the page was written
+    to.  When a page fault later has to read that paging file offset, the
+    page is decompressed from the store instead of being read from the
+    paging file.
+
+    The paging file always holds a copy of the page, so the store is only
+    a cache: an entry may be evicted at any time, and an entry is removed
+    whenever its paging file space is released.  An entry is also removed
+    when the page is faulted back in from the store.
+
+    The store is protected by the PFN lock.  Since pool may not be freed
+    with the PFN lock held, removed entries are queued and freed by the
+    compressed store thread.
+
+Author:
+
+Revision History:
+
+--*/
+
+#include "mi.h"
+
+//
+// Define the number of pages the modified page writer may queue to the
+// compressed store thread.  Each queued page holds a reference so it
+// stays off the standby list until it has been compressed.
+//
+
+#define MM_COMPRESSION_QUEUE_SIZE 64
+
+//
+// Define the largest compressed page that is kept in the store.  Pages
+// which do not compress to half a page are not worth the nonpaged pool.
+//
+
+#define MM_MAXIMUM_COMPRESSED_PAGE (PAGE_SIZE / 2)
+
+//
+// Define the key of a paging file offset.
+//
+
+#define MI_COMPRESSED_PAGE_KEY(PTE) \
+    ((GET_PAGING_FILE_NUMBER (PTE) << 20) | GET_PAGING_FILE_OFFSET (PTE))
+
+#define MI_COMPRESSED_PAGE_HASH(KEY) \
+    (((KEY) ^ ((KEY) >> 20)) & MmCompressedStore.HashMask)
+
+typedef struct _MMCOMPRESSED_PAGE {
+    LIST_ENTRY HashLinks;
+    LIST_ENTRY AgeLinks;
+    ULONG Key;
+    ULONG Size;
+    UCHAR Data[1];
+} MMCOMPRESSED_PAGE, *PMMCOMPRESSED_PAGE;
+
+typedef struct _MMCOMPRESSED_STORE {
+    PLIST_ENTRY HashTable;
+    ULONG HashMask;
+    LIST_ENTRY AgeListHead;
+    LIST_ENTRY FreeListHead;
+    SYSTEM_COMPRESSED_STORE_INFORMATION Info;
+} MMCOMPRESSED_STORE, *PMMCOMPRESSED_STORE;
+
+//
+// Set from ntos\config\CMDAT3.C.  Zero selects a size based on the
+// amount of physical memory, 0xFFFFFFFF disables the store.
+//
+
+ULONG MmSizeOfCompressedStoreInBytes;
+
+BOOLEAN MmCompressedStoreEnabled;
+
+MMCOMPRESSED_STORE MmCompressedStore;
+
+KEVENT MmCompressionEvent;
+
+ULONG MmCompressionQueue[MM_COMPRESSION_QUEUE_SIZE];
+
+ULONG MmCompressionQueueCount;
+
+NPAGED_LOOKASIDE_LIST MmDecompressionBufferList;
+
+BOOLEAN
+MiInitializeCompressedStore (
+    OUT PVOID *WorkSpace,
+    OUT PUCHAR *Buffer,
+    OUT PUCHAR *CompressedBuffer
+    );
+
+VOID
+MiCompressPage (
+    IN ULONG PageFrameIndex,
+    IN MMPTE OriginalPte,
+    IN PVOID WorkSpace,
+    IN PUCHAR Buffer,
+    IN PUCHAR CompressedBuffer
+    );
+
+PMMCOMPRESSED_PAGE
+MiLookupCompressedPage (
+    IN ULONG Key
+    );
+
+VOID
+MiUnlinkCompressedPage (
+    IN PMMCOMPRESSED_PAGE Entry
+    );
+
+VOID
+MiFreeCompressedPages (
+    VOID
+    );
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE,MiInitializeCompressedStore)
+#endif
+
+
+VOID
+MiCompressedStoreThread (
+    IN PVOID StartContext
+    )
+
+/*++
+
+Routine Description:
+
+    Implements the compressed store thread.  The thread waits for the
+    modified page writer to queue pages which have been written to a
+    paging file, compresses them into the store, and frees entries which
+    have been removed from the store.
+
+    N.B. This thread is separate from the modified page writer as the
+         compression routines are pageable.  A page fault in this thread
+         may wait for free pages, which must not stop the modified page
+         writer from producing them.
+
+Arguments:
+
+    StartContext - not used.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode.
+
+--*/
+
+{
+    PUCHAR Buffer;
+    PUCHAR CompressedBuffer;
+    ULONG Count;
+    ULONG i;
+    KIRQL OldIrql;
+    MMPTE OriginalPte[MM_COMPRESSION_QUEUE_SIZE];
+    ULONG Page[MM_COMPRESSION_QUEUE_SIZE];
+    PVOID WorkSpace;
+
+    StartContext;  //avoid compiler warning.
+
+    if (!MiInitializeCompressedStore (&WorkSpace, &Buffer, &CompressedBuffer)) {
+        return;
+    }
+
+    (VOID) KeSetPriorityThread (&PsGetCurrentThread()->Tcb,
+                                LOW_REALTIME_PRIORITY);
+
+    for (;;) {
+
+        KeWaitForSingleObject (&MmCompressionEvent,
+                               WrVirtualMemory,
+                               KernelMode,
+                               FALSE,
+                               (PLARGE_INTEGER)NULL);
+
+        do {
+
+            //
+            // Take the queued pages.  Their original PTEs are captured
+            // so a page whose paging file space changes while it is
+            // compressed can be detected.
+            //
+
+            LOCK_PFN (OldIrql);
+
+            Count = MmCompressionQueueCount;
+            for (i = 0; i < Count; i += 1) {
+                Page[i] = MmCompressionQueue[i];
+                OriginalPte[i] = MI_PFN_ELEMENT (Page[i])->OriginalPte;
+            }
+
+            MmCompressionQueueCount = 0;
+
+            UNLOCK_PFN (OldIrql);
+
+            MiFreeCompressedPages ();
+
+            for (i = 0; i < Count; i += 1) {
+                MiCompressPage (Page[i],
+                                OriginalPte[i],
+                                WorkSpace,
+                                Buffer,
+                                CompressedBuffer);
+            }
+
+        } while (Count != 0);
+    }
+}
+
+
+BOOLEAN
+MiInitializeCompressedStore (
+    OUT PVOID *WorkSpace,
+    OUT PUCHAR *Buffer,
+    OUT PUCHAR *CompressedBuffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sizes and allocates the compressed store and the buffers
+    used by the compressed store thread, and then enables the store.
+
+Arguments:
+
+    WorkSpace - Receives the compression work space.
+
+    Buffer - Receives a page sized buffer the page is copied to.
+
+    CompressedBuffer - Receives the buffer the page is compressed into.
+
+Return Value:
+
+    TRUE if the store was enabled, FALSE if not.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.
+
+--*/
+
+{
+    ULONG Buckets;
+    ULONG FragmentWorkSpaceSize;
+    ULONG i;
+    ULONG MaximumSize;
+    NTSTATUS Status;
+    ULONG WorkSpaceSize;
+
+    PAGED_CODE();
+
+    //
+    // By default the store may use a thirty second of physical memory,
+    // but no more than a quarter of nonpaged pool.
+    //
+
+    MaximumSize = MmSizeOfCompressedStoreInBytes;
+
+    if (MaximumSize == 0) {
+        MaximumSize = (MmNumberOfPhysicalPages / 32) << PAGE_SHIFT;
+
+        if (MaximumSize > MmMaximumNonPagedPoolInBytes / 4) {
+            MaximumSize = MmMaximumNonPagedPoolInBytes / 4;
+        }
+    }
+
+    //
+    // Size the hash table for pages compressed to a quarter page with two
+    // pages per bucket.
+    //
+
+    Buckets = 64;
+    while ((Buckets < MaximumSize / (PAGE_SIZE / 2)) && (Buckets < 65536)) {
+        Buckets = Buckets << 1;
+    }
+
+    Status = RtlGetCompressionWorkSpaceSize (COMPRESSION_FORMAT_LZNT1 |
+                                                COMPRESSION_ENGINE_STANDARD,
+                                             &WorkSpaceSize,
+                                             &FragmentWorkSpaceSize);
+
+    if (!NT_SUCCESS (Status)) {
+        return FALSE;
+    }
+
+    *WorkSpace = ExAllocatePoolWithTag (NonPagedPool, WorkSpaceSize, 'wCmM');
+    *Buffer = ExAllocatePoolWithTag (NonPagedPool, PAGE_SIZE, 'bCmM');
+    *CompressedBuffer = ExAllocatePoolWithTag (NonPagedPool,
+                                               MM_MAXIMUM_COMPRESSED_PAGE,
+                                               'bCmM');
+
+    MmCompressedStore.HashTable = ExAllocatePoolWithTag (NonPagedPool,
+                                                         Buckets * sizeof(LIST_ENTRY),
+                                                         'hCmM');
+
+    if ((*WorkSpace == NULL) ||
+        (*Buffer == NULL) ||
+        (*CompressedBuffer == NULL) ||
+        (MmCompressedStore.HashTable == NULL)) {
+
+        if (*WorkSpace != NULL) {
+            ExFreePool (*WorkSpace);
+        }
+        if (*Buffer != NULL) {
+            ExFreePool (*Buffer);
+        }
+        if (*CompressedBuffer != NULL) {
+            ExFreePool (*CompressedBuffer);
+        }
+        if (MmCompressedStore.HashTable != NULL) {
+            ExFreePool (MmCompressedStore.HashTable);
+        }
+        return FALSE;
+    }
+
+    for (i = 0; i < Buckets; i += 1) {
+        InitializeListHead (&MmCompressedStore.HashTable[i]);
+    }
+
+    MmCompressedStore.HashMask = Buckets - 1;
+    InitializeListHead (&MmCompressedStore.AgeListHead);
+    InitializeListHead (&MmCompressedStore.FreeListHead);
+    MmCompressedStore.Info.MaximumSize = MaximumSize;
+
+    ExInitializeNPagedLookasideList (&MmDecompressionBufferList,
+                                     NULL,
+                                     NULL,
+                                     0,
+                                     PAGE_SIZE,
+                                     'bCmM',
+                                     4);
+
+    KeInitializeEvent (&MmCompressionEvent, SynchronizationEvent, FALSE);
+
+    MmCompressedStoreEnabled = TRUE;
+    return TRUE;
+}
+
+
+VOID
+FASTCALL
+MiQueuePageForCompression (
+    IN ULONG PageFrameIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine queues a page which has been written to a paging file
+    to the compressed store thread.  If the queue is full the page is
+    not compressed.
+
+Arguments:
+
+    PageFrameIndex - Supplies the physical page number which was written.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PFN lock held.
+
+--*/
+
+{
+    PMMPFN Pfn1;
+
+    MM_PFN_LOCK_ASSERT();
+
+    if ((MmCompressedStoreEnabled == FALSE) ||
+        (MmCompressionQueueCount == MM_COMPRESSION_QUEUE_SIZE)) {
+        return;
+    }
+
+    Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
+
+    ASSERT (Pfn1->OriginalPte.u.Soft.Prototype == 0);
+
+    //
+    // Keep the page off the standby list until it has been compressed.
+    //
+
+    Pfn1->u3.e2.ReferenceCount += 1;
+
+    MmCompressionQueue[MmCompressionQueueCount] = PageFrameIndex;
+    MmCompressionQueueCount += 1;
+
+    if (MmCompressionQueueCount == 1) {
+        KeSetEvent (&MmCompressionEvent, 0, FALSE);
+    }
+
+    return;
+}
+
+
+VOID
+MiCompressPage (
+    IN ULONG PageFrameIndex,
+    IN MMPTE OriginalPte,
+    IN PVOID WorkSpace,
+    IN PUCHAR Buffer,
+    IN PUCHAR CompressedBuffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compresses a queued page into the store and releases
+    the reference taken when the page was queued.
+
+    The page is still described by the paging file offset it was written
+    to if its original PTE has not changed and it has not been modified.
+    A page which is mapped and modified while it is compressed has its
+    paging file space released when the modification is noticed, which
+    removes the entry from the store before the offset can be read.
+
+Arguments:
+
+    PageFrameIndex - Supplies the physical page number to compress.
+
+    OriginalPte - Supplies the original PTE of the page when it was taken
+                  from the queue.
+
+    WorkSpace - Supplies the compression work space.
+
+    Buffer - Supplies a page sized buffer the page is copied to.
+
+    CompressedBuffer - Supplies the buffer the page is compressed into.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.
+
+--*/
+
+{
+    PMMCOMPRESSED_PAGE Entry;
+    ULONG Hash;
+    KIRQL OldIrql;
+    PMMCOMPRESSED_PAGE OldEntry;
+    PMMPFN Pfn1;
+    PVOID PageVa;
+    ULONG Size;
+    NTSTATUS Status;
+
+    Entry = NULL;
+
+    //
+    // Copy the page so it may be compressed with pageable code.
+    //
+
+    PageVa = MiMapPageInHyperSpace (PageFrameIndex, &OldIrql);
+    RtlCopyMemory (Buffer, PageVa, PAGE_SIZE);
+    MiUnmapPageInHyperSpace (OldIrql);
+
+    Status = RtlCompressBuffer (COMPRESSION_FORMAT_LZNT1 |
+                                    COMPRESSION_ENGINE_STANDARD,
+                                Buffer,
+                                PAGE_SIZE,
+                                CompressedBuffer,
+                                MM_MAXIMUM_COMPRESSED_PAGE,
+                                4096,
+                                &Size,
+                                WorkSpace);
+
+    //
+    // A page of zeroes is kept without any compressed data.
+    //
+
+    if (Status == STATUS_BUFFER_ALL_ZEROS) {
+        Size = 0;
+    }
+
+    if (NT_SUCCESS (Status)) {
+        Entry = ExAllocatePoolWithTag (NonPagedPool,
+                                       FIELD_OFFSET (MMCOMPRESSED_PAGE, Data) + Size,
+                                       'sCmM');
+
+        if (Entry != NULL) {
+            RtlCopyMemory (Entry->Data, CompressedBuffer, Size);
+            Entry->Key = MI_COMPRESSED_PAGE_KEY (OriginalPte);
+            Entry->Size = Size;
+        }
+    }
+
+    Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
+
+    LOCK_PFN (OldIrql);
+
+    if ((Entry != NULL) &&
+        (Pfn1->OriginalPte.u.Long == OriginalPte.u.Long) &&
+        (Pfn1->u3.e1.Modified == 0) &&
+        (!MI_IS_PFN_DELETED (Pfn1))) {
+
+        //
+        // Replace any stale entry for the offset and make room for the
+        // new entry by evicting the oldest entries.
+        //
+
+        OldEntry = MiLookupCompressedPage (Entry->Key);
+        if (OldEntry != NULL) {
+            MiUnlinkCompressedPage (OldEntry);
+        }
+
+        while ((MmCompressedStore.Info.CurrentSize +
+                FIELD_OFFSET (MMCOMPRESSED_PAGE, Data) + Size >
+                                    MmCompressedStore.Info.MaximumSize) &&
+               (!IsListEmpty (&MmCompressedStore.AgeListHead))) {
+
+            OldEntry = CONTAINING_RECORD (MmCompressedStore.AgeListHead.Flink,
+                                          MMCOMPRESSED_PAGE,
+                                          AgeLinks);
+
+            MiUnlinkCompressedPage (OldEntry);
+            MmCompressedStore.Info.Evictions += 1;
+        }
+
+        Hash = MI_COMPRESSED_PAGE_HASH (Entry->Key);
+        InsertHeadList (&MmCompressedStore.HashTable[Hash], &Entry->HashLinks);
+        InsertTailList (&MmCompressedStore.AgeListHead, &Entry->AgeLinks);
+
+        MmCompressedStore.Info.CurrentSize += FIELD_OFFSET (MMCOMPRESSED_PAGE, Data) + Size;
+        MmCompressedStore.Info.NumberOfPages += 1;
+        MmCompressedStore.Info.PagesCompressed += 1;
+        Entry = NULL;
+
+    } else {
+        MmCompressedStore.Info.PagesRejected += 1;
+    }
+
+    MiDecrementReferenceCount (PageFrameIndex);
+
+    UNLOCK_PFN (OldIrql);
+
+    if (Entry != NULL) {
+        ExFreePool (Entry);
+    }
+
+    return;
+}
+
+
+BOOLEAN
+MiReadCompressedPage (
+    IN PMMINPAGE_SUPPORT ReadBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine satisfies a paging file read from the compressed store.
+    If the paging file offset is in the store, the page is decompressed
+    into the read block's page and the read block's event is set as if
+    the read had completed.
+
+Arguments:
+
+    ReadBlock - Supplies the read block of the in-page operation, whose
+                page is read in progress.
+
+Return Value:
+
+    TRUE if the read was satisfied from the store, FALSE if the page must
+    be read from the paging file.
+
+Environment:
+
+    Kernel mode, APC_LEVEL, no locks held.
+
+--*/
+
+{
+    PUCHAR Buffer;
+    PMMCOMPRESSED_PAGE Entry;
+    KIRQL OldIrql;
+    PVOID PageVa;
+    PMMPFN Pfn1;
+    ULONG Size;
+    NTSTATUS Status;
+
+    //
+    // Only single page reads from a paging file can be in the store.
+    //
+
+    Pfn1 = ReadBlock->Pfn;
+
+    if ((MmCompressedStoreEnabled == FALSE) ||
+        (ReadBlock->Mdl.ByteCount != PAGE_SIZE) ||
+        (Pfn1->OriginalPte.u.Soft.Prototype == 1) ||
+        (Pfn1->OriginalPte.u.Soft.PageFileHigh == 0)) {
+        return FALSE;
+    }
+
+    Buffer = ExAllocateFromNPagedLookasideList (&MmDecompressionBufferList);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    Entry = NULL;
+
+    LOCK_PFN (OldIrql);
+
+    if ((Pfn1->OriginalPte.u.Soft.Prototype == 0) &&
+        (Pfn1->OriginalPte.u.Soft.PageFileHigh != 0)) {
+
+        Entry = MiLookupCompressedPage (MI_COMPRESSED_PAGE_KEY (Pfn1->OriginalPte));
+
+        if (Entry != NULL) {
+
+            //
+            // The page is resident once it is decompressed, so the entry
+            // is removed from the store.
+            //
+
+            RemoveEntryList (&Entry->HashLinks);
+            RemoveEntryList (&Entry->AgeLinks);
+            MmCompressedStore.Info.CurrentSize -= FIELD_OFFSET (MMCOMPRESSED_PAGE, Data) + Entry->Size;
+            MmCompressedStore.Info.NumberOfPages -= 1;
+            MmCompressedStore.Info.Hits += 1;
+            MmInfoCounters.PageReadIoCount -= 1;
+        } else {
+            MmCompressedStore.Info.Misses += 1;
+        }
+    }
+
+    UNLOCK_PFN (OldIrql);
+
+    if (Entry == NULL) {
+        ExFreeToNPagedLookasideList (&MmDecompressionBufferList, Buffer);
+        return FALSE;
+    }
+
+    if (Entry->Size == 0) {
+        RtlZeroMemory (Buffer, PAGE_SIZE);
+
+    } else {
+        Status = RtlDecompressBuffer (COMPRESSION_FORMAT_LZNT1,
+                                      Buffer,
+                                      PAGE_SIZE,
+                                      Entry->Data,
+                                      Entry->Size,
+                                      &Size);
+
+        if (!NT_SUCCESS (Status)) {
+
+            //
+            // The paging file still holds the page, read it from there.
+            //
+
+            KdPrint(("MM:decompress failed %lx\n",Status));
+            ExFreeToNPagedLookasideList (&MmDecompressionBufferList, Buffer);
+            ExFreePool (Entry);
+            return FALSE;
+        }
+
+        if (Size < PAGE_SIZE) {
+            RtlZeroMemory (Buffer + Size, PAGE_SIZE - Size);
+        }
+    }
+
+    PageVa = MiMapPageInHyperSpace (ReadBlock->Page[0], &OldIrql);
+    RtlCopyMemory (PageVa, Buffer, PAGE_SIZE);
+    MiUnmapPageInHyperSpace (OldIrql);
+
+    ExFreeToNPagedLookasideList (&MmDecompressionBufferList, Buffer);
+    ExFreePool (Entry);
+
+    ReadBlock->IoStatus.Status = STATUS_SUCCESS;
+    ReadBlock->IoStatus.Information = PAGE_SIZE;
+    KeSetEvent (&ReadBlock->Event, 0, FALSE);
+
+    return TRUE;
+}
+
+
+VOID
+FASTCALL
+MiRemoveCompressedPage (
+    IN MMPTE PteContents
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes the entry for a paging file offset whose space
+    is being released from the compressed store.
+
+Arguments:
+
+    PteContents - Supplies the PTE which is in page file format.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PFN lock held.
+
+--*/
+
+{
+    PMMCOMPRESSED_PAGE Entry;
+
+    MM_PFN_LOCK_ASSERT();
+
+    if (MmCompressedStore.Info.NumberOfPages == 0) {
+        return;
+    }
+
+    Entry = MiLookupCompressedPage (MI_COMPRESSED_PAGE_KEY (PteContents));
+    if (Entry != NULL) {
+        MiUnlinkCompressedPage (Entry);
+        MmCompressedStore.Info.Invalidations += 1;
+    }
+
+    return;
+}
+
+
+PMMCOMPRESSED_PAGE
+MiLookupCompressedPage (
+    IN ULONG Key
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the entry for a paging file offset in the
+    compressed store.
+
+Arguments:
+
+    Key - Supplies the key of the paging file offset.
+
+Return Value:
+
+    The entry, or NULL if the offset is not in the store.
+
+Environment:
+
+    Kernel mode, PFN lock held.
+
+--*/
+
+{
+    PMMCOMPRESSED_PAGE Entry;
+    PLIST_ENTRY ListHead;
+    PLIST_ENTRY NextEntry;
+
+    MM_PFN_LOCK_ASSERT();
+
+    ListHead = &MmCompressedStore.HashTable[MI_COMPRESSED_PAGE_HASH (Key)];
+    NextEntry = ListHead->Flink;
+
+    while (NextEntry != ListHead) {
+        Entry = CONTAINING_RECORD (NextEntry, MMCOMPRESSED_PAGE, HashLinks);
+        if (Entry->Key == Key) {
+            return Entry;
+        }
+        NextEntry = NextEntry->Flink;
+    }
+
+    return NULL;
+}
+
+
+VOID
+MiUnlinkCompressedPage (
+    IN PMMCOMPRESSED_PAGE Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes an entry from the compressed store and queues it
+    to be freed by the compressed store thread.
+
+Arguments:
+
+    Entry - Supplies the entry to remove.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PFN lock held.
+
+--*/
+
+{
+    MM_PFN_LOCK_ASSERT();
+
+    RemoveEntryList (&Entry->HashLinks);
+    RemoveEntryList (&Entry->AgeLinks);
+
+    MmCompressedStore.Info.CurrentSize -= FIELD_OFFSET (MMCOMPRESSED_PAGE, Data) + Entry->Size;
+    MmCompressedStore.Info.NumberOfPages -= 1;
+
+    InsertTailList (&MmCompressedStore.FreeListHead, &Entry->HashLinks);
+
+    return;
+}
+
+
+VOID
+MiFreeCompressedPages (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the entries which have been removed from the
+    compressed store.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PFN lock not held.
+
+--*/
+
+{
+    PMMCOMPRESSED_PAGE Entry;
+    LIST_ENTRY FreeList;
+    KIRQL OldIrql;
+
+    InitializeListHead (&FreeList);
+
+    LOCK_PFN (OldIrql);
+
+    if (!IsListEmpty (&MmCompressedStore.FreeListHead)) {
+        FreeList = MmCompressedStore.FreeListHead;
+        FreeList.Flink->Blink = &FreeList;
+        FreeList.Blink->Flink = &FreeList;
+        InitializeListHead (&MmCompressedStore.FreeListHead);
+    }
+
+    UNLOCK_PFN (OldIrql);
+
+    while (!IsListEmpty (&FreeList)) {
+        Entry = CONTAINING_RECORD (RemoveHeadList (&FreeList),
+                                   MMCOMPRESSED_PAGE,
+                                   HashLinks);
+        ExFreePool (Entry);
+    }
+
+    return;
+}
+
+
+NTSTATUS
+MmGetCompressedStoreInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the size and statistics of the compressed store.
+
+Arguments:
+
+    SystemInformation - Returns the compressed store information.
+
+    SystemInformationLength - Supplies the length of the SystemInformation
+                              buffer.
+
+    Length - Returns the length of the compressed store information.
+
+Return Value:
+
+    Returns the status of the operation.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The SystemInformation buffer may be a
+    user mode buffer which is probed by the caller.
+
+--*/
+
+{
+    SYSTEM_COMPRESSED_STORE_INFORMATION Info;
+    KIRQL OldIrql;
+
+    *Length = sizeof(SYSTEM_COMPRESSED_STORE_INFORMATION);
+
+    if (SystemInformationLength < sizeof(SYSTEM_COMPRESSED_STORE_INFORMATION)) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    LOCK_PFN (OldIrql);
+    Info = MmCompressedStore.Info;
+    UNLOCK_PFN (OldIrql);
+
+    *(PSYSTEM_COMPRESSED_STORE_INFORMATION)SystemInformation = Info;
+
+    return STATUS_SUCCESS;
+}
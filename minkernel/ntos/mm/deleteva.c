@@ -802,6 +802,13 @@ Environment:
     }
 #endif //DBG
 
+    //
+    // The paging file offset may be reused, remove any copy of the page
+    // from the compressed store.
+    //
+
+    MiRemoveCompressedPage (PteContents);
+
     RtlClearBits ( MmPagingFile[PageFileNumber]->Bitmap, FreeBit, 1);
 
     MmPagingFile[PageFileNumber]->FreeSpace += 1;
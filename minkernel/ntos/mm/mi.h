@@ -105,6 +105,8 @@ Revision History:
 
 #define MM_MAXIMUM_WRITE_CLUSTER (MM_MAXIMUM_DISK_IO_SIZE / PAGE_SIZE)
 
+#define MM_MINIMUM_WRITE_CLUSTER 2
+
 //
 // Number of PTEs to flush singularly before flushing the entire TB.
 //
@@ -1514,12 +1516,14 @@ typedef struct _MMMOD_WRITER_MDL_ENTRY {
     PFILE_OBJECT File;
     PCONTROL_AREA ControlArea;
     PERESOURCE FileResource;
+    ULONG IssueTime;
+    BOOLEAN Sequential;
     MDL Mdl;
     ULONG Page[1];
 } MMMOD_WRITER_MDL_ENTRY, *PMMMOD_WRITER_MDL_ENTRY;
 
 
-#define MM_PAGING_FILE_MDLS 2
+#define MM_PAGING_FILE_MDLS 4
 
 typedef struct _MMPAGING_FILE {
     ULONG Size;
@@ -1537,6 +1541,16 @@ typedef struct _MMPAGING_FILE {
     UNICODE_STRING PageFileName;
     BOOLEAN Extended;
     BOOLEAN HintSetToZero;
+    ULONG WriteClusterSize;
+    ULONG NextWriteOffset;
+    ULONG WritesInProgress;
+    ULONG WriteCount;
+    ULONG PagesWritten;
+    ULONG WriteErrors;
+    ULONG TotalWriteLatency;
+    ULONG MaximumWriteLatency;
+    ULONG ClusterGrows;
+    ULONG ClusterShrinks;
     } MMPAGING_FILE, *PMMPAGING_FILE;
 
 typedef struct _MMINPAGE_SUPPORT_LIST {
@@ -1578,6 +1592,16 @@ typedef struct _MMPTE_FLUSH_LIST {
     PVOID FlushVa[MM_MAXIMUM_FLUSH_COUNT];
 } MMPTE_FLUSH_LIST, *PMMPTE_FLUSH_LIST;
 
+//
+// List of working set entries being trimmed together so the TB
+// can be flushed for all of them with a single request.
+//
+
+typedef struct _MMWSLE_FLUSH_LIST {
+    ULONG Count;
+    ULONG FlushIndex[MM_MAXIMUM_FLUSH_COUNT];
+} MMWSLE_FLUSH_LIST, *PMMWSLE_FLUSH_LIST;
+
 
 
 VOID
@@ -2309,6 +2333,32 @@ MiUpdateModifiedWriterMdls (
     IN ULONG PageFileNumber
     );
 
+//
+// Routines which manage the compressed page store.
+//
+
+VOID
+MiCompressedStoreThread (
+    IN PVOID StartContext
+    );
+
+VOID
+FASTCALL
+MiQueuePageForCompression (
+    IN ULONG PageFrameIndex
+    );
+
+VOID
+FASTCALL
+MiRemoveCompressedPage (
+    IN MMPTE PteContents
+    );
+
+BOOLEAN
+MiReadCompressedPage (
+    IN PMMINPAGE_SUPPORT ReadBlock
+    );
+
 
 //
 // General support routines.
@@ -2890,6 +2940,27 @@ extern BOOLEAN MmZeroingPageThreadActive;
 
 extern ULONG MmMinimumFreePagesToZero;
 
+//
+// Number of zero page threads, the number of them currently zeroing
+// pages, and the number of pages they have zeroed.
+//
+
+extern ULONG MmNumberOfZeroingThreads;
+
+extern ULONG MmZeroingThreadsActive;
+
+extern ULONG MmPagesZeroedByThreads;
+
+//
+// Number of times a zeroed page was requested and one was available
+// on the zeroed page list, and the number of times the page had to
+// be zeroed by the caller.
+//
+
+extern ULONG MmZeroPageHits;
+
+extern ULONG MmZeroPageMisses;
+
 //
 // Global event to synchronize mapped writing with cleaning segments.
 //
@@ -3265,12 +3336,24 @@ extern ULONG MmModifiedPageMinimum;
 
 extern ULONG MmModifiedWriteClusterSize;
 
+extern ULONG MmWriteClusterGrowLatency;
+
+extern ULONG MmWriteClusterShrinkLatency;
+
 extern ULONG MmMinimumFreeDiskSpace;
 
 extern ULONG MmPageFileExtension;
 
 extern ULONG MmMinimumPageFileReduction;
 
+//
+// Compressed page store.
+//
+
+extern ULONG MmSizeOfCompressedStoreInBytes;
+
+extern BOOLEAN MmCompressedStoreEnabled;
+
 //
 // System process working set sizes.
 //
@@ -248,6 +248,27 @@ BOOLEAN MmZeroingPageThreadActive;
 
 ULONG MmMinimumFreePagesToZero = 8;
 
+//
+// Number of zero page threads, the number of them currently zeroing
+// pages, and the number of pages they have zeroed.
+//
+
+ULONG MmNumberOfZeroingThreads = 1;
+
+ULONG MmZeroingThreadsActive;
+
+ULONG MmPagesZeroedByThreads;
+
+//
+// Number of times a zeroed page was requested and one was available
+// on the zeroed page list, and the number of times the page had to
+// be zeroed by the caller.
+//
+
+ULONG MmZeroPageHits;
+
+ULONG MmZeroPageMisses;
+
 //
 // System space sizes - MmNonPagedSystemStart to MM_NON_PAGED_SYSTEM_END
 // defines the ranges of PDEs which must be copied into a new process's
@@ -541,6 +562,17 @@ ULONG MmMinimumPageFileReduction = 256;  //256 pages (1mb)
 
 ULONG MmModifiedWriteClusterSize = MM_MAXIMUM_WRITE_CLUSTER;
 
+//
+// Paging file writes which complete in no more than this many milliseconds
+// while no other write to the file is in progress let the write cluster
+// size for the file grow.  Writes which take at least the shrink latency
+// halve the write cluster size.
+//
+
+ULONG MmWriteClusterGrowLatency = 20;
+
+ULONG MmWriteClusterShrinkLatency = 100;
+
 //
 // Number of pages to read in a single I/O if possible.
 //
@@ -56,6 +56,7 @@ MiClusterWritePages (
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGE,NtCreatePagingFile)
 #pragma alloc_text(PAGE,MmGetPageFileInformation)
+#pragma alloc_text(PAGE,MmGetPageFileWriteInformation)
 #pragma alloc_text(PAGE,MiModifiedPageWriter)
 #pragma alloc_text(PAGE,MiCheckForCrashDump)
 #pragma alloc_text(PAGE,MmGetCrashDumpInformation)
@@ -135,6 +136,12 @@ MiModifiedPageWriterWorker (
     VOID
     );
 
+VOID
+MiUpdateWriteClusterSize (
+    IN PMMMOD_WRITER_MDL_ENTRY WriterEntry,
+    IN NTSTATUS Status
+    );
+
 VOID
 MiMappedPageWriter (
     IN PVOID StartContext
@@ -206,6 +213,7 @@ Return Value:
     ULONG ReturnedLength;
     ULONG FinalStatus;
     ULONG PageFileNumber;
+    ULONG i;
 
     DBG_UNREFERENCED_PARAMETER (Priority);
 
@@ -470,56 +478,43 @@ Return Value:
     MmPagingFile[MmNumberOfPagingFiles]->PageFileNumber = MmNumberOfPagingFiles;
 
     //
-    // Adjust the commit page limit to reflect the new page file space.
+    // Start writing to the paging file with the largest write cluster,
+    // the cluster size is reduced if the writes take too long.
     //
 
-    MmPagingFile[MmNumberOfPagingFiles]->Entry[0] = ExAllocatePoolWithTag (NonPagedPool,
-                                            sizeof(MMMOD_WRITER_MDL_ENTRY) +
-                                            MmModifiedWriteClusterSize *
-                                            sizeof(ULONG),
-                                            '  mM');
-
-    if (MmPagingFile[MmNumberOfPagingFiles]->Entry[0] == NULL) {
+    MmPagingFile[MmNumberOfPagingFiles]->WriteClusterSize =
+                                                MmModifiedWriteClusterSize;
 
-        //
-        // Allocate pool failed.
-        //
-
-        Status = STATUS_INSUFFICIENT_RESOURCES;
-        goto ErrorReturn5;
-    }
-
-    RtlZeroMemory (MmPagingFile[MmNumberOfPagingFiles]->Entry[0],
-                   sizeof(MMMOD_WRITER_MDL_ENTRY));
+    //
+    // Allocate the MDL entries used to write to the paging file.
+    //
 
-    MmPagingFile[MmNumberOfPagingFiles]->Entry[0]->PagingListHead =
-                                          &MmPagingFileHeader;
-    MmPagingFile[MmNumberOfPagingFiles]->Entry[0]->PagingFile =
-                                          MmPagingFile[MmNumberOfPagingFiles];
+    for (i = 0; i < MM_PAGING_FILE_MDLS; i += 1) {
 
-    MmPagingFile[MmNumberOfPagingFiles]->Entry[1] = ExAllocatePoolWithTag (NonPagedPool,
+        MmPagingFile[MmNumberOfPagingFiles]->Entry[i] = ExAllocatePoolWithTag (NonPagedPool,
                                             sizeof(MMMOD_WRITER_MDL_ENTRY) +
                                             MmModifiedWriteClusterSize *
                                             sizeof(ULONG),
                                             '  mM');
 
-    if (MmPagingFile[MmNumberOfPagingFiles]->Entry[1] == NULL) {
+        if (MmPagingFile[MmNumberOfPagingFiles]->Entry[i] == NULL) {
 
-        //
-        // Allocate pool failed.
-        //
+            //
+            // Allocate pool failed.
+            //
 
-        Status = STATUS_INSUFFICIENT_RESOURCES;
-        goto ErrorReturn6;
-    }
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto ErrorReturn6;
+        }
 
-    RtlZeroMemory (MmPagingFile[MmNumberOfPagingFiles]->Entry[1],
-                   sizeof(MMMOD_WRITER_MDL_ENTRY));
+        RtlZeroMemory (MmPagingFile[MmNumberOfPagingFiles]->Entry[i],
+                       sizeof(MMMOD_WRITER_MDL_ENTRY));
 
-    MmPagingFile[MmNumberOfPagingFiles]->Entry[1]->PagingListHead =
-                                          &MmPagingFileHeader;
-    MmPagingFile[MmNumberOfPagingFiles]->Entry[1]->PagingFile =
-                                          MmPagingFile[MmNumberOfPagingFiles];
+        MmPagingFile[MmNumberOfPagingFiles]->Entry[i]->PagingListHead =
+                                              &MmPagingFileHeader;
+        MmPagingFile[MmNumberOfPagingFiles]->Entry[i]->PagingFile =
+                                              MmPagingFile[MmNumberOfPagingFiles];
+    }
 
     MmPagingFile[MmNumberOfPagingFiles]->PageFileName = CapturedName;
 
@@ -534,7 +529,7 @@ Return Value:
         //
 
         Status = STATUS_INSUFFICIENT_RESOURCES;
-        goto ErrorReturn7;
+        goto ErrorReturn6;
     }
 
     RtlSetAllBits (MmPagingFile[MmNumberOfPagingFiles]->Bitmap);
@@ -612,11 +607,12 @@ Return Value:
     // Error returns:
     //
 
-ErrorReturn7:
-        ExFreePool (MmPagingFile[MmNumberOfPagingFiles]->Entry[0]);
-
 ErrorReturn6:
-        ExFreePool (MmPagingFile[MmNumberOfPagingFiles]->Entry[1]);
+        for (i = 0; i < MM_PAGING_FILE_MDLS; i += 1) {
+            if (MmPagingFile[MmNumberOfPagingFiles]->Entry[i] != NULL) {
+                ExFreePool (MmPagingFile[MmNumberOfPagingFiles]->Entry[i]);
+            }
+        }
 
 ErrorReturn5:
         ExFreePool (MmPagingFile[MmNumberOfPagingFiles]);
@@ -1438,6 +1434,7 @@ Return Value:
     BOOLEAN Reduce = FALSE;
     KIRQL OldIrql;
     ULONG i;
+    ULONG j;
     ULONG StartReduction;
     ULONG ReductionSize;
     ULONG TryBit;
@@ -1568,11 +1565,11 @@ Return Value:
                         // the file.
                         //
 
-                        if ((MmPagingFile[i]->Entry[0]->LastPageToWrite >
-                                                              StartReduction) ||
-                            (MmPagingFile[i]->Entry[1]->LastPageToWrite >
-                                                              StartReduction)) {
-                            StartReduction = 0;
+                        for (j = 0; j < MM_PAGING_FILE_MDLS; j += 1) {
+                            if (MmPagingFile[i]->Entry[j]->LastPageToWrite >
+                                                              StartReduction) {
+                                StartReduction = 0;
+                            }
                         }
                     }
 
@@ -1849,6 +1846,17 @@ Environment:
 
             MiReleasePageFileSpace (Pfn1->OriginalPte);
             Pfn1->OriginalPte.u.Soft.PageFileHigh = 0;
+
+        } else if ((WriterEntry->PagingFile != NULL) &&
+                   (Pfn1->u3.e1.Modified == 0) &&
+                   (!MI_IS_PFN_DELETED (Pfn1))) {
+
+            //
+            // This page was written to a paging file and is going to
+            // the standby list, let it be compressed on the way.
+            //
+
+            MiQueuePageForCompression (*Page);
         }
 
         MiDecrementReferenceCount (*Page);
@@ -1860,6 +1868,10 @@ Environment:
         ByteCount -= (LONG)PAGE_SIZE;
     }
 
+    if (WriterEntry->PagingFile != NULL) {
+        MiUpdateWriteClusterSize (WriterEntry, status);
+    }
+
     //
     // Check to which list to insert this entry into depending on
     // the amount of free space left in the paging file.
@@ -2003,6 +2015,98 @@ Environment:
     return;
 }
 
+VOID
+MiUpdateWriteClusterSize (
+    IN PMMMOD_WRITER_MDL_ENTRY WriterEntry,
+    IN NTSTATUS Status
+    )
+
+/*++
+
+Routine Description:
+
+    This routine updates the write counters of the paging file a
+    modified page write completed for and adapts the write cluster
+    size of the paging file to how the write went.
+
+    The write cluster size is doubled when a full cluster was written
+    sequentially after the previous write, no other write to the paging
+    file is in progress and the write completed quickly, as the paging
+    device is keeping up.  The write cluster size is halved when a write
+    is slow, so writes of fewer pages are queued behind each other and
+    the pages become available sooner.
+
+Arguments:
+
+    WriterEntry - Supplies a pointer to the MOD_WRITER_MDL_ENTRY which was
+                  used for a paging file write.
+
+    Status - Supplies the status of the write.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PFN lock held.
+
+--*/
+
+{
+    PMMPAGING_FILE PagingFile;
+    ULONG Latency;
+    ULONG PageCount;
+    LARGE_INTEGER TickCount;
+
+    MM_PFN_LOCK_ASSERT();
+
+    PagingFile = WriterEntry->PagingFile;
+    PageCount = BYTES_TO_PAGES (WriterEntry->Mdl.ByteCount);
+
+    ASSERT (PagingFile->WritesInProgress != 0);
+    PagingFile->WritesInProgress -= 1;
+
+    KeQueryTickCount (&TickCount);
+    Latency = ((TickCount.LowPart - WriterEntry->IssueTime) *
+                    KeQueryTimeIncrement ()) / 10000;
+
+    PagingFile->WriteCount += 1;
+    PagingFile->TotalWriteLatency += Latency;
+    if (Latency > PagingFile->MaximumWriteLatency) {
+        PagingFile->MaximumWriteLatency = Latency;
+    }
+
+    if (NT_ERROR(Status)) {
+        PagingFile->WriteErrors += 1;
+        return;
+    }
+
+    PagingFile->PagesWritten += PageCount;
+
+    if (Latency >= MmWriteClusterShrinkLatency) {
+
+        if (PagingFile->WriteClusterSize > MM_MINIMUM_WRITE_CLUSTER) {
+            PagingFile->WriteClusterSize >>= 1;
+            PagingFile->ClusterShrinks += 1;
+        }
+
+    } else if ((Latency <= MmWriteClusterGrowLatency) &&
+               (WriterEntry->Sequential) &&
+               (PagingFile->WritesInProgress == 0) &&
+               (PageCount >= PagingFile->WriteClusterSize) &&
+               (PagingFile->WriteClusterSize < MmModifiedWriteClusterSize)) {
+
+        PagingFile->WriteClusterSize <<= 1;
+        if (PagingFile->WriteClusterSize > MmModifiedWriteClusterSize) {
+            PagingFile->WriteClusterSize = MmModifiedWriteClusterSize;
+        }
+        PagingFile->ClusterGrows += 1;
+    }
+
+    return;
+}
+
 VOID
 MiModifiedPageWriter (
     IN PVOID StartContext
@@ -2107,6 +2211,23 @@ Environment:
                           MiMappedPageWriter,
                           NULL );
     ZwClose (ThreadHandle);
+
+    //
+    // Start the thread which compresses written pages into the
+    // compressed store, unless the store has been disabled.
+    //
+
+    if (MmSizeOfCompressedStoreInBytes != 0xFFFFFFFF) {
+        PsCreateSystemThread (&ThreadHandle,
+                              THREAD_ALL_ACCESS,
+                              &ObjectAttributes,
+                              0L,
+                              NULL,
+                              MiCompressedStoreThread,
+                              NULL );
+        ZwClose (ThreadHandle);
+    }
+
     MiModifiedPageWriterWorker();
 
     //
@@ -2945,6 +3066,7 @@ Environment:
     KIRQL OldIrql = 0;
     ULONG NextColor;
     ULONG PageFileFull = FALSE;
+    LARGE_INTEGER TickCount;
     //MM_WRITE_CLUSTER WriteCluster;
 
     //
@@ -2990,13 +3112,13 @@ Environment:
     CurrentPagingFile = ModWriterEntry->PagingFile;
 
     File = ModWriterEntry->PagingFile->File;
-    ThisCluster = MmModifiedWriteClusterSize;
+    ThisCluster = CurrentPagingFile->WriteClusterSize;
 
     do {
         //
-        // Attempt to cluster MmModifiedWriteClusterSize pages
-        // together.  Reduce by one half until we succeed or
-        // can't find a single page free in the paging file.
+        // Attempt to cluster the current write cluster size of pages
+        // for this paging file together.  Reduce by one half until we
+        // succeed or can't find a single page free in the paging file.
         //
 
         if (((CurrentPagingFile->Hint + MmModifiedWriteClusterSize) >
@@ -3231,6 +3353,19 @@ Environment:
     ModWriterEntry->Mdl.ByteCount = ClusterSize * PAGE_SIZE;
     ModWriterEntry->LastPageToWrite = StartBit - 1;
 
+    //
+    // Note whether this write continues where the last write to the
+    // paging file ended, and when it was issued, so the completion can
+    // adjust the write cluster size of the paging file.
+    //
+
+    ModWriterEntry->Sequential =
+        (BOOLEAN)((StartBit - ClusterSize) == CurrentPagingFile->NextWriteOffset);
+    CurrentPagingFile->NextWriteOffset = StartBit;
+    CurrentPagingFile->WritesInProgress += 1;
+    KeQueryTickCount (&TickCount);
+    ModWriterEntry->IssueTime = TickCount.LowPart;
+
     MmInfoCounters.DirtyWriteIoCount += 1;
     MmInfoCounters.DirtyPagesWriteCount += ClusterSize;
 
@@ -3742,6 +3877,68 @@ Return Value:
     return(STATUS_SUCCESS);
 }
 
+
+
+NTSTATUS
+MmGetPageFileWriteInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the write counters and the current write
+    cluster size of the currently active paging files.
+
+Arguments:
+
+    SystemInformation - Returns the paging file write information.
+
+    SystemInformationLength - Supplies the length of the SystemInformation
+                              buffer.
+
+    Length - Returns the length of the paging file write information placed
+             in the buffer.
+
+Return Value:
+
+    Returns the status of the operation.
+
+--*/
+
+{
+    PSYSTEM_PAGEFILE_WRITE_INFORMATION WriteInfo;
+    ULONG i;
+
+    PAGED_CODE();
+
+    *Length = MmNumberOfPagingFiles * sizeof(SYSTEM_PAGEFILE_WRITE_INFORMATION);
+
+    if (*Length > SystemInformationLength) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    WriteInfo = (PSYSTEM_PAGEFILE_WRITE_INFORMATION)SystemInformation;
+
+    for (i = 0; i < MmNumberOfPagingFiles; i++) {
+        WriteInfo->WriteClusterSize = MmPagingFile[i]->WriteClusterSize;
+        WriteInfo->WritesInProgress = MmPagingFile[i]->WritesInProgress;
+        WriteInfo->WriteCount = MmPagingFile[i]->WriteCount;
+        WriteInfo->PagesWritten = MmPagingFile[i]->PagesWritten;
+        WriteInfo->WriteErrors = MmPagingFile[i]->WriteErrors;
+        WriteInfo->TotalWriteLatency = MmPagingFile[i]->TotalWriteLatency;
+        WriteInfo->MaximumWriteLatency = MmPagingFile[i]->MaximumWriteLatency;
+        WriteInfo->ClusterGrows = MmPagingFile[i]->ClusterGrows;
+        WriteInfo->ClusterShrinks = MmPagingFile[i]->ClusterShrinks;
+        WriteInfo += 1;
+    }
+
+    return STATUS_SUCCESS;
+}
+
 
 NTSTATUS
 MiCheckPageFileMapping (
@@ -3807,6 +4004,7 @@ Return Value:
 {
     KIRQL OldIrql;
     ULONG Count;
+    ULONG i;
 
     LOCK_PFN (OldIrql);
 
@@ -3817,19 +4015,16 @@ Return Value:
         KeSetEvent (&MmPagingFileHeader.Event, 0, FALSE);
     }
 
-    InsertTailList (&MmPagingFileHeader.ListHead,
-                    &MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[0]->Links);
-
-    MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[0]->CurrentList =
-                                                &MmPagingFileHeader.ListHead;
+    for (i = 0; i < MM_PAGING_FILE_MDLS; i += 1) {
 
-    InsertTailList (&MmPagingFileHeader.ListHead,
-                    &MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[1]->Links);
+        InsertTailList (&MmPagingFileHeader.ListHead,
+                        &MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[i]->Links);
 
-    MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[1]->CurrentList =
+        MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[i]->CurrentList =
                                                 &MmPagingFileHeader.ListHead;
+    }
 
-    MmNumberOfActiveMdlEntries += 2;
+    MmNumberOfActiveMdlEntries += MM_PAGING_FILE_MDLS;
 
     UNLOCK_PFN (OldIrql);
 
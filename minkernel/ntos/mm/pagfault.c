@@ -237,28 +237,33 @@ ProtoPteNotResident:
 #endif //DBG
 
         //
-        // Issue the read request.
+        // If the page is in the compressed store, decompress it rather
+        // than reading it from the paging file.  Otherwise issue the
+        // read request.
         //
 
-        status = IoPageRead ( ReadBlock->FilePointer,
-                              &ReadBlock->Mdl,
-                              &ReadBlock->ReadOffset,
-                              &ReadBlock->Event,
-                              &ReadBlock->IoStatus);
+        if (MiReadCompressedPage (ReadBlock) == FALSE) {
 
+            status = IoPageRead ( ReadBlock->FilePointer,
+                                  &ReadBlock->Mdl,
+                                  &ReadBlock->ReadOffset,
+                                  &ReadBlock->Event,
+                                  &ReadBlock->IoStatus);
 
-        if (!NT_SUCCESS(status)) {
 
-            //
-            // Set the event as the I/O system doesn't set it on errors.
-            //
+            if (!NT_SUCCESS(status)) {
+
+                //
+                // Set the event as the I/O system doesn't set it on errors.
+                //
 
 
-            ReadBlock->IoStatus.Status = status;
-            ReadBlock->IoStatus.Information = 0;
-            KeSetEvent (&ReadBlock->Event,
-                       0,
-                       FALSE);
+                ReadBlock->IoStatus.Status = status;
+                ReadBlock->IoStatus.Information = 0;
+                KeSetEvent (&ReadBlock->Event,
+                           0,
+                           FALSE);
+            }
         }
 
         //
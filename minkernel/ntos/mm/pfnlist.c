@@ -42,12 +42,6 @@ MiDumpReferencedPages (VOID);
 
 #endif //DBG
 
-ULONG
-MiCompressPage (
-    IN PVOID Page
-    );
-
-
 #pragma alloc_text(PAGELK,MiUnlinkFreeOrZeroedPage)
 
 VOID
@@ -1064,6 +1058,7 @@ Environment:
         ASSERT (Pfn1->u3.e2.ReferenceCount == 0);
         ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
+        MmZeroPageHits += 1;
         return Page;
 
     } else {
@@ -1093,6 +1088,7 @@ Environment:
             ASSERT (Pfn1->u3.e2.ReferenceCount == 0);
             ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
+            MmZeroPageHits += 1;
             return Page;
         }
         //
@@ -1170,6 +1166,7 @@ Environment:
 #endif
 
         MI_CHECK_PAGE_ALIGNMENT(Page, PageColor & MM_COLOR_MASK);
+        MmZeroPageHits += 1;
 
     } else {
 
@@ -1234,6 +1231,7 @@ Environment:
 
 ZeroPage:
 
+        MmZeroPageMisses += 1;
         Pfn1 = MI_PFN_ELEMENT(Page);
 #if defined(MIPS) || defined(_ALPHA_)
         HalZeroPage((PVOID)((PageColor & MM_COLOR_MASK) << PAGE_SHIFT),
@@ -1652,56 +1650,3 @@ Environment:
     Pfn1->u3.e1.PageLocation = ModifiedNoWritePageList;
     return;
 }
-
-
-#if 0
-PVOID MmCompressionWorkSpace;
-ULONG MmCompressionWorkSpaceSize;
-PCHAR MmCompressedBuffer;
-
-VOID
-MiInitializeCompression (VOID)
-{
-    NTSTATUS status;
-    ULONG Frag;
-
-    status = RtlGetCompressionWorkSpaceSize (COMPRESSION_FORMAT_LZNT1,
-                                             &MmCompressionWorkSpaceSize,
-                                             &Frag
-                                             );
-    ASSERT (NT_SUCCESS (status));
-    MmCompressionWorkSpace = ExAllocatePoolWithTag (NonPagedPool,
-                                             MmCompressionWorkSpaceSize,'  mM');
-    MmCompressedBuffer = ExAllocatePoolWithTag (NonPagedPool, PAGE_SIZE,'  mM');
-    return;
-}
-
-ULONG MmCompressionStats[(PAGE_SIZE/256) + 1];
-
-ULONG
-MiCompressPage (
-    IN PVOID Input
-    )
-
-{
-    ULONG Size;
-    NTSTATUS status;
-
-    status = RtlCompressBuffer (COMPRESSION_FORMAT_LZNT1,
-                                (PCHAR)Input,
-                                PAGE_SIZE,
-                                MmCompressedBuffer,
-                                PAGE_SIZE,
-                                4096,
-                                &Size,
-                                (PVOID)MmCompressionWorkSpace);
-    if (!NT_SUCCESS (status)) {
-        KdPrint(("MM:compress failed %lx\n",status));
-        MmCompressionStats[4096/256] += 1;
-    } else {
-        MmCompressionStats[Size/256] += 1;
-    }
-
-    return Size;
-}
-#endif //0
@@ -44,7 +44,14 @@ MiEliminateWorkingSetEntry (
     IN ULONG WorkingSetIndex,
     IN PMMPTE PointerPte,
     IN PMMPFN Pfn,
-    IN PMMWSLE Wsle
+    IN PMMWSLE Wsle,
+    IN PMMPTE_FLUSH_LIST PteFlushList OPTIONAL
+    );
+
+ULONG
+MiFreeWsleList (
+    IN PMMSUPPORT WsInfo,
+    IN PMMWSLE_FLUSH_LIST WsleFlushList
     );
 
 ULONG
@@ -409,7 +416,8 @@ Environment:
     MiEliminateWorkingSetEntry (WorkingSetIndex,
                                 PointerPte,
                                 Pfn1,
-                                Wsle);
+                                Wsle,
+                                NULL);
     UNLOCK_PFN (OldIrql);
 
     //
@@ -963,7 +971,8 @@ Environment:
     MiEliminateWorkingSetEntry (WorkingSetIndex,
                                 PointerPte,
                                 Pfn1,
-                                Wsle);
+                                Wsle,
+                                NULL);
     UNLOCK_PFN (OldIrql);
 
     //
@@ -998,6 +1007,173 @@ Environment:
     return TRUE;
 }
 
+ULONG
+MiFreeWsleList (
+    IN PMMSUPPORT WsInfo,
+    IN PMMWSLE_FLUSH_LIST WsleFlushList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the working set entries in the specified list
+    as MiFreeWsle does, but acquires the PFN lock once and flushes the
+    TB for all the removed pages with a single request rather than one
+    request (and on multiprocessor systems one interprocessor interrupt)
+    per page.
+
+    Entries which are not eligible for removal are left in the working
+    set and are replaced with WSLE_NULL_INDEX in the list.
+
+Arguments:
+
+    WsInfo - Supplies a pointer to the working set structure (process or
+             system cache).
+
+    WsleFlushList - Supplies a pointer to the list of working set indices
+                    to free.  The list is empty on return.
+
+Return Value:
+
+    Returns the number of working set entries removed.
+
+Environment:
+
+    Kernel mode, APC's disabled, working set lock.  Pfn lock NOT held.
+
+--*/
+
+{
+    PMMPFN Pfn1;
+    PMMWSL WorkingSetList;
+    PMMWSLE Wsle;
+    PMMPTE PointerPte;
+    ULONG WorkingSetIndex;
+    ULONG NumberFreed;
+    ULONG i;
+    MMPTE_FLUSH_LIST PteFlushList;
+    KIRQL OldIrql;
+
+    WorkingSetList = WsInfo->VmWorkingSetList;
+    Wsle = WorkingSetList->Wsle;
+    PteFlushList.Count = 0;
+    NumberFreed = 0;
+
+#if DBG
+    if (WsInfo == &MmSystemCacheWs) {
+        MM_SYSTEM_WS_LOCK_ASSERT();
+    }
+#endif //DBG
+
+    ASSERT (WsleFlushList->Count <= MM_MAXIMUM_FLUSH_COUNT);
+
+    LOCK_PFN (OldIrql);
+
+    for (i = 0; i < WsleFlushList->Count; i += 1) {
+
+        WorkingSetIndex = WsleFlushList->FlushIndex[i];
+
+        ASSERT (Wsle[WorkingSetIndex].u1.e1.Valid == 1);
+
+        PointerPte = MiGetPteAddress (Wsle[WorkingSetIndex].u1.VirtualAddress);
+
+        ASSERT (PointerPte->u.Hard.Valid == 1);
+
+        Pfn1 = MI_PFN_ELEMENT (PointerPte->u.Hard.PageFrameNumber);
+
+        //
+        // Apply the same eligibility checks as MiFreeWsle.  The
+        // entries are examined in order, so a page table page whose
+        // last valid PTE was removed earlier in this list is eligible
+        // just as it would be when the entries are freed one at a time.
+        //
+
+        if (WsInfo == &MmSystemCacheWs) {
+            if (Pfn1->u3.e2.ReferenceCount > 1) {
+                WsleFlushList->FlushIndex[i] = WSLE_NULL_INDEX;
+                continue;
+            }
+        } else {
+            if ((Pfn1->u2.ShareCount > 1) &&
+                (Pfn1->u3.e1.PrototypePte == 0)) {
+
+                ASSERT ((Wsle[WorkingSetIndex].u1.VirtualAddress >= (PVOID)PTE_BASE) &&
+                 (Wsle[WorkingSetIndex].u1.VirtualAddress<= (PVOID)PDE_TOP));
+
+                WsleFlushList->FlushIndex[i] = WSLE_NULL_INDEX;
+                continue;
+            }
+        }
+
+        MiEliminateWorkingSetEntry (WorkingSetIndex,
+                                    PointerPte,
+                                    Pfn1,
+                                    Wsle,
+                                    &PteFlushList);
+    }
+
+    //
+    // Flush the TB for all the removed pages before releasing the PFN
+    // lock.  The PTEs have already been rewritten.
+    //
+
+    if (PteFlushList.Count != 0) {
+        if (PteFlushList.Count == 1) {
+            (VOID)KeFlushSingleTb (PteFlushList.FlushVa[0],
+                                   TRUE,
+                                   (BOOLEAN)(Wsle == MmSystemCacheWsle),
+                                   (PHARDWARE_PTE)PteFlushList.FlushPte[0],
+                                   PteFlushList.FlushPte[0]->u.Flush);
+        } else {
+            KeFlushMultipleTb (PteFlushList.Count,
+                               &PteFlushList.FlushVa[0],
+                               TRUE,
+                               (BOOLEAN)(Wsle == MmSystemCacheWsle),
+                               NULL,
+                               ZeroPte.u.Flush);
+        }
+    }
+
+    UNLOCK_PFN (OldIrql);
+
+    for (i = 0; i < WsleFlushList->Count; i += 1) {
+
+        WorkingSetIndex = WsleFlushList->FlushIndex[i];
+
+        if (WorkingSetIndex == WSLE_NULL_INDEX) {
+            continue;
+        }
+
+        //
+        // Remove the working set entry from the working set tree.
+        //
+
+        MiRemoveWsle (WorkingSetIndex, WorkingSetList);
+
+        //
+        // Put the entry on the free list and decrement the current
+        // size.
+        //
+
+        ASSERT ((WorkingSetList->FirstFree <= WorkingSetList->LastInitializedWsle) ||
+                (WorkingSetList->FirstFree == WSLE_NULL_INDEX));
+        Wsle[WorkingSetIndex].u1.Long = WorkingSetList->FirstFree << MM_FREE_WSLE_SHIFT;
+        WorkingSetList->FirstFree = WorkingSetIndex;
+        ASSERT ((WorkingSetList->FirstFree <= WorkingSetList->LastInitializedWsle) ||
+                (WorkingSetList->FirstFree == WSLE_NULL_INDEX));
+
+        if (WsInfo->WorkingSetSize > WsInfo->MinimumWorkingSetSize) {
+            MmPagesAboveWsMinimum -= 1;
+        }
+        WsInfo->WorkingSetSize -= 1;
+        NumberFreed += 1;
+    }
+
+    WsleFlushList->Count = 0;
+    return NumberFreed;
+}
+
 VOID
 MiInitializeWorkingSetList (
     IN PEPROCESS CurrentProcess
@@ -2014,8 +2190,10 @@ Environment:
     ULONG NumberLeftToRemove;
     ULONG LoopCount;
     ULONG EndCount;
+    MMWSLE_FLUSH_LIST WsleFlushList;
 
     NumberLeftToRemove = Reduction;
+    WsleFlushList.Count = 0;
     WorkingSetList = WsInfo->VmWorkingSetList;
     Wsle = WorkingSetList->Wsle;
 
@@ -2036,7 +2214,22 @@ Environment:
     }
 
     while ((NumberLeftToRemove != 0) && (LoopCount != EndCount)) {
-        while ((NumberLeftToRemove != 0) && (TryToFree <= LastEntry)) {
+        while (TryToFree <= LastEntry) {
+
+            if (NumberLeftToRemove == 0) {
+
+                //
+                // Enough candidates have been gathered.  Free them and
+                // account for any which turned out not to be eligible.
+                //
+
+                if (WsleFlushList.Count == 0) {
+                    break;
+                }
+                NumberLeftToRemove += WsleFlushList.Count -
+                                    MiFreeWsleList (WsInfo, &WsleFlushList);
+                continue;
+            }
 
             if (Wsle[TryToFree].u1.e1.Valid == 1) {
                 PointerPte = MiGetPteAddress (Wsle[TryToFree].u1.VirtualAddress);
@@ -2049,13 +2242,34 @@ Environment:
 
                     MI_SET_ACCESSED_IN_PTE (PointerPte, 0);
                 } else {
-                    if (MiFreeWsle (TryToFree, WsInfo, PointerPte)) {
-                        NumberLeftToRemove -= 1;
+
+                    //
+                    // Gather the entry so the TB is flushed for a batch
+                    // of pages with one request instead of one per page.
+                    //
+
+                    WsleFlushList.FlushIndex[WsleFlushList.Count] = TryToFree;
+                    WsleFlushList.Count += 1;
+                    NumberLeftToRemove -= 1;
+
+                    if (WsleFlushList.Count == MM_MAXIMUM_FLUSH_COUNT) {
+                        NumberLeftToRemove += WsleFlushList.Count -
+                                    MiFreeWsleList (WsInfo, &WsleFlushList);
                     }
                 }
             }
             TryToFree += 1;
         }
+
+        //
+        // Free any gathered entries before the scan wraps so that no
+        // entry is gathered twice.
+        //
+
+        if (WsleFlushList.Count != 0) {
+            NumberLeftToRemove += WsleFlushList.Count -
+                                    MiFreeWsleList (WsInfo, &WsleFlushList);
+        }
         TryToFree = WorkingSetList->FirstDynamic;
         LoopCount += 1;
     }
@@ -2247,7 +2461,8 @@ MiEliminateWorkingSetEntry (
     IN ULONG WorkingSetIndex,
     IN PMMPTE PointerPte,
     IN PMMPFN Pfn,
-    IN PMMWSLE Wsle
+    IN PMMWSLE Wsle,
+    IN PMMPTE_FLUSH_LIST PteFlushList OPTIONAL
     )
 
 /*++
@@ -2259,6 +2474,10 @@ Routine Description:
     the share count for the physical page, and, if necessary turns
     the PTE into a transition PTE.
 
+    If a PTE flush list is supplied, the PTE is rewritten but the TB
+    is not flushed; the PTE and virtual address are appended to the
+    list and the caller must flush the TB before releasing the PFN lock.
+
 Arguments:
 
     WorkingSetIndex - Supplies the working set index to remove.
@@ -2271,6 +2490,9 @@ Arguments:
     Wsle - Supplies a pointer to the first working set list entry for this
            working set.
 
+    PteFlushList - Supplies an optional pointer to a list which receives
+                   the PTE and virtual address to be flushed.
+
 Return Value:
 
     None.
@@ -2385,11 +2607,31 @@ Environment:
 
     }
 
-    PreviousPte.u.Flush = KeFlushSingleTb (Wsle[WorkingSetIndex].u1.VirtualAddress,
-                                   TRUE,
-                                   (BOOLEAN)(Wsle == MmSystemCacheWsle),
-                                   (PHARDWARE_PTE)PointerPte,
-                                   TempPte.u.Flush);
+    if (ARGUMENT_PRESENT (PteFlushList)) {
+
+        //
+        // The TB flush is deferred to the caller.  The PFN lock is held
+        // until the flush completes, so the page cannot be reused while
+        // another processor may still hold a stale translation for it.
+        //
+
+        ASSERT (PteFlushList->Count < MM_MAXIMUM_FLUSH_COUNT);
+
+        PreviousPte = *PointerPte;
+        *PointerPte = TempPte;
+
+        PteFlushList->FlushPte[PteFlushList->Count] = PointerPte;
+        PteFlushList->FlushVa[PteFlushList->Count] =
+                                    Wsle[WorkingSetIndex].u1.VirtualAddress;
+        PteFlushList->Count += 1;
+
+    } else {
+        PreviousPte.u.Flush = KeFlushSingleTb (Wsle[WorkingSetIndex].u1.VirtualAddress,
+                                       TRUE,
+                                       (BOOLEAN)(Wsle == MmSystemCacheWsle),
+                                       (PHARDWARE_PTE)PointerPte,
+                                       TempPte.u.Flush);
+    }
 
     ASSERT (PreviousPte.u.Hard.Valid == 1);
 
@@ -2918,7 +3160,8 @@ MiDumpPteInCacheBlock (
             MiEliminateWorkingSetEntry (WorkingSetIndex,
                                         PointerPte,
                                         Pfn1,
-                                        MmSystemCacheWsle);
+                                        MmSystemCacheWsle,
+                                        NULL);
             UNLOCK_PFN (OldIrql);
 
             //
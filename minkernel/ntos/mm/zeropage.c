@@ -8,7 +8,17 @@ Module Name:
 
 Abstract:
 
-    This module contains the zero page thread for memory management.
+    This module contains the zero page threads for memory management.
+
+    The zero page thread started by the system initialization thread
+    creates one more zero page thread for each additional processor.
+    Each thread is bound to its processor and runs at priority zero, so
+    pages are zeroed by every processor that would otherwise be idle.
+    The threads remove a batch of pages from the free list at a time,
+    zero the batch without holding the PFN lock, and insert the pages
+    in the zeroed page list.  Each thread starts its search for free
+    pages at a different page color so the threads work on different
+    colors.
 
 Author:
 
@@ -20,6 +30,27 @@ Revision History:
 
 #include "mi.h"
 
+//
+// Define the maximum number of pages a zero page thread removes from the
+// free list at a time.
+//
+
+#define MM_ZERO_PAGE_BATCH 16
+
+VOID
+MiZeroPageWorkerThread (
+    IN PVOID StartContext
+    );
+
+VOID
+MiZeroPageWorker (
+    IN ULONG ThreadNumber
+    );
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE,MmGetZeroPageInformation)
+#endif
+
 
 VOID
 MmZeroPageThread (
@@ -31,8 +62,11 @@ MmZeroPageThread (
 Routine Description:
 
     Implements the NT zeroing page thread.  This thread runs
-    at priority zero and removes a page from the free list,
-    zeroes it, and places it on the zeroed page list.
+    at priority zero and removes pages from the free list,
+    zeroes them, and places them on the zeroed page list.
+
+    On multiprocessor systems a zero page thread is created for
+    each additional processor.
 
 Arguments:
 
@@ -50,13 +84,10 @@ Environment:
 
 {
     PVOID EndVa;
-    KIRQL OldIrql;
-    ULONG PageFrame;
-    PMMPFN Pfn1;
-    PVOID StartVa;
-    PKTHREAD Thread;
-    PVOID ZeroBase;
     ULONG i;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    PVOID StartVa;
+    HANDLE ThreadHandle;
 
     //
     // Before this becomes the zero page thread, free the kernel
@@ -68,6 +99,107 @@ Environment:
         MiFreeInitializationCode (StartVa, EndVa);
     }
 
+    //
+    // Start a zero page thread for each of the other processors.
+    //
+
+    MmNumberOfZeroingThreads = 1;
+
+    InitializeObjectAttributes (&ObjectAttributes, NULL, 0, NULL, NULL);
+
+    for (i = 1; i < (ULONG)KeNumberProcessors; i += 1) {
+        if (NT_SUCCESS (PsCreateSystemThread (&ThreadHandle,
+                                              THREAD_ALL_ACCESS,
+                                              &ObjectAttributes,
+                                              0L,
+                                              NULL,
+                                              MiZeroPageWorkerThread,
+                                              (PVOID)i))) {
+            ZwClose (ThreadHandle);
+            MmNumberOfZeroingThreads += 1;
+        }
+    }
+
+    MiZeroPageWorker (0);
+}
+
+
+VOID
+MiZeroPageWorkerThread (
+    IN PVOID StartContext
+    )
+
+/*++
+
+Routine Description:
+
+    This is the start routine of the zero page threads for the
+    additional processors.
+
+Arguments:
+
+    StartContext - Supplies the number of the processor the thread
+                   zeroes pages on.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode.
+
+--*/
+
+{
+    MiZeroPageWorker ((ULONG)StartContext);
+}
+
+
+VOID
+MiZeroPageWorker (
+    IN ULONG ThreadNumber
+    )
+
+/*++
+
+Routine Description:
+
+    This routine zeroes pages on the free list for the calling zero
+    page thread and never returns.
+
+Arguments:
+
+    ThreadNumber - Supplies the number of the zero page thread, which is
+                   also the number of the processor it is bound to.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode.
+
+--*/
+
+{
+    ULONG Color;
+    ULONG Count;
+    ULONG i;
+    KIRQL OldIrql;
+    ULONG Page[MM_ZERO_PAGE_BATCH];
+    ULONG PageFrame;
+    PMMPFN Pfn1;
+    PKTHREAD Thread;
+#if defined(_X86_)
+    PMMPTE PointerPte;
+    MMPTE TempPte;
+    PVOID ZeroBase;
+#elif !defined(_PPC_)
+    PVOID ZeroBase;
+#endif
+
     //
     // The following code sets the current thread's base priority to zero
     // and then sets its current priority to zero. This ensures that the
@@ -78,6 +210,48 @@ Environment:
     Thread->BasePriority = 0;
     KeSetPriorityThread (Thread, 0);
 
+    //
+    // Bind each thread to its own processor.  The thread must stay on one
+    // processor while it flushes only the local translation buffer.
+    //
+
+    KeSetAffinityThread (Thread, (KAFFINITY)1 << ThreadNumber);
+
+#if defined(_X86_)
+
+    //
+    // Reserve system PTEs to map a batch of pages.  As the thread is bound
+    // to one processor, only the translation buffer of that processor
+    // needs to be flushed when the PTEs are reused.  If the PTEs cannot be
+    // reserved, zero the pages through hyper space one at a time.
+    //
+
+    PointerPte = MiReserveSystemPtes (MM_ZERO_PAGE_BATCH,
+                                      SystemPteSpace,
+                                      0,
+                                      0,
+                                      FALSE);
+
+    if (PointerPte == NULL) {
+        KeSetAffinityThread (Thread, KeActiveProcessors);
+    }
+
+#endif //X86
+
+    //
+    // Start the search for free pages at a different color in each thread.
+    //
+    // N.B. The number of processors is used rather than the number of zero
+    //      page threads, as the latter is still being counted while the
+    //      threads are created.
+    //
+
+#if MM_MAXIMUM_NUMBER_OF_COLORS > 1
+    Color = (ThreadNumber * MM_MAXIMUM_NUMBER_OF_COLORS) / (ULONG)KeNumberProcessors;
+#else
+    Color = 0;
+#endif
+
     //
     // Loop forever zeroing pages.
     //
@@ -96,6 +270,7 @@ Environment:
                                (PLARGE_INTEGER)NULL);
 
         LOCK_PFN_WITH_TRY (OldIrql);
+        MmZeroingThreadsActive += 1;
         do {
             if ((volatile)MmFreePageListHead.Total == 0) {
 
@@ -104,55 +279,166 @@ Environment:
                 // some more.
                 //
 
-                MmZeroingPageThreadActive = FALSE;
+                MmZeroingThreadsActive -= 1;
+                if (MmZeroingThreadsActive == 0) {
+                    MmZeroingPageThreadActive = FALSE;
+                }
                 UNLOCK_PFN (OldIrql);
                 break;
 
             } else {
 
+                //
+                // Remove a batch of pages from the free list.  Take one
+                // page at a time when memory is low so the pages being
+                // zeroed are not missed.
+                //
+
+                Count = 0;
+
+                do {
+
 #if MM_MAXIMUM_NUMBER_OF_COLORS > 1
-                for (i = 0; i < MM_MAXIMUM_NUMBER_OF_COLORS; i++) {
-                    PageFrame = MmFreePagesByPrimaryColor[FreePageList][i].Flink;
-                    if (PageFrame != MM_EMPTY_LIST) {
-                        break;
+                    for (i = 0; i < MM_MAXIMUM_NUMBER_OF_COLORS; i++) {
+                        PageFrame = MmFreePagesByPrimaryColor[FreePageList][Color].Flink;
+                        if (PageFrame != MM_EMPTY_LIST) {
+                            break;
+                        }
+                        Color = (Color + 1) & (MM_MAXIMUM_NUMBER_OF_COLORS - 1);
                     }
-                }
 #else  //MM_MAXIMUM_NUMBER_OF_COLORS > 1
-                PageFrame = MmFreePageListHead.Flink;
+                    PageFrame = MmFreePageListHead.Flink;
 #endif //MM_MAXIMUM_NUMBER_OF_COLORS > 1
-                Pfn1 = MI_PFN_ELEMENT(PageFrame);
 
-                ASSERT (PageFrame != MM_EMPTY_LIST);
-                Pfn1 = MI_PFN_ELEMENT(PageFrame);
-                MiRemoveAnyPage (MI_GET_SECONDARY_COLOR (PageFrame, Pfn1));
+                    ASSERT (PageFrame != MM_EMPTY_LIST);
+                    Pfn1 = MI_PFN_ELEMENT(PageFrame);
+                    Page[Count] = MiRemoveAnyPage (MI_GET_SECONDARY_COLOR (PageFrame, Pfn1));
+                    Count += 1;
+
+                } while ((Count < MM_ZERO_PAGE_BATCH) &&
+                         ((volatile)MmFreePageListHead.Total != 0) &&
+                         (MmAvailablePages > MmFreeGoal));
 
                 //
-                // Zero the page using the last color used to map the page.
+                // If more pages are waiting to be zeroed, wake another
+                // zero page thread.
+                //
+
+                if (((volatile)MmFreePageListHead.Total >= MM_ZERO_PAGE_BATCH) &&
+                    (MmZeroingThreadsActive < MmNumberOfZeroingThreads)) {
+                    KeSetEvent (&MmZeroingPageEvent, 0, FALSE);
+                }
+
+                //
+                // Zero the pages using the last color used to map each page.
                 //
 
 #if defined(_X86_)
 
-                ZeroBase = MiMapPageToZeroInHyperSpace (PageFrame);
-                UNLOCK_PFN (OldIrql);
-                RtlZeroMemory (ZeroBase, PAGE_SIZE);
+                if (PointerPte == NULL) {
+                    UNLOCK_PFN (OldIrql);
+                    for (i = 0; i < Count; i += 1) {
+                        MiZeroPhysicalPage (Page[i], 0);
+                    }
+
+                } else {
+                    UNLOCK_PFN (OldIrql);
+
+                    TempPte = ValidKernelPte;
+                    for (i = 0; i < Count; i += 1) {
+                        TempPte.u.Hard.PageFrameNumber = Page[i];
+                        KeFlushSingleTb (MiGetVirtualAddressMappedByPte (PointerPte + i),
+                                         TRUE,
+                                         FALSE,
+                                         (PHARDWARE_PTE)(PointerPte + i),
+                                         TempPte.u.Flush);
+                    }
+
+                    ZeroBase = MiGetVirtualAddressMappedByPte (PointerPte);
+                    RtlZeroMemory (ZeroBase, Count << PAGE_SHIFT);
+                }
 
 #elif defined(_PPC_)
 
                 UNLOCK_PFN (OldIrql);
-                KeZeroPage(PageFrame);
+                for (i = 0; i < Count; i += 1) {
+                    KeZeroPage(Page[i]);
+                }
 
 #else
 
-                ZeroBase = (PVOID)(Pfn1->u3.e1.PageColor << PAGE_SHIFT);
                 UNLOCK_PFN (OldIrql);
-                HalZeroPage(ZeroBase, ZeroBase, PageFrame);
+                for (i = 0; i < Count; i += 1) {
+                    Pfn1 = MI_PFN_ELEMENT(Page[i]);
+                    ZeroBase = (PVOID)(Pfn1->u3.e1.PageColor << PAGE_SHIFT);
+                    HalZeroPage(ZeroBase, ZeroBase, Page[i]);
+                }
 
 #endif //X86
 
                 LOCK_PFN_WITH_TRY (OldIrql);
-                MiInsertPageInList (MmPageLocationList[ZeroedPageList],
-                                    PageFrame);
+                for (i = 0; i < Count; i += 1) {
+                    MiInsertPageInList (MmPageLocationList[ZeroedPageList],
+                                        Page[i]);
+                }
+                MmPagesZeroedByThreads += Count;
             }
         } while(TRUE);
     } while (TRUE);
 }
+
+
+NTSTATUS
+MmGetZeroPageInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of zero page threads, the number of
+    pages they have zeroed, and how often a zeroed page was available
+    when one was needed.
+
+Arguments:
+
+    SystemInformation - Returns the zero page information.
+
+    SystemInformationLength - Supplies the length of the SystemInformation
+                              buffer.
+
+    Length - Returns the length of the zero page information.
+
+Return Value:
+
+    Returns the status of the operation.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The SystemInformation buffer may be a
+    user mode buffer which is probed by the caller.
+
+--*/
+
+{
+    PSYSTEM_ZERO_PAGE_INFORMATION Info;
+
+    PAGED_CODE();
+
+    *Length = sizeof(SYSTEM_ZERO_PAGE_INFORMATION);
+
+    if (SystemInformationLength < sizeof(SYSTEM_ZERO_PAGE_INFORMATION)) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    Info = (PSYSTEM_ZERO_PAGE_INFORMATION)SystemInformation;
+    Info->ZeroingThreads = MmNumberOfZeroingThreads;
+    Info->PagesZeroed = MmPagesZeroedByThreads;
+    Info->ZeroPageHits = MmZeroPageHits;
+    Info->ZeroPageMisses = MmZeroPageMisses;
+
+    return STATUS_SUCCESS;
+}
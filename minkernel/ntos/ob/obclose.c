@@ -51,12 +51,11 @@ NtClose(
     ObjectTable = ObpGetObjectTable();
     ObjectTableEntry = (POBJECT_TABLE_ENTRY)ExMapHandleToPointer(
                    ObjectTable,
-                   (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle ),
-                   FALSE
+                   (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle )
                    );
 
     if (ObjectTableEntry != NULL) {
-        ObjectHeader = (POBJECT_HEADER)(ObjectTableEntry->Attributes & ~OBJ_HANDLE_ATTRIBUTES);
+        ObjectHeader = ObpGetObjectTableEntryHeader(ObjectTableEntry);
         CapturedAttributes = (ULONG)(ObjectTableEntry->Attributes);
 
         //
@@ -66,7 +65,7 @@ NtClose(
 
         if ((CapturedAttributes & OBJ_PROTECT_CLOSE) != 0) {
             if (KeGetPreviousMode() != KernelMode) {
-                ExUnlockHandleTableExclusive(ObjectTable);
+                ExUnlockHandleTableEntry(ObjectTable, (PHANDLE_ENTRY)ObjectTableEntry);
                 if ((NtGlobalFlag & FLG_ENABLE_CLOSE_EXCEPTIONS) ||
                     (PsGetCurrentProcess()->DebugPort != NULL)) {
                     return(KeRaiseUserException(STATUS_HANDLE_NOT_CLOSABLE));
@@ -75,7 +74,7 @@ NtClose(
                 }
             } else {
                 if ( !PsIsThreadTerminating(PsGetCurrentThread()) ) {
-                    ExUnlockHandleTableExclusive(ObjectTable);
+                    ExUnlockHandleTableEntry(ObjectTable, (PHANDLE_ENTRY)ObjectTableEntry);
 #if DBG
                     //
                     // bugcheck here on checked builds if kernel mode code is
@@ -98,9 +97,8 @@ NtClose(
 
         ExDestroyHandle( ObjectTable,
                          (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle ),
-                         TRUE );
+                         (PHANDLE_ENTRY)ObjectTableEntry );
 
-        ExUnlockHandleTableExclusive(ObjectTable);
         Object = &ObjectHeader->Body;
 
 #if DBG
@@ -1671,8 +1671,7 @@ ObpCaptureHandleInformation(
         Status = STATUS_INFO_LENGTH_MISMATCH;
         }
     else {
-        ObjectHeader = (POBJECT_HEADER)
-            (ObjectTableEntry->Attributes & ~OBJ_HANDLE_ATTRIBUTES);
+        ObjectHeader = ObpGetObjectTableEntryHeader(ObjectTableEntry);
         (*HandleEntryInfo)->UniqueProcessId = (USHORT)UniqueProcessId;
         (*HandleEntryInfo)->HandleAttributes = (UCHAR)
             (ObjectTableEntry->Attributes & OBJ_HANDLE_ATTRIBUTES);
@@ -220,10 +220,7 @@ Return Value:
         PsGetCurrentProcess()->QuotaBlock = &PspDefaultQuotaBlock;
 
         PsGetCurrentProcess()->ObjectTable =
-            ExCreateHandleTable( NULL,
-                                 0,
-                                 0
-                               );
+            ExCreateHandleTable( NULL );
 
         RtlZeroMemory( &ObjectTypeInitializer, sizeof( ObjectTypeInitializer ) );
         ObjectTypeInitializer.Length = sizeof( ObjectTypeInitializer );
@@ -474,8 +471,7 @@ ObDupHandleProcedure(
         return( FALSE );
         }
 
-    ObjectHeader = (POBJECT_HEADER)
-        (ObjectTableEntry->Attributes & ~OBJ_HANDLE_ATTRIBUTES);
+    ObjectHeader = ObpGetObjectTableEntryHeader(ObjectTableEntry);
 
     Object = &ObjectHeader->Body;
 #if i386 && !FPO
@@ -613,10 +609,7 @@ Return Value:
         }
     else {
         OldObjectTable = NULL;
-        NewObjectTable = ExCreateHandleTable( NewProcess,
-                                              0,
-                                              0
-                                            );
+        NewObjectTable = ExCreateHandleTable( NewProcess );
         }
 
     if (NewObjectTable) {
@@ -797,7 +790,7 @@ Return Value:
     ULONG HandleAttributes;
     POBP_FIND_HANDLE_DATA MatchCriteria = EnumParameter;
 
-    ObjectHeader = (POBJECT_HEADER)((ULONG)ObjectTableEntry->ObjectHeader & ~OBJ_HANDLE_ATTRIBUTES);
+    ObjectHeader = ObpGetObjectTableEntryHeader(ObjectTableEntry);
     if (MatchCriteria->ObjectHeader != NULL &&
         MatchCriteria->ObjectHeader != ObjectHeader
        ) {
@@ -264,6 +264,15 @@ PACCESS_MASK ObpCachedGrantedAccesses;
 
 #define OBJ_HANDLE_ATTRIBUTES (OBJ_PROTECT_CLOSE | OBJ_INHERIT | OBJ_AUDIT_OBJECT_CLOSE)
 
+//
+// The following macro computes the address of the object header from the
+// Object field of an ObjectTableEntry. The high bit of the field is clear
+// while the handle entry is locked, so it is always set here.
+//
+
+#define ObpGetObjectTableEntryHeader(e) \
+    ((POBJECT_HEADER)(((e)->Attributes | EX_HANDLE_ENTRY_LOCK_BIT) & ~OBJ_HANDLE_ATTRIBUTES))
+
 //
 // Security Descriptor Cache
 //
@@ -626,19 +626,18 @@ ObQueryObjectAuditingByHandle(
     ObjectTable = ObpGetObjectTable();
     ObjectTableEntry = (POBJECT_TABLE_ENTRY)ExMapHandleToPointer(
                    ObjectTable,
-                   (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle ),
-                   TRUE         // shared access
+                   (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle )
                    );
 
     if (ObjectTableEntry != NULL) {
-        ObjectHeader = (POBJECT_HEADER)(ObjectTableEntry->Attributes & ~OBJ_HANDLE_ATTRIBUTES);
+        ObjectHeader = ObpGetObjectTableEntryHeader(ObjectTableEntry);
         CapturedAttributes = (ULONG)(ObjectTableEntry->Attributes);
         if (CapturedAttributes & OBJ_AUDIT_OBJECT_CLOSE) {
             *GenerateOnClose = TRUE;
         } else {
             *GenerateOnClose = FALSE;
         }
-        ExUnlockHandleTableShared(ObjectTable);
+        ExUnlockHandleTableEntry(ObjectTable, (PHANDLE_ENTRY)ObjectTableEntry);
         return(STATUS_SUCCESS);
     } else {
         return(STATUS_INVALID_HANDLE);
@@ -430,9 +430,6 @@ ObReferenceObjectByHandle(
     POBJECT_TABLE_ENTRY ObjectTableEntry;
     PEPROCESS Process;
     NTSTATUS Status;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
-    ULONG TableIndex;
     PETHREAD Thread;
 
     ObpValidateIrql("ObReferenceObjectByHandle");
@@ -446,93 +443,82 @@ ObReferenceObjectByHandle(
     if ((LONG)Handle >= 0) {
 
         //
-        // Lock the current process object handle table and translate the
-        // specified handle to an object table index.
+        // Map the specified handle to a locked handle entry in the current
+        // process object handle table.
+        //
+        // N.B. The handle table is not locked. The handle entry is locked
+        //      until the object has been referenced.
         //
 
         HandleTable = ObpGetObjectTable();
 
         ASSERT(HandleTable != NULL);
 
-        ExLockHandleTableShared(HandleTable);
+        HandleEntry = ExMapHandleToPointer(HandleTable,
+                                           (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX(Handle));
 
         //
-        // If the object table index is less than the number of entires in
-        // the handle table, then get the contents of the handle table entry.
+        // If the handle table entry is in use, then compute the address of
+        // the object header.
         //
 
-        TableIndex = HANDLE_TO_INDEX(OBJ_HANDLE_TO_HANDLE_INDEX(Handle));
-        TableBound = HandleTable->TableBound;
-        TableEntries = HandleTable->TableEntries;
-        if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-            HandleEntry = &TableEntries[TableIndex];
+        if (HandleEntry != NULL) {
 
             //
-            // If the handle table entry is not free, then compute the address
-            // of the object header.
+            // If the object type matches the specified object type or the
+            // the specified objec type is NULL, then determine whether
+            // access to the object is allowed.
             //
 
-            if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-
-                //
-                // If the object type matches the specified object type or the
-                // the specified objec type is NULL, then determine whether
-                // access to the object is allowed.
-                //
-
-                ObjectTableEntry = (POBJECT_TABLE_ENTRY)HandleEntry;
-                ObjectHeader = (POBJECT_HEADER)(ObjectTableEntry->Attributes & ~OBJ_HANDLE_ATTRIBUTES);
-                if ((ObjectHeader->Type == ObjectType) || (ObjectType == NULL)) {
+            ObjectTableEntry = (POBJECT_TABLE_ENTRY)HandleEntry;
+            ObjectHeader = ObpGetObjectTableEntryHeader(ObjectTableEntry);
+            if ((ObjectHeader->Type == ObjectType) || (ObjectType == NULL)) {
 
 #if i386 && !FPO
-                    if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
-                        if ((AccessMode != KernelMode) ||
-                            ARGUMENT_PRESENT(HandleInformation)) {
-                            GrantedAccess = ObpTranslateGrantedAccessIndex( ObjectTableEntry->GrantedAccessIndex );
-                        }
+                if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
+                    if ((AccessMode != KernelMode) ||
+                        ARGUMENT_PRESENT(HandleInformation)) {
+                        GrantedAccess = ObpTranslateGrantedAccessIndex( ObjectTableEntry->GrantedAccessIndex );
+                    }
 
-                    } else
+                } else
 #endif // i386 && !FPO
 
-                    GrantedAccess = ObjectTableEntry->GrantedAccess;
-                    if ((SeComputeDeniedAccesses(GrantedAccess, DesiredAccess) == 0) ||
-                        (AccessMode == KernelMode)) {
-
-                        //
-                        // Access to the object is allowed. Return the handle
-                        // information is requested, increment the object
-                        // pointer count, unlock the handle table and return
-                        // a success status.
-                        //
-
-                        if (ARGUMENT_PRESENT(HandleInformation)) {
-                            HandleInformation->GrantedAccess = GrantedAccess;
-                            HandleInformation->HandleAttributes = ObjectTableEntry->Attributes & OBJ_HANDLE_ATTRIBUTES;
-                        }
+                GrantedAccess = ObjectTableEntry->GrantedAccess;
+                if ((SeComputeDeniedAccesses(GrantedAccess, DesiredAccess) == 0) ||
+                    (AccessMode == KernelMode)) {
 
-                        ObpIncrPointerCount(ObjectHeader);
-                        *Object = &ObjectHeader->Body;
-                        ExUnlockHandleTableShared(HandleTable);
-                        return STATUS_SUCCESS;
+                    //
+                    // Access to the object is allowed. Return the handle
+                    // information is requested, increment the object
+                    // pointer count, unlock the handle entry and return
+                    // a success status.
+                    //
 
-                    } else {
-                        Status = STATUS_ACCESS_DENIED;
+                    if (ARGUMENT_PRESENT(HandleInformation)) {
+                        HandleInformation->GrantedAccess = GrantedAccess;
+                        HandleInformation->HandleAttributes = ObjectTableEntry->Attributes & OBJ_HANDLE_ATTRIBUTES;
                     }
 
+                    ObpIncrPointerCount(ObjectHeader);
+                    *Object = &ObjectHeader->Body;
+                    ExUnlockHandleTableEntry(HandleTable, HandleEntry);
+                    return STATUS_SUCCESS;
+
                 } else {
-                    Status = STATUS_OBJECT_TYPE_MISMATCH;
+                    Status = STATUS_ACCESS_DENIED;
                 }
 
             } else {
-                Status = STATUS_INVALID_HANDLE;
+                Status = STATUS_OBJECT_TYPE_MISMATCH;
             }
 
+            ExUnlockHandleTableEntry(HandleTable, HandleEntry);
+
         } else {
             Status = STATUS_INVALID_HANDLE;
         }
 
-        ExUnlockHandleTableShared(HandleTable);
-
     //
     // If the handle is equal to the current process handle and the object
     // type is NULL or type process, then attempt to translate a handle to
@@ -449,10 +449,7 @@ Return Value:
     ACCESS_MASK GrantedAccess;
     PVOID WaitObjects[MAXIMUM_WAIT_OBJECTS];
     PHANDLE_TABLE HandleTable;
-    ULONG TableIndex;
     PHANDLE_ENTRY HandleEntry;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
 
     PAGED_CODE();
 
@@ -527,9 +524,6 @@ Return Value:
     //
 
     HandleTable = ObpGetObjectTable();
-    ExLockHandleTableShared( HandleTable );
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
 
     i = 0;
     RefCount = 0;
@@ -540,58 +534,54 @@ Return Value:
         // Get a referenced pointer to the specified objects with
         // synchronize access.
         //
+        // N.B. Each handle entry is locked while its object is referenced.
+        //      The handle table is not locked.
+        //
 
-        TableIndex = HANDLE_TO_INDEX( CapturedHandles[ i ] );
-        if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-            HandleEntry = &TableEntries[TableIndex];
-            if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
+        HandleEntry = ExMapHandleToPointer( HandleTable, CapturedHandles[ i ] );
+        if (HandleEntry != NULL) {
 #if i386 && !FPO
-                if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
-                    if (PreviousMode != KernelMode) {
-                        GrantedAccess = ObpTranslateGrantedAccessIndex( ((POBJECT_TABLE_ENTRY)HandleEntry)->GrantedAccessIndex );
-                        }
+            if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
+                if (PreviousMode != KernelMode) {
+                    GrantedAccess = ObpTranslateGrantedAccessIndex( ((POBJECT_TABLE_ENTRY)HandleEntry)->GrantedAccessIndex );
                     }
-                else
+                }
+            else
 #endif // i386 && !FPO
-                GrantedAccess = (ACCESS_MASK)HandleEntry->Attributes;
-                if ((PreviousMode != KernelMode) &&
-                    (SeComputeDeniedAccesses( GrantedAccess, SYNCHRONIZE ) != 0)) {
-                    Status = STATUS_ACCESS_DENIED;
-                    ExUnlockHandleTableShared( HandleTable );
-                    goto ServiceFailed;
+            GrantedAccess = (ACCESS_MASK)HandleEntry->Attributes;
+            if ((PreviousMode != KernelMode) &&
+                (SeComputeDeniedAccesses( GrantedAccess, SYNCHRONIZE ) != 0)) {
+                Status = STATUS_ACCESS_DENIED;
+                ExUnlockHandleTableEntry( HandleTable, HandleEntry );
+                goto ServiceFailed;
+                }
+            else {
+                ObjectHeader = ObpGetObjectTableEntryHeader( (POBJECT_TABLE_ENTRY)HandleEntry );
+
+                if ((LONG)ObjectHeader->Type->DefaultObject < 0) {
+                    RefCount += 1;
+                    Objects[i] = NULL;
+                    WaitObjects[i] = ObjectHeader->Type->DefaultObject;
                     }
                 else {
-                    ObjectHeader = (POBJECT_HEADER)((ULONG)HandleEntry->Object & ~OBJ_HANDLE_ATTRIBUTES);
-
-                    if ((LONG)ObjectHeader->Type->DefaultObject < 0) {
-                        RefCount += 1;
-                        Objects[i] = NULL;
-                        WaitObjects[i] = ObjectHeader->Type->DefaultObject;
-                        }
-                    else {
-                        ObpIncrPointerCount( ObjectHeader );
-                        RefCount += 1;
-                        Objects[i] = &ObjectHeader->Body;
-
-                        //
-                        // Compute the address of the kernel wait object.
-                        //
-
-                        WaitObjects[i] = (PVOID)((PCHAR)&ObjectHeader->Body +
-                                                 (ULONG)ObjectHeader->Type->DefaultObject
-                                                );
-                        }
+                    ObpIncrPointerCount( ObjectHeader );
+                    RefCount += 1;
+                    Objects[i] = &ObjectHeader->Body;
+
+                    //
+                    // Compute the address of the kernel wait object.
+                    //
+
+                    WaitObjects[i] = (PVOID)((PCHAR)&ObjectHeader->Body +
+                                             (ULONG)ObjectHeader->Type->DefaultObject
+                                            );
                     }
                 }
-            else {
-                Status = STATUS_INVALID_HANDLE;
-                ExUnlockHandleTableShared( HandleTable );
-                goto ServiceFailed;
-                }
+
+            ExUnlockHandleTableEntry( HandleTable, HandleEntry );
             }
         else {
             Status = STATUS_INVALID_HANDLE;
-            ExUnlockHandleTableShared( HandleTable );
             goto ServiceFailed;
             }
 
@@ -599,8 +589,6 @@ Return Value:
         }
     while (i < Count);
 
-    ExUnlockHandleTableShared( HandleTable );
-
     //
     // Check to determine if any of the objects are specified more than once.
     //
@@ -63,11 +63,11 @@ Return Value:
     PETHREAD lThread;
     NTSTATUS Status;
 
-    CidEntry = ExMapHandleToPointer(PspCidTable, Cid->UniqueThread, TRUE);
+    CidEntry = ExMapHandleToPointer(PspCidTable, Cid->UniqueThread);
     Status = STATUS_INVALID_CID;
     if (CidEntry != NULL) {
-        lThread = (PETHREAD)CidEntry->Object;
-        if ((lThread != (PETHREAD)PSP_INVALID_ID) &&
+        lThread = (PETHREAD)ExGetHandleEntryObject(CidEntry);
+        if ((CidEntry->Object != (PVOID)PSP_INVALID_ID) &&
             (lThread->Cid.UniqueProcess == Cid->UniqueProcess)) {
             if (ARGUMENT_PRESENT(Process)) {
                 *Process = THREAD_TO_PROCESS(lThread);
@@ -79,7 +79,7 @@ Return Value:
             Status = STATUS_SUCCESS;
         }
 
-        ExUnlockHandleTableShared(PspCidTable);
+        ExUnlockHandleTableEntry(PspCidTable, CidEntry);
     }
 
     return Status;
@@ -121,17 +121,17 @@ Return Value:
     PEPROCESS lProcess;
     NTSTATUS Status;
 
-    CidEntry = ExMapHandleToPointer(PspCidTable, ProcessId, TRUE);
+    CidEntry = ExMapHandleToPointer(PspCidTable, ProcessId);
     Status = STATUS_INVALID_PARAMETER;
     if (CidEntry != NULL) {
-        lProcess = (PEPROCESS)CidEntry->Object;
-        if (lProcess != (PEPROCESS)PSP_INVALID_ID) {
+        lProcess = (PEPROCESS)ExGetHandleEntryObject(CidEntry);
+        if (CidEntry->Object != (PVOID)PSP_INVALID_ID) {
             ObReferenceObject(lProcess);
             *Process = lProcess;
             Status = STATUS_SUCCESS;
         }
 
-        ExUnlockHandleTableShared(PspCidTable);
+        ExUnlockHandleTableEntry(PspCidTable, CidEntry);
     }
 
     return Status;
@@ -173,17 +173,17 @@ Return Value:
     PETHREAD lThread;
     NTSTATUS Status;
 
-    CidEntry = ExMapHandleToPointer(PspCidTable, ThreadId, TRUE);
+    CidEntry = ExMapHandleToPointer(PspCidTable, ThreadId);
     Status = STATUS_INVALID_PARAMETER;
     if (CidEntry != NULL) {
-        lThread = (PETHREAD)CidEntry->Object;
-        if (lThread != (PETHREAD)PSP_INVALID_ID) {
+        lThread = (PETHREAD)ExGetHandleEntryObject(CidEntry);
+        if (CidEntry->Object != (PVOID)PSP_INVALID_ID) {
             ObReferenceObject(lThread);
             *Thread = lThread;
             Status = STATUS_SUCCESS;
         }
 
-        ExUnlockHandleTableShared(PspCidTable);
+        ExUnlockHandleTableEntry(PspCidTable, CidEntry);
     }
 
     return Status;
@@ -607,6 +607,11 @@ PspMarkCidInvalid(
     IN ULONG Parameter
     )
 {
+    //
+    // N.B. The CID handle entry is locked while it is changed. The invalid
+    //      CID value leaves the lock bit of the object field clear.
+    //
+
     HandleEntry->Object = (PVOID)Parameter;
     return TRUE;
 }
@@ -1119,7 +1124,7 @@ PspProcessDelete(
         ObDereferenceObject(Process->ExceptionPort);
     }
     if ( Process->UniqueProcessId ) {
-        if ( !(ExDestroyHandle(PspCidTable,Process->UniqueProcessId,FALSE))) {
+        if ( !(ExDestroyHandle(PspCidTable,Process->UniqueProcessId,NULL))) {
             KeBugCheck(CID_HANDLE_DELETION);
         }
     }
@@ -1178,7 +1183,7 @@ PspThreadDelete(
         }
 
     if ( Thread->Cid.UniqueThread ) {
-        if (!(ExDestroyHandle(PspCidTable,Thread->Cid.UniqueThread,FALSE))) {
+        if (!(ExDestroyHandle(PspCidTable,Thread->Cid.UniqueThread,NULL))) {
             KeBugCheck(CID_HANDLE_DELETION);
             }
         }
@@ -454,7 +454,7 @@ Return Value:
     //      it will not be enumerated for object handle queries.
     //
 
-    PspCidTable = ExCreateHandleTable(NULL, 0, 0);
+    PspCidTable = ExCreateHandleTable(NULL);
     if ( ! PspCidTable ) {
         return FALSE;
     }
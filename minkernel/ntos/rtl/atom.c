@@ -114,7 +114,7 @@ RtlpInitializeHandleTableForAtomTable(
     )
 {
 #if defined(NTOS_KERNEL_RUNTIME)
-    AtomTable->ExHandleTable = ExCreateHandleTable( NULL, 64, 32 );
+    AtomTable->ExHandleTable = ExCreateHandleTable( NULL );
     if (AtomTable->ExHandleTable != NULL) {
         //
         // Make sure atom handle tables are NOT part of object handle enumeration
@@ -159,12 +159,11 @@ RtlpAtomMapAtomToHandleEntry(
     PRTL_ATOM_TABLE_ENTRY a;
 
     ExHandleEntry = ExMapHandleToPointer( AtomTable->ExHandleTable,
-                                          INDEX_TO_HANDLE( HandleIndex ),
-                                          TRUE
+                                          INDEX_TO_HANDLE( HandleIndex )
                                         );
     if (ExHandleEntry != NULL) {
-        a = ExHandleEntry->Object;
-        ExUnlockHandleTableShared( AtomTable->ExHandleTable );
+        a = ExGetHandleEntryObject( ExHandleEntry );
+        ExUnlockHandleTableEntry( AtomTable->ExHandleTable, ExHandleEntry );
         return a;
         }
 #else
@@ -229,7 +228,7 @@ RtlpFreeHandleForAtom(
     )
 {
 #if defined(NTOS_KERNEL_RUNTIME)
-    ExDestroyHandle( p->ExHandleTable, INDEX_TO_HANDLE( a->HandleIndex ), FALSE );
+    ExDestroyHandle( p->ExHandleTable, INDEX_TO_HANDLE( a->HandleIndex ), NULL );
 #else
     PRTL_ATOM_HANDLE_TABLE_ENTRY HandleEntry;
 
@@ -0,0 +1,1203 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    AvlTable.c
+
+Abstract:
+
+    This module implements the AVL generic table package.  It has the same
+    interface and callback contract as the splay tree generic table package
+    in gentable.c, but the tree is kept balanced by height, so a lookup
+    never has to rearrange the tree.  Lookups and enumerations that do not
+    splay only read the table, and can run concurrently with each other
+    under a shared lock.
+
+    Like the splay package, each element is allocated as the tree links,
+    followed by a list entry that keeps the elements in the order they were
+    inserted, followed by the user data:
+
+        RTL_BALANCED_LINKS,
+        LIST_ENTRY,
+        USER_DATA
+
+    The balance of a node is the height of its right subtree minus the
+    height of its left subtree, and is always -1, 0 or 1 between calls.
+
+Environment:
+
+    Pure Utility Routines
+
+Revision History:
+
+--*/
+
+#include <nt.h>
+
+#include <ntrtl.h>
+
+//
+//  Convert between the links of an element and its user data
+//
+
+#define AvlUserData(Links) \
+    ((PVOID)(((PLIST_ENTRY)((PVOID)((Links)+1)))+1))
+
+#define AvlInsertOrderEntry(Links) \
+    ((PLIST_ENTRY)((PVOID)((Links)+1)))
+
+//
+//  This enumerated type is used as the function return value of the
+//  function that is used to search the tree for a key, exactly as in the
+//  splay tree package.
+//
+
+typedef enum _SEARCH_RESULT{
+    EmptyTree,
+    FoundNode,
+    InsertAsLeft,
+    InsertAsRight
+} SEARCH_RESULT;
+
+
+static
+SEARCH_RESULT
+FindNodeOrParent(
+    IN PRTL_AVL_TABLE Table,
+    IN PVOID Buffer,
+    OUT PRTL_BALANCED_LINKS *NodeOrParent
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is used by all of the routines of the AVL generic table
+    package to locate a node in the tree.  It will find and return (via
+    the NodeOrParent parameter) the node with the given key, or if that
+    node is not in the tree it will return (via the NodeOrParent parameter)
+    a pointer to the parent.  The tree is not changed.
+
+Arguments:
+
+    Table - The generic table to search for the key.
+
+    Buffer - Pointer to a buffer holding the key.  The table package
+             doesn't examine the key itself.  It leaves this up to the
+             user supplied compare routine.
+
+    NodeOrParent - Will be set to point to the node containing the key or
+                   what should be the parent of the node if it were in the
+                   tree.  Note that this will *NOT* be set if the search
+                   result is EmptyTree.
+
+Return Value:
+
+    SEARCH_RESULT - EmptyTree: The tree was empty.  NodeOrParent
+                               is *not* altered.
+
+                    FoundNode: A node with the key is in the tree.
+                               NodeOrParent points to that node.
+
+                    InsertAsLeft: Node with key was not found.
+                                  NodeOrParent points to what would be
+                                  parent.  The node would be the left
+                                  child.
+
+                    InsertAsRight: Node with key was not found.
+                                   NodeOrParent points to what would be
+                                   parent.  The node would be the right
+                                   child.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS NodeToExamine;
+    PRTL_BALANCED_LINKS Child;
+    RTL_GENERIC_COMPARE_RESULTS Result;
+
+    NodeToExamine = Table->TableRoot;
+
+    if (NodeToExamine == NULL) {
+
+        return EmptyTree;
+    }
+
+    while (TRUE) {
+
+        //
+        // Compare the buffer with the key in the tree element.
+        //
+
+        Result = Table->CompareRoutine( Table,
+                                        Buffer,
+                                        AvlUserData(NodeToExamine) );
+
+        if (Result == GenericLessThan) {
+
+            if ((Child = NodeToExamine->LeftChild) == NULL) {
+
+                *NodeOrParent = NodeToExamine;
+                return InsertAsLeft;
+            }
+
+        } else if (Result == GenericGreaterThan) {
+
+            if ((Child = NodeToExamine->RightChild) == NULL) {
+
+                *NodeOrParent = NodeToExamine;
+                return InsertAsRight;
+            }
+
+        } else {
+
+            ASSERT(Result == GenericEqual);
+
+            *NodeOrParent = NodeToExamine;
+            return FoundNode;
+        }
+
+        NodeToExamine = Child;
+    }
+}
+
+
+static
+PRTL_BALANCED_LINKS
+RealSuccessor (
+    IN PRTL_BALANCED_LINKS Links
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the node that follows the input node in key order
+    within the entire tree, or NULL if there is none.
+
+Arguments:
+
+    Links - Supplies the node to start from.
+
+Return Value:
+
+    PRTL_BALANCED_LINKS - The successor of the node.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS Ptr;
+
+    //
+    //  If there is a right subtree the successor is its leftmost node,
+    //  otherwise it is the first ancestor we reach from its left side.
+    //
+
+    if ((Ptr = Links->RightChild) != NULL) {
+
+        while (Ptr->LeftChild != NULL) {
+
+            Ptr = Ptr->LeftChild;
+        }
+
+        return Ptr;
+    }
+
+    Ptr = Links;
+
+    while ((Ptr->Parent != NULL) && (Ptr->Parent->RightChild == Ptr)) {
+
+        Ptr = Ptr->Parent;
+    }
+
+    return Ptr->Parent;
+}
+
+
+static
+PRTL_BALANCED_LINKS
+RealPredecessor (
+    IN PRTL_BALANCED_LINKS Links
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the node that precedes the input node in key
+    order within the entire tree, or NULL if there is none.
+
+Arguments:
+
+    Links - Supplies the node to start from.
+
+Return Value:
+
+    PRTL_BALANCED_LINKS - The predecessor of the node.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS Ptr;
+
+    if ((Ptr = Links->LeftChild) != NULL) {
+
+        while (Ptr->RightChild != NULL) {
+
+            Ptr = Ptr->RightChild;
+        }
+
+        return Ptr;
+    }
+
+    Ptr = Links;
+
+    while ((Ptr->Parent != NULL) && (Ptr->Parent->LeftChild == Ptr)) {
+
+        Ptr = Ptr->Parent;
+    }
+
+    return Ptr->Parent;
+}
+
+
+static
+VOID
+PromoteNode (
+    IN PRTL_AVL_TABLE Table,
+    IN PRTL_BALANCED_LINKS Links
+    )
+
+/*++
+
+Routine Description:
+
+    This routine does a single rotation that moves the input node up one
+    level, making its parent its child.  The key order of the tree does
+    not change.  Balance factors are left for the caller to fix up.
+
+Arguments:
+
+    Table - Supplies the table, whose root changes if the parent of the
+        node was the root.
+
+    Links - Supplies the node to move up.  It must have a parent.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS Parent;
+    PRTL_BALANCED_LINKS GrandParent;
+
+    Parent = Links->Parent;
+    GrandParent = Parent->Parent;
+
+    //
+    //  The inner subtree of the node moves across to the parent
+    //
+
+    if (Parent->LeftChild == Links) {
+
+        Parent->LeftChild = Links->RightChild;
+
+        if (Links->RightChild != NULL) {
+
+            Links->RightChild->Parent = Parent;
+        }
+
+        Links->RightChild = Parent;
+
+    } else {
+
+        Parent->RightChild = Links->LeftChild;
+
+        if (Links->LeftChild != NULL) {
+
+            Links->LeftChild->Parent = Parent;
+        }
+
+        Links->LeftChild = Parent;
+    }
+
+    Parent->Parent = Links;
+    Links->Parent = GrandParent;
+
+    if (GrandParent == NULL) {
+
+        Table->TableRoot = Links;
+
+    } else if (GrandParent->LeftChild == Parent) {
+
+        GrandParent->LeftChild = Links;
+
+    } else {
+
+        GrandParent->RightChild = Links;
+    }
+}
+
+
+static
+PRTL_BALANCED_LINKS
+RebalanceNode (
+    IN PRTL_AVL_TABLE Table,
+    IN PRTL_BALANCED_LINKS Links,
+    OUT PBOOLEAN HeightChanged
+    )
+
+/*++
+
+Routine Description:
+
+    This routine restores the balance of a node whose balance has become
+    -2 or 2 after an insert or delete below it, with a single or a double
+    rotation.
+
+Arguments:
+
+    Table - Supplies the table the node is in.
+
+    Links - Supplies the node that is out of balance.
+
+    HeightChanged - Receives TRUE if the subtree is now one shorter than it
+        was before the rotation, and FALSE if its height is unchanged.
+        After an insert the height always goes back to what it was before
+        the insert.
+
+Return Value:
+
+    PRTL_BALANCED_LINKS - The new root of the subtree.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS Child;
+    PRTL_BALANCED_LINKS GrandChild;
+    CHAR Direction;
+
+    //
+    //  Direction is -1 if the left subtree is too tall and 1 if the right
+    //  subtree is.  Child is the root of that subtree.
+    //
+
+    if (Links->Balance < 0) {
+
+        Direction = -1;
+        Child = Links->LeftChild;
+
+    } else {
+
+        Direction = 1;
+        Child = Links->RightChild;
+    }
+
+    if (Child->Balance != -Direction) {
+
+        //
+        //  The child leans the same way, or not at all, which only happens
+        //  after a delete.  A single rotation fixes it.
+        //
+
+        PromoteNode( Table, Child );
+
+        if (Child->Balance == 0) {
+
+            Links->Balance = Direction;
+            Child->Balance = -Direction;
+            *HeightChanged = FALSE;
+
+        } else {
+
+            Links->Balance = 0;
+            Child->Balance = 0;
+            *HeightChanged = TRUE;
+        }
+
+        return Child;
+    }
+
+    //
+    //  The child leans the other way, so its inner child goes to the top
+    //  with a double rotation.
+    //
+
+    GrandChild = (Direction < 0) ? Child->RightChild : Child->LeftChild;
+
+    PromoteNode( Table, GrandChild );
+    PromoteNode( Table, GrandChild );
+
+    Links->Balance = (GrandChild->Balance == Direction) ? -Direction : 0;
+    Child->Balance = (GrandChild->Balance == -Direction) ? Direction : 0;
+    GrandChild->Balance = 0;
+
+    *HeightChanged = TRUE;
+
+    return GrandChild;
+}
+
+
+VOID
+RtlInitializeGenericTableAvl (
+    IN PRTL_AVL_TABLE Table,
+    IN PRTL_AVL_COMPARE_ROUTINE CompareRoutine,
+    IN PRTL_AVL_ALLOCATE_ROUTINE AllocateRoutine,
+    IN PRTL_AVL_FREE_ROUTINE FreeRoutine,
+    IN PVOID TableContext
+    )
+
+/*++
+
+Routine Description:
+
+    The procedure InitializeGenericTableAvl takes as input an uninitialized
+    generic table variable and pointers to the three user supplied routines.
+    This must be called for every individual generic table variable before
+    it can be used.
+
+Arguments:
+
+    Table - Pointer to the generic table to be initialized.
+
+    CompareRoutine - User routine to be used to compare to keys in the
+                     table.
+
+    AllocateRoutine - User routine to call to allocate memory for a new
+                      node in the generic table.
+
+    FreeRoutine - User routine to call to deallocate memory for
+                        a node in the generic table.
+
+    TableContext - Supplies user supplied context for the table.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    Table->TableRoot = NULL;
+    InitializeListHead(&Table->InsertOrderList);
+    Table->NumberGenericTableElements = 0;
+    Table->OrderedPointer = &Table->InsertOrderList;
+    Table->WhichOrderedElement = 0;
+    Table->RestartKey = NULL;
+    Table->CompareRoutine = CompareRoutine;
+    Table->AllocateRoutine = AllocateRoutine;
+    Table->FreeRoutine = FreeRoutine;
+    Table->TableContext = TableContext;
+}
+
+
+PVOID
+RtlInsertElementGenericTableAvl (
+    IN PRTL_AVL_TABLE Table,
+    IN PVOID Buffer,
+    IN CLONG BufferSize,
+    OUT PBOOLEAN NewElement OPTIONAL
+    )
+
+/*++
+
+Routine Description:
+
+    The function InsertElementGenericTableAvl will insert a new element
+    in a table.  It does this by allocating space for the new element
+    (this includes the tree links), inserting the element in the table,
+    and then returning to the user a pointer to the new element.  If an
+    element with the same key already exists in the table the return
+    value is a pointer to the old element.  The optional output parameter
+    NewElement is used to indicate if the element previously existed in
+    the table.  Note: the user supplied Buffer is only used for searching
+    the table, upon insertion its contents are copied to the newly created
+    element.  This means that pointer to the input buffer will not point
+    to the new element.
+
+Arguments:
+
+    Table - Pointer to the table in which to (possibly) insert the
+            key buffer.
+
+    Buffer - Passed to the user comparasion routine.  Its contents are
+             up to the user but one could imagine that it contains some
+             sort of key value.
+
+    BufferSize - The amount of space to allocate when the (possible)
+                 insertion is made.  Note that if we actually do not find
+                 the node and we do allocate space then we will add the
+                 size of the tree links and the insert order list entry
+                 to this buffer size.  The user should really take care
+                 not to depend on anything in those first bytes of the
+                 memory allocated via the memory allocation routine.
+
+    NewElement - Optional Flag.  If present then it will be set to
+                 TRUE if the buffer was not "found" in the generic
+                 table.
+
+Return Value:
+
+    PVOID - Pointer to the user defined data.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS NodeOrParent;
+    PRTL_BALANCED_LINKS NodeToReturn;
+    PRTL_BALANCED_LINKS Node;
+    PRTL_BALANCED_LINKS Parent;
+    SEARCH_RESULT Lookup;
+    BOOLEAN HeightChanged;
+
+    Lookup = FindNodeOrParent( Table, Buffer, &NodeOrParent );
+
+    if (Lookup == FoundNode) {
+
+        if (ARGUMENT_PRESENT(NewElement)) {
+
+            *NewElement = FALSE;
+        }
+
+        return AvlUserData(NodeOrParent);
+    }
+
+    ASSERT(Table->NumberGenericTableElements != (MAXULONG-1));
+
+    //
+    // The node wasn't in the (possibly empty) tree.  Call the user
+    // allocation routine to get space for the new node.
+    //
+
+    NodeToReturn = Table->AllocateRoutine( Table,
+                                           BufferSize +
+                                               sizeof(RTL_BALANCED_LINKS) +
+                                               sizeof(LIST_ENTRY) );
+
+    if (NodeToReturn == NULL) {
+
+        if (ARGUMENT_PRESENT(NewElement)) {
+
+            *NewElement = FALSE;
+        }
+
+        return NULL;
+    }
+
+    NodeToReturn->LeftChild = NULL;
+    NodeToReturn->RightChild = NULL;
+    NodeToReturn->Balance = 0;
+
+    //
+    // Insert the new node at the end of the ordered linked list.
+    //
+
+    InsertTailList( &Table->InsertOrderList,
+                    AvlInsertOrderEntry(NodeToReturn) );
+
+    Table->NumberGenericTableElements++;
+
+    //
+    // Copy the users buffer into the user data area of the table.
+    //
+
+    RtlCopyMemory( AvlUserData(NodeToReturn), Buffer, BufferSize );
+
+    //
+    // Hang the new node off its parent.
+    //
+
+    if (Lookup == EmptyTree) {
+
+        NodeToReturn->Parent = NULL;
+        Table->TableRoot = NodeToReturn;
+
+    } else {
+
+        NodeToReturn->Parent = NodeOrParent;
+
+        if (Lookup == InsertAsLeft) {
+
+            NodeOrParent->LeftChild = NodeToReturn;
+
+        } else {
+
+            NodeOrParent->RightChild = NodeToReturn;
+        }
+
+        //
+        // Walk back up the tree while the subtree we came from has grown.
+        // The walk stops at the first node that becomes balanced, and a
+        // node that becomes too unbalanced is rotated back into shape,
+        // which leaves its subtree as tall as it was before the insert.
+        //
+
+        Node = NodeToReturn;
+
+        while ((Parent = Node->Parent) != NULL) {
+
+            Parent->Balance += (Parent->LeftChild == Node) ? -1 : 1;
+
+            if (Parent->Balance == 0) {
+
+                break;
+            }
+
+            if ((Parent->Balance == -2) || (Parent->Balance == 2)) {
+
+                RebalanceNode( Table, Parent, &HeightChanged );
+                break;
+            }
+
+            Node = Parent;
+        }
+    }
+
+    if (ARGUMENT_PRESENT(NewElement)) {
+
+        *NewElement = TRUE;
+    }
+
+    return AvlUserData(NodeToReturn);
+}
+
+
+BOOLEAN
+RtlDeleteElementGenericTableAvl (
+    IN PRTL_AVL_TABLE Table,
+    IN PVOID Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    The function DeleteElementGenericTableAvl will find and delete an
+    element from a generic table.  If the element is located and deleted
+    the return value is TRUE, otherwise if the element is not located the
+    return value is FALSE.  The user supplied input buffer is only used as
+    a key in locating the element in the table.
+
+Arguments:
+
+    Table - Pointer to the table in which to (possibly) delete the
+            memory accessed by the key buffer.
+
+    Buffer - Passed to the user comparasion routine.  Its contents are
+             up to the user but one could imagine that it contains some
+             sort of key value.
+
+Return Value:
+
+    BOOLEAN - If the table contained the key then true, otherwise false.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS NodeToDelete;
+    PRTL_BALANCED_LINKS Target;
+    PRTL_BALANCED_LINKS Child;
+    PRTL_BALANCED_LINKS Parent;
+    PRTL_BALANCED_LINKS Node;
+    SEARCH_RESULT Lookup;
+    BOOLEAN FromLeft;
+    BOOLEAN HeightChanged;
+
+    Lookup = FindNodeOrParent( Table, Buffer, &NodeToDelete );
+
+    if (Lookup != FoundNode) {
+
+        return FALSE;
+    }
+
+    //
+    // If an enumeration is positioned on this node, back it up to the
+    // previous node so the enumeration continues with the next one.
+    //
+
+    if (Table->RestartKey == NodeToDelete) {
+
+        Table->RestartKey = RealPredecessor( NodeToDelete );
+    }
+
+    //
+    // The node unlinked from the tree is the node being deleted if it has
+    // at most one child, and otherwise its successor, which has no left
+    // child and is moved into the deleted node's place below.  The user
+    // data never moves, since callers hold pointers to it.
+    //
+
+    if ((NodeToDelete->LeftChild == NULL) || (NodeToDelete->RightChild == NULL)) {
+
+        Target = NodeToDelete;
+
+    } else {
+
+        Target = NodeToDelete->RightChild;
+
+        while (Target->LeftChild != NULL) {
+
+            Target = Target->LeftChild;
+        }
+    }
+
+    Child = (Target->LeftChild != NULL) ? Target->LeftChild : Target->RightChild;
+    Parent = Target->Parent;
+    FromLeft = FALSE;
+
+    if (Child != NULL) {
+
+        Child->Parent = Parent;
+    }
+
+    if (Parent == NULL) {
+
+        Table->TableRoot = Child;
+
+    } else if (Parent->LeftChild == Target) {
+
+        Parent->LeftChild = Child;
+        FromLeft = TRUE;
+
+    } else {
+
+        Parent->RightChild = Child;
+    }
+
+    if (Target != NodeToDelete) {
+
+        //
+        // Put the successor where the deleted node was.  If the successor
+        // was the deleted node's own child, the rebalancing below starts
+        // at the successor in its new position.
+        //
+
+        Target->LeftChild = NodeToDelete->LeftChild;
+        Target->RightChild = NodeToDelete->RightChild;
+        Target->Parent = NodeToDelete->Parent;
+        Target->Balance = NodeToDelete->Balance;
+
+        if (Target->LeftChild != NULL) {
+
+            Target->LeftChild->Parent = Target;
+        }
+
+        if (Target->RightChild != NULL) {
+
+            Target->RightChild->Parent = Target;
+        }
+
+        if (Target->Parent == NULL) {
+
+            Table->TableRoot = Target;
+
+        } else if (Target->Parent->LeftChild == NodeToDelete) {
+
+            Target->Parent->LeftChild = Target;
+
+        } else {
+
+            Target->Parent->RightChild = Target;
+        }
+
+        if (Parent == NodeToDelete) {
+
+            Parent = Target;
+        }
+    }
+
+    //
+    // Walk back up the tree while the subtree we came from has shrunk.
+    // The walk stops at the first node whose height does not change.
+    //
+
+    while (Parent != NULL) {
+
+        Parent->Balance += FromLeft ? 1 : -1;
+
+        if ((Parent->Balance == -1) || (Parent->Balance == 1)) {
+
+            break;
+        }
+
+        Node = Parent;
+
+        if (Parent->Balance != 0) {
+
+            Node = RebalanceNode( Table, Parent, &HeightChanged );
+
+            if (!HeightChanged) {
+
+                break;
+            }
+        }
+
+        Parent = Node->Parent;
+
+        if (Parent != NULL) {
+
+            FromLeft = (BOOLEAN)(Parent->LeftChild == Node);
+        }
+    }
+
+    //
+    // Delete the element from the linked list.
+    //
+
+    RemoveEntryList( AvlInsertOrderEntry(NodeToDelete) );
+    Table->NumberGenericTableElements--;
+    Table->WhichOrderedElement = 0;
+    Table->OrderedPointer = &Table->InsertOrderList;
+
+    //
+    // Give the node to the user deletion routine.  As in the splay tree
+    // package the routine gets a pointer to the links rather than to the
+    // user data.
+    //
+
+    Table->FreeRoutine( Table, NodeToDelete );
+
+    return TRUE;
+}
+
+
+PVOID
+RtlLookupElementGenericTableAvl (
+    IN PRTL_AVL_TABLE Table,
+    IN PVOID Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    The function LookupElementGenericTableAvl will find an element in a
+    generic table.  If the element is located the return value is a
+    pointer to the user defined structure associated with the element,
+    otherwise if the element is not located the return value is NULL.  The
+    user supplied input buffer is only used as a key in locating the
+    element in the table.  The table is not changed, so lookups may be
+    done under a shared lock.
+
+Arguments:
+
+    Table - Pointer to the users Generic table to search for the key.
+
+    Buffer - Used for the comparasion.
+
+Return Value:
+
+    PVOID - returns a pointer to the user data.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS NodeOrParent;
+
+    if (FindNodeOrParent( Table, Buffer, &NodeOrParent ) != FoundNode) {
+
+        return NULL;
+    }
+
+    return AvlUserData(NodeOrParent);
+}
+
+
+PVOID
+RtlEnumerateGenericTableAvl (
+    IN PRTL_AVL_TABLE Table,
+    IN BOOLEAN Restart
+    )
+
+/*++
+
+Routine Description:
+
+    The function EnumerateGenericTableAvl will return to the caller
+    one-by-one the elements of of a table, in key order.  The return value
+    is a pointer to the user defined structure associated with the element.
+    The input parameter Restart indicates if the enumeration should start
+    from the beginning or should return the next element.  If the are no
+    more new elements to return the return value is NULL.
+
+    The position of the enumeration is kept in the table, so unlike
+    lookups this routine needs exclusive access to the table.  Use
+    RtlEnumerateGenericTableWithoutSplayingAvl to enumerate under a shared
+    lock.
+
+Arguments:
+
+    Table - Pointer to the generic table to enumerate.
+
+    Restart - Flag that if true we should start with the least element in
+              the tree, otherwise return the element after the one
+              returned last.
+
+Return Value:
+
+    PVOID - Pointer to the user data.
+
+--*/
+
+{
+    if (Restart) {
+
+        Table->RestartKey = NULL;
+    }
+
+    return RtlEnumerateGenericTableWithoutSplayingAvl( Table,
+                                                       (PVOID *)&Table->RestartKey );
+}
+
+
+PVOID
+RtlEnumerateGenericTableWithoutSplayingAvl (
+    IN PRTL_AVL_TABLE Table,
+    IN PVOID *RestartKey
+    )
+
+/*++
+
+Routine Description:
+
+    The function EnumerateGenericTableWithoutSplayingAvl will return to the
+    caller one-by-one the elements of of a table, in key order.  The
+    return value is a pointer to the user defined structure associated with
+    the element.  The input parameter RestartKey indicates if the
+    enumeration should start from the beginning or should return the next
+    element.  If the are no more new elements to return the return value
+    is NULL.  As an example of its use, to enumerate all of the elements in
+    a table the user would write:
+
+        RestartKey = NULL;
+
+        for (ptr = EnumerateGenericTableWithoutSplayingAvl(Table, &RestartKey);
+             ptr != NULL;
+             ptr = EnumerateGenericTableWithoutSplayingAvl(Table, &RestartKey)) {
+                :
+        }
+
+    The table is not changed, so enumerations may be done under a shared
+    lock.  The name is kept from the splay tree package, where it matters.
+
+Arguments:
+
+    Table - Pointer to the generic table to enumerate.
+
+    RestartKey - Pointer that indicates if we should restart or return the
+                 next element.  If the contents of RestartKey is NULL, the
+                 search will be started from the beginning.
+
+Return Value:
+
+    PVOID - Pointer to the user data.
+
+--*/
+
+{
+    PRTL_BALANCED_LINKS NodeToReturn;
+
+    if (Table->TableRoot == NULL) {
+
+        return NULL;
+    }
+
+    if (*RestartKey == NULL) {
+
+        //
+        // Start with the leftmost node of the tree.
+        //
+
+        for (NodeToReturn = Table->TableRoot;
+             NodeToReturn->LeftChild != NULL;
+             NodeToReturn = NodeToReturn->LeftChild) {
+            ;
+        }
+
+    } else {
+
+        NodeToReturn = RealSuccessor( *RestartKey );
+    }
+
+    if (NodeToReturn == NULL) {
+
+        return NULL;
+    }
+
+    *RestartKey = NodeToReturn;
+
+    return AvlUserData(NodeToReturn);
+}
+
+
+BOOLEAN
+RtlIsGenericTableEmptyAvl (
+    IN PRTL_AVL_TABLE Table
+    )
+
+/*++
+
+Routine Description:
+
+    The function IsGenericTableEmptyAvl will return to the caller TRUE if
+    the input table is empty (i.e., does not contain any elements) and
+    FALSE otherwise.
+
+Arguments:
+
+    Table - Supplies a pointer to the Generic Table.
+
+Return Value:
+
+    BOOLEAN - if enabled the tree is empty.
+
+--*/
+
+{
+    return ((Table->TableRoot)?(FALSE):(TRUE));
+}
+
+
+PVOID
+RtlGetElementGenericTableAvl (
+    IN PRTL_AVL_TABLE Table,
+    IN ULONG I
+    )
+
+/*++
+
+Routine Description:
+
+    The function GetElementGenericTableAvl will return the i'th element
+    inserted in the generic table.  I = 0 implies the first element,
+    I = (RtlNumberGenericTableElementsAvl(Table)-1) will return the last
+    element inserted into the generic table.  The type of I is ULONG.
+    Values of I > than (NumberGenericTableElements(Table)-1) will return
+    NULL.  If an arbitrary element is deleted from the generic table it
+    will cause all elements inserted after the deleted element to "move
+    up".
+
+    The routine remembers the last element it returned in the table to
+    speed up the next call, so it needs exclusive access to the table.
+
+Arguments:
+
+    Table - Pointer to the generic table from which to get the ith element.
+
+    I - Which element to get.
+
+Return Value:
+
+    PVOID - Pointer to the user data.
+
+--*/
+
+{
+    ULONG CurrentLocation = Table->WhichOrderedElement;
+    ULONG NumberInTable = Table->NumberGenericTableElements;
+    ULONG NormalizedI = I + 1;
+    ULONG ForwardDistance,BackwardDistance;
+    PLIST_ENTRY CurrentNode = Table->OrderedPointer;
+
+    //
+    // If it's out of bounds get out quick.
+    //
+
+    if ((I == MAXULONG) || (NormalizedI > NumberInTable)) return NULL;
+
+    //
+    // If we're already at the node then return it.
+    //
+
+    if (NormalizedI == CurrentLocation) return CurrentNode+1;
+
+    //
+    // Walk the insert order list from the current position or from the
+    // list head, whichever is closer, in the same way as the splay tree
+    // package does.
+    //
+
+    if (CurrentLocation > NormalizedI) {
+
+        if (NormalizedI > (CurrentLocation/2)) {
+
+            for (BackwardDistance = CurrentLocation - NormalizedI;
+                 BackwardDistance;
+                 BackwardDistance--) {
+
+                CurrentNode = CurrentNode->Blink;
+            }
+
+        } else {
+
+            for (CurrentNode = &Table->InsertOrderList;
+                 NormalizedI;
+                 NormalizedI--) {
+
+                CurrentNode = CurrentNode->Flink;
+            }
+        }
+
+    } else {
+
+        ForwardDistance = NormalizedI - CurrentLocation;
+        BackwardDistance = (NumberInTable - NormalizedI) + 1;
+
+        if (ForwardDistance <= BackwardDistance) {
+
+            for (;
+                 ForwardDistance;
+                 ForwardDistance--) {
+
+                CurrentNode = CurrentNode->Flink;
+            }
+
+        } else {
+
+            for (CurrentNode = &Table->InsertOrderList;
+                 BackwardDistance;
+                 BackwardDistance--) {
+
+                CurrentNode = CurrentNode->Blink;
+            }
+        }
+    }
+
+    Table->OrderedPointer = CurrentNode;
+    Table->WhichOrderedElement = I+1;
+
+    return CurrentNode+1;
+}
+
+
+ULONG
+RtlNumberGenericTableElementsAvl (
+    IN PRTL_AVL_TABLE Table
+    )
+
+/*++
+
+Routine Description:
+
+    The function NumberGenericTableElementsAvl returns a ULONG value which
+    is the number of generic table elements currently inserted in the
+    generic table.
+
+Arguments:
+
+    Table - Pointer to the generic table from which to find out the number
+    of elements.
+
+Return Value:
+
+    ULONG - The number of elements in the generic table.
+
+--*/
+
+{
+    return Table->NumberGenericTableElements;
+}
@@ -31,8 +31,16 @@ Revision History:
 
 #if defined(ALLOC_PRAGMA) && defined(NTOS_KERNEL_RUNTIME)
 #pragma alloc_text(PAGE,RtlInitializeBitMap)
+#pragma alloc_text(PAGE,RtlInitializeSummaryBitMap)
 #endif
 
+VOID
+RtlpUpdateSummary (
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap,
+    IN ULONG FirstUlong,
+    IN ULONG LastUlong
+    );
+
 #define RightShiftUlong(E1,E2) ((E2) < 32 ? (E1) >> (E2) : 0)
 #define LeftShiftUlong(E1,E2)  ((E2) < 32 ? (E1) << (E2) : 0)
 
@@ -212,6 +220,35 @@ static UCHAR FillMask[] = { 0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF
 
 static UCHAR ZeroMask[] = { 0xFF, 0xFE, 0xFC, 0xF8, 0xf0, 0xe0, 0xc0, 0x80, 0x00 };
 
+//
+//  Mask with the low order N bits of a ulong set, for N less than 32
+//
+
+#define FillMaskUlong(N) (((ULONG)1 << (N)) - 1)
+
+//
+//  Macros that tell how many contiguous LOW and HIGH order bits are clear
+//  (i.e., 0) in a ulong.  A ulong of zero has 32 of each.
+//
+
+#define RtlpBitsClearLowUlong(U)                                    \
+    (((U) & 0xFFFF) ?                                               \
+        (((U) & 0xFF) ?                                             \
+            RtlpBitsClearLow[(U) & 0xFF] :                          \
+            RtlpBitsClearLow[((U) >> 8) & 0xFF] + 8) :              \
+        ((((U) >> 16) & 0xFF) ?                                     \
+            RtlpBitsClearLow[((U) >> 16) & 0xFF] + 16 :             \
+            RtlpBitsClearLow[(U) >> 24] + 24))
+
+#define RtlpBitsClearHighUlong(U)                                   \
+    (((U) & 0xFFFF0000) ?                                           \
+        (((U) & 0xFF000000) ?                                       \
+            RtlpBitsClearHigh[(U) >> 24] :                          \
+            RtlpBitsClearHigh[((U) >> 16) & 0xFF] + 8) :            \
+        (((U) & 0xFF00) ?                                           \
+            RtlpBitsClearHigh[((U) >> 8) & 0xFF] + 16 :             \
+            RtlpBitsClearHigh[(U) & 0xFF] + 24))
+
 
 VOID
 RtlInitializeBitMap (
@@ -259,6 +296,87 @@ Return Value:
     return;
 }
 
+
+VOID
+RtlInitializeSummaryBitMap (
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap,
+    IN PULONG BitMapBuffer,
+    IN ULONG SizeOfBitMap,
+    IN PULONG SummaryBuffer
+    )
+
+/*++
+
+Routine Description:
+
+    This procedure initializes a summary bitmap and builds its summary
+    from the current contents of the bitmap.  It can be called again on
+    the same buffers to rebuild the summary after the bitmap has been
+    changed behind its back.
+
+Arguments:
+
+    SummaryBitMap - Supplies a pointer to the summary bitmap to initialize.
+
+    BitMapBuffer - Supplies a pointer to the buffer that is to serve as the
+        BitMap.  This must be an a multiple number of longwords in size.
+
+    SizeOfBitMap - Supplies the number of bits required in the Bit Map.
+
+    SummaryBuffer - Supplies a pointer to the buffer that is to hold the
+        summary.  This must be RTL_SUMMARY_BUFFER_SIZE( SizeOfBitMap )
+        bytes in size.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    ULONG Level;
+    ULONG SizeInUlongs;
+
+    RTL_PAGED_CODE();
+
+    RtlInitializeBitMap( &SummaryBitMap->BitMap, BitMapBuffer, SizeOfBitMap );
+
+    //
+    //  Lay out the summary levels one after the other in the summary
+    //  buffer.  Each level has a bit for every ulong of the level below.
+    //
+
+    SizeInUlongs = (SizeOfBitMap + 31) / 32;
+
+    for (Level = 0; Level < RTL_SUMMARY_LEVELS; Level += 1) {
+
+        RtlInitializeBitMap( &SummaryBitMap->Summary[Level],
+                             SummaryBuffer,
+                             SizeInUlongs );
+
+        //
+        //  Start with every summary bit set so that the unused bits at the
+        //  end of each level always read as full ulongs.
+        //
+
+        RtlSetAllBits( &SummaryBitMap->Summary[Level] );
+
+        SummaryBuffer += (SizeInUlongs + 31) / 32;
+        SizeInUlongs = (SizeInUlongs + 31) / 32;
+    }
+
+    //
+    //  Now compute the real summary bits
+    //
+
+    if (SizeOfBitMap != 0) {
+
+        RtlpUpdateSummary( SummaryBitMap, 0, ((SizeOfBitMap + 31) / 32) - 1 );
+    }
+
+    return;
+}
+
 
 VOID
 RtlClearAllBits (
@@ -339,527 +457,526 @@ Return Value:
 }
 
 
-ULONG
-RtlFindClearBits (
-    IN PRTL_BITMAP BitMapHeader,
-    IN ULONG NumberToFind,
-    IN ULONG HintIndex
+VOID
+RtlpUpdateSummary (
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap,
+    IN ULONG FirstUlong,
+    IN ULONG LastUlong
     )
 
 /*++
 
 Routine Description:
 
-    This procedure searches the specified bit map for the specified
-    contiguous region of clear bits.  If a run is not found from the
-    hint to the end of the bitmap, we will search again from the
-    beginning of the bitmap.
+    This procedure recomputes the summary bits for a range of ulongs of a
+    summary bitmap, at every level of the summary.  It must be called after
+    any bits within the range have been set or cleared.
 
 Arguments:
 
-    BitMapHeader - Supplies a pointer to the previously initialized BitMap.
+    SummaryBitMap - Supplies a pointer to the previously initialized summary
+        bitmap.
 
-    NumberToFind - Supplies the size of the contiguous region to find.
+    FirstUlong - Supplies the index of the first ulong of the bitmap that
+        changed.
 
-    HintIndex - Supplies the index (zero based) of where we should start
-        the search from within the bitmap.
+    LastUlong - Supplies the index of the last ulong of the bitmap that
+        changed.
 
 Return Value:
 
-    ULONG - Receives the starting index (zero based) of the contiguous
-        region of clear bits found.  If not such a region cannot be found
-        a -1 (i.e. 0xffffffff) is returned.
+    None.
 
 --*/
 
 {
-    ULONG SizeOfBitMap;
-    ULONG SizeInBytes;
+    PRTL_BITMAP Source;
+    PRTL_BITMAP Summary;
+    ULONG Level;
+    ULONG SizeInUlongs;
+    ULONG LastUlongMask;
+    ULONG UlongIndex;
+    ULONG CurrentUlong;
 
-    ULONG HintBit;
-    ULONG MainLoopIndex;
+    Source = &SummaryBitMap->BitMap;
 
-    GET_BYTE_DECLARATIONS();
+    for (Level = 0; Level < RTL_SUMMARY_LEVELS; Level += 1) {
 
-    //
-    //  To make the loops in our test run faster we'll extract the
-    //  fields from the bitmap header
-    //
+        Summary = &SummaryBitMap->Summary[Level];
 
-    SizeOfBitMap = BitMapHeader->SizeOfBitMap;
-    SizeInBytes = (SizeOfBitMap + 7) / 8;
+        //
+        //  The unused bits in the last ulong of the level below count as
+        //  set, otherwise the last ulong could never be marked full.
+        //
 
-    //
-    //  Set any unused bits in the last byte so we won't count them.  We do
-    //  this by first checking if there is any odd bits in the last byte.
-    //
+        SizeInUlongs = (Source->SizeOfBitMap + 31) / 32;
+        LastUlongMask = 0;
 
-    if ((SizeOfBitMap % 8) != 0) {
+        if ((Source->SizeOfBitMap % 32) != 0) {
 
-        //
-        //  The last byte has some odd bits so we'll set the high unused
-        //  bits in the last byte to 1's
-        //
+            LastUlongMask = ~FillMaskUlong(Source->SizeOfBitMap % 32);
+        }
 
-        ((PUCHAR)BitMapHeader->Buffer)[SizeInBytes - 1] |=
-                                                    ZeroMask[SizeOfBitMap % 8];
-    }
+        for (UlongIndex = FirstUlong; UlongIndex <= LastUlong; UlongIndex += 1) {
 
-    //
-    //  Calculate from the hint index where the hint byte is and set ourselves
-    //  up to read the hint on the next call to GET_BYTE.  To make the
-    //  algorithm run fast we'll only honor hints down to the byte level of
-    //  granularity.  There is a possibility that we'll need to execute
-    //  our main logic twice.  Once to test from the hint byte to the end of
-    //  the bitmap and the other to test from the start of the bitmap.  First
-    //  we need to make sure the Hint Index is within range.
-    //
+            CurrentUlong = Source->Buffer[UlongIndex];
 
-    if (HintIndex >= SizeOfBitMap) {
+            if (UlongIndex == SizeInUlongs - 1) {
 
-        HintIndex = 0;
-    }
+                CurrentUlong |= LastUlongMask;
+            }
 
-    HintBit = HintIndex % 8;
+            if (CurrentUlong == 0xffffffff) {
 
-    for (MainLoopIndex = 0; MainLoopIndex < 2; MainLoopIndex += 1) {
+                Summary->Buffer[UlongIndex / 32] |= (ULONG)1 << (UlongIndex % 32);
 
-        ULONG StartByteIndex;
-        ULONG EndByteIndex;
+            } else {
 
-        UCHAR CurrentByte;
+                Summary->Buffer[UlongIndex / 32] &= ~((ULONG)1 << (UlongIndex % 32));
+            }
+        }
 
         //
-        //  Check for the first time through the main loop, which indicates
-        //  that we are going to start our search at our hint byte
+        //  The summary ulongs just changed are the ulongs to look at for
+        //  the next level up.
         //
 
-        if (MainLoopIndex == 0) {
+        Source = Summary;
+        FirstUlong /= 32;
+        LastUlong /= 32;
+    }
 
-            StartByteIndex = HintIndex / 8;
-            EndByteIndex = SizeInBytes;
+    return;
+}
 
-        //
-        //  This is the second time through the loop, make sure there is
-        //  actually something to check before the hint byte
-        //
+
+ULONG
+RtlpFindNonFullUlong (
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap,
+    IN ULONG UlongIndex
+    )
 
-        } else if (HintIndex != 0) {
+/*++
 
-            //
-            //  The end index for the second time around is based on the
-            //  number of bits we need to find.  We need to use this inorder
-            //  to take the case where the preceding byte to the hint byte
-            //  is the start of our run, and the run includes the hint byte
-            //  and some following bytes, based on the number of bits needed
-            //  The computation is to take the number of bits needed minus
-            //  2 divided by 8 and then add 2.  This will take in to account
-            //  the worst possible case where we have one bit hanging off
-            //  of each end byte, and all intervening bytes are all zero.
-            //
+Routine Description:
 
-            if (NumberToFind < 2) {
+    This procedure uses the summary of a summary bitmap to find the first
+    ulong of the bitmap, at or after the specified one, that is not known
+    to be full.  It climbs the summary levels while the summary ulongs it
+    looks at are full, and then comes back down through the first summary
+    ulongs that are not.
 
-                EndByteIndex = 0;
+Arguments:
 
-            } else {
+    SummaryBitMap - Supplies a pointer to the previously initialized summary
+        bitmap.
 
-                EndByteIndex = (HintIndex / 8) + ((NumberToFind - 2) / 8) + 2;
+    UlongIndex - Supplies the index of the ulong of the bitmap where the
+        search starts.
 
-                //
-                //  Make sure we don't overrun the end of the bitmap
-                //
+Return Value:
 
-                if (EndByteIndex > SizeInBytes) {
+    ULONG - Receives the index of the ulong found.  If every ulong from the
+        starting one to the end of the bitmap is full, the number of ulongs
+        in the bitmap is returned.
 
-                    EndByteIndex = SizeInBytes;
-                }
-            }
+--*/
 
-            HintIndex = 0;
-            HintBit = 0;
-            StartByteIndex = 0;
+{
+    PRTL_BITMAP Summary;
+    ULONG Level;
+    ULONG Index;
+    ULONG CurrentUlong;
 
-        //
-        //  Otherwise we already did a complete loop through the bitmap
-        //  so we should simply return -1 to say nothing was found
-        //
+    //
+    //  Index is a bit index within the current summary level.  The unused
+    //  bits at the end of each level are always set, so they never stop the
+    //  search.
+    //
 
-        } else {
+    Index = UlongIndex;
+    Level = 0;
 
-            return 0xffffffff;
+    while (TRUE) {
+
+        Summary = &SummaryBitMap->Summary[Level];
+
+        if (Index >= Summary->SizeOfBitMap) {
+
+            return SummaryBitMap->Summary[0].SizeOfBitMap;
         }
 
-        //
-        //  Set ourselves up to get the next byte
-        //
+        CurrentUlong = Summary->Buffer[Index / 32] | FillMaskUlong(Index % 32);
 
-        GET_BYTE_INITIALIZATION(BitMapHeader, StartByteIndex);
+        if (CurrentUlong != 0xffffffff) {
+
+            Index = (Index & ~31) + RtlpBitsClearLowUlong( ~CurrentUlong );
+            break;
+        }
 
         //
-        //  Get the first byte, and set any bits before the hint bit.
+        //  The rest of this summary ulong is full.  Carry on from the next
+        //  summary ulong, which the level above can tell us about, or at the
+        //  top level by just looking at it.
         //
 
-        GET_BYTE( CurrentByte );
+        if (Level < RTL_SUMMARY_LEVELS - 1) {
 
-        CurrentByte |= FillMask[HintBit];
+            Index = (Index / 32) + 1;
+            Level += 1;
 
-        //
-        //  If the number of bits can only fit in 1 or 2 bytes (i.e., 9 bits or
-        //  less) we do the following test case.
-        //
+        } else {
 
-        if (NumberToFind <= 9) {
+            Index = (Index | 31) + 1;
+        }
+    }
 
-            ULONG CurrentBitIndex;
-            UCHAR PreviousByte;
+    //
+    //  Each summary level is exact with respect to the level below it, so a
+    //  clear bit always leads to a summary ulong with a clear bit.
+    //
 
-            PreviousByte = 0xff;
+    while (Level > 0) {
 
-            //
-            //  Examine all the bytes within our test range searching
-            //  for a fit
-            //
+        Level -= 1;
 
-            CurrentBitIndex = StartByteIndex * 8;
+        CurrentUlong = SummaryBitMap->Summary[Level].Buffer[Index];
 
-            while (TRUE) {
+        ASSERT( CurrentUlong != 0xffffffff );
 
-                //
-                //  If this is the first itteration of the loop, mask Current
-                //  byte with the real hint.
-                //
+        Index = (Index * 32) + RtlpBitsClearLowUlong( ~CurrentUlong );
+    }
 
-                //
-                //  The current byte does not satisfy our requirements so we'll
-                //  check the previous and current byte together to see if
-                //  we'll fit.  To check uses the high part of the previous
-                //  byte and low part of the current byte.
-                //
+    return Index;
+}
 
-                if (((ULONG)RtlpBitsClearHigh[PreviousByte] +
-                           (ULONG)RtlpBitsClearLow[CurrentByte]) >= NumberToFind) {
+
+ULONG
+RtlpFindClearRun (
+    IN PRTL_BITMAP BitMapHeader,
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap OPTIONAL,
+    IN ULONG NumberToFind,
+    IN ULONG StartIndex,
+    IN ULONG EndIndex
+    )
 
-                    ULONG StartingIndex;
+/*++
 
-                    //
-                    //  It all fits in these two bytes, so we can compute
-                    //  the starting index.  This is done by taking the
-                    //  index of the current byte (bit 0) and subtracting the
-                    //  number of bits its takes to get to the first cleared
-                    //  high bit.
-                    //
+Routine Description:
 
-                    StartingIndex = CurrentBitIndex -
-                                             (LONG)RtlpBitsClearHigh[PreviousByte];
+    This procedure finds the first run of clear bits of at least the
+    specified size that starts at or after StartIndex and before EndIndex.
+    The run itself may extend beyond EndIndex.
 
-                    //
-                    //  Now make sure the total size isn't beyond the bitmap
-                    //
+    The bitmap is examined a ulong at a time.  Ulongs that are all set or
+    all clear are passed over with a single compare, and only ulongs with
+    both set and clear bits are looked at in more detail.  If a summary is
+    supplied, whenever no run is being built up the search goes straight
+    to the next ulong that the summary does not mark as full.
 
-                    if ((StartingIndex + NumberToFind) <= SizeOfBitMap) {
+Arguments:
 
-                        return StartingIndex;
-                    }
-                }
+    BitMapHeader - Supplies a pointer to the previously initialized BitMap.
 
-                //
-                //  Check to see if a single byte will satisfy the requirement
-                //
+    SummaryBitMap - Optionally supplies the summary bitmap that BitMapHeader
+        belongs to.
 
-                if ((ULONG)RtlpBitsClearAnywhere[CurrentByte] >= NumberToFind) {
+    NumberToFind - Supplies the size of the run to find.  This must not be
+        zero.
 
-                    UCHAR BitMask;
-                    ULONG i;
+    StartIndex - Supplies the index (zero based) of the first bit where the
+        run may start.
 
-                    //
-                    //  It all fits in a single byte, so calculate the bit
-                    //  number.  We do this by taking a mask of the appropriate
-                    //  size and shifting it over until it fits.  It fits when
-                    //  we can bitwise-and the current byte with the bitmask
-                    //  and get a zero back.
-                    //
+    EndIndex - Supplies the index (zero based) of the bit after the last bit
+        where the run may start.
 
-                    BitMask = FillMask[ NumberToFind ];
-                    for (i = 0; (BitMask & CurrentByte) != 0; i += 1) {
+Return Value:
 
-                        BitMask <<= 1;
-                    }
+    ULONG - Receives the starting index (zero based) of the run found.  If
+        no such run exists a -1 (i.e., 0xffffffff) is returned.
 
-                    //
-                    //  return to our caller the located bit index, and the
-                    //  number that we found.
-                    //
+--*/
 
-                    return CurrentBitIndex + i;
-                }
+{
+    PULONG Buffer;
+    ULONG SizeInUlongs;
+    ULONG LastUlongMask;
 
-                //
-                //  For the next iteration through our loop we need to make
-                //  the current byte into the previous byte, and go to the
-                //  top of the loop again.
-                //
+    ULONG UlongIndex;
+    ULONG CurrentUlong;
 
-                PreviousByte = CurrentByte;
+    ULONG RunSize;
+    ULONG LowClear;
+    ULONG Fit;
+    ULONG FitSize;
+    ULONG Shift;
 
-                //
-                //  Increment our Bit Index, and either exit, or get the
-                //  next byte.
-                //
+    //
+    //  Compute the bits to set in the last ulong so the unused bits at the
+    //  end of the bitmap are never counted as clear.
+    //
 
-                CurrentBitIndex += 8;
+    Buffer = BitMapHeader->Buffer;
+    SizeInUlongs = (BitMapHeader->SizeOfBitMap + 31) / 32;
+    LastUlongMask = 0;
 
-                if ( CurrentBitIndex < EndByteIndex * 8 ) {
+    if ((BitMapHeader->SizeOfBitMap % 32) != 0) {
 
-                    GET_BYTE( CurrentByte );
+        LastUlongMask = ~FillMaskUlong(BitMapHeader->SizeOfBitMap % 32);
+    }
 
-                } else {
+    //
+    //  RunSize is the number of clear bits immediately before the current
+    //  ulong, so the run being built up always starts at bit
+    //  (UlongIndex * 32) - RunSize.
+    //
 
-                    break;
-                }
+    RunSize = 0;
 
-            } // end loop CurrentBitIndex
+    for (UlongIndex = StartIndex / 32; UlongIndex < SizeInUlongs; UlongIndex += 1) {
 
         //
-        //  The number to find is greater than 9 but if it is less than 15
-        //  then we know it can be satisfied with at most 2 bytes, or 3 bytes
-        //  if the middle byte (of the 3) is all zeros.
+        //  Stop as soon as any run we could still find would start too late
         //
 
-        } else if (NumberToFind < 15) {
+        if (((UlongIndex * 32) - RunSize) >= EndIndex) {
 
-            ULONG CurrentBitIndex;
+            break;
+        }
 
-            UCHAR PreviousPreviousByte;
-            UCHAR PreviousByte;
+        CurrentUlong = Buffer[UlongIndex];
 
-            PreviousPreviousByte = 0xff;
-            PreviousByte = 0xff;
+        //
+        //  Set the bits before the start index in the first ulong and the
+        //  unused bits in the last ulong so they are never part of a run.
+        //
 
-            //
-            //  Examine all the bytes within our test range searching
-            //  for a fit
-            //
+        if (UlongIndex == StartIndex / 32) {
 
-            CurrentBitIndex = StartByteIndex * 8;
+            CurrentUlong |= FillMaskUlong(StartIndex % 32);
+        }
 
-            while (TRUE) {
+        if (UlongIndex == SizeInUlongs - 1) {
 
-                //
-                //  Check to see if the Previous byte and current byte
-                //  together satisfy the request.
-                //
+            CurrentUlong |= LastUlongMask;
+        }
 
-                if (((ULONG)RtlpBitsClearHigh[PreviousByte] +
-                           (ULONG)RtlpBitsClearLow[CurrentByte]) >= NumberToFind) {
+        //
+        //  An all clear ulong simply extends the current run
+        //
 
-                    ULONG StartingIndex;
+        if (CurrentUlong == 0) {
 
-                    //
-                    //  It all fits in these two bytes, so we can compute
-                    //  the starting index.  This is done by taking the
-                    //  index of the current byte (bit 0) and subtracting the
-                    //  number of bits its takes to get to the first cleared
-                    //  high bit.
-                    //
+            RunSize += 32;
 
-                    StartingIndex = CurrentBitIndex -
-                                             (LONG)RtlpBitsClearHigh[PreviousByte];
+            if (RunSize >= NumberToFind) {
 
-                    //
-                    //  Now make sure the total size isn't beyond the bitmap
-                    //
+                return (UlongIndex * 32) + 32 - RunSize;
+            }
 
-                    if ((StartingIndex + NumberToFind) <= SizeOfBitMap) {
+            continue;
+        }
 
-                        return StartingIndex;
-                    }
-                }
+        if (CurrentUlong != 0xffffffff) {
 
-                //
-                //  if the previous byte is all zeros then maybe the
-                //  request can be satisfied using the Previous Previous Byte
-                //  Previous Byte, and the Current Byte.
-                //
+            //
+            //  The clear bits at the low end of the ulong finish the
+            //  current run.  Check if that is enough.
+            //
 
-                if ((PreviousByte == 0)
+            LowClear = RtlpBitsClearLowUlong( CurrentUlong );
 
-                        &&
+            if ((RunSize + LowClear) >= NumberToFind) {
 
-                    (((ULONG)RtlpBitsClearHigh[PreviousPreviousByte] + 8 +
-                          (ULONG)RtlpBitsClearLow[CurrentByte]) >= NumberToFind)) {
+                return (UlongIndex * 32) - RunSize;
+            }
 
-                    ULONG StartingIndex;
+            //
+            //  Check for a run that fits entirely inside this ulong.  Fit
+            //  starts out with a bit set for every clear bit, and after each
+            //  step a bit stays set only if FitSize clear bits start there.
+            //  The bits shifted in at the high end are zero, so a run that
+            //  reaches the top of the ulong is never reported here; it is
+            //  carried into the next ulong instead.
+            //
 
-                    //
-                    //  It all fits in these three bytes, so we can compute
-                    //  the starting index.  This is done by taking the
-                    //  index of the previous byte (bit 0) and subtracting
-                    //  the number of bits its takes to get to the first
-                    //  cleared high bit.
-                    //
+            if (NumberToFind < 32) {
 
-                    StartingIndex = (CurrentBitIndex - 8) -
-                                     (LONG)RtlpBitsClearHigh[PreviousPreviousByte];
+                Fit = ~CurrentUlong;
 
-                    //
-                    //  Now make sure the total size isn't beyond the bitmap
-                    //
+                for (FitSize = 1; (FitSize < NumberToFind) && (Fit != 0); FitSize += Shift) {
 
-                    if ((StartingIndex + NumberToFind) <= SizeOfBitMap) {
+                    Shift = NumberToFind - FitSize;
 
-                        return StartingIndex;
+                    if (Shift > FitSize) {
+
+                        Shift = FitSize;
                     }
+
+                    Fit &= Fit >> Shift;
                 }
 
-                //
-                //  For the next iteration through our loop we need to make
-                //  the current byte into the previous byte, the previous
-                //  byte into the previous previous byte, and go to the
-                //  top of the loop again.
-                //
+                if (Fit != 0) {
 
-                PreviousPreviousByte = PreviousByte;
-                PreviousByte = CurrentByte;
+                    if (((UlongIndex * 32) + RtlpBitsClearLowUlong( Fit )) >= EndIndex) {
 
-                //
-                //  Increment our Bit Index, and either exit, or get the
-                //  next byte.
-                //
+                        break;
+                    }
 
-                CurrentBitIndex += 8;
+                    return (UlongIndex * 32) + RtlpBitsClearLowUlong( Fit );
+                }
+            }
+        }
 
-                if ( CurrentBitIndex < EndByteIndex * 8 ) {
+        //
+        //  The clear bits at the high end of the ulong start the next run
+        //
 
-                    GET_BYTE( CurrentByte );
+        RunSize = RtlpBitsClearHighUlong( CurrentUlong );
 
-                } else {
+        //
+        //  If no run carries over and the summary says the next ulong is
+        //  full, skip ahead to the next ulong that is not.
+        //
 
-                    break;
-                }
+        if ((SummaryBitMap != NULL) &&
+            (RunSize == 0) &&
+            (UlongIndex + 1 < SizeInUlongs) &&
+            RtlCheckBit( &SummaryBitMap->Summary[0], UlongIndex + 1 )) {
 
-            } // end loop CurrentBitIndex
+            UlongIndex = RtlpFindNonFullUlong( SummaryBitMap, UlongIndex + 1 ) - 1;
+        }
+    }
 
-        //
-        //  The number to find is greater than or equal to 15.  This request
-        //  has to have at least one byte of all zeros to be satisfied
-        //
+    return 0xffffffff;
+}
 
-        } else {
+
+ULONG
+RtlpFindClearBits (
+    IN PRTL_BITMAP BitMapHeader,
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap OPTIONAL,
+    IN ULONG NumberToFind,
+    IN ULONG HintIndex
+    )
 
-            ULONG CurrentByteIndex;
+/*++
 
-            ULONG ZeroBytesNeeded;
-            ULONG ZeroBytesFound;
+Routine Description:
 
-            UCHAR StartOfRunByte;
-            LONG StartOfRunIndex;
+    This procedure does the work of RtlFindClearBits and
+    RtlFindClearBitsWithSummary.
 
-            //
-            //  First precalculate how many zero bytes we're going to need
-            //
+Arguments:
 
-            ZeroBytesNeeded = (NumberToFind - 7) / 8;
+    BitMapHeader - Supplies a pointer to the previously initialized BitMap.
 
-            //
-            //  Indicate for the first time through our loop that we haven't
-            //  found a zero byte yet, and indicate that the start of the
-            //  run is the byte just before the start byte index
-            //
+    SummaryBitMap - Optionally supplies the summary bitmap that BitMapHeader
+        belongs to.
+
+    NumberToFind - Supplies the size of the contiguous region to find.
+
+    HintIndex - Supplies the index (zero based) of where we should start
+        the search from within the bitmap.
 
-            ZeroBytesFound = 0;
-            StartOfRunByte = 0xff;
-            StartOfRunIndex = StartByteIndex - 1;
+Return Value:
 
-            //
-            //  Examine all the bytes in our test range searching for a fit
-            //
+    ULONG - Receives the starting index (zero based) of the contiguous
+        region of clear bits found.  If such a region cannot be found a -1
+        (i.e. 0xffffffff) is returned.
 
-            CurrentByteIndex = StartByteIndex;
+--*/
 
-            while (TRUE) {
+{
+    ULONG SizeOfBitMap;
+    ULONG StartingIndex;
 
-                //
-                //  If the number of zero bytes fits our minimum requirements
-                //  then we can do the additional test to see if we
-                //  actually found a fit
-                //
+    SizeOfBitMap = BitMapHeader->SizeOfBitMap;
 
-                if ((ZeroBytesFound >= ZeroBytesNeeded)
+    //
+    //  First we need to make sure the Hint Index is within range.
+    //
 
-                        &&
+    if (HintIndex >= SizeOfBitMap) {
 
-                    ((ULONG)RtlpBitsClearHigh[StartOfRunByte] + ZeroBytesFound*8 +
-                     (ULONG)RtlpBitsClearLow[CurrentByte]) >= NumberToFind) {
+        HintIndex = 0;
+    }
 
-                    ULONG StartingIndex;
+    //
+    //  A request for no bits is always satisfied at the start of the
+    //  hint byte, which is what callers have always gotten back.
+    //
 
-                    //
-                    //  It all fits in these bytes, so we can compute
-                    //  the starting index.  This is done by taking the
-                    //  StartOfRunIndex times 8 and adding the number of bits
-                    //  it takes to get to the first cleared high bit.
-                    //
+    if (NumberToFind == 0) {
 
-                    StartingIndex = (StartOfRunIndex * 8) +
-                                     (8 - (LONG)RtlpBitsClearHigh[StartOfRunByte]);
+        return HintIndex & ~7;
+    }
 
-                    //
-                    //  Now make sure the total size isn't beyond the bitmap
-                    //
+    if (NumberToFind > SizeOfBitMap) {
 
-                    if ((StartingIndex + NumberToFind) <= SizeOfBitMap) {
+        return 0xffffffff;
+    }
 
-                        return StartingIndex;
-                    }
-                }
+    //
+    //  Search from the hint to the end of the bitmap.  If that fails, search
+    //  again for a run that starts before the hint; such a run may reach
+    //  over the hint.
+    //
 
-                //
-                //  Check to see if the byte is zero and increment
-                //  the number of zero bytes found
-                //
+    StartingIndex = RtlpFindClearRun( BitMapHeader,
+                                      SummaryBitMap,
+                                      NumberToFind,
+                                      HintIndex,
+                                      SizeOfBitMap );
 
-                if (CurrentByte == 0) {
+    if ((StartingIndex == 0xffffffff) && (HintIndex != 0)) {
 
-                    ZeroBytesFound += 1;
+        StartingIndex = RtlpFindClearRun( BitMapHeader,
+                                          SummaryBitMap,
+                                          NumberToFind,
+                                          0,
+                                          HintIndex );
+    }
 
-                //
-                //  The byte isn't a zero so we need to start over again
-                //  looking for zero bytes.
-                //
+    return StartingIndex;
+}
 
-                } else {
+
+ULONG
+RtlFindClearBits (
+    IN PRTL_BITMAP BitMapHeader,
+    IN ULONG NumberToFind,
+    IN ULONG HintIndex
+    )
 
-                    ZeroBytesFound = 0;
-                    StartOfRunByte = CurrentByte;
-                    StartOfRunIndex = CurrentByteIndex;
-                }
+/*++
 
-                //
-                //  Increment our Byte Index, and either exit, or get the
-                //  next byte.
-                //
+Routine Description:
 
-                CurrentByteIndex += 1;
+    This procedure searches the specified bit map for the specified
+    contiguous region of clear bits.  If a run is not found from the
+    hint to the end of the bitmap, we will search again from the
+    beginning of the bitmap.
 
-                if ( CurrentByteIndex < EndByteIndex ) {
+Arguments:
 
-                    GET_BYTE( CurrentByte );
+    BitMapHeader - Supplies a pointer to the previously initialized BitMap.
 
-                } else {
+    NumberToFind - Supplies the size of the contiguous region to find.
 
-                    break;
-                }
+    HintIndex - Supplies the index (zero based) of where we should start
+        the search from within the bitmap.
 
-            } // end loop CurrentByteIndex
-        }
-    }
+Return Value:
 
-    //
-    //  We never found a fit so we'll return -1
-    //
+    ULONG - Receives the starting index (zero based) of the contiguous
+        region of clear bits found.  If not such a region cannot be found
+        a -1 (i.e. 0xffffffff) is returned.
 
-    return 0xffffffff;
+--*/
+
+{
+    return RtlpFindClearBits( BitMapHeader, NULL, NumberToFind, HintIndex );
 }
 
 
@@ -1412,6 +1529,97 @@ Return Value:
 
 }
 
+
+ULONG
+RtlFindClearBitsWithSummary (
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap,
+    IN ULONG NumberToFind,
+    IN ULONG HintIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This procedure searches the specified summary bit map for the
+    specified contiguous region of clear bits.  It returns the same
+    result as RtlFindClearBits, but skips over the full parts of the bit
+    map using the summary.
+
+Arguments:
+
+    SummaryBitMap - Supplies a pointer to the previously initialized summary
+        BitMap.
+
+    NumberToFind - Supplies the size of the contiguous region to find.
+
+    HintIndex - Supplies the index (zero based) of where we should start
+        the search from within the bitmap.
+
+Return Value:
+
+    ULONG - Receives the starting index (zero based) of the contiguous
+        region of clear bits found.  If such a region cannot be found a -1
+        (i.e. 0xffffffff) is returned.
+
+--*/
+
+{
+    return RtlpFindClearBits( &SummaryBitMap->BitMap,
+                              SummaryBitMap,
+                              NumberToFind,
+                              HintIndex );
+}
+
+
+ULONG
+RtlFindClearBitsAndSetWithSummary (
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap,
+    IN ULONG NumberToFind,
+    IN ULONG HintIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This procedure searches the specified summary bit map for the
+    specified contiguous region of clear bits, sets the bits and updates
+    the summary.
+
+Arguments:
+
+    SummaryBitMap - Supplies a pointer to the previously initialized summary
+        BitMap.
+
+    NumberToFind - Supplies the size of the contiguous region to find.
+
+    HintIndex - Supplies the index (zero based) of where we should start
+        the search from within the bitmap.
+
+Return Value:
+
+    ULONG - Receives the starting index (zero based) of the contiguous
+        region found.  If such a region cannot be located a -1 (i.e.,
+        0xffffffff) is returned.
+
+--*/
+
+{
+    ULONG StartingIndex;
+
+    StartingIndex = RtlFindClearBitsWithSummary( SummaryBitMap,
+                                                 NumberToFind,
+                                                 HintIndex );
+
+    if (StartingIndex != 0xffffffff) {
+
+        RtlSetBitsWithSummary( SummaryBitMap, StartingIndex, NumberToFind );
+    }
+
+    return StartingIndex;
+}
+
 
 ULONG
 RtlFindSetBitsAndClear (
@@ -1725,200 +1933,101 @@ Return Value:
 }
 
 
-ULONG
-RtlFindLongestRunClear (
-    IN PRTL_BITMAP BitMapHeader,
-    OUT PULONG StartingIndex
+VOID
+RtlClearBitsWithSummary (
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap,
+    IN ULONG StartingIndex,
+    IN ULONG NumberToClear
     )
 
 /*++
 
 Routine Description:
 
-    This procedure finds the largest contiguous range of clear bits
-    within the specified bit map.
+    This procedure clears the specified range of bits within the specified
+    summary bit map and updates the summary.
 
 Arguments:
 
-    BitMapHeader - Supplies a pointer to the previously initialized BitMap.
+    SummaryBitMap - Supplies a pointer to the previously initialized summary
+        BitMap.
 
-    StartingIndex - Receives the index (zero based) of the first run
-        equal to the longest run of clear bits in the BitMap.
+    StartingIndex - Supplies the index (zero based) of the first bit to
+        clear.
+
+    NumberToClear - Supplies the number of bits to clear.
 
 Return Value:
 
-    ULONG - Receives the number of bits contained in the largest contiguous
-        run of clear bits.
+    None.
 
 --*/
 
 {
-    ULONG SizeOfBitMap;
-    ULONG SizeInBytes;
-
-    ULONG LongestRunSize;
-    ULONG LongestRunIndex;
-
-    ULONG CurrentRunSize;
-    ULONG CurrentRunIndex;
-    ULONG CurrentByteIndex;
-    UCHAR CurrentByte;
-
-    GET_BYTE_DECLARATIONS();
-
-    //
-    //  Reference the bitmap header to make the loop run faster
-    //
-
-    SizeOfBitMap = BitMapHeader->SizeOfBitMap;
-    SizeInBytes = (SizeOfBitMap + 7) / 8;
-
-    //
-    //  Set any unused bits in the last byte so we won't count them.  We do
-    //  this by first checking if there is any odd bits in the last byte.
-    //
-
-    if ((SizeOfBitMap % 8) != 0) {
-
-        //
-        //  The last byte has some odd bits so we'll set the high unused
-        //  bits in the last byte to 1's
-        //
+    if (NumberToClear == 0) {
 
-        ((PUCHAR)BitMapHeader->Buffer)[SizeInBytes - 1] |=
-                                                    ZeroMask[SizeOfBitMap % 8];
+        return;
     }
 
-    //
-    //  Set it up so we can the use GET_BYTE macro
-    //
-
-    GET_BYTE_INITIALIZATION( BitMapHeader, 0);
-
-    //
-    //  Set our longest and current run variables
-    //
-
-    LongestRunSize = 0;
-    LongestRunIndex = 0;
-
-    CurrentRunSize = 0;
-    CurrentRunIndex = 0;
-
-    //
-    //  Examine every byte in the BitMap
-    //
-
-    for (CurrentByteIndex = 0;
-         CurrentByteIndex < SizeInBytes;
-         CurrentByteIndex += 1) {
-
-        GET_BYTE( CurrentByte );
-
-        //
-        //  If the current byte is not all zeros we need to
-        //  (1) check if the current run is big enough to supercede the
-        //  longest run, and (2) check if the current byte inside of
-        //  itself can supercede the longest run, and (3) start a new
-        //  current run
-        //
-
-        if (CurrentByte != 0x00) {
-
-            UCHAR Temp;
-
-            //
-            //  Compute the final size of the current run
-            //
-
-            CurrentRunSize += RtlpBitsClearLow[CurrentByte];
-
-            //
-            //  Check if the current run is larger than the longest run that
-            //  we've found so far
-            //
-
-            if (CurrentRunSize > LongestRunSize) {
-
-                LongestRunSize = CurrentRunSize;
-                LongestRunIndex = CurrentRunIndex;
-            }
-
-            //
-            //  The next run starts with the remaining clear bits in the
-            //  current byte.  We set this up before we check inside the
-            //  current byte for a longer run, because the latter test
-            //  might require extra work.
-            //
+    RtlClearBits( &SummaryBitMap->BitMap, StartingIndex, NumberToClear );
 
-            CurrentRunSize = RtlpBitsClearHigh[ CurrentByte ];
-            CurrentRunIndex = (CurrentByteIndex * 8) + (8 - CurrentRunSize);
+    RtlpUpdateSummary( SummaryBitMap,
+                       StartingIndex / 32,
+                       (StartingIndex + NumberToClear - 1) / 32 );
 
-            //
-            //  Check if the current byte contains a run inside of it that
-            //  is both greater than the longest run size, and the current
-            //  run size.  But we'll only both with this test if the
-            //  longest run size, and current run size are both less than 8.
-            //
+    return;
+}
 
-            if ((LongestRunSize < 8) && (CurrentRunSize < 8) &&
-                ((ULONG)(Temp = RtlpBitsClearAnywhere[CurrentByte]) > LongestRunSize) &&
-                ((ULONG)Temp > CurrentRunSize)) {
+
+VOID
+RtlSetBitsWithSummary (
+    IN PRTL_SUMMARY_BITMAP SummaryBitMap,
+    IN ULONG StartingIndex,
+    IN ULONG NumberToSet
+    )
 
-                UCHAR BitMask;
-                ULONG i;
+/*++
 
-                //
-                //  Somewhere in the current byte is a run longer than the
-                //  longest run, or the current run.  All we need to do now
-                //  is find the index for this new longest run.
-                //
+Routine Description:
 
-                BitMask = FillMask[ Temp ];
+    This procedure sets the specified range of bits within the specified
+    summary bit map and updates the summary.
 
-                for (i = 0; (BitMask & CurrentByte) != 0; i += 1) {
+Arguments:
 
-                    BitMask <<= 1;
-                }
+    SummaryBitMap - Supplies a pointer to the previously initialized summary
+        BitMap.
 
-                LongestRunIndex = (CurrentByteIndex * 8) + i;
-                LongestRunSize = Temp;
-            }
+    StartingIndex - Supplies the index (zero based) of the first bit to set.
 
-        //
-        //  Otherwise the current byte is all zeros and
-        //  we simply continue with the current run
-        //
+    NumberToSet - Supplies the number of bits to set.
 
-        } else {
+Return Value:
 
-            CurrentRunSize += 8;
-        }
-    }
+    None.
 
-    //
-    //  See if we finished looking over the bitmap with an open current
-    //  run that is longer than the longest saved run
-    //
+--*/
 
-    if (CurrentRunSize > LongestRunSize) {
+{
+    if (NumberToSet == 0) {
 
-        LongestRunSize = CurrentRunSize;
-        LongestRunIndex = CurrentRunIndex;
+        return;
     }
 
-    //
-    //  Set our output variables and return to our caller
-    //
+    RtlSetBits( &SummaryBitMap->BitMap, StartingIndex, NumberToSet );
 
-    *StartingIndex = LongestRunIndex;
-    return LongestRunSize;
+    RtlpUpdateSummary( SummaryBitMap,
+                       StartingIndex / 32,
+                       (StartingIndex + NumberToSet - 1) / 32 );
+
+    return;
 }
 
 
 ULONG
-RtlFindLongestRunSet (
+RtlpFindLongestClearRun (
     IN PRTL_BITMAP BitMapHeader,
+    IN ULONG Invert,
     OUT PULONG StartingIndex
     )
 
@@ -1926,164 +2035,141 @@ RtlFindLongestRunSet (
 
 Routine Description:
 
-    This procedure finds the largest contiguous range of set bits
-    within the specified bit map.
+    This procedure finds the first of the longest runs of clear bits in the
+    specified bitmap, examining it a ulong at a time.  Each ulong is first
+    exclusive or'ed with Invert, so passing all ones finds the longest run
+    of set bits instead.
 
 Arguments:
 
     BitMapHeader - Supplies a pointer to the previously initialized BitMap.
 
+    Invert - Supplies zero to look for clear bits, or 0xffffffff to look for
+        set bits.
+
     StartingIndex - Receives the index (zero based) of the first run
-        equal to the longest run of set bits in the BitMap.
+        equal to the longest run in the BitMap.
 
 Return Value:
 
-    ULONG - Receives the number of bits contained in the largest contiguous
-        run of set bits.
+    ULONG - Receives the number of bits contained in the longest run.
 
 --*/
 
 {
-    ULONG SizeOfBitMap;
-    ULONG SizeInBytes;
+    PULONG Buffer;
+    ULONG SizeInUlongs;
+    ULONG LastUlongMask;
+
+    ULONG UlongIndex;
+    ULONG CurrentUlong;
 
     ULONG LongestRunSize;
     ULONG LongestRunIndex;
+    ULONG RunSize;
 
-    ULONG CurrentRunSize;
-    ULONG CurrentRunIndex;
-    ULONG CurrentByteIndex;
-    UCHAR CurrentByte;
-
-    GET_BYTE_DECLARATIONS();
-
-    //
-    //  Reference the bitmap header to make the loop run faster
-    //
-
-    SizeOfBitMap = BitMapHeader->SizeOfBitMap;
-    SizeInBytes = (SizeOfBitMap + 7) / 8;
-
-    //
-    //  Set any unused bits in the last byte so we won't count them.  We do
-    //  this by first checking if there is any odd bits in the last byte.
-    //
+    ULONG LowClear;
+    ULONG Interior;
+    ULONG InteriorIndex;
+    ULONG InteriorSize;
 
-    if ((SizeOfBitMap % 8) != 0) {
+    Buffer = BitMapHeader->Buffer;
+    SizeInUlongs = (BitMapHeader->SizeOfBitMap + 31) / 32;
+    LastUlongMask = 0;
 
-        //
-        //  The last byte has some odd bits so we'll set the high unused
-        //  bits in the last byte to 0's
-        //
+    if ((BitMapHeader->SizeOfBitMap % 32) != 0) {
 
-        ((PUCHAR)BitMapHeader->Buffer)[SizeInBytes - 1] &=
-                                                    FillMask[SizeOfBitMap % 8];
+        LastUlongMask = ~FillMaskUlong(BitMapHeader->SizeOfBitMap % 32);
     }
 
-    //
-    //  Set it up so we can the use GET_BYTE macro
-    //
-
-    GET_BYTE_INITIALIZATION( BitMapHeader, 0);
+    LongestRunSize = 0;
+    LongestRunIndex = 0;
 
     //
-    //  Set our longest and current run variables
+    //  RunSize is the number of clear bits immediately before the current
+    //  ulong
     //
 
-    LongestRunSize = 0;
-    LongestRunIndex = 0;
+    RunSize = 0;
 
-    CurrentRunSize = 0;
-    CurrentRunIndex = 0;
+    for (UlongIndex = 0; UlongIndex < SizeInUlongs; UlongIndex += 1) {
 
-    //
-    //  Examine every byte in the BitMap
-    //
+        CurrentUlong = Buffer[UlongIndex] ^ Invert;
 
-    for (CurrentByteIndex = 0;
-         CurrentByteIndex < SizeInBytes;
-         CurrentByteIndex += 1) {
+        if (UlongIndex == SizeInUlongs - 1) {
 
-        GET_BYTE( CurrentByte );
+            CurrentUlong |= LastUlongMask;
+        }
 
         //
-        //  If the current byte is not all ones we need to
-        //  (1) check if the current run is big enough to supercede the
-        //  longest run, and (2) check if the current byte inside of
-        //  itself can supercede the longest run, and (3) start a new
-        //  current run
+        //  An all clear ulong simply continues the current run, and an all
+        //  set ulong ends it.
         //
 
-        if (CurrentByte != 0xff) {
+        if (CurrentUlong == 0) {
 
-            UCHAR Temp;
+            RunSize += 32;
+            continue;
+        }
 
-            //
-            //  Compute the final size of the current run
-            //
+        if (CurrentUlong == 0xffffffff) {
 
-            CurrentRunSize += RtlpBitsSetLow(CurrentByte);
+            if (RunSize > LongestRunSize) {
 
-            //
-            //  Check if the current run is larger than the longest run that
-            //  we've found so far
-            //
+                LongestRunSize = RunSize;
+                LongestRunIndex = (UlongIndex * 32) - RunSize;
+            }
 
-            if (CurrentRunSize > LongestRunSize) {
+            RunSize = 0;
+            continue;
+        }
 
-                LongestRunSize = CurrentRunSize;
-                LongestRunIndex = CurrentRunIndex;
-            }
+        //
+        //  The clear bits at the low end of the ulong finish the current run.
+        //  Check if it is larger than the longest run found so far.
+        //
 
-            //
-            //  The next run starts with the remaining set bits in the
-            //  current byte.  We set this up before we check inside the
-            //  current byte for a longer run, because the latter test
-            //  might require extra work.
-            //
+        LowClear = RtlpBitsClearLowUlong( CurrentUlong );
+        RunSize += LowClear;
 
-            CurrentRunSize = RtlpBitsSetHigh( CurrentByte );
-            CurrentRunIndex = (CurrentByteIndex * 8) + (8 - CurrentRunSize);
+        if (RunSize > LongestRunSize) {
 
-            //
-            //  Check if the current byte contains a run inside of it that
-            //  is both greater than the longest run size, and the current
-            //  run size.  But we'll only both with this test if the
-            //  longest run size, and current run size are both less than 8.
-            //
+            LongestRunSize = RunSize;
+            LongestRunIndex = (UlongIndex * 32) + LowClear - RunSize;
+        }
 
-            if ((LongestRunSize < 8) && (CurrentRunSize < 8) &&
-                ((ULONG)(Temp = RtlpBitSetAnywhere(CurrentByte)) > LongestRunSize) &&
-                ((ULONG)Temp > CurrentRunSize)) {
+        //
+        //  The next run starts with the clear bits at the high end of the
+        //  ulong.
+        //
 
-                UCHAR BitMask;
-                ULONG i;
+        RunSize = RtlpBitsClearHighUlong( CurrentUlong );
 
-                //
-                //  Somewhere in the current byte is a run longer than the
-                //  longest run, or the current run.  All we need to do now
-                //  is find the index for this new longest run.
-                //
+        //
+        //  A run strictly inside the ulong has a set bit on either side so it
+        //  can be at most 30 bits long.  Only bother looking at those runs if
+        //  one could be longer than the longest run.  Interior gets a bit for
+        //  every clear bit that is not part of the low or high runs, and each
+        //  run is removed from it once it has been checked.
+        //
 
-                BitMask = FillMask[ Temp ];
+        if (LongestRunSize < 30) {
 
-                for (i = 0; (BitMask & CurrentByte) != BitMask; i += 1) {
+            Interior = (~CurrentUlong) & ~FillMaskUlong(LowClear) & (0xffffffff >> RunSize);
 
-                    BitMask <<= 1;
-                }
+            while (Interior != 0) {
 
-                LongestRunIndex = (CurrentByteIndex * 8) + i;
-                LongestRunSize = Temp;
-            }
+                InteriorIndex = RtlpBitsClearLowUlong( Interior );
+                InteriorSize = RtlpBitsClearLowUlong( ~(Interior >> InteriorIndex) );
 
-        //
-        //  Otherwise the current byte is all ones and
-        //  we simply continue with the current run
-        //
+                if (InteriorSize > LongestRunSize) {
 
-        } else {
+                    LongestRunSize = InteriorSize;
+                    LongestRunIndex = (UlongIndex * 32) + InteriorIndex;
+                }
 
-            CurrentRunSize += 8;
+                Interior &= ~(FillMaskUlong(InteriorSize) << InteriorIndex);
+            }
         }
     }
 
@@ -2092,20 +2178,80 @@ Return Value:
     //  run that is longer than the longest saved run
     //
 
-    if (CurrentRunSize > LongestRunSize) {
+    if (RunSize > LongestRunSize) {
 
-        LongestRunSize = CurrentRunSize;
-        LongestRunIndex = CurrentRunIndex;
+        LongestRunSize = RunSize;
+        LongestRunIndex = (SizeInUlongs * 32) - RunSize;
     }
 
-    //
-    //  Set our output variables and return to our caller
-    //
-
     *StartingIndex = LongestRunIndex;
     return LongestRunSize;
 }
 
+
+ULONG
+RtlFindLongestRunClear (
+    IN PRTL_BITMAP BitMapHeader,
+    OUT PULONG StartingIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This procedure finds the largest contiguous range of clear bits
+    within the specified bit map.
+
+Arguments:
+
+    BitMapHeader - Supplies a pointer to the previously initialized BitMap.
+
+    StartingIndex - Receives the index (zero based) of the first run
+        equal to the longest run of clear bits in the BitMap.
+
+Return Value:
+
+    ULONG - Receives the number of bits contained in the largest contiguous
+        run of clear bits.
+
+--*/
+
+{
+    return RtlpFindLongestClearRun( BitMapHeader, 0, StartingIndex );
+}
+
+
+ULONG
+RtlFindLongestRunSet (
+    IN PRTL_BITMAP BitMapHeader,
+    OUT PULONG StartingIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This procedure finds the largest contiguous range of set bits
+    within the specified bit map.
+
+Arguments:
+
+    BitMapHeader - Supplies a pointer to the previously initialized BitMap.
+
+    StartingIndex - Receives the index (zero based) of the first run
+        equal to the longest run of set bits in the BitMap.
+
+Return Value:
+
+    ULONG - Receives the number of bits contained in the largest contiguous
+        run of set bits.
+
+--*/
+
+{
+    return RtlpFindLongestClearRun( BitMapHeader, 0xffffffff, StartingIndex );
+}
+
 
 ULONG
 RtlFindFirstRunClear (
@@ -2485,58 +2631,7 @@ Return Value:
 --*/
 
 {
-    ULONG SizeOfBitMap;
-    ULONG SizeInBytes;
-
-    ULONG i;
-    UCHAR CurrentByte;
-
-    ULONG TotalClear;
-
-    GET_BYTE_DECLARATIONS();
-
-    //
-    //  Reference the bitmap header to make the loop run faster
-    //
-
-    SizeOfBitMap = BitMapHeader->SizeOfBitMap;
-    SizeInBytes = (SizeOfBitMap + 7) / 8;
-
-    //
-    //  Set any unused bits in the last byte so we don't count them.  We
-    //  do this by first checking if there are any odd bits in the last byte
-    //
-
-    if ((SizeOfBitMap % 8) != 0) {
-
-        //
-        //  The last byte has some odd bits so we'll set the high unused
-        //  bits in the last byte to 1's
-        //
-
-        ((PUCHAR)BitMapHeader->Buffer)[SizeInBytes - 1] |=
-                                                    ZeroMask[SizeOfBitMap % 8];
-    }
-
-    //
-    //  Set if up so we can use the GET_BYTE macro
-    //
-
-    GET_BYTE_INITIALIZATION( BitMapHeader, 0 );
-
-    //
-    //  Examine every byte in the bitmap
-    //
-
-    TotalClear = 0;
-    for (i = 0; i < SizeInBytes; i += 1) {
-
-        GET_BYTE( CurrentByte );
-
-        TotalClear += RtlpBitsClearTotal[CurrentByte];
-    }
-
-    return TotalClear;
+    return BitMapHeader->SizeOfBitMap - RtlNumberOfSetBits( BitMapHeader );
 }
 
 
@@ -2563,55 +2658,44 @@ Return Value:
 --*/
 
 {
-    ULONG SizeOfBitMap;
-    ULONG SizeInBytes;
+    PULONG Buffer;
+    ULONG SizeInUlongs;
 
     ULONG i;
-    UCHAR CurrentByte;
+    ULONG CurrentUlong;
 
     ULONG TotalSet;
 
-    GET_BYTE_DECLARATIONS();
-
     //
     //  Reference the bitmap header to make the loop run faster
     //
 
-    SizeOfBitMap = BitMapHeader->SizeOfBitMap;
-    SizeInBytes = (SizeOfBitMap + 7) / 8;
+    Buffer = BitMapHeader->Buffer;
+    SizeInUlongs = (BitMapHeader->SizeOfBitMap + 31) / 32;
 
     //
-    //  Clear any unused bits in the last byte so we don't count them.  We
-    //  do this by first checking if there are any odd bits in the last byte
+    //  Examine every ulong in the bitmap, counting its bits in parallel:
+    //  first the bits in each pair, then in each nibble, and then summing
+    //  the bytes with a multiply.
     //
 
-    if ((SizeOfBitMap % 8) != 0) {
+    TotalSet = 0;
+    for (i = 0; i < SizeInUlongs; i += 1) {
+
+        CurrentUlong = Buffer[i];
 
         //
-        //  The last byte has some odd bits so we'll set the high unused
-        //  bits in the last byte to 0's
+        //  Don't count the unused bits at the end of the bitmap
         //
 
-        ((PUCHAR)BitMapHeader->Buffer)[SizeInBytes - 1] &=
-                                                    FillMask[SizeOfBitMap % 8];
-    }
-
-    //
-    //  Set if up so we can use the GET_BYTE macro
-    //
-
-    GET_BYTE_INITIALIZATION( BitMapHeader, 0 );
-
-    //
-    //  Examine every byte in the bitmap
-    //
-
-    TotalSet = 0;
-    for (i = 0; i < SizeInBytes; i += 1) {
+        if ((i == SizeInUlongs - 1) && ((BitMapHeader->SizeOfBitMap % 32) != 0)) {
 
-        GET_BYTE( CurrentByte );
+            CurrentUlong &= FillMaskUlong(BitMapHeader->SizeOfBitMap % 32);
+        }
 
-        TotalSet += RtlpBitsSetTotal(CurrentByte);
+        CurrentUlong = CurrentUlong - ((CurrentUlong >> 1) & 0x55555555);
+        CurrentUlong = (CurrentUlong & 0x33333333) + ((CurrentUlong >> 2) & 0x33333333);
+        TotalSet += (((CurrentUlong + (CurrentUlong >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
     }
 
     return TotalSet;
@@ -83,6 +83,28 @@ RtlReserveChunkNS (
     IN ULONG ChunkSize
     );
 
+NTSTATUS
+RtlDecompressStreamWorkSpaceSizeNS (
+    OUT PULONG StreamWorkSpaceSize
+    );
+
+NTSTATUS
+RtlInitializeDecompressStreamNS (
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    );
+
+NTSTATUS
+RtlDecompressStreamNS (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    );
+
 //
 //  Routines to query the amount of memory needed for each workspace
 //
@@ -121,7 +143,7 @@ PRTL_DECOMPRESS_BUFFER RtlDecompressBufferProcs[8] = {
     NULL,                     // 0
     NULL,                     // 1
     RtlDecompressBufferLZNT1, // 2
-    RtlDecompressBufferNS,    // 3
+    RtlDecompressBufferMrcf,  // 3
     RtlDecompressBufferNS,    // 4
     RtlDecompressBufferNS,    // 5
     RtlDecompressBufferNS,    // 6
@@ -173,6 +195,79 @@ PRTL_RESERVE_CHUNK RtlReserveChunkProcs[8] = {
     RtlReserveChunkNS     // 7
 };
 
+//
+//  Routines to query the amount of memory needed for a stream workspace
+//
+
+PRTL_DECOMPRESS_STREAM_WORKSPACE_SIZE RtlDecompressStreamWorkSpaceProcs[8] = {
+    NULL,                                  // 0
+    NULL,                                  // 1
+    RtlDecompressStreamWorkSpaceSizeLZNT1, // 2
+    RtlDecompressStreamWorkSpaceSizeMrcf,  // 3
+    RtlDecompressStreamWorkSpaceSizeNS,    // 4
+    RtlDecompressStreamWorkSpaceSizeNS,    // 5
+    RtlDecompressStreamWorkSpaceSizeNS,    // 6
+    RtlDecompressStreamWorkSpaceSizeNS     // 7
+};
+
+//
+//  Routines to initialize a stream workspace
+//
+
+PRTL_INITIALIZE_DECOMPRESS_STREAM RtlInitializeDecompressStreamProcs[8] = {
+    NULL,                               // 0
+    NULL,                               // 1
+    RtlInitializeDecompressStreamLZNT1, // 2
+    RtlInitializeDecompressStreamMrcf,  // 3
+    RtlInitializeDecompressStreamNS,    // 4
+    RtlInitializeDecompressStreamNS,    // 5
+    RtlInitializeDecompressStreamNS,    // 6
+    RtlInitializeDecompressStreamNS     // 7
+};
+
+//
+//  Routines to decompress the next piece of a stream
+//
+
+PRTL_DECOMPRESS_STREAM RtlDecompressStreamProcs[8] = {
+    NULL,                     // 0
+    NULL,                     // 1
+    RtlDecompressStreamLZNT1, // 2
+    RtlDecompressStreamMrcf,  // 3
+    RtlDecompressStreamNS,    // 4
+    RtlDecompressStreamNS,    // 5
+    RtlDecompressStreamNS,    // 6
+    RtlDecompressStreamNS     // 7
+};
+
+//
+//  The parallel compression routines split the uncompressed buffer on
+//  chunk boundaries.  All of the formats we support today use a fixed
+//  4KB chunk, and store a chunk that will not compress as the raw data
+//  preceded by a USHORT chunk header.  A stripe of n chunks can thus
+//  never need more than RtlpMaximumStripeSize(n) bytes of output, which
+//  includes room for the USHORT ending chunk header.
+//
+
+#define RTL_PARALLEL_CHUNK_SIZE         (0x1000)
+
+#define RtlpMaximumStripeSize(N)        (                      \
+    ((N) * (RTL_PARALLEL_CHUNK_SIZE + sizeof(USHORT))) +       \
+    sizeof(USHORT)                                             \
+)
+
+#define RtlpAlignWorkSpace(S)           (((S) + 7) & ~7)
+
+NTSTATUS
+RtlpComputeCompressionStripes (
+    IN USHORT CompressionFormatAndEngine,
+    IN ULONG UncompressedBufferSize,
+    IN ULONG UncompressedChunkSize,
+    IN OUT PULONG NumberOfStripes,
+    OUT PULONG ChunksPerStripe,
+    OUT PULONG EngineWorkSpaceSize
+    );
+
 #if defined(ALLOC_PRAGMA) && defined(NTOS_KERNEL_RUNTIME)
 #pragma alloc_text(PAGE, RtlGetCompressionWorkSpaceSize)
 #pragma alloc_text(PAGE, RtlCompressBuffer)
@@ -180,12 +275,22 @@ PRTL_RESERVE_CHUNK RtlReserveChunkProcs[8] = {
 #pragma alloc_text(PAGE, RtlDecompressFragment)
 #pragma alloc_text(PAGE, RtlDescribeChunk)
 #pragma alloc_text(PAGE, RtlReserveChunk)
+#pragma alloc_text(PAGE, RtlGetDecompressStreamWorkSpaceSize)
+#pragma alloc_text(PAGE, RtlInitializeDecompressStream)
+#pragma alloc_text(PAGE, RtlDecompressStream)
+#pragma alloc_text(PAGE, RtlGetParallelCompressionWorkSpaceSize)
+#pragma alloc_text(PAGE, RtlCompressBufferParallel)
+#pragma alloc_text(PAGE, RtlCompressStripe)
+#pragma alloc_text(PAGE, RtlpComputeCompressionStripes)
 #pragma alloc_text(PAGE, RtlCompressWorkSpaceSizeNS)
 #pragma alloc_text(PAGE, RtlCompressBufferNS)
 #pragma alloc_text(PAGE, RtlDecompressBufferNS)
 #pragma alloc_text(PAGE, RtlDecompressFragmentNS)
 #pragma alloc_text(PAGE, RtlDescribeChunkNS)
 #pragma alloc_text(PAGE, RtlReserveChunkNS)
+#pragma alloc_text(PAGE, RtlDecompressStreamWorkSpaceSizeNS)
+#pragma alloc_text(PAGE, RtlInitializeDecompressStreamNS)
+#pragma alloc_text(PAGE, RtlDecompressStreamNS)
 #endif
 
 
@@ -714,6 +819,251 @@ Return Value:
                                            ChunkSize );
 }
 
+
+NTSTATUS
+RtlGetDecompressStreamWorkSpaceSize (
+    IN USHORT CompressionFormat,
+    OUT PULONG StreamWorkSpaceSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns to the caller the size in bytes of the
+    work space needed to decompress a stream of the specified format
+    one piece at a time.
+
+Arguments:
+
+    CompressionFormat - Supplies the format of the compressed data.
+
+    StreamWorkSpaceSize - Receives the size in bytes needed for the
+        stream work space.
+
+Return Value:
+
+    STATUS_SUCCESS - the operation worked without a hitch.
+
+    STATUS_INVALID_PARAMETER - The specified format is illegal
+
+    STATUS_UNSUPPORTED_COMPRESSION - the specified compression format
+        is not support.
+
+--*/
+
+{
+    //
+    //  Declare a variable to hold the format specification
+    //
+
+    USHORT Format = CompressionFormat & 0x00ff;
+
+    //
+    //  make sure the format is sort of supported
+    //
+
+    if ((Format == COMPRESSION_FORMAT_NONE) || (Format == COMPRESSION_FORMAT_DEFAULT)) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (Format & 0x00f0) {
+
+        return STATUS_UNSUPPORTED_COMPRESSION;
+    }
+
+    //
+    //  Call the routine to return the workspace size for the format
+    //
+
+    return RtlDecompressStreamWorkSpaceProcs[ Format ]( StreamWorkSpaceSize );
+}
+
+
+NTSTATUS
+RtlInitializeDecompressStream (
+    IN USHORT CompressionFormat,
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a stream work space to decompress a compressed
+    buffer that will be handed to RtlDecompressStream a piece at a time.
+
+Arguments:
+
+    CompressionFormat - Supplies the format of the compressed data.
+
+    UncompressedSize - Supplies the number of bytes of uncompressed data
+        the caller wants out of the stream.  The stream stops once it
+        has returned this many bytes, exactly as RtlDecompressBuffer
+        stops at the end of its uncompressed buffer.  Some formats
+        (e.g., MRCF) need the exact uncompressed size to find the end
+        of the compressed data; others (e.g., LZNT1) accept MAXULONG
+        to mean decompress until the ending chunk header.
+
+    StreamWorkSpace - Supplies the work space, of at least the size
+        returned by RtlGetDecompressStreamWorkSpaceSize, to initialize.
+
+Return Value:
+
+    STATUS_SUCCESS - the operation worked without a hitch.
+
+    STATUS_INVALID_PARAMETER - The specified format is illegal
+
+    STATUS_UNSUPPORTED_COMPRESSION - the specified compression format
+        is not support.
+
+--*/
+
+{
+    NTSTATUS Status;
+
+    //
+    //  Declare a variable to hold the format specification
+    //
+
+    USHORT Format = CompressionFormat & 0x00ff;
+
+    //
+    //  make sure the format is sort of supported
+    //
+
+    if ((Format == COMPRESSION_FORMAT_NONE) || (Format == COMPRESSION_FORMAT_DEFAULT)) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (Format & 0x00f0) {
+
+        return STATUS_UNSUPPORTED_COMPRESSION;
+    }
+
+    //
+    //  Let the format initialize its part of the work space, and then
+    //  fill in the common header so RtlDecompressStream can find the
+    //  format again.
+    //
+
+    Status = RtlInitializeDecompressStreamProcs[ Format ]( UncompressedSize,
+                                                           StreamWorkSpace );
+
+    if (NT_SUCCESS(Status)) {
+
+        PRTL_DECOMPRESS_STREAM_HEADER Header = StreamWorkSpace;
+
+        Header->CompressionFormat = Format;
+        Header->Reserved = 0;
+        Header->UncompressedSizeRemaining = UncompressedSize;
+    }
+
+    return Status;
+}
+
+
+NTSTATUS
+RtlDecompressStream (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    )
+
+/*++
+
+Routine Description:
+
+    This routine takes as input the next piece of a compressed stream
+    and produces as much of its uncompressed equivalent as fits in the
+    uncompressed piece.  Any compressed data that can not yet be decoded,
+    because the rest of its chunk or token is in a later piece, and any
+    uncompressed data that did not fit, is kept in the stream work space
+    for the next call.
+
+    The caller should keep calling this routine, handing in the part of
+    the compressed piece it did not use followed by the next compressed
+    piece, until it returns something other than STATUS_SUCCESS.  Once
+    the caller has no more compressed data it hands in a compressed
+    piece size of zero.
+
+Arguments:
+
+    StreamWorkSpace - Supplies the stream work space initialized by
+        RtlInitializeDecompressStream.
+
+    CompressedPiece - Supplies a pointer to the next compressed data.
+
+    CompressedPieceSize - Supplies the size, in bytes, of the compressed
+        piece, or zero if there is no more compressed data.
+
+    CompressedPieceUsed - Receives the number of bytes of the compressed
+        piece consumed by this call.
+
+    UncompressedPiece - Supplies a pointer to where the uncompressed
+        data is to be stored.
+
+    UncompressedPieceSize - Supplies the size, in bytes, of the
+        uncompressed piece.
+
+    UncompressedPieceUsed - Receives the number of bytes stored in the
+        uncompressed piece by this call.
+
+Return Value:
+
+    STATUS_SUCCESS - the call made what progress it could, and the
+        caller should call again with more compressed data or room for
+        more uncompressed data.
+
+    STATUS_NO_MORE_ENTRIES - the stream is complete; all of its
+        uncompressed data has been returned.
+
+    STATUS_BAD_COMPRESSION_BUFFER - the compressed stream is ill-formed.
+
+    STATUS_UNSUPPORTED_COMPRESSION - the work space does not describe
+        a supported stream.
+
+--*/
+
+{
+    PRTL_DECOMPRESS_STREAM_HEADER Header = StreamWorkSpace;
+
+    USHORT Format = Header->CompressionFormat;
+
+    *CompressedPieceUsed = 0;
+    *UncompressedPieceUsed = 0;
+
+    //
+    //  make sure the work space was set up by RtlInitializeDecompressStream
+    //
+
+    if ((Format == COMPRESSION_FORMAT_NONE) ||
+        (Format == COMPRESSION_FORMAT_DEFAULT) ||
+        (Format & 0xfff8)) {
+
+        return STATUS_UNSUPPORTED_COMPRESSION;
+    }
+
+    //
+    //  Call the decompression routine for the individual format
+    //
+
+    return RtlDecompressStreamProcs[ Format ]( StreamWorkSpace,
+                                               CompressedPiece,
+                                               CompressedPieceSize,
+                                               CompressedPieceUsed,
+                                               UncompressedPiece,
+                                               UncompressedPieceSize,
+                                               UncompressedPieceUsed );
+}
+
 
 NTSTATUS
 RtlDecompressChunks (
@@ -1176,6 +1526,428 @@ Return Value:
 }
 
 
+NTSTATUS
+RtlGetParallelCompressionWorkSpaceSize (
+    IN USHORT CompressionFormatAndEngine,
+    IN ULONG UncompressedBufferSize,
+    IN ULONG UncompressedChunkSize,
+    IN ULONG NumberOfStripes,
+    OUT PULONG ParallelWorkSpaceSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns to the caller the size in bytes of the work
+    space needed by RtlCompressBufferParallel to compress a buffer of
+    the specified size using up to the specified number of stripes.
+
+    The work space holds the stripe descriptors, one compression engine
+    work space per stripe, and the staging buffers that every stripe but
+    the first is compressed into before being packed behind its
+    predecessor.
+
+Arguments:
+
+    CompressionFormatAndEngine - Supplies the format and engine
+        specification for the compressed data.
+
+    UncompressedBufferSize - Supplies the size, in bytes, of the
+        uncompressed buffer that will be compressed.
+
+    UncompressedChunkSize - Supplies the chunk size to use when
+        compressing the input buffer.  The only valid value is 4096.
+
+    NumberOfStripes - Supplies the maximum number of stripes the caller
+        wants the buffer split into.
+
+    ParallelWorkSpaceSize - Receives the size in bytes of the work space.
+
+Return Value:
+
+    STATUS_SUCCESS - the operation worked without a hitch.
+
+    STATUS_INVALID_PARAMETER - The specified format or chunk size is illegal
+
+    STATUS_UNSUPPORTED_COMPRESSION - the specified compression format and/or engine
+        is not support.
+
+--*/
+
+{
+    NTSTATUS Status;
+    ULONG ChunksPerStripe;
+    ULONG EngineWorkSpaceSize;
+
+    Status = RtlpComputeCompressionStripes( CompressionFormatAndEngine,
+                                            UncompressedBufferSize,
+                                            UncompressedChunkSize,
+                                            &NumberOfStripes,
+                                            &ChunksPerStripe,
+                                            &EngineWorkSpaceSize );
+
+    if (!NT_SUCCESS(Status)) { return Status; }
+
+    *ParallelWorkSpaceSize = RtlpAlignWorkSpace(NumberOfStripes * sizeof(RTL_COMPRESS_STRIPE)) +
+                             (NumberOfStripes * EngineWorkSpaceSize) +
+                             ((NumberOfStripes - 1) * RtlpMaximumStripeSize(ChunksPerStripe));
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS
+RtlCompressBufferParallel (
+    IN USHORT CompressionFormatAndEngine,
+    IN PUCHAR UncompressedBuffer,
+    IN ULONG UncompressedBufferSize,
+    OUT PUCHAR CompressedBuffer,
+    IN ULONG CompressedBufferSize,
+    IN ULONG UncompressedChunkSize,
+    OUT PULONG FinalCompressedSize,
+    IN ULONG NumberOfStripes,
+    IN PRTL_COMPRESS_STRIPE_DISPATCH DispatchRoutine OPTIONAL,
+    IN PVOID DispatchContext OPTIONAL,
+    IN PVOID WorkSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine takes as input an uncompressed buffer and produces
+    its compressed equivalent provided the compressed data fits within
+    the specified destination buffer.  The output is in exactly the
+    same format as that produced by RtlCompressBuffer.
+
+    The uncompressed buffer is split into stripes of whole chunks which
+    are handed to the caller's dispatch routine so they can be compressed
+    concurrently.  The first stripe is compressed directly into the
+    caller's buffer and the remaining stripes are compressed into staging
+    buffers in the work space and then copied down behind the previous
+    stripe, dropping the ending chunk header each stripe leaves behind.
+
+Arguments:
+
+    CompressionFormatAndEngine - Supplies the format and engine
+        specification for the compressed data.
+
+    UncompressedBuffer - Supplies a pointer to the uncompressed data.
+
+    UncompressedBufferSize - Supplies the size, in bytes, of the
+        uncompressed buffer.
+
+    CompressedBuffer - Supplies a pointer to where the compressed data
+        is to be stored.
+
+    CompressedBufferSize - Supplies the size, in bytes, of the
+        compressed buffer.
+
+    UncompressedChunkSize - Supplies the chunk size to use when
+        compressing the input buffer.  The only valid value is 4096.
+
+    FinalCompressedSize - Receives the number of bytes needed in
+        the compressed buffer to store the compressed data.
+
+    NumberOfStripes - Supplies the maximum number of stripes to split the
+        buffer into.  This is typically the number of workers the dispatch
+        routine has available.  The buffer is never split into stripes of
+        less than one chunk.
+
+    DispatchRoutine - Optionally supplies the routine that compresses the
+        stripes.  If not specified the stripes are compressed one after
+        the other in the caller's context.
+
+    DispatchContext - Supplies an uninterpreted value passed to the
+        dispatch routine.
+
+    WorkSpace - A workspace area of the size returned from
+        RtlGetParallelCompressionWorkSpaceSize for the same format,
+        buffer size, chunk size and number of stripes.
+
+Return Value:
+
+    STATUS_SUCCESS - the compression worked without a hitch.
+
+    STATUS_INVALID_PARAMETER - The specified format or chunk size is illegal
+
+    STATUS_BUFFER_ALL_ZEROS - the compression worked without a hitch and in
+        addition the input buffer was all zeros.
+
+    STATUS_BUFFER_TOO_SMALL - the compressed buffer is too small to hold the
+        compressed data.
+
+    STATUS_UNSUPPORTED_COMPRESSION - the specified compression format and/or engine
+        is not support.
+
+--*/
+
+{
+    NTSTATUS Status;
+
+    PRTL_COMPRESS_STRIPE Stripes;
+    PUCHAR EngineWorkSpace;
+    PUCHAR StagingBuffer;
+
+    ULONG ChunksPerStripe;
+    ULONG EngineWorkSpaceSize;
+    ULONG StripeSize;
+    ULONG CompressedSize;
+    ULONG i;
+
+    BOOLEAN AllZero = TRUE;
+
+    Status = RtlpComputeCompressionStripes( CompressionFormatAndEngine,
+                                            UncompressedBufferSize,
+                                            UncompressedChunkSize,
+                                            &NumberOfStripes,
+                                            &ChunksPerStripe,
+                                            &EngineWorkSpaceSize );
+
+    if (!NT_SUCCESS(Status)) { return Status; }
+
+    //
+    //  Carve up the work space into the stripe array, the engine work
+    //  spaces and the staging buffers, in the order that
+    //  RtlGetParallelCompressionWorkSpaceSize sized them.
+    //
+
+    Stripes = (PRTL_COMPRESS_STRIPE)WorkSpace;
+    EngineWorkSpace = (PUCHAR)WorkSpace + RtlpAlignWorkSpace(NumberOfStripes * sizeof(RTL_COMPRESS_STRIPE));
+    StagingBuffer = EngineWorkSpace + (NumberOfStripes * EngineWorkSpaceSize);
+
+    StripeSize = ChunksPerStripe * RTL_PARALLEL_CHUNK_SIZE;
+
+    for (i = 0; i < NumberOfStripes; i += 1) {
+
+        Stripes[i].CompressionFormatAndEngine = CompressionFormatAndEngine;
+        Stripes[i].Reserved = 0;
+
+        Stripes[i].UncompressedBuffer = UncompressedBuffer + (i * StripeSize);
+        Stripes[i].UncompressedBufferSize = UncompressedBufferSize - (i * StripeSize);
+
+        if (Stripes[i].UncompressedBufferSize > StripeSize) {
+
+            Stripes[i].UncompressedBufferSize = StripeSize;
+        }
+
+        Stripes[i].WorkSpace = EngineWorkSpace + (i * EngineWorkSpaceSize);
+
+        //
+        //  The first stripe goes straight into the caller's buffer, the
+        //  rest get a staging buffer large enough for the worst case.
+        //
+
+        if (i == 0) {
+
+            Stripes[i].CompressedBuffer = CompressedBuffer;
+            Stripes[i].CompressedBufferSize = CompressedBufferSize;
+
+        } else {
+
+            Stripes[i].CompressedBuffer = StagingBuffer + ((i - 1) * RtlpMaximumStripeSize(ChunksPerStripe));
+            Stripes[i].CompressedBufferSize = RtlpMaximumStripeSize(ChunksPerStripe);
+        }
+
+        Stripes[i].FinalCompressedSize = 0;
+        Stripes[i].Status = STATUS_PENDING;
+    }
+
+    //
+    //  Now have the stripes compressed, either by the caller's workers
+    //  or inline if the caller didn't give us a way to dispatch them.
+    //
+
+    if (ARGUMENT_PRESENT(DispatchRoutine) && (NumberOfStripes > 1)) {
+
+        DispatchRoutine( Stripes, NumberOfStripes, DispatchContext );
+
+    } else {
+
+        for (i = 0; i < NumberOfStripes; i += 1) {
+
+            RtlCompressStripe( &Stripes[i] );
+        }
+    }
+
+    //
+    //  Pack the stripes together.  Each stripe ends on a chunk boundary so
+    //  the next stripe's first chunk header simply overwrites the ending
+    //  chunk header of its predecessor.
+    //
+
+    CompressedSize = 0;
+
+    for (i = 0; i < NumberOfStripes; i += 1) {
+
+        ASSERT(Stripes[i].Status != STATUS_PENDING);
+
+        if (!NT_SUCCESS(Stripes[i].Status)) {
+
+            return Stripes[i].Status;
+        }
+
+        AllZero = AllZero && (Stripes[i].Status == STATUS_BUFFER_ALL_ZEROS);
+
+        if (i != 0) {
+
+            if (Stripes[i].FinalCompressedSize > CompressedBufferSize - CompressedSize) {
+
+                return STATUS_BUFFER_TOO_SMALL;
+            }
+
+            RtlCopyMemory( CompressedBuffer + CompressedSize,
+                           Stripes[i].CompressedBuffer,
+                           Stripes[i].FinalCompressedSize );
+        }
+
+        CompressedSize += Stripes[i].FinalCompressedSize;
+    }
+
+    //
+    //  As in the serial case, store the ending chunk header if there is
+    //  room for it but don't count it in the final size.
+    //
+
+    if (CompressedSize + sizeof(USHORT) <= CompressedBufferSize) {
+
+        *(CompressedBuffer + CompressedSize) = 0;
+        *(CompressedBuffer + CompressedSize + 1) = 0;
+    }
+
+    *FinalCompressedSize = CompressedSize;
+
+    if (AllZero) { return STATUS_BUFFER_ALL_ZEROS; }
+
+    return STATUS_SUCCESS;
+}
+
+
+VOID
+RtlCompressStripe (
+    IN OUT PRTL_COMPRESS_STRIPE Stripe
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compresses one stripe set up by RtlCompressBufferParallel.
+    It is called by the caller's dispatch routine, and may be called for
+    different stripes of the same buffer concurrently.
+
+Arguments:
+
+    Stripe - Supplies the stripe to compress, and receives the compressed
+        size and completion status.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    Stripe->Status = RtlCompressBuffer( Stripe->CompressionFormatAndEngine,
+                                        Stripe->UncompressedBuffer,
+                                        Stripe->UncompressedBufferSize,
+                                        Stripe->CompressedBuffer,
+                                        Stripe->CompressedBufferSize,
+                                        RTL_PARALLEL_CHUNK_SIZE,
+                                        &Stripe->FinalCompressedSize,
+                                        Stripe->WorkSpace );
+}
+
+
+//
+//  Local support routine
+//
+
+NTSTATUS
+RtlpComputeCompressionStripes (
+    IN USHORT CompressionFormatAndEngine,
+    IN ULONG UncompressedBufferSize,
+    IN ULONG UncompressedChunkSize,
+    IN OUT PULONG NumberOfStripes,
+    OUT PULONG ChunksPerStripe,
+    OUT PULONG EngineWorkSpaceSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine decides how a buffer is to be split up for parallel
+    compression.  Chunks are spread as evenly as possible over the
+    requested number of stripes, and the number of stripes is trimmed
+    so that no stripe is left empty.
+
+Arguments:
+
+    CompressionFormatAndEngine - Supplies the format and engine
+        specification for the compressed data.
+
+    UncompressedBufferSize - Supplies the size, in bytes, of the
+        uncompressed buffer.
+
+    UncompressedChunkSize - Supplies the chunk size to use when
+        compressing the input buffer.
+
+    NumberOfStripes - Supplies the maximum number of stripes and receives
+        the number of stripes that will actually be used.
+
+    ChunksPerStripe - Receives the number of chunks in every stripe but
+        possibly the last.
+
+    EngineWorkSpaceSize - Receives the aligned size of the work space
+        each stripe needs for the compression engine.
+
+Return Value:
+
+    STATUS_SUCCESS - the operation worked without a hitch.
+
+    STATUS_INVALID_PARAMETER - The specified format or chunk size is illegal
+
+    STATUS_UNSUPPORTED_COMPRESSION - the specified compression format and/or engine
+        is not support.
+
+--*/
+
+{
+    NTSTATUS Status;
+    ULONG NumberOfChunks;
+    ULONG FragmentWorkSpaceSize;
+
+    if (UncompressedChunkSize != RTL_PARALLEL_CHUNK_SIZE) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Status = RtlGetCompressionWorkSpaceSize( CompressionFormatAndEngine,
+                                             EngineWorkSpaceSize,
+                                             &FragmentWorkSpaceSize );
+
+    if (!NT_SUCCESS(Status)) { return Status; }
+
+    *EngineWorkSpaceSize = RtlpAlignWorkSpace(*EngineWorkSpaceSize);
+
+    NumberOfChunks = (UncompressedBufferSize + RTL_PARALLEL_CHUNK_SIZE - 1) / RTL_PARALLEL_CHUNK_SIZE;
+
+    if (NumberOfChunks == 0) { NumberOfChunks = 1; }
+
+    if ((*NumberOfStripes == 0) || (*NumberOfStripes > NumberOfChunks)) {
+
+        *NumberOfStripes = NumberOfChunks;
+    }
+
+    *ChunksPerStripe = (NumberOfChunks + *NumberOfStripes - 1) / *NumberOfStripes;
+    *NumberOfStripes = (NumberOfChunks + *ChunksPerStripe - 1) / *ChunksPerStripe;
+
+    return STATUS_SUCCESS;
+}
+
+
 NTSTATUS
 RtlCompressWorkSpaceSizeNS (
     IN USHORT CompressionEngine,
@@ -1255,3 +2027,33 @@ RtlReserveChunkNS (
     return STATUS_UNSUPPORTED_COMPRESSION;
 }
 
+NTSTATUS
+RtlDecompressStreamWorkSpaceSizeNS (
+    OUT PULONG StreamWorkSpaceSize
+    )
+{
+    return STATUS_UNSUPPORTED_COMPRESSION;
+}
+
+NTSTATUS
+RtlInitializeDecompressStreamNS (
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    )
+{
+    return STATUS_UNSUPPORTED_COMPRESSION;
+}
+
+NTSTATUS
+RtlDecompressStreamNS (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    )
+{
+    return STATUS_UNSUPPORTED_COMPRESSION;
+}
@@ -68,9 +68,12 @@ RtlpExtendHeap(
 #pragma alloc_text(PAGE, RtlpInsertFreeBlock)
 #pragma alloc_text(PAGE, RtlAllocateHeap)
 #pragma alloc_text(PAGE, RtlFreeHeap)
+#pragma alloc_text(PAGE, RtlpFreeBlockToFreeLists)
+#pragma alloc_text(PAGE, RtlpGetHeapAffinityCount)
 #pragma alloc_text(PAGE, RtlpGetSizeOfBigBlock)
 #pragma alloc_text(PAGE, RtlpCheckBusyBlockTail)
 #pragma alloc_text(PAGE, RtlZeroHeap)
+#pragma alloc_text(PAGE, RtlQueryHeapInformation)
 #endif
 
 #else
@@ -957,6 +960,7 @@ Return Value:
     Heap->FreeListsInUseTerminate = 0xFFFF;
     Heap->HeaderValidateLength = (USHORT)((ULONG)NextHeapHeaderAddress - (ULONG)Heap);
     Heap->HeaderValidateCopy = NULL;
+    RtlZeroMemory( &Heap->Counters, sizeof( Heap->Counters ) );
 
     FreeListHead = &Heap->FreeLists[ 0 ];
     n = HEAP_MAXIMUM_FREELISTS;
@@ -1018,6 +1022,35 @@ Return Value:
 
         }
     Heap->CommitRoutine = Parameters->CommitRoutine;
+    Heap->FrontEndHeap = NULL;
+
+    //
+    // The low fragmentation front end relies on the heap being serialized
+    // and is bypassed by all of the slow path features, so only set it up
+    // for heaps that use the fast paths.  A heap without a front end still
+    // works, so failing to create one is not fatal.
+    //
+
+    Heap->FreeCache = NULL;
+    if (!(Flags & HEAP_NO_SERIALIZE) && !(Heap->ForceFlags & HEAP_SLOW_FLAGS)) {
+        if (Flags & HEAP_CREATE_LOW_FRAGMENTATION) {
+            RtlpCreateLowFragHeap( Heap );
+            }
+
+        //
+        // The front end already keeps small blocks out of the heap lock, so
+        // the free cache is only needed for growable heaps without one.
+        // Fixed size heaps do not get one either, since the blocks it holds
+        // on to could make them run out of space early.  Callers that want
+        // every free to coalesce right away can ask for no free cache.
+        //
+
+        if (Heap->FrontEndHeap == NULL &&
+            (Flags & HEAP_GROWABLE) &&
+            !(Flags & HEAP_CREATE_NO_FREE_CACHE)) {
+            RtlpCreateHeapFreeCache( Heap );
+            }
+        }
 
 #if !defined(NTOS_KERNEL_RUNTIME)
     RtlpAddHeapToProcessList( Heap );
@@ -1085,6 +1118,8 @@ RtlDestroyHeap(
     RtlpRemoveHeapFromProcessList( Heap );
 #endif // !defined(NTOS_KERNEL_RUNTIME)
 
+    RtlpDestroyLowFragHeap( Heap );
+
     //
     // If the heap is serialized, delete the critical section created
     // by RtlCreateHeap.
@@ -1144,6 +1179,7 @@ RtlpExtendHeap(
     FreeSize = NumberOfPages * PAGE_SIZE;
 
     HeapInternalTrace( Heap, (Heap->TraceBuffer, HEAP_TRACE_EXTEND_HEAP, 3, AllocationSize, NumberOfPages, FreeSize) );
+    Heap->Counters.ExtendCalls += 1;
 
     EmptySegmentIndex = HEAP_MAXIMUM_SEGMENTS;
     for (SegmentIndex=0; SegmentIndex<HEAP_MAXIMUM_SEGMENTS; SegmentIndex++) {
@@ -1273,6 +1309,7 @@ RtlpCoalesceFreeBlocks(
             }
 
         RtlpRemoveFreeBlock( Heap, FreeBlock1 );
+        Heap->Counters.CoalescedBlocks += 1;
         FreeBlock1->Flags = FreeBlock->Flags & HEAP_ENTRY_LAST_ENTRY;
         FreeBlock = FreeBlock1;
         *FreeSize += FreeBlock1->Size;
@@ -1304,6 +1341,7 @@ RtlpCoalesceFreeBlocks(
 
             FreeBlock->Flags = NextFreeBlock->Flags & HEAP_ENTRY_LAST_ENTRY;
             RtlpRemoveFreeBlock( Heap, NextFreeBlock );
+            Heap->Counters.CoalescedBlocks += 1;
             *FreeSize += NextFreeBlock->Size;
             Heap->TotalFreeSize -= NextFreeBlock->Size;
             FreeBlock->Size = (USHORT)*FreeSize;
@@ -1388,6 +1426,7 @@ RtlpDeCommitFreeBlock(
                                         DeCommitSize
                                       );
             Segment->NumberOfUnCommittedPages += DeCommitSize / PAGE_SIZE;
+            Heap->Counters.DeCommitCalls += 1;
 
             if (LeadingFreeSize != 0) {
                 LeadingFreeBlock->Flags = HEAP_ENTRY_LAST_ENTRY;
@@ -1529,6 +1568,40 @@ RtlAllocateHeap(
 
         AllocationSize = ((Size ? Size : 1) + 7 + sizeof( HEAP_ENTRY )) & (ULONG)~7;
         AllocationIndex = AllocationSize >>  HEAP_GRANULARITY_SHIFT;
+        RtlpCountHeapAllocation( Heap, AllocationIndex );
+
+        //
+        // A small block of exactly the right size may be sitting in the free
+        // cache, in which case there is no need to take the lock.
+        //
+
+        if (Heap->FreeCache != NULL && AllocationIndex < HEAP_MAXIMUM_FREELISTS) {
+            BusyBlock = RtlpAllocateFromHeapFreeCache( Heap, AllocationIndex );
+            if (BusyBlock != NULL) {
+                Heap->Counters.FrontEndHits += 1;
+                BusyBlock->UnusedBytes = (UCHAR)(AllocationSize - Size);
+                ReturnValue = BusyBlock + 1;
+                if (Flags & HEAP_ZERO_MEMORY) {
+                    RtlZeroMemory( ReturnValue, Size );
+                }
+
+                return ReturnValue;
+            }
+        }
+
+        //
+        // Small blocks come from the low fragmentation front end if the heap
+        // has one.  If it cannot get more memory fall into the regular path,
+        // which will fail the same way or find a free block.
+        //
+
+        if (Heap->FrontEndHeap != NULL && AllocationIndex < HEAP_MAXIMUM_FREELISTS) {
+            ReturnValue = RtlpLowFragHeapAllocate( Heap, Flags, Size, AllocationIndex );
+            if (ReturnValue != NULL) {
+                Heap->Counters.FrontEndHits += 1;
+                return ReturnValue;
+            }
+        }
 
         if (!(Flags & HEAP_NO_SERIALIZE)) {
 
@@ -1538,6 +1611,7 @@ RtlAllocateHeap(
             RtlAcquireLockRoutine( Heap->LockVariable );
         }
 
+SearchFreeLists:
         if (AllocationIndex < HEAP_MAXIMUM_FREELISTS) {
             FreeListHead = &Heap->FreeLists[ AllocationIndex ];
             if ( !IsListEmpty( FreeListHead ))  {
@@ -1547,11 +1621,13 @@ RtlAllocateHeap(
                 FreeFlags = FreeBlock->Flags;
                 RtlpFastRemoveDedicatedFreeBlock( Heap, FreeBlock );
                 Heap->TotalFreeSize -= AllocationIndex;
+                Heap->Counters.FreeListHits += 1;
                 BusyBlock = (PHEAP_ENTRY)FreeBlock;
                 BusyBlock->Flags = HEAP_ENTRY_BUSY | (FreeFlags & HEAP_ENTRY_LAST_ENTRY);
                 BusyBlock->UnusedBytes = (UCHAR)(AllocationSize - Size);
                 BusyBlock->SmallTagIndex = 0;
             } else {
+                Heap->Counters.FreeListMisses += 1;
 
                 //
                 // Scan the free list in use vector to find the smallest
@@ -1702,6 +1778,7 @@ SplitFreeBlock:
 
             return(ReturnValue);
         } else if (AllocationIndex <= Heap->VirtualMemoryThreshold) {
+            Heap->Counters.FreeListMisses += 1;
 
 LookInNonDedicatedList:
             FreeListHead = &Heap->FreeLists[0];
@@ -1720,6 +1797,15 @@ LookInNonDedicatedList:
                 RtlpFastRemoveNonDedicatedFreeBlock( Heap, FreeBlock );
                 goto SplitFreeBlock;
             }
+
+            //
+            // Before giving up, give back whatever is in the free cache and
+            // look again.
+            //
+
+            if (RtlpFlushHeapFreeCache( Heap )) {
+                goto SearchFreeLists;
+            }
             Status = STATUS_NO_MEMORY;
 
         } else if (Heap->Flags & HEAP_GROWABLE) {
@@ -1852,6 +1938,9 @@ RtlAllocateHeapSlowly(
 
 
     try {
+        RtlpCountHeapAllocation( Heap, AllocationIndex );
+
+SearchFreeLists:
         if (AllocationIndex < HEAP_MAXIMUM_FREELISTS) {
             FreeListHead = &Heap->FreeLists[ AllocationIndex ];
             if ( !IsListEmpty( FreeListHead ))  {
@@ -1862,11 +1951,13 @@ RtlAllocateHeapSlowly(
                 FreeFlags = FreeBlock->Flags;
                 RtlpRemoveFreeBlock( Heap, FreeBlock );
                 Heap->TotalFreeSize -= AllocationIndex;
+                Heap->Counters.FreeListHits += 1;
                 BusyBlock = (PHEAP_ENTRY)FreeBlock;
                 BusyBlock->Flags = EntryFlags | (FreeFlags & HEAP_ENTRY_LAST_ENTRY);
                 BusyBlock->UnusedBytes = (UCHAR)(AllocationSize - Size);
                 }
             else {
+                Heap->Counters.FreeListMisses += 1;
                 if (AllocationIndex < (HEAP_MAXIMUM_FREELISTS * 1) / 4) {
                     FreeListsInUse = &Heap->u.FreeListsInUseUlong[ 0 ];
                     FreeListsInUseUlong = *FreeListsInUse++ >> (AllocationIndex & 0x1F);
@@ -2074,6 +2165,7 @@ SplitFreeBlock:
             }
         else
         if (AllocationIndex <= Heap->VirtualMemoryThreshold) {
+            Heap->Counters.FreeListMisses += 1;
 LookInNonDedicatedList:
             FreeListHead = &Heap->FreeLists[ 0 ];
             Next = FreeListHead->Flink;
@@ -2092,6 +2184,15 @@ LookInNonDedicatedList:
                 goto SplitFreeBlock;
                 }
 
+            //
+            // Before giving up, give back whatever is in the free cache and
+            // look again.
+            //
+
+            if (RtlpFlushHeapFreeCache( Heap )) {
+                goto SearchFreeLists;
+                }
+
             Status = STATUS_NO_MEMORY;
             }
         else
@@ -2207,6 +2308,21 @@ RtlFreeHeap(
 
         Flags |= Heap->ForceFlags;
 
+        //
+        // Blocks carved by the low fragmentation front end go back to it,
+        // whatever flags the caller passed.  Frees are only counted once
+        // the block has actually been freed.
+        //
+
+        if (IS_LOW_FRAG_HEAP_BLOCK( Heap, (PHEAP_ENTRY)BaseAddress - 1 )) {
+            if (!RtlpLowFragHeapFree( Heap, (PHEAP_ENTRY)BaseAddress - 1 )) {
+                return(FALSE);
+            }
+
+            Heap->Counters.Frees += 1;
+            return(TRUE);
+        }
+
         if ( ! ( Flags & HEAP_SLOW_FLAGS )) {
 
             BusyBlock = (PHEAP_ENTRY)BaseAddress - 1;
@@ -2230,6 +2346,27 @@ RtlFreeHeap(
                 (((ULONG)BaseAddress & 0x7) == 0) &&
                 (BusyBlock->SegmentIndex < HEAP_MAXIMUM_SEGMENTS)) {
 
+                if (Heap->FreeCache != NULL &&
+                    BusyBlock->Size < HEAP_MAXIMUM_FREELISTS &&
+                    !(BusyBlock->Flags & (HEAP_ENTRY_EXTRA_PRESENT |
+                                          HEAP_ENTRY_FILL_PATTERN |
+                                          HEAP_ENTRY_VIRTUAL_ALLOC))) {
+
+                    //
+                    // A block that is already in the free cache is being
+                    // freed a second time.
+                    //
+
+                    if (BusyBlock->UnusedBytes == 0) {
+                        SET_LAST_STATUS( STATUS_INVALID_PARAMETER );
+                        return(FALSE);
+                    }
+
+                    RtlpFreeToHeapFreeCache( Heap, Flags, BusyBlock );
+                    Heap->Counters.Frees += 1;
+                    return(TRUE);
+                }
+
                 //
                 // Lock the heap
                 //
@@ -2239,50 +2376,8 @@ RtlFreeHeap(
                 }
 
                 if (!(BusyBlock->Flags & HEAP_ENTRY_VIRTUAL_ALLOC)) {
-                    FreeSize = BusyBlock->Size;
-#ifdef NTOS_KERNEL_RUNTIME
-                    BusyBlock = (PHEAP_ENTRY)RtlpCoalesceFreeBlocks( Heap,
-                                                                     (PHEAP_FREE_ENTRY)BusyBlock,
-                                                                     &FreeSize,
-                                                                     FALSE );
-#else
-                    if (!(Heap->Flags & HEAP_DISABLE_COALESCE_ON_FREE)) {
-                        BusyBlock = (PHEAP_ENTRY)RtlpCoalesceFreeBlocks( Heap,
-                                                                         (PHEAP_FREE_ENTRY)BusyBlock,
-                                                                         &FreeSize,
-                                                                         FALSE );
-                    }
-#endif
-                    //
-                    // Check for a small allocation that can go on a freelist
-                    // first, these should never trigger a decommit.
-                    //
-                    HEAPASSERT(HEAP_MAXIMUM_FREELISTS < Heap->DeCommitFreeBlockThreshold);
-                    if (FreeSize < HEAP_MAXIMUM_FREELISTS) {
-                        RtlpFastInsertDedicatedFreeBlockDirect( Heap,
-                                                                (PHEAP_FREE_ENTRY)BusyBlock,
-                                                                (USHORT)FreeSize );
-                        Heap->TotalFreeSize += FreeSize;
-                        if (!(BusyBlock->Flags & HEAP_ENTRY_LAST_ENTRY)) {
-                            HEAPASSERT((BusyBlock + FreeSize)->PreviousSize == (USHORT)FreeSize);
-                        }
-                    } else if ((FreeSize < Heap->DeCommitFreeBlockThreshold) ||
-                        ((Heap->TotalFreeSize + FreeSize) < Heap->DeCommitTotalFreeThreshold)) {
-                        if (FreeSize <= (ULONG)HEAP_MAXIMUM_BLOCK_SIZE) {
-                            RtlpFastInsertNonDedicatedFreeBlockDirect( Heap,
-                                                                       (PHEAP_FREE_ENTRY)BusyBlock,
-                                                                       (USHORT)FreeSize );
-                            if (!(BusyBlock->Flags & HEAP_ENTRY_LAST_ENTRY)) {
-                                HEAPASSERT((BusyBlock + FreeSize)->PreviousSize == (USHORT)FreeSize);
-                            }
-                            Heap->TotalFreeSize += FreeSize;
-                        } else {
-                            RtlpInsertFreeBlock( Heap, (PHEAP_FREE_ENTRY)BusyBlock, FreeSize );
-                        }
-
-                    } else {
-                        RtlpDeCommitFreeBlock( Heap, (PHEAP_FREE_ENTRY)BusyBlock, FreeSize );
-                    }
+                    RtlpFreeBlockToFreeLists( Heap, BusyBlock );
+                    Heap->Counters.Frees += 1;
 
                     //
                     // Unlock the heap
@@ -2315,6 +2410,8 @@ RtlFreeHeap(
                         SET_LAST_STATUS( Status );
                         return(FALSE);
                     }
+
+                    Heap->Counters.Frees += 1;
                 }
 
                 return(TRUE);
@@ -2335,7 +2432,12 @@ RtlFreeHeap(
             // Call the do-everything allocator.
             //
 
-            return(RtlFreeHeapSlowly(HeapHandle, Flags, BaseAddress));
+            if (!RtlFreeHeapSlowly(HeapHandle, Flags, BaseAddress)) {
+                return(FALSE);
+            }
+
+            Heap->Counters.Frees += 1;
+            return(TRUE);
         }
 
     } else {
@@ -2350,6 +2452,363 @@ RtlFreeHeap(
 } // RtlFreeHeap
 
 
+VOID
+RtlpFreeBlockToFreeLists(
+    IN PHEAP Heap,
+    IN PHEAP_ENTRY BusyBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a busy block that is not a virtual allocation.  The
+    block is coalesced with its free neighbors and the result is put on the
+    free lists or decommitted.  The heap lock must be held by the caller.
+
+Arguments:
+
+    Heap - Supplies the heap the block belongs to.
+
+    BusyBlock - Supplies the block being freed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    ULONG FreeSize;
+
+    RTL_PAGED_CODE();
+
+    FreeSize = BusyBlock->Size;
+#ifdef NTOS_KERNEL_RUNTIME
+    BusyBlock = (PHEAP_ENTRY)RtlpCoalesceFreeBlocks( Heap,
+                                                     (PHEAP_FREE_ENTRY)BusyBlock,
+                                                     &FreeSize,
+                                                     FALSE );
+#else
+    if (!(Heap->Flags & HEAP_DISABLE_COALESCE_ON_FREE)) {
+        BusyBlock = (PHEAP_ENTRY)RtlpCoalesceFreeBlocks( Heap,
+                                                         (PHEAP_FREE_ENTRY)BusyBlock,
+                                                         &FreeSize,
+                                                         FALSE );
+    }
+#endif
+    //
+    // Check for a small allocation that can go on a freelist
+    // first, these should never trigger a decommit.
+    //
+    HEAPASSERT(HEAP_MAXIMUM_FREELISTS < Heap->DeCommitFreeBlockThreshold);
+    if (FreeSize < HEAP_MAXIMUM_FREELISTS) {
+        RtlpFastInsertDedicatedFreeBlockDirect( Heap,
+                                                (PHEAP_FREE_ENTRY)BusyBlock,
+                                                (USHORT)FreeSize );
+        Heap->TotalFreeSize += FreeSize;
+        if (!(BusyBlock->Flags & HEAP_ENTRY_LAST_ENTRY)) {
+            HEAPASSERT((BusyBlock + FreeSize)->PreviousSize == (USHORT)FreeSize);
+        }
+    } else if ((FreeSize < Heap->DeCommitFreeBlockThreshold) ||
+        ((Heap->TotalFreeSize + FreeSize) < Heap->DeCommitTotalFreeThreshold)) {
+        if (FreeSize <= (ULONG)HEAP_MAXIMUM_BLOCK_SIZE) {
+            RtlpFastInsertNonDedicatedFreeBlockDirect( Heap,
+                                                       (PHEAP_FREE_ENTRY)BusyBlock,
+                                                       (USHORT)FreeSize );
+            if (!(BusyBlock->Flags & HEAP_ENTRY_LAST_ENTRY)) {
+                HEAPASSERT((BusyBlock + FreeSize)->PreviousSize == (USHORT)FreeSize);
+            }
+            Heap->TotalFreeSize += FreeSize;
+        } else {
+            RtlpInsertFreeBlock( Heap, (PHEAP_FREE_ENTRY)BusyBlock, FreeSize );
+        }
+
+    } else {
+        RtlpDeCommitFreeBlock( Heap, (PHEAP_FREE_ENTRY)BusyBlock, FreeSize );
+    }
+}
+
+
+ULONG
+RtlpGetHeapAffinityCount(
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of affinity slots to use for per heap
+    data that is replicated to avoid contention: the number of processors
+    rounded up to a power of two, but no more than HEAP_MAXIMUM_AFFINITY.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    ULONG - the number of affinity slots.
+
+--*/
+
+{
+    ULONG NumberOfProcessors;
+    ULONG AffinityCount;
+
+    RTL_PAGED_CODE();
+
+#ifdef NTOS_KERNEL_RUNTIME
+    NumberOfProcessors = (ULONG)KeNumberProcessors;
+#else
+    NumberOfProcessors = NtCurrentPeb()->NumberOfProcessors;
+#endif // NTOS_KERNEL_RUNTIME
+
+    AffinityCount = 1;
+    while (AffinityCount < NumberOfProcessors &&
+           AffinityCount < HEAP_MAXIMUM_AFFINITY
+          ) {
+        AffinityCount <<= 1;
+        }
+
+    return AffinityCount;
+}
+
+#if HEAP_FREE_CACHE_SUPPORTED
+
+
+BOOLEAN
+RtlpCreateHeapFreeCache(
+    IN PHEAP Heap
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates the free cache for a heap.  The cache is allocated
+    from the heap itself and starts out with all of its lists empty.
+
+Arguments:
+
+    Heap - Supplies the heap that is to get a free cache.
+
+Return Value:
+
+    BOOLEAN - TRUE if the cache was created and FALSE otherwise.  The heap
+        is usable without a cache.
+
+--*/
+
+{
+    PHEAP_FREE_CACHE FreeCache;
+    ULONG AffinityCount;
+
+    AffinityCount = RtlpGetHeapAffinityCount();
+    FreeCache = RtlAllocateHeap( Heap,
+                                 HEAP_ZERO_MEMORY,
+                                 FIELD_OFFSET( HEAP_FREE_CACHE, Slots ) +
+                                     (AffinityCount * sizeof( HEAP_FREE_CACHE_SLOT ))
+                               );
+    if (FreeCache == NULL) {
+        return FALSE;
+        }
+
+    FreeCache->AffinityMask = AffinityCount - 1;
+    Heap->FreeCache = FreeCache;
+    return TRUE;
+}
+
+
+PHEAP_ENTRY
+RtlpAllocateFromHeapFreeCache(
+    IN PHEAP Heap,
+    IN ULONG AllocationIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine takes a block of the given size out of the free cache of
+    the current affinity slot.  The block is still marked busy, so the
+    caller only has to fill in UnusedBytes.
+
+Arguments:
+
+    Heap - Supplies the heap to allocate from.
+
+    AllocationIndex - Supplies the size of the block in granules.
+
+Return Value:
+
+    PHEAP_ENTRY - the block, or NULL if the cache has none of that size.
+
+--*/
+
+{
+    PHEAP_FREE_CACHE FreeCache;
+    PSLIST_HEADER ListHead;
+    PSINGLE_LIST_ENTRY Entry;
+
+    FreeCache = Heap->FreeCache;
+    ListHead = &FreeCache->Slots[ RtlpGetHeapAffinityIndex() & FreeCache->AffinityMask ].Lists[ AllocationIndex ];
+    if (ListHead->Next.Next == NULL) {
+        return NULL;
+        }
+
+    //
+    // The pop reads the link in the first block, which can fault if another
+    // thread took that block and its page was decommitted in the meantime.
+    // Treat that as a miss.
+    //
+
+    try {
+        Entry = RtlpInterlockedPopEntrySList( ListHead );
+        }
+    except( EXCEPTION_EXECUTE_HANDLER ) {
+        Entry = NULL;
+        }
+
+    if (Entry == NULL) {
+        return NULL;
+        }
+
+    return (PHEAP_ENTRY)Entry - 1;
+}
+
+
+VOID
+RtlpFreeToHeapFreeCache(
+    IN PHEAP Heap,
+    IN ULONG Flags,
+    IN PHEAP_ENTRY BusyBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine puts a busy block into the free cache of the current
+    affinity slot.  If the list for its size is already full, the whole
+    list and the block are given back to the free lists instead, under a
+    single acquisition of the heap lock.
+
+Arguments:
+
+    Heap - Supplies the heap the block belongs to.
+
+    Flags - Supplies the flags of the free call.
+
+    BusyBlock - Supplies the block being freed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PHEAP_FREE_CACHE FreeCache;
+    PSLIST_HEADER ListHead;
+    PSINGLE_LIST_ENTRY Entry, Next;
+    ULONG MaximumDepth;
+
+    FreeCache = Heap->FreeCache;
+    ListHead = &FreeCache->Slots[ RtlpGetHeapAffinityIndex() & FreeCache->AffinityMask ].Lists[ BusyBlock->Size ];
+
+    BusyBlock->Flags &= (HEAP_ENTRY_BUSY | HEAP_ENTRY_LAST_ENTRY);
+    BusyBlock->UnusedBytes = 0;
+    BusyBlock->SmallTagIndex = 0;
+
+    MaximumDepth = HEAP_FREE_CACHE_BYTES / (BusyBlock->Size << HEAP_GRANULARITY_SHIFT);
+    if (MaximumDepth < HEAP_FREE_CACHE_MINIMUM_DEPTH) {
+        MaximumDepth = HEAP_FREE_CACHE_MINIMUM_DEPTH;
+        }
+    else
+    if (MaximumDepth > HEAP_FREE_CACHE_MAXIMUM_DEPTH) {
+        MaximumDepth = HEAP_FREE_CACHE_MAXIMUM_DEPTH;
+        }
+
+    if (ListHead->Depth < MaximumDepth) {
+        RtlpInterlockedPushEntrySList( ListHead, (PSINGLE_LIST_ENTRY)(BusyBlock + 1) );
+        return;
+        }
+
+    Entry = RtlpInterlockedFlushSList( ListHead );
+
+    if (!(Flags & HEAP_NO_SERIALIZE)) {
+        RtlAcquireLockRoutine( Heap->LockVariable );
+        }
+
+    RtlpFreeBlockToFreeLists( Heap, BusyBlock );
+    while (Entry != NULL) {
+        Next = Entry->Next;
+        RtlpFreeBlockToFreeLists( Heap, (PHEAP_ENTRY)Entry - 1 );
+        Entry = Next;
+        }
+
+    if (!(Flags & HEAP_NO_SERIALIZE)) {
+        RtlReleaseLockRoutine( Heap->LockVariable );
+        }
+
+    return;
+}
+
+
+BOOLEAN
+RtlpFlushHeapFreeCache(
+    IN PHEAP Heap
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gives every block in the free cache of a heap back to the
+    free lists.  The heap lock must be held by the caller.
+
+Arguments:
+
+    Heap - Supplies the heap whose cache is flushed.
+
+Return Value:
+
+    BOOLEAN - TRUE if any blocks were given back and FALSE otherwise.
+
+--*/
+
+{
+    PHEAP_FREE_CACHE FreeCache;
+    PSINGLE_LIST_ENTRY Entry, Next;
+    ULONG Slot, Index;
+    BOOLEAN Flushed;
+
+    FreeCache = Heap->FreeCache;
+    if (FreeCache == NULL) {
+        return FALSE;
+        }
+
+    Flushed = FALSE;
+    for (Slot = 0; Slot <= FreeCache->AffinityMask; Slot++) {
+        for (Index = 0; Index < HEAP_MAXIMUM_FREELISTS; Index++) {
+            Entry = RtlpInterlockedFlushSList( &FreeCache->Slots[ Slot ].Lists[ Index ] );
+            while (Entry != NULL) {
+                Next = Entry->Next;
+                RtlpFreeBlockToFreeLists( Heap, (PHEAP_ENTRY)Entry - 1 );
+                Flushed = TRUE;
+                Entry = Next;
+                }
+            }
+        }
+
+    return Flushed;
+}
+
+#endif // HEAP_FREE_CACHE_SUPPORTED
+
+
 BOOLEAN
 RtlFreeHeapSlowly(
     IN PVOID HeapHandle,
@@ -2701,3 +3160,97 @@ RtlZeroHeap(
 
     return Status;
 }
+
+
+NTSTATUS
+RtlQueryHeapInformation(
+    IN PVOID HeapHandle,
+    IN HEAP_INFORMATION_CLASS HeapInformationClass,
+    OUT PVOID HeapInformation,
+    IN ULONG HeapInformationLength,
+    OUT PULONG ReturnLength OPTIONAL
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns information about a heap.  The heap lock is not
+    taken, so the information is a snapshot that may already be stale when
+    it is returned.
+
+Arguments:
+
+    HeapHandle - Supplies the heap being queried.
+
+    HeapInformationClass - Supplies the type of information wanted.  The only
+        class defined is HeapCounterInformation, which returns the heap
+        counters in an RTL_HEAP_COUNTERS structure.
+
+    HeapInformation - Supplies the buffer to receive the information.
+
+    HeapInformationLength - Supplies the length of the buffer in bytes.
+
+    ReturnLength - Optionally receives the length of the information.
+
+Return Value:
+
+    NTSTATUS - STATUS_SUCCESS, STATUS_INVALID_INFO_CLASS for an unknown
+        information class, or STATUS_BUFFER_TOO_SMALL if the buffer cannot
+        hold the information.
+
+--*/
+
+{
+    PHEAP Heap = (PHEAP)HeapHandle;
+    PRTL_HEAP_COUNTERS Counters;
+    NTSTATUS Status;
+
+    RTL_PAGED_CODE();
+
+    if (HeapInformationClass != HeapCounterInformation) {
+        return STATUS_INVALID_INFO_CLASS;
+        }
+
+    Status = STATUS_SUCCESS;
+    try {
+        if (Heap->Signature != HEAP_SIGNATURE) {
+            Status = STATUS_INVALID_PARAMETER;
+            leave;
+            }
+
+        if (ARGUMENT_PRESENT( ReturnLength )) {
+            *ReturnLength = sizeof( RTL_HEAP_COUNTERS );
+            }
+
+        if (HeapInformationLength < sizeof( RTL_HEAP_COUNTERS )) {
+            Status = STATUS_BUFFER_TOO_SMALL;
+            leave;
+            }
+
+        Counters = (PRTL_HEAP_COUNTERS)HeapInformation;
+        *Counters = Heap->Counters;
+
+        //
+        // Contention is already counted by the lock itself.
+        //
+
+        Counters->LockContentions = 0;
+        if (Heap->LockVariable != NULL) {
+#ifdef NTOS_KERNEL_RUNTIME
+            Counters->LockContentions = ((PERESOURCE)Heap->LockVariable)->ContentionCount;
+#else
+            if (((PRTL_CRITICAL_SECTION)Heap->LockVariable)->DebugInfo != NULL) {
+                Counters->LockContentions = ((PRTL_CRITICAL_SECTION)Heap->LockVariable)->DebugInfo->ContentionCount;
+                }
+#endif // NTOS_KERNEL_RUNTIME
+            }
+
+        Counters->TotalFreeSize = Heap->TotalFreeSize << HEAP_GRANULARITY_SHIFT;
+        }
+    except( EXCEPTION_EXECUTE_HANDLER ) {
+        Status = GetExceptionCode();
+        }
+
+    return Status;
+}
@@ -664,6 +664,10 @@ RtlReAllocateHeap(
         return NULL;
         }
 
+    if (IS_LOW_FRAG_HEAP_BLOCK( Heap, (PHEAP_ENTRY)BaseAddress - 1 )) {
+        return RtlpLowFragHeapReAllocate( Heap, Flags, BaseAddress, Size );
+        }
+
     //
     // Round the requested size up to the allocation granularity.  Note
     // that if the request is for 0 bytes, we still allocate memory, because
@@ -1489,6 +1493,7 @@ RtlCompactHeap(
 
     LargestFreeSize = 0;
     try {
+        RtlpFlushHeapFreeCache( Heap );
         FreeBlock = RtlpCoalesceHeap( (PHEAP)HeapHandle );
         if (FreeBlock != NULL) {
             LargestFreeSize = FreeBlock->Size << HEAP_GRANULARITY_SHIFT;
@@ -0,0 +1,538 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    heaplfh.c
+
+Abstract:
+
+    This module implements the low fragmentation front end of the heap
+    allocator.  The front end is enabled by creating a heap with the
+    HEAP_CREATE_LOW_FRAGMENTATION flag and services small allocations
+    without acquiring the heap lock.
+
+    Each block size below HEAP_MAXIMUM_FREELISTS granules has its own
+    bucket.  A bucket hands out blocks from subsegments, which are ordinary
+    busy blocks allocated from the heap and split into equal sized pieces.
+    The buckets are replicated per affinity slot, and each affinity slot is
+    protected by its own lock, so threads running on different processors
+    allocate from different subsegments and do not contend with one another.
+
+Revision History:
+
+--*/
+
+#include "ntrtlp.h"
+#include "heap.h"
+#include "heappriv.h"
+
+PHEAP_SUBSEGMENT
+RtlpCreateSubsegment(
+    IN PHEAP Heap,
+    IN PHEAP_LFH_AFFINITY Affinity,
+    IN ULONG BlockSize
+    );
+
+#if defined(ALLOC_PRAGMA) && defined(NTOS_KERNEL_RUNTIME)
+#pragma alloc_text(PAGE, RtlpCreateLowFragHeap)
+#pragma alloc_text(PAGE, RtlpDestroyLowFragHeap)
+#pragma alloc_text(PAGE, RtlpCreateSubsegment)
+#pragma alloc_text(PAGE, RtlpLowFragHeapAllocate)
+#pragma alloc_text(PAGE, RtlpLowFragHeapFree)
+#endif
+
+#define RtlpGetLowFragAffinity( L ) \
+    (&(L)->Affinity[ RtlpGetHeapAffinityIndex() & (L)->AffinityMask ])
+
+
+BOOLEAN
+RtlpCreateLowFragHeap(
+    IN PHEAP Heap
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates the low fragmentation front end for a heap.  The
+    front end data is allocated from the heap itself.
+
+Arguments:
+
+    Heap - Supplies the heap that is to get a front end.
+
+Return Value:
+
+    BOOLEAN - TRUE if the front end was created and FALSE otherwise.  The
+        heap is usable without a front end.
+
+--*/
+
+{
+    PHEAP_LFH FrontEndHeap;
+    PHEAP_LFH_AFFINITY Affinity;
+    ULONG AffinityCount;
+    ULONG i, n;
+    NTSTATUS Status;
+
+    RTL_PAGED_CODE();
+
+    AffinityCount = RtlpGetHeapAffinityCount();
+    FrontEndHeap = RtlAllocateHeap( Heap,
+                                    HEAP_ZERO_MEMORY,
+                                    FIELD_OFFSET( HEAP_LFH, Affinity ) +
+                                        (AffinityCount * sizeof( HEAP_LFH_AFFINITY ))
+                                  );
+    if (FrontEndHeap == NULL) {
+        return FALSE;
+        }
+
+    FrontEndHeap->Heap = Heap;
+    FrontEndHeap->AffinityMask = AffinityCount - 1;
+
+    for (i = 0; i < AffinityCount; i++) {
+        Affinity = &FrontEndHeap->Affinity[ i ];
+        Status = RtlInitializeLockRoutine( &Affinity->Lock );
+        if (!NT_SUCCESS( Status )) {
+            while (i--) {
+                (VOID)RtlDeleteLockRoutine( &FrontEndHeap->Affinity[ i ].Lock );
+                }
+
+            RtlFreeHeap( Heap, 0, FrontEndHeap );
+            return FALSE;
+            }
+
+        for (n = 0; n < HEAP_MAXIMUM_FREELISTS; n++) {
+            InitializeListHead( &Affinity->Buckets[ n ].PartialSubsegments );
+            }
+        }
+
+    Heap->FrontEndHeap = FrontEndHeap;
+    return TRUE;
+}
+
+
+VOID
+RtlpDestroyLowFragHeap(
+    IN PHEAP Heap
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tears down the front end of a heap that is being
+    destroyed.  The subsegments and the front end data live in the heap
+    segments and go away with them, so only the locks need to be deleted.
+
+Arguments:
+
+    Heap - Supplies the heap being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PHEAP_LFH FrontEndHeap;
+    ULONG i;
+
+    RTL_PAGED_CODE();
+
+    FrontEndHeap = Heap->FrontEndHeap;
+    if (FrontEndHeap == NULL) {
+        return;
+        }
+
+    Heap->FrontEndHeap = NULL;
+    for (i = 0; i <= FrontEndHeap->AffinityMask; i++) {
+        (VOID)RtlDeleteLockRoutine( &FrontEndHeap->Affinity[ i ].Lock );
+        }
+
+    return;
+}
+
+
+PHEAP_SUBSEGMENT
+RtlpCreateSubsegment(
+    IN PHEAP Heap,
+    IN PHEAP_LFH_AFFINITY Affinity,
+    IN ULONG BlockSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a new subsegment for blocks of the given size.
+    The blocks are carved out of the subsegment lazily, so none of them is
+    touched here.  It is called without the affinity lock held, since the
+    heap lock is acquired to allocate the subsegment.
+
+Arguments:
+
+    Heap - Supplies the heap to allocate the subsegment from.
+
+    Affinity - Supplies the affinity slot that is to own the subsegment.
+
+    BlockSize - Supplies the size of each block in granules.
+
+Return Value:
+
+    PHEAP_SUBSEGMENT - the new subsegment, or NULL if no memory is available.
+
+--*/
+
+{
+    PHEAP_SUBSEGMENT Subsegment;
+    ULONG BlockCount;
+    ULONG SubsegmentSize;
+
+    RTL_PAGED_CODE();
+
+    BlockCount = HEAP_LFH_SUBSEGMENT_SIZE / (BlockSize << HEAP_GRANULARITY_SHIFT);
+    if (BlockCount < HEAP_LFH_MINIMUM_BLOCK_COUNT) {
+        BlockCount = HEAP_LFH_MINIMUM_BLOCK_COUNT;
+        }
+
+    //
+    // The subsegment is always too big for the front end, so this does not
+    // recurse.
+    //
+
+    SubsegmentSize = sizeof( HEAP_SUBSEGMENT ) +
+                     (BlockCount * (BlockSize << HEAP_GRANULARITY_SHIFT));
+    HEAPASSERT( (SubsegmentSize >> HEAP_GRANULARITY_SHIFT) >= HEAP_MAXIMUM_FREELISTS );
+
+    Subsegment = RtlAllocateHeap( Heap, 0, SubsegmentSize );
+    if (Subsegment == NULL) {
+        return NULL;
+        }
+
+    Subsegment->PartialList.Flink = NULL;
+    Subsegment->PartialList.Blink = NULL;
+    Subsegment->Affinity = Affinity;
+    Subsegment->FreeList = NULL;
+    Subsegment->Signature = HEAP_SUBSEGMENT_SIGNATURE;
+    Subsegment->BlockSize = (USHORT)BlockSize;
+    Subsegment->BlockCount = (USHORT)BlockCount;
+    Subsegment->FreeCount = (USHORT)BlockCount;
+    Subsegment->CarvedCount = 0;
+    Subsegment->Reserved = 0;
+
+    return Subsegment;
+}
+
+
+PVOID
+RtlpLowFragHeapAllocate(
+    IN PHEAP Heap,
+    IN ULONG Flags,
+    IN ULONG Size,
+    IN ULONG AllocationIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a block from the front end of a heap.
+
+Arguments:
+
+    Heap - Supplies the heap to allocate from.
+
+    Flags - Supplies the allocation flags, already combined with the heap's
+        ForceFlags.  Only HEAP_ZERO_MEMORY is of interest here.
+
+    Size - Supplies the number of bytes requested.
+
+    AllocationIndex - Supplies the size of the block in granules, including
+        the block header.  Must be less than HEAP_MAXIMUM_FREELISTS.
+
+Return Value:
+
+    PVOID - the address of the allocated block, or NULL if a new subsegment
+        was needed and could not be allocated.  The caller falls back to
+        the regular allocator in that case.
+
+--*/
+
+{
+    PHEAP_LFH FrontEndHeap;
+    PHEAP_LFH_AFFINITY Affinity;
+    PHEAP_LFH_BUCKET Bucket;
+    PHEAP_SUBSEGMENT Subsegment, NewSubsegment;
+    PHEAP_ENTRY BusyBlock;
+    PVOID ReturnValue;
+
+    RTL_PAGED_CODE();
+
+    FrontEndHeap = Heap->FrontEndHeap;
+    Affinity = RtlpGetLowFragAffinity( FrontEndHeap );
+    Bucket = &Affinity->Buckets[ AllocationIndex ];
+    NewSubsegment = NULL;
+
+    RtlAcquireLockRoutine( &Affinity->Lock );
+
+    //
+    // Find a subsegment with a free block, preferring the active one, then
+    // one from the partial list and only then a brand new one.  The lock is
+    // dropped while a new subsegment is allocated, so the bucket has to be
+    // looked at again afterwards.
+    //
+
+    Subsegment = Bucket->ActiveSubsegment;
+    while (Subsegment == NULL || Subsegment->FreeCount == 0) {
+        if (!IsListEmpty( &Bucket->PartialSubsegments )) {
+            Subsegment = CONTAINING_RECORD( Bucket->PartialSubsegments.Flink,
+                                            HEAP_SUBSEGMENT,
+                                            PartialList
+                                          );
+            RemoveEntryList( &Subsegment->PartialList );
+            Subsegment->PartialList.Flink = NULL;
+            }
+        else
+        if (NewSubsegment != NULL) {
+            Subsegment = NewSubsegment;
+            NewSubsegment = NULL;
+            }
+        else {
+            RtlReleaseLockRoutine( &Affinity->Lock );
+
+            NewSubsegment = RtlpCreateSubsegment( Heap, Affinity, AllocationIndex );
+            if (NewSubsegment == NULL) {
+                return NULL;
+                }
+
+            RtlAcquireLockRoutine( &Affinity->Lock );
+            Subsegment = Bucket->ActiveSubsegment;
+            continue;
+            }
+
+        Bucket->ActiveSubsegment = Subsegment;
+        }
+
+    if (Subsegment->FreeList != NULL) {
+        BusyBlock = Subsegment->FreeList;
+        Subsegment->FreeList = *(PHEAP_ENTRY *)(BusyBlock + 1);
+        }
+    else {
+        BusyBlock = (PHEAP_ENTRY)(Subsegment + 1) +
+                    (Subsegment->CarvedCount * Subsegment->BlockSize);
+        BusyBlock->Size = Subsegment->BlockSize;
+        BusyBlock->PreviousSize = (USHORT)(BusyBlock - (PHEAP_ENTRY)Subsegment);
+        BusyBlock->SegmentIndex = HEAP_LFH_SEGMENT_INDEX;
+        BusyBlock->SmallTagIndex = 0;
+        Subsegment->CarvedCount += 1;
+        }
+
+    Subsegment->FreeCount -= 1;
+    BusyBlock->Flags = HEAP_ENTRY_BUSY;
+
+    RtlReleaseLockRoutine( &Affinity->Lock );
+
+    //
+    // Another thread refilled the bucket while the new subsegment was being
+    // allocated, so give it back.
+    //
+
+    if (NewSubsegment != NULL) {
+        RtlFreeHeap( Heap, 0, NewSubsegment );
+        }
+
+    BusyBlock->UnusedBytes = (UCHAR)((AllocationIndex << HEAP_GRANULARITY_SHIFT) - Size);
+
+    ReturnValue = BusyBlock + 1;
+    if (Flags & HEAP_ZERO_MEMORY) {
+        RtlZeroMemory( ReturnValue, Size );
+        }
+
+    return ReturnValue;
+}
+
+
+BOOLEAN
+RtlpLowFragHeapFree(
+    IN PHEAP Heap,
+    IN PHEAP_ENTRY BusyBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a block to the subsegment it was carved from.  A
+    subsegment that becomes completely free is given back to the heap,
+    unless it is the active subsegment of its bucket.
+
+Arguments:
+
+    Heap - Supplies the heap the block belongs to.
+
+    BusyBlock - Supplies the header of the block being freed.
+
+Return Value:
+
+    BOOLEAN - TRUE if the block was freed and FALSE if it is not a busy
+        front end block.
+
+--*/
+
+{
+    PHEAP_SUBSEGMENT Subsegment;
+    PHEAP_LFH_AFFINITY Affinity;
+    PHEAP_LFH_BUCKET Bucket;
+    BOOLEAN ReleaseSubsegment;
+
+    RTL_PAGED_CODE();
+
+    Subsegment = (PHEAP_SUBSEGMENT)(BusyBlock - BusyBlock->PreviousSize);
+    if (!(BusyBlock->Flags & HEAP_ENTRY_BUSY) ||
+        (((ULONG)(BusyBlock + 1) & 0x7) != 0) ||
+        (Subsegment->Signature != HEAP_SUBSEGMENT_SIGNATURE) ||
+        (Subsegment->BlockSize != BusyBlock->Size)
+       ) {
+        SET_LAST_STATUS( STATUS_INVALID_PARAMETER );
+        return FALSE;
+        }
+
+    Affinity = Subsegment->Affinity;
+    Bucket = &Affinity->Buckets[ Subsegment->BlockSize ];
+    ReleaseSubsegment = FALSE;
+
+    RtlAcquireLockRoutine( &Affinity->Lock );
+
+    //
+    // Check the busy bit again now that the lock is held, so that two
+    // threads freeing the same block cannot both succeed.
+    //
+
+    if (!(BusyBlock->Flags & HEAP_ENTRY_BUSY)) {
+        RtlReleaseLockRoutine( &Affinity->Lock );
+        SET_LAST_STATUS( STATUS_INVALID_PARAMETER );
+        return FALSE;
+        }
+
+    BusyBlock->Flags = 0;
+    *(PHEAP_ENTRY *)(BusyBlock + 1) = Subsegment->FreeList;
+    Subsegment->FreeList = BusyBlock;
+    Subsegment->FreeCount += 1;
+
+    if (Subsegment != Bucket->ActiveSubsegment) {
+        if (Subsegment->FreeCount == Subsegment->BlockCount) {
+            if (Subsegment->PartialList.Flink != NULL) {
+                RemoveEntryList( &Subsegment->PartialList );
+                }
+
+            ReleaseSubsegment = TRUE;
+            }
+        else
+        if (Subsegment->PartialList.Flink == NULL) {
+            InsertTailList( &Bucket->PartialSubsegments, &Subsegment->PartialList );
+            }
+        }
+
+    RtlReleaseLockRoutine( &Affinity->Lock );
+
+    if (ReleaseSubsegment) {
+        Subsegment->Signature = 0;
+        RtlFreeHeap( Heap, 0, Subsegment );
+        }
+
+    return TRUE;
+}
+
+
+#if !defined(NTOS_KERNEL_RUNTIME)
+
+PVOID
+RtlpLowFragHeapReAllocate(
+    IN PHEAP Heap,
+    IN ULONG Flags,
+    IN PVOID BaseAddress,
+    IN ULONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resizes a block that was allocated by the front end.  The
+    block is resized in place if the new size still fits the block, and
+    moved otherwise.
+
+Arguments:
+
+    Heap - Supplies the heap the block belongs to.
+
+    Flags - Supplies the reallocation flags, already combined with the
+        heap's ForceFlags.
+
+    BaseAddress - Supplies the block to resize.
+
+    Size - Supplies the new size in bytes.
+
+Return Value:
+
+    PVOID - the address of the resized block, or NULL on failure.
+
+--*/
+
+{
+    PHEAP_ENTRY BusyBlock;
+    ULONG BlockBytes;
+    ULONG OldSize;
+    PVOID NewBaseAddress;
+
+    BusyBlock = (PHEAP_ENTRY)BaseAddress - 1;
+    if (!(BusyBlock->Flags & HEAP_ENTRY_BUSY)) {
+        SET_LAST_STATUS( STATUS_INVALID_PARAMETER );
+        return NULL;
+        }
+
+    BlockBytes = BusyBlock->Size << HEAP_GRANULARITY_SHIFT;
+    OldSize = BlockBytes - BusyBlock->UnusedBytes;
+
+    //
+    // The block can stay where it is if the new size fits and the slack
+    // can still be described by UnusedBytes.
+    //
+
+    if ((Size + sizeof( HEAP_ENTRY )) <= BlockBytes &&
+        (BlockBytes - Size) <= 0xFF
+       ) {
+        BusyBlock->UnusedBytes = (UCHAR)(BlockBytes - Size);
+        if (Size > OldSize && (Flags & HEAP_ZERO_MEMORY)) {
+            RtlZeroMemory( (PCHAR)BaseAddress + OldSize, Size - OldSize );
+            }
+
+        return BaseAddress;
+        }
+
+    if (Flags & HEAP_REALLOC_IN_PLACE_ONLY) {
+#if DBG
+        HeapDebugPrint(( "Failing ReAlloc because cant do it inplace.\n" ));
+#endif
+        return NULL;
+        }
+
+    NewBaseAddress = RtlAllocateHeap( Heap, Flags & ~HEAP_ZERO_MEMORY, Size );
+    if (NewBaseAddress == NULL) {
+        return NULL;
+        }
+
+    RtlMoveMemory( NewBaseAddress, BaseAddress, Size < OldSize ? Size : OldSize );
+    if (Size > OldSize && (Flags & HEAP_ZERO_MEMORY)) {
+        RtlZeroMemory( (PCHAR)NewBaseAddress + OldSize, Size - OldSize );
+        }
+
+    RtlpLowFragHeapFree( Heap, BusyBlock );
+    return NewBaseAddress;
+}
+
+#endif // !defined(NTOS_KERNEL_RUNTIME)
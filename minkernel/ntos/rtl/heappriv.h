@@ -213,6 +213,126 @@ RtlFreeHeapSlowly(
     IN PVOID BaseAddress
     );
 
+VOID
+RtlpFreeBlockToFreeLists(
+    IN PHEAP Heap,
+    IN PHEAP_ENTRY BusyBlock
+    );
+
+//
+// Count an allocation of the given number of granules in its size class.
+// See RTL_HEAP_COUNTERS for the classes.
+//
+
+#define RtlpCountHeapAllocation( H, I )                 \
+    (H)->Counters.Allocations[ (I) <= 2 ? 0 :           \
+                               (I) <= 4 ? 1 :           \
+                               (I) <= 8 ? 2 :           \
+                               (I) <= 16 ? 3 :          \
+                               (I) <= 32 ? 4 :          \
+                               (I) <= 64 ? 5 :          \
+                               (I) <= 128 ? 6 : 7 ] += 1
+
+//
+// The front end and the free cache spread threads over affinity slots.  In
+// kernel mode the slot is the current processor.  User mode has no cheap
+// way to learn the current processor, so the thread id is used instead,
+// which spreads concurrently running threads over the slots just as well.
+//
+
+ULONG
+RtlpGetHeapAffinityCount(
+    VOID
+    );
+
+#ifdef NTOS_KERNEL_RUNTIME
+#define RtlpGetHeapAffinityIndex() ((ULONG)KeGetCurrentProcessorNumber())
+#else
+#define RtlpGetHeapAffinityIndex() ((ULONG)NtCurrentTeb()->ClientId.UniqueThread >> 2)
+#endif // NTOS_KERNEL_RUNTIME
+
+//
+// The free cache is built on the user mode interlocked sequenced lists.
+// Heap memory is pageable in kernel mode, so the kernel heap does without.
+//
+
+#if defined(_X86_) && !defined(NTOS_KERNEL_RUNTIME)
+#define HEAP_FREE_CACHE_SUPPORTED 1
+#else
+#define HEAP_FREE_CACHE_SUPPORTED 0
+#endif
+
+#if HEAP_FREE_CACHE_SUPPORTED
+BOOLEAN
+RtlpCreateHeapFreeCache(
+    IN PHEAP Heap
+    );
+
+PHEAP_ENTRY
+RtlpAllocateFromHeapFreeCache(
+    IN PHEAP Heap,
+    IN ULONG AllocationIndex
+    );
+
+VOID
+RtlpFreeToHeapFreeCache(
+    IN PHEAP Heap,
+    IN ULONG Flags,
+    IN PHEAP_ENTRY BusyBlock
+    );
+
+BOOLEAN
+RtlpFlushHeapFreeCache(
+    IN PHEAP Heap
+    );
+#else
+#define RtlpCreateHeapFreeCache( H ) FALSE
+#define RtlpAllocateFromHeapFreeCache( H, I ) NULL
+#define RtlpFreeToHeapFreeCache( H, F, B )
+#define RtlpFlushHeapFreeCache( H ) FALSE
+#endif // HEAP_FREE_CACHE_SUPPORTED
+
+//
+// Low fragmentation front end routines (heaplfh.c)
+//
+
+BOOLEAN
+RtlpCreateLowFragHeap(
+    IN PHEAP Heap
+    );
+
+VOID
+RtlpDestroyLowFragHeap(
+    IN PHEAP Heap
+    );
+
+PVOID
+RtlpLowFragHeapAllocate(
+    IN PHEAP Heap,
+    IN ULONG Flags,
+    IN ULONG Size,
+    IN ULONG AllocationIndex
+    );
+
+BOOLEAN
+RtlpLowFragHeapFree(
+    IN PHEAP Heap,
+    IN PHEAP_ENTRY BusyBlock
+    );
+
+#if !defined(NTOS_KERNEL_RUNTIME)
+PVOID
+RtlpLowFragHeapReAllocate(
+    IN PHEAP Heap,
+    IN ULONG Flags,
+    IN PVOID BaseAddress,
+    IN ULONG Size
+    );
+#endif // !defined(NTOS_KERNEL_RUNTIME)
+
+#define IS_LOW_FRAG_HEAP_BLOCK( H, B ) \
+    (((B)->SegmentIndex == HEAP_LFH_SEGMENT_INDEX) && ((H)->FrontEndHeap != NULL))
+
 //
 // Macro for setting a bit in the freelist vector to indicate entries are present.
 //
@@ -47,6 +47,39 @@ typedef struct _LZNT1_MAXIMUM_WORKSPACE {
 
 } LZNT1_MAXIMUM_WORKSPACE, *PLZNT1_MAXIMUM_WORKSPACE;
 
+//
+//  The chained workspace keeps, for every position in the current chunk,
+//  the previous position that hashed to the same slot.  HashHead holds the
+//  most recent position for each slot.  Positions are stored biased by one
+//  so that zero can mean an empty slot or the end of a chain.
+//
+//  The lazy match fields cache the match found one byte ahead of the last
+//  ziv, so that when we decide to emit a literal in favor of that longer
+//  match we don't have to search for it again.
+//
+
+#define LZNT1_HASH_TABLE_SIZE       (4096)
+#define LZNT1_MAXIMUM_CHAIN_DEPTH   (64)
+#define LZNT1_LAZY_MATCH_LIMIT      (32)
+
+typedef struct _LZNT1_CHAINED_WORKSPACE {
+
+    PUCHAR UncompressedBuffer;
+    PUCHAR EndOfUncompressedBufferPlus1;
+    ULONG  MaxLength;
+    PUCHAR MatchedString;
+
+    PUCHAR NextInsert;
+
+    PUCHAR LazyZivString;
+    PUCHAR LazyMatchedString;
+    ULONG  LazyLength;
+
+    USHORT HashHead[LZNT1_HASH_TABLE_SIZE];
+    USHORT ChainPrevious[4096];
+
+} LZNT1_CHAINED_WORKSPACE, *PLZNT1_CHAINED_WORKSPACE;
+
 typedef struct _LZNT1_FRAGMENT_WORKSPACE {
 
     UCHAR Buffer[0x1000];
@@ -92,6 +125,20 @@ LZNT1FindMatchMaximum (
     IN PVOID WorkSpace
     );
 
+ULONG
+LZNT1FindMatchChained (
+    IN PUCHAR ZivString,
+    IN PLZNT1_CHAINED_WORKSPACE WorkSpace
+    );
+
+ULONG
+LZNT1SearchChain (
+    IN PUCHAR ZivString,
+    IN ULONG MaxLength,
+    IN PLZNT1_CHAINED_WORKSPACE WorkSpace,
+    OUT PUCHAR *MatchedString
+    );
+
 
 //
 //  Local data structures
@@ -169,6 +216,23 @@ typedef union _COMPRESSED_CHUNK_HEADER {
 
 #define GetUncompressedChunkSize(CH) (MAX_UNCOMPRESSED_CHUNK_SIZE)
 
+//
+//  PUCHAR
+//  EndOfUncompressedChunk (
+//      IN PUCHAR UncompressedChunk,
+//      IN PUCHAR EndOfUncompressedBuffer
+//      );
+//
+//  A chunk never holds more than MAX_UNCOMPRESSED_CHUNK_SIZE bytes, and
+//  the copy token format only goes that far, so the chunk decoders are
+//  never handed more output than that even if the caller has room.
+//
+
+#define EndOfUncompressedChunk(UC,EUB) (                      \
+    ((UC) + MAX_UNCOMPRESSED_CHUNK_SIZE < (EUB)) ?            \
+        ((UC) + MAX_UNCOMPRESSED_CHUNK_SIZE) : (EUB)          \
+)
+
 #define SetCompressedChunkHeader(CH,CCS,ICC) {        \
     ASSERT((CCS) >= 4 && (CCS) <= 4098);              \
     (CH).Chunk.CompressedChunkSizeMinus3 = (CCS) - 3; \
@@ -176,6 +240,41 @@ typedef union _COMPRESSED_CHUNK_HEADER {
     (CH).Chunk.IsChunkCompressed = (ICC);             \
 }
 
+//
+//  The stream workspace collects one compressed chunk at a time, because
+//  a chunk can only be decoded once all of it is at hand, and then keeps
+//  the decoded chunk in Window until the caller has taken all of it.
+//  Chunks never refer to data outside of themselves so no other history
+//  is needed.
+//
+//  ChunkSize is the size of the body (everything after the chunk header)
+//  of the chunk being collected, and is zero while we are still looking
+//  for its chunk header.  PendingZeros is the zero fill owed for a chunk
+//  that decoded short, which is only handed back if another chunk follows.
+//
+
+typedef struct _LZNT1_STREAM_WORKSPACE {
+
+    RTL_DECOMPRESS_STREAM_HEADER Header;
+
+    COMPRESSED_CHUNK_HEADER ChunkHeader;
+    UCHAR ChunkHeaderBuffer[sizeof(COMPRESSED_CHUNK_HEADER)];
+    ULONG ChunkHeaderBytes;
+
+    ULONG ChunkSize;
+    ULONG ChunkBytes;
+
+    ULONG WindowSize;
+    ULONG WindowOffset;
+
+    ULONG PendingZeros;
+    BOOLEAN EndOfStream;
+
+    UCHAR Chunk[MAX_UNCOMPRESSED_CHUNK_SIZE];
+    UCHAR Window[MAX_UNCOMPRESSED_CHUNK_SIZE];
+
+} LZNT1_STREAM_WORKSPACE, *PLZNT1_STREAM_WORKSPACE;
+
 
 //
 //  Local macros
@@ -188,6 +287,17 @@ typedef union _COMPRESSED_CHUNK_HEADER {
 #define Minimum(A,B)    ((A) < (B) ? (A) : (B))
 #define Maximum(A,B)    ((A) > (B) ? (A) : (B))
 
+//
+//  The chunk decoder is written in assembler for x86, MIPS, PPC and Alpha.
+//  The portable decoder is used everywhere else.  Test programs define
+//  LZNT1_PORTABLE_DECOMPRESS to build the portable decoder on any
+//  architecture.
+//
+
+#if !defined(_ALPHA_) && !defined(_MIPS_) && !defined(_PPC_) && !defined(i386)
+#define LZNT1_PORTABLE_DECOMPRESS
+#endif
+
 #if defined(ALLOC_PRAGMA) && defined(NTOS_KERNEL_RUNTIME)
 
 #pragma alloc_text(PAGE, RtlCompressWorkSpaceSizeLZNT1)
@@ -196,21 +306,20 @@ typedef union _COMPRESSED_CHUNK_HEADER {
 #pragma alloc_text(PAGE, RtlDecompressFragmentLZNT1)
 #pragma alloc_text(PAGE, RtlDescribeChunkLZNT1)
 #pragma alloc_text(PAGE, RtlReserveChunkLZNT1)
+#pragma alloc_text(PAGE, RtlDecompressStreamWorkSpaceSizeLZNT1)
+#pragma alloc_text(PAGE, RtlInitializeDecompressStreamLZNT1)
+#pragma alloc_text(PAGE, RtlDecompressStreamLZNT1)
 
 #pragma alloc_text(PAGE, LZNT1CompressChunk)
 
-#if !defined(_ALPHA_)
-#if !defined(_MIPS_)
-#if !defined(_PPC_)
-#if !defined(i386)
+#if defined(LZNT1_PORTABLE_DECOMPRESS)
 #pragma alloc_text(PAGE, LZNT1DecompressChunk)
 #endif
-#endif
-#endif
-#endif
 
 #pragma alloc_text(PAGE, LZNT1FindMatchStandard)
 #pragma alloc_text(PAGE, LZNT1FindMatchMaximum)
+#pragma alloc_text(PAGE, LZNT1FindMatchChained)
+#pragma alloc_text(PAGE, LZNT1SearchChain)
 
 #endif
 
@@ -240,6 +349,13 @@ Return Value:
 
         return STATUS_SUCCESS;
 
+    } else if (Engine == COMPRESSION_ENGINE_CHAINED) {
+
+        *CompressBufferWorkSpaceSize = sizeof(LZNT1_CHAINED_WORKSPACE);
+        *CompressFragmentWorkSpaceSize = sizeof(LZNT1_FRAGMENT_WORKSPACE);
+
+        return STATUS_SUCCESS;
+
     } else if (Engine == COMPRESSION_ENGINE_MAXIMUM) {
 
         *CompressBufferWorkSpaceSize = sizeof(LZNT1_MAXIMUM_WORKSPACE);
@@ -341,6 +457,10 @@ Return Value:
 
         MatchFunction = LZNT1FindMatchStandard;
 
+    } else if (Engine == COMPRESSION_ENGINE_CHAINED) {
+
+        MatchFunction = LZNT1FindMatchChained;
+
     } else if (Engine == COMPRESSION_ENGINE_MAXIMUM) {
 
         MatchFunction = LZNT1FindMatchMaximum;
@@ -533,7 +653,8 @@ Return Value:
             //
 
             if (!NT_SUCCESS(Status = LZNT1DecompressChunk( UncompressedChunk,
-                                                           EndOfUncompressedBuffer,
+                                                           EndOfUncompressedChunk( UncompressedChunk,
+                                                                                   EndOfUncompressedBuffer ),
                                                            CompressedChunk + sizeof(COMPRESSED_CHUNK_HEADER),
                                                            CompressedChunk + CompressedChunkSize,
                                                            &UncompressedChunkSize ))) {
@@ -868,7 +989,8 @@ Return Value:
             if ((FragmentOffset == 0) && (CopySize == UncompressedChunkSize)) {
 
                 if (!NT_SUCCESS(Status = LZNT1DecompressChunk( CurrentUncompressedFragment,
-                                                               EndOfUncompressedFragment,
+                                                               EndOfUncompressedChunk( CurrentUncompressedFragment,
+                                                                                       EndOfUncompressedFragment ),
                                                                CompressedChunk + sizeof(COMPRESSED_CHUNK_HEADER),
                                                                CompressedChunk + CompressedChunkSize,
                                                                &CopySize ))) {
@@ -1355,6 +1477,374 @@ Return Value:
     return Status;
 }
 
+
+NTSTATUS
+RtlDecompressStreamWorkSpaceSizeLZNT1 (
+    OUT PULONG StreamWorkSpaceSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the size of the work space needed to decompress
+    an LZNT1 stream one piece at a time.
+
+Arguments:
+
+    StreamWorkSpaceSize - Receives the size in bytes needed for the
+        stream work space.
+
+Return Value:
+
+    STATUS_SUCCESS - this routine always succeeds.
+
+--*/
+
+{
+    *StreamWorkSpaceSize = sizeof(LZNT1_STREAM_WORKSPACE);
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS
+RtlInitializeDecompressStreamLZNT1 (
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a work space to decompress an LZNT1 stream.
+    The common stream header is filled in by our caller.
+
+Arguments:
+
+    UncompressedSize - Supplies the number of uncompressed bytes wanted,
+        or MAXULONG to decompress until the ending chunk header.
+
+    StreamWorkSpace - Supplies the work space to initialize.
+
+Return Value:
+
+    STATUS_SUCCESS - this routine always succeeds.
+
+--*/
+
+{
+    PLZNT1_STREAM_WORKSPACE WorkSpace = StreamWorkSpace;
+
+    UNREFERENCED_PARAMETER( UncompressedSize );
+
+    WorkSpace->ChunkHeader.Short = 0;
+    WorkSpace->ChunkHeaderBytes = 0;
+
+    WorkSpace->ChunkSize = 0;
+    WorkSpace->ChunkBytes = 0;
+
+    WorkSpace->WindowSize = 0;
+    WorkSpace->WindowOffset = 0;
+
+    WorkSpace->PendingZeros = 0;
+    WorkSpace->EndOfStream = FALSE;
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS
+RtlDecompressStreamLZNT1 (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    )
+
+/*++
+
+Routine Description:
+
+    This routine decompresses the next piece of an LZNT1 stream.  The
+    uncompressed data produced, including the zero fill between a short
+    chunk and the chunk that follows it, is exactly what
+    RtlDecompressBufferLZNT1 would produce for the whole stream.
+
+    Whenever an entire chunk is in the compressed piece and there is
+    room for all of it in the uncompressed piece we decompress it in
+    place, so a caller with reasonably sized pieces only pays for the
+    copies through the work space at the piece boundaries.
+
+Arguments:
+
+    StreamWorkSpace - Supplies the stream work space.
+
+    CompressedPiece - Supplies a pointer to the next compressed data.
+
+    CompressedPieceSize - Supplies the size, in bytes, of the compressed
+        piece, or zero if there is no more compressed data.
+
+    CompressedPieceUsed - Receives the number of compressed bytes used.
+
+    UncompressedPiece - Supplies a pointer to where the uncompressed
+        data is to be stored.
+
+    UncompressedPieceSize - Supplies the size, in bytes, of the
+        uncompressed piece.
+
+    UncompressedPieceUsed - Receives the number of uncompressed bytes
+        stored.
+
+Return Value:
+
+    STATUS_SUCCESS - call again with more data or more room.
+
+    STATUS_NO_MORE_ENTRIES - the stream is complete.
+
+    STATUS_BAD_COMPRESSION_BUFFER - the compressed stream is ill-formed.
+
+--*/
+
+{
+    PLZNT1_STREAM_WORKSPACE WorkSpace = StreamWorkSpace;
+
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    PUCHAR Input = CompressedPiece;
+    PUCHAR EndOfInput = CompressedPiece + CompressedPieceSize;
+
+    PUCHAR Output = UncompressedPiece;
+    PUCHAR EndOfOutput = UncompressedPiece + UncompressedPieceSize;
+
+    ULONG Remaining = WorkSpace->Header.UncompressedSizeRemaining;
+
+    BOOLEAN InPlace;
+    PUCHAR Target;
+    ULONG TargetSize;
+    ULONG Size;
+
+    while (TRUE) {
+
+        //
+        //  Stop once the caller has everything it asked for
+        //
+
+        if (Remaining == 0) {
+
+            Status = STATUS_NO_MORE_ENTRIES;
+            break;
+        }
+
+        //
+        //  Hand back whatever is left in the window before doing anything
+        //  else, since the window is about to be reused.
+        //
+
+        if (WorkSpace->WindowOffset < WorkSpace->WindowSize) {
+
+            if (Output == EndOfOutput) { break; }
+
+            Size = Minimum( WorkSpace->WindowSize - WorkSpace->WindowOffset,
+                            (ULONG)(EndOfOutput - Output) );
+
+            RtlCopyMemory( Output, &WorkSpace->Window[WorkSpace->WindowOffset], Size );
+
+            Output += Size;
+            Remaining -= Size;
+            WorkSpace->WindowOffset += Size;
+
+            continue;
+        }
+
+        if (WorkSpace->EndOfStream) {
+
+            Status = STATUS_NO_MORE_ENTRIES;
+            break;
+        }
+
+        //
+        //  If we don't have a chunk header yet then gather one.  The header
+        //  may be split across two compressed pieces.
+        //
+
+        if (WorkSpace->ChunkSize == 0) {
+
+            while ((WorkSpace->ChunkHeaderBytes < sizeof(COMPRESSED_CHUNK_HEADER)) &&
+                   (Input < EndOfInput)) {
+
+                WorkSpace->ChunkHeaderBuffer[WorkSpace->ChunkHeaderBytes++] = *Input++;
+            }
+
+            if (WorkSpace->ChunkHeaderBytes < sizeof(COMPRESSED_CHUNK_HEADER)) {
+
+                //
+                //  Like RtlDecompressBufferLZNT1, running out of data where
+                //  the next chunk header should be simply ends the stream.
+                //
+
+                if (CompressedPieceSize == 0) {
+
+                    WorkSpace->EndOfStream = TRUE;
+                    continue;
+                }
+
+                break;
+            }
+
+            WorkSpace->ChunkHeaderBytes = 0;
+
+            RtlRetrieveUshort( &WorkSpace->ChunkHeader, WorkSpace->ChunkHeaderBuffer );
+
+            if (WorkSpace->ChunkHeader.Short == 0) {
+
+                WorkSpace->EndOfStream = TRUE;
+                continue;
+            }
+
+            //
+            //  Check the signature, and that an uncompressed chunk really
+            //  holds a full chunk of data.
+            //
+
+            if ((WorkSpace->ChunkHeader.Chunk.ChunkSignature != 3) ||
+                (!WorkSpace->ChunkHeader.Chunk.IsChunkCompressed &&
+                 (GetCompressedChunkSize(WorkSpace->ChunkHeader) !=
+                  sizeof(COMPRESSED_CHUNK_HEADER) + MAX_UNCOMPRESSED_CHUNK_SIZE))) {
+
+                Status = STATUS_BAD_COMPRESSION_BUFFER;
+                break;
+            }
+
+            //
+            //  There is another chunk so the zero fill for the last one is
+            //  now owed, unless it would run to the end of what the caller
+            //  wants in which case we stop short just like
+            //  RtlDecompressBufferLZNT1.
+            //
+
+            if (WorkSpace->PendingZeros != 0) {
+
+                if (WorkSpace->PendingZeros >= Remaining) {
+
+                    WorkSpace->EndOfStream = TRUE;
+                    continue;
+                }
+
+                RtlZeroMemory( WorkSpace->Window, WorkSpace->PendingZeros );
+
+                WorkSpace->WindowSize = WorkSpace->PendingZeros;
+                WorkSpace->WindowOffset = 0;
+                WorkSpace->PendingZeros = 0;
+            }
+
+            WorkSpace->ChunkSize = GetCompressedChunkSize(WorkSpace->ChunkHeader) -
+                                   sizeof(COMPRESSED_CHUNK_HEADER);
+            WorkSpace->ChunkBytes = 0;
+
+            continue;
+        }
+
+        //
+        //  We have a chunk header.  If the whole chunk is in this piece and
+        //  the whole chunk fits in the caller's buffer then decode it in
+        //  place, otherwise collect it into the work space.
+        //
+
+        if ((WorkSpace->ChunkBytes == 0) &&
+            ((ULONG)(EndOfInput - Input) >= WorkSpace->ChunkSize) &&
+            ((ULONG)(EndOfOutput - Output) >= MAX_UNCOMPRESSED_CHUNK_SIZE) &&
+            (Remaining >= MAX_UNCOMPRESSED_CHUNK_SIZE)) {
+
+            InPlace = TRUE;
+            Target = Output;
+            TargetSize = MAX_UNCOMPRESSED_CHUNK_SIZE;
+
+        } else {
+
+            Size = Minimum( WorkSpace->ChunkSize - WorkSpace->ChunkBytes,
+                            (ULONG)(EndOfInput - Input) );
+
+            if (Size == 0) {
+
+                //
+                //  The compressed data ended in the middle of a chunk.
+                //
+
+                if (CompressedPieceSize == 0) {
+
+                    Status = STATUS_BAD_COMPRESSION_BUFFER;
+                }
+
+                break;
+            }
+
+            RtlCopyMemory( &WorkSpace->Chunk[WorkSpace->ChunkBytes], Input, Size );
+
+            Input += Size;
+            WorkSpace->ChunkBytes += Size;
+
+            if (WorkSpace->ChunkBytes < WorkSpace->ChunkSize) { continue; }
+
+            InPlace = FALSE;
+            Target = WorkSpace->Window;
+            TargetSize = Minimum( MAX_UNCOMPRESSED_CHUNK_SIZE, Remaining );
+        }
+
+        //
+        //  Now decompress the chunk, which is either at Input or in the
+        //  work space.
+        //
+
+        if (WorkSpace->ChunkHeader.Chunk.IsChunkCompressed) {
+
+            PUCHAR ChunkBuffer = InPlace ? Input : WorkSpace->Chunk;
+
+            Status = LZNT1DecompressChunk( Target,
+                                           Target + TargetSize,
+                                           ChunkBuffer,
+                                           ChunkBuffer + WorkSpace->ChunkSize,
+                                           &Size );
+
+            if (!NT_SUCCESS(Status)) { break; }
+
+        } else {
+
+            Size = TargetSize;
+
+            RtlCopyMemory( Target,
+                           InPlace ? Input : WorkSpace->Chunk,
+                           Size );
+        }
+
+        if (InPlace) {
+
+            Input += WorkSpace->ChunkSize;
+            Output += Size;
+            Remaining -= Size;
+
+        } else {
+
+            WorkSpace->WindowSize = Size;
+            WorkSpace->WindowOffset = 0;
+        }
+
+        WorkSpace->PendingZeros = MAX_UNCOMPRESSED_CHUNK_SIZE - Size;
+        WorkSpace->ChunkSize = 0;
+    }
+
+    WorkSpace->Header.UncompressedSizeRemaining = Remaining;
+
+    *CompressedPieceUsed = Input - CompressedPiece;
+    *UncompressedPieceUsed = Output - UncompressedPiece;
+
+    return Status;
+}
+
 
 //
 //  The Copy token is two bytes in size.
@@ -1787,10 +2277,37 @@ Return Value:
 }
 
 
-#if !defined(_ALPHA_)
-#if !defined(_MIPS_)
-#if !defined(_PPC_)
-#if !defined(i386)
+#if defined(LZNT1_PORTABLE_DECOMPRESS)
+
+//
+//  VOID
+//  LZNT1CopyBytes (
+//      OUT PUCHAR Destination,
+//      IN PUCHAR Source,
+//      IN ULONG Length
+//      );
+//
+//  Copies non-overlapping bytes sixteen, then eight, at a time with
+//  unaligned word moves and finishes up the tail a byte at a time.  It
+//  never stores beyond Destination + Length.
+//
+
+#define LZNT1CopyBytes(D,S,L) {                                                             \
+    PUCHAR _D = (D);                                                                        \
+    PUCHAR _S = (S);                                                                        \
+    ULONG _L = (L);                                                                         \
+    while (_L >= 16) {                                                                      \
+        ((ULONGLONG UNALIGNED *)_D)[0] = ((ULONGLONG UNALIGNED *)_S)[0];                    \
+        ((ULONGLONG UNALIGNED *)_D)[1] = ((ULONGLONG UNALIGNED *)_S)[1];                    \
+        _D += 16; _S += 16; _L -= 16;                                                       \
+    }                                                                                       \
+    if (_L >= 8) {                                                                          \
+        *(ULONGLONG UNALIGNED *)_D = *(ULONGLONG UNALIGNED *)_S;                            \
+        _D += 8; _S += 8; _L -= 8;                                                          \
+    }                                                                                       \
+    while (_L > 0) { *(_D++) = *(_S++); _L -= 1; }                                          \
+}
+
 //
 //  Local support routine
 //
@@ -1817,6 +2334,16 @@ Routine Description:
     An output variable indicates the number of bytes used to store the
     uncompressed data.
 
+    Literals and copies are moved a word at a time wherever possible.
+    A flag byte of all literals is handled with a single eight byte move
+    when both buffers have room for it.  A copy whose source doesn't
+    overlap its destination is a plain word copy.  A copy that does
+    overlap, which is how LZNT1 encodes runs, is done by repeatedly
+    copying the pattern already produced, doubling the distance each
+    time, so that all but the first few bytes go a word at a time.  No
+    byte is ever stored outside of what the byte at a time algorithm
+    would have stored, so the results are identical.
+
 Arguments:
 
     UncompressedBuffer - Supplies a pointer to where the uncompressed
@@ -1879,7 +2406,27 @@ Return Value:
 
     while ((OutputPointer < EndOfUncompressedBufferPlus1) && (InputPointer < EndOfCompressedBufferPlus1)) {
 
-        while (UncompressedBuffer + FormatMaxDisplacement[Format] < OutputPointer) { Format += 1; }
+        //
+        //  If we are at the start of a flag byte that describes eight
+        //  literals and there is room for all of them then move them
+        //  in one go and pick up the next flag byte.
+        //
+
+        if ((FlagBit == 0) &&
+            (FlagByte == 0) &&
+            (InputPointer + 8 <= EndOfCompressedBufferPlus1) &&
+            (OutputPointer + 8 <= EndOfUncompressedBufferPlus1)) {
+
+            *(ULONGLONG UNALIGNED *)OutputPointer = *(ULONGLONG UNALIGNED *)InputPointer;
+
+            OutputPointer += 8;
+            InputPointer += 8;
+
+            if (InputPointer >= EndOfCompressedBufferPlus1) { break; }
+
+            FlagByte = *(InputPointer++);
+            continue;
+        }
 
         //
         //  Check the current flag if it is zero then the current
@@ -1893,9 +2440,11 @@ Return Value:
 
         } else {
 
-            LZNT1_COPY_TOKEN CopyToken;
+            PUCHAR SourcePointer;
+            ULONG CopyToken;
             LONG Displacement;
             LONG Length;
+            LONG Size;
 
             //
             //  The current input is a copy token so we'll get the
@@ -1910,16 +2459,25 @@ Return Value:
                 return STATUS_BAD_COMPRESSION_BUFFER;
             }
 
+            //
+            //  The copy token format only changes as the output pointer
+            //  moves forward, so we only need to recompute it here.
+            //
+
+            while (UncompressedBuffer + FormatMaxDisplacement[Format] < OutputPointer) { Format += 1; }
+
             //
             //  Now grab the next input byte and extract the
-            //  length and displacement from the copy token
+            //  length and displacement from the copy token.  This is
+            //  the same as GetLZNT1Length and GetLZNT1Displacement; the
+            //  length occupies the low 12 - Format bits.
             //
 
-            CopyToken.Bytes[0] = *(InputPointer++);
-            CopyToken.Bytes[1] = *(InputPointer++);
+            CopyToken = InputPointer[0] | (InputPointer[1] << 8);
+            InputPointer += 2;
 
-            Displacement = GetLZNT1Displacement(Format, CopyToken);
-            Length = GetLZNT1Length(Format, CopyToken);
+            Displacement = (CopyToken >> (12 - Format)) + 1;
+            Length = (CopyToken & (0xfff >> Format)) + 3;
 
             //
             //  At this point we have the length and displacement
@@ -1948,13 +2506,39 @@ Return Value:
             //  Now we copy bytes.  We cannot use Rtl Move Memory here because
             //  it does the copy backwards from what the LZ algorithm needs.
             //
+            //  A displacement of one is a run of a single byte, which is
+            //  by far the most common overlapping copy.
+            //
+
+            if (Displacement == 1) {
 
-            while (Length > 0) {
+                RtlFillMemory( OutputPointer, Length, *(OutputPointer - 1) );
+                OutputPointer += Length;
 
-                *(OutputPointer) = *(OutputPointer-Displacement);
+            } else {
 
-                Length -= 1;
-                OutputPointer += 1;
+                //
+                //  Otherwise keep the source fixed at the start of the
+                //  pattern.  Each pass copies everything between the source
+                //  and the output pointer, which never overlaps and is
+                //  always a whole number of repeats of the pattern, so
+                //  the distance doubles every pass.  A copy that doesn't
+                //  overlap at all finishes in one pass.
+                //
+
+                SourcePointer = OutputPointer - Displacement;
+
+                while (Length > 0) {
+
+                    Size = OutputPointer - SourcePointer;
+
+                    if (Size > Length) { Size = Length; }
+
+                    LZNT1CopyBytes( OutputPointer, SourcePointer, Size );
+
+                    Length -= Size;
+                    OutputPointer += Size;
+                }
             }
         }
 
@@ -1985,10 +2569,7 @@ Return Value:
 
     return STATUS_SUCCESS;
 }
-#endif // i386
-#endif // _MIPS_
-#endif // _PPC_
-#endif // _ALPHA_
+#endif // LZNT1_PORTABLE_DECOMPRESS
 
 
 //
@@ -2201,3 +2782,276 @@ Return Value:
     }
 }
 
+
+
+//
+//  ULONG
+//  LZNT1Hash (
+//      IN PUCHAR String
+//      );
+//
+//  Computes the hash table index for the first three bytes of String.
+//  This is the same hash the standard engine uses for IndexPTable.
+//
+
+#define LZNT1Hash(S) (                                                   \
+    ((40543*(((((S)[0]<<4)^(S)[1])<<4)^(S)[2]))>>4) & (LZNT1_HASH_TABLE_SIZE-1) \
+)
+
+//
+//  VOID
+//  LZNT1InsertString (
+//      IN PLZNT1_CHAINED_WORKSPACE WorkSpace,
+//      IN PUCHAR String
+//      );
+//
+//  Links String onto the front of the hash chain for its first three bytes.
+//
+
+#define LZNT1InsertString(WS,S) {                                                 \
+    ULONG _Index = LZNT1Hash(S);                                                  \
+    (WS)->ChainPrevious[(S) - (WS)->UncompressedBuffer] = (WS)->HashHead[_Index]; \
+    (WS)->HashHead[_Index] = (USHORT)((S) - (WS)->UncompressedBuffer + 1);        \
+}
+
+
+//
+//  Local support routine
+//
+
+ULONG
+LZNT1FindMatchChained (
+    IN PUCHAR ZivString,
+    IN PLZNT1_CHAINED_WORKSPACE WorkSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine does the compression lookup.  It locates
+    a match for the ziv within a specified uncompressed buffer.
+
+    Unlike the standard engine, which remembers only the last two
+    strings for each hash value, every position in the chunk is kept on
+    a chain of earlier positions with the same hash.  The chain is walked
+    to a bounded depth looking for the longest match, which gives most of
+    the ratio of the maximum engine at a small fraction of its cost.
+
+    This routine also does one step of lazy matching.  When a match is
+    found we check whether the string starting at the next byte has a
+    longer match, and if so we return no match so that our caller emits
+    the current byte as a literal and takes the longer match next time.
+
+Arguments:
+
+    ZivString - Supplies a pointer to the Ziv in the uncompressed buffer.
+        The Ziv is the string we want to try and find a match for.
+
+Return Value:
+
+    Returns the length of the match if the match is greater than three
+    characters otherwise return 0.
+
+--*/
+
+{
+    PUCHAR UncompressedBuffer = WorkSpace->UncompressedBuffer;
+    PUCHAR EndOfUncompressedBufferPlus1 = WorkSpace->EndOfUncompressedBufferPlus1;
+    ULONG MaxLength = WorkSpace->MaxLength;
+
+    ULONG Length;
+    PUCHAR MatchedString;
+
+    ULONG LazyLength;
+    ULONG LazyMaxLength;
+    ULONG Format;
+
+    //
+    //  The first lookup in a chunk starts a new set of chains.  Nothing
+    //  from the previous chunk may be referenced, so empty the hash heads
+    //  and forget any lazy match.
+    //
+
+    if (ZivString == UncompressedBuffer) {
+
+        RtlZeroMemory( WorkSpace->HashHead, sizeof(WorkSpace->HashHead) );
+
+        WorkSpace->NextInsert = UncompressedBuffer;
+        WorkSpace->LazyZivString = NULL;
+    }
+
+    //
+    //  Add the strings our caller skipped over with the last copy token
+    //  to the chains, so that they can be matched against.
+    //
+
+    while (WorkSpace->NextInsert < ZivString) {
+
+        LZNT1InsertString( WorkSpace, WorkSpace->NextInsert );
+        WorkSpace->NextInsert += 1;
+    }
+
+    //
+    //  If we already searched for this ziv while looking ahead on the
+    //  previous call then use that result, otherwise walk the chain.
+    //
+
+    if (ZivString == WorkSpace->LazyZivString) {
+
+        Length = Minimum( WorkSpace->LazyLength, MaxLength );
+        MatchedString = WorkSpace->LazyMatchedString;
+
+    } else {
+
+        Length = LZNT1SearchChain( ZivString, MaxLength, WorkSpace, &MatchedString );
+    }
+
+    WorkSpace->LazyZivString = NULL;
+
+    //
+    //  Now add the ziv itself to its chain.
+    //
+
+    LZNT1InsertString( WorkSpace, ZivString );
+    WorkSpace->NextInsert = ZivString + 1;
+
+    if (Length < 3) { return 0; }
+
+    //
+    //  See if a longer match starts at the next byte.  Don't bother if the
+    //  current match is already long, since the saving would be small.
+    //  The next byte may be in a copy token format with a shorter maximum
+    //  length, so figure out which format that is first.
+    //
+
+    if ((Length < LZNT1_LAZY_MATCH_LIMIT) &&
+        ((ZivString + 1 + 3) <= EndOfUncompressedBufferPlus1)) {
+
+        for (Format = FORMAT412;
+             UncompressedBuffer + FormatMaxDisplacement[Format] < ZivString + 1;
+             Format += 1) {
+
+            NOTHING;
+        }
+
+        LazyMaxLength = Minimum( FormatMaxLength[Format], MaxLength );
+
+        LazyLength = LZNT1SearchChain( ZivString + 1,
+                                       LazyMaxLength,
+                                       WorkSpace,
+                                       &WorkSpace->LazyMatchedString );
+
+        if (LazyLength > Length) {
+
+            WorkSpace->LazyZivString = ZivString + 1;
+            WorkSpace->LazyLength = LazyLength;
+
+            return 0;
+        }
+    }
+
+    WorkSpace->MatchedString = MatchedString;
+    return Length;
+}
+
+
+//
+//  Local support routine
+//
+
+ULONG
+LZNT1SearchChain (
+    IN PUCHAR ZivString,
+    IN ULONG MaxLength,
+    IN PLZNT1_CHAINED_WORKSPACE WorkSpace,
+    OUT PUCHAR *MatchedString
+    )
+
+/*++
+
+Routine Description:
+
+    This routine walks the hash chain for the ziv, up to a fixed depth,
+    and returns the longest match it finds.  The chain is not modified.
+
+Arguments:
+
+    ZivString - Supplies a pointer to the Ziv in the uncompressed buffer.
+
+    MaxLength - Supplies the longest match the current copy token format
+        can describe.
+
+    MatchedString - Receives a pointer to the start of the longest match,
+        if one of three or more characters was found.
+
+Return Value:
+
+    Returns the length of the longest match, or 0 if there isn't one of
+    at least three characters.
+
+--*/
+
+{
+    PUCHAR UncompressedBuffer = WorkSpace->UncompressedBuffer;
+    PUCHAR EndOfUncompressedBufferPlus1 = WorkSpace->EndOfUncompressedBufferPlus1;
+
+    ULONG Candidate;
+    ULONG Depth;
+    ULONG BestLength;
+    ULONG i;
+    PUCHAR q;
+
+    //
+    //  The longest match can't run past the end of the chunk.
+    //
+
+    if ((ULONG)(EndOfUncompressedBufferPlus1 - ZivString) < MaxLength) {
+
+        MaxLength = EndOfUncompressedBufferPlus1 - ZivString;
+    }
+
+    BestLength = 2;
+
+    for (Candidate = WorkSpace->HashHead[ LZNT1Hash(ZivString) ], Depth = 0;
+         (Candidate != 0) && (Depth < LZNT1_MAXIMUM_CHAIN_DEPTH);
+         Candidate = WorkSpace->ChainPrevious[ Candidate - 1 ], Depth += 1) {
+
+        q = UncompressedBuffer + Candidate - 1;
+
+        ASSERT(q < ZivString);
+
+        //
+        //  A candidate can only beat the best so far if it matches one
+        //  more byte than that, so check that byte before anything else.
+        //
+
+        if ((BestLength >= MaxLength) ||
+            (q[BestLength] != ZivString[BestLength]) ||
+            (q[0] != ZivString[0]) ||
+            (q[1] != ZivString[1])) {
+
+            continue;
+        }
+
+        for (i = 2; (i < MaxLength) && (q[i] == ZivString[i]); i += 1) {
+
+            NOTHING;
+        }
+
+        if (i > BestLength) {
+
+            BestLength = i;
+            *MatchedString = q;
+
+            if (BestLength >= MaxLength) { break; }
+        }
+    }
+
+    if (BestLength < 3) {
+
+        return 0;
+    }
+
+    return BestLength;
+}
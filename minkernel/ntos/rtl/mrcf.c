@@ -93,6 +93,57 @@ typedef MDSIGNATURE *PMDSIGNATURE;
 #define MD_STAMP        0x5344  // Signature stamp at start of compressed blk
 #define MASK_VALID_mds  0x0300  // All other bits must be zero
 
+//
+//  The stream workspace keeps the bits of a token that straddles two
+//  compressed pieces in a 64 bit buffer, which always has room for a
+//  whole token (at most 32 bits) plus the next word we read.  A trailing
+//  odd byte is held back until we know whether it is the first half of
+//  a word or the last byte of the stream.
+//
+//  Matches can reach back wBACKPOINTERMAX bytes into data the caller has
+//  already taken, so we keep that much history.  A match that does not
+//  fit in the caller's buffer is finished on the next call.
+//
+
+#define MRCF_HISTORY_SIZE               (8192)
+
+#define MRCF_TOKEN_LITERAL              (0)
+#define MRCF_TOKEN_MATCH                (1)
+#define MRCF_TOKEN_END_OF_CHUNK         (2)
+#define MRCF_TOKEN_INVALID              (3)
+
+typedef struct _MRCF_TOKEN {
+
+    ULONG Type;
+    UCHAR Literal;
+    ULONG Offset;
+    ULONG Length;
+
+} MRCF_TOKEN;
+typedef MRCF_TOKEN *PMRCF_TOKEN;
+
+typedef struct _MRCF_STREAM_WORKSPACE {
+
+    RTL_DECOMPRESS_STREAM_HEADER Header;
+
+    UCHAR Signature[sizeof(MDSIGNATURE)];
+    ULONG SignatureBytes;
+
+    ULONGLONG BitBuffer;
+    ULONG BitCount;
+
+    UCHAR OddByte;
+    BOOLEAN HaveOddByte;
+
+    ULONG Position;
+    ULONG MatchOffset;
+    ULONG MatchLength;
+
+    UCHAR History[MRCF_HISTORY_SIZE];
+
+} MRCF_STREAM_WORKSPACE;
+typedef MRCF_STREAM_WORKSPACE *PMRCF_STREAM_WORKSPACE;
+
 
 //
 //  Local procedure declarations and macros
@@ -127,6 +178,25 @@ MrcfReadNBits (
     PMRCF_BIT_IO BitIo
     );
 
+ULONG
+MrcfDecodeToken (
+    IN ULONGLONG BitBuffer,
+    IN ULONG BitCount,
+    OUT PMRCF_TOKEN Token
+    );
+
+#if defined(ALLOC_PRAGMA) && defined(NTOS_KERNEL_RUNTIME)
+#pragma alloc_text(PAGE, RtlDecompressBufferMrcf)
+#pragma alloc_text(PAGE, RtlDecompressStreamWorkSpaceSizeMrcf)
+#pragma alloc_text(PAGE, RtlInitializeDecompressStreamMrcf)
+#pragma alloc_text(PAGE, RtlDecompressStreamMrcf)
+#pragma alloc_text(PAGE, MrcfSetBitBuffer)
+#pragma alloc_text(PAGE, MrcfFillBitBuffer)
+#pragma alloc_text(PAGE, MrcfReadBit)
+#pragma alloc_text(PAGE, MrcfReadNBits)
+#pragma alloc_text(PAGE, MrcfDecodeToken)
+#endif
+
 
 NTSTATUS
 RtlDecompressBufferMrcf (
@@ -153,7 +223,8 @@ Arguments:
           NOTE: UncompressedBufferSize must be the EXACT length of the uncompressed
                 data, as Decompress uses this information to detect
                 when decompression is complete.  If this value is
-                incorrect, Decompress may crash!
+                incorrect, Decompress normally fails with
+                STATUS_BAD_COMPRESSION_BUFFER.
 
     CompressedBuffer - buffer containing compressed data
 
@@ -163,8 +234,10 @@ Arguments:
 
 Return Value:
 
-    ULONG - Returns the size of the decompressed data in bytes. Returns 0 if
-        there was an error in the decompress.
+    STATUS_SUCCESS - the decompression worked without a hitch.
+
+    STATUS_BAD_COMPRESSION_BUFFER - the input compressed buffer is
+        ill-formed.
 
 --*/
 
@@ -221,7 +294,11 @@ Return Value:
 
         if (y == 1 || y == 2) {
 
-            ASSERTMSG("Don't exceed expected length ", i<UncompressedBufferSize);
+            if (i >= UncompressedBufferSize) {
+
+                *FinalUncompressedSize = i;
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            }
 
             UncompressedBuffer[i] = (UCHAR)((y == 1 ? 0x80 : 0) | MrcfReadNBits(7,&WorkSpace));
 
@@ -245,8 +322,6 @@ Return Value:
 
                 off = MrcfReadNBits(6,&WorkSpace);
 
-                ASSERTMSG("offset 0 is invalid ", off != 0);
-
             } else {
 
                 x = MrcfReadBit(&WorkSpace);
@@ -295,16 +370,29 @@ Return Value:
                 }
             }
 
-            ASSERTMSG("Don't exceed expected length ", i<UncompressedBufferSize);
-            ASSERTMSG("Cannot match before start of uncoded buffer! ", off <= i);
+            //
+            //  Offset zero is invalid, and we can't match before the start
+            //  of the uncompressed buffer or beyond its end
+            //
+
+            if ((off == 0) || (off > i) || (i >= UncompressedBufferSize)) {
+
+                *FinalUncompressedSize = i;
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            }
 
             //
             //  Get the length  - logarithmically encoded
             //
 
-            for (k=0; (x=MrcfReadBit(&WorkSpace)) == 0; k++) { NOTHING; }
+            for (k=0; (x=MrcfReadBit(&WorkSpace)) == 0; k++) {
 
-            ASSERT(k <= 8);
+                if (k == 8) {
+
+                    *FinalUncompressedSize = i;
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                }
+            }
 
             if (k == 0) {
 
@@ -319,8 +407,6 @@ Return Value:
                 cbMatch = (1 << k) + 1 + MrcfReadNBits(k, &WorkSpace);
             }
 
-            ASSERTMSG("Don't exceed buffer size ", (i - off + cbMatch - 1) <= UncompressedBufferSize);
-
             //
             //  Copy the matched string
             //
@@ -339,6 +425,366 @@ Return Value:
 }
 
 
+NTSTATUS
+RtlDecompressStreamWorkSpaceSizeMrcf (
+    OUT PULONG StreamWorkSpaceSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the size of the work space needed to decompress
+    an Mrcf stream one piece at a time.
+
+Arguments:
+
+    StreamWorkSpaceSize - Receives the size in bytes needed for the
+        stream work space.
+
+Return Value:
+
+    STATUS_SUCCESS - this routine always succeeds.
+
+--*/
+
+{
+    *StreamWorkSpaceSize = sizeof(MRCF_STREAM_WORKSPACE);
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS
+RtlInitializeDecompressStreamMrcf (
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a work space to decompress an Mrcf stream.
+    The common stream header is filled in by our caller.
+
+Arguments:
+
+    UncompressedSize - Supplies the EXACT length of the uncompressed data.
+        As with RtlDecompressBufferMrcf this is the only way we can tell
+        where the compressed data ends.
+
+    StreamWorkSpace - Supplies the work space to initialize.
+
+Return Value:
+
+    STATUS_SUCCESS - the work space is ready.
+
+    STATUS_INVALID_PARAMETER - the uncompressed size was not given.
+
+--*/
+
+{
+    PMRCF_STREAM_WORKSPACE WorkSpace = StreamWorkSpace;
+
+    if (UncompressedSize == MAXULONG) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    WorkSpace->SignatureBytes = 0;
+
+    WorkSpace->BitBuffer = 0;
+    WorkSpace->BitCount = 0;
+
+    WorkSpace->OddByte = 0;
+    WorkSpace->HaveOddByte = FALSE;
+
+    WorkSpace->Position = 0;
+    WorkSpace->MatchOffset = 0;
+    WorkSpace->MatchLength = 0;
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS
+RtlDecompressStreamMrcf (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    )
+
+/*++
+
+Routine Description:
+
+    This routine decompresses the next piece of an Mrcf stream.  It
+    decodes the same bit stream as RtlDecompressBufferMrcf, but reads
+    it a word at a time into the work space so that a token split across
+    two compressed pieces is simply finished on the next call.  Once the
+    caller has all of the uncompressed data the next token must be the
+    end of chunk marker, as RtlDecompressBufferMrcf requires, otherwise
+    the stream is ill-formed.
+
+Arguments:
+
+    StreamWorkSpace - Supplies the stream work space.
+
+    CompressedPiece - Supplies a pointer to the next compressed data.
+
+    CompressedPieceSize - Supplies the size, in bytes, of the compressed
+        piece, or zero if there is no more compressed data.
+
+    CompressedPieceUsed - Receives the number of compressed bytes used.
+
+    UncompressedPiece - Supplies a pointer to where the uncompressed
+        data is to be stored.
+
+    UncompressedPieceSize - Supplies the size, in bytes, of the
+        uncompressed piece.
+
+    UncompressedPieceUsed - Receives the number of uncompressed bytes
+        stored.
+
+Return Value:
+
+    STATUS_SUCCESS - call again with more data or more room.
+
+    STATUS_NO_MORE_ENTRIES - the stream is complete.
+
+    STATUS_BAD_COMPRESSION_BUFFER - the compressed stream is ill-formed.
+
+--*/
+
+{
+    PMRCF_STREAM_WORKSPACE WorkSpace = StreamWorkSpace;
+
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    PUCHAR Input = CompressedPiece;
+    PUCHAR EndOfInput = CompressedPiece + CompressedPieceSize;
+
+    PUCHAR Output = UncompressedPiece;
+    PUCHAR EndOfOutput = UncompressedPiece + UncompressedPieceSize;
+
+    ULONG Remaining = WorkSpace->Header.UncompressedSizeRemaining;
+
+    MRCF_TOKEN Token;
+    ULONG TokenBits;
+    ULONG Word;
+    UCHAR Byte;
+
+    while (TRUE) {
+
+        //
+        //  Finish any match that did not fit in the last uncompressed piece
+        //
+
+        while ((WorkSpace->MatchLength != 0) && (Output < EndOfOutput) && (Remaining != 0)) {
+
+            Byte = WorkSpace->History[(WorkSpace->Position - WorkSpace->MatchOffset) & (MRCF_HISTORY_SIZE - 1)];
+
+            WorkSpace->History[WorkSpace->Position & (MRCF_HISTORY_SIZE - 1)] = Byte;
+            *Output++ = Byte;
+
+            WorkSpace->Position += 1;
+            WorkSpace->MatchLength -= 1;
+            Remaining -= 1;
+        }
+
+        //
+        //  Once the caller has all of the uncompressed data we drop the
+        //  rest of any match that runs past it, as RtlDecompressBufferMrcf
+        //  does, and go on to look for the end of chunk marker.
+        //
+
+        if (Remaining == 0) {
+
+            WorkSpace->MatchLength = 0;
+
+        } else if (Output == EndOfOutput) {
+
+            break;
+        }
+
+        //
+        //  Verify that the compressed data starts with a proper signature
+        //
+
+        if (WorkSpace->SignatureBytes < sizeof(MDSIGNATURE)) {
+
+            while ((WorkSpace->SignatureBytes < sizeof(MDSIGNATURE)) && (Input < EndOfInput)) {
+
+                WorkSpace->Signature[WorkSpace->SignatureBytes++] = *Input++;
+            }
+
+            if (WorkSpace->SignatureBytes < sizeof(MDSIGNATURE)) {
+
+                if (CompressedPieceSize == 0) {
+
+                    Status = STATUS_BAD_COMPRESSION_BUFFER;
+                }
+
+                break;
+            }
+
+            if ((((PMDSIGNATURE)WorkSpace->Signature)->sigStamp != MD_STAMP) ||
+                (((PMDSIGNATURE)WorkSpace->Signature)->sigType & (~MASK_VALID_mds))) {
+
+                Status = STATUS_BAD_COMPRESSION_BUFFER;
+                break;
+            }
+        }
+
+        //
+        //  Top up the bit buffer a word at a time, exactly as
+        //  MrcfFillBitBuffer would read the coded buffer.
+        //
+
+        while (WorkSpace->BitCount <= 64 - 16) {
+
+            if (WorkSpace->HaveOddByte) {
+
+                if (Input == EndOfInput) { break; }
+
+                Word = WorkSpace->OddByte | (*Input++ << 8);
+                WorkSpace->HaveOddByte = FALSE;
+
+            } else if (EndOfInput - Input >= 2) {
+
+                Word = Input[0] | (Input[1] << 8);
+                Input += 2;
+
+            } else if (Input < EndOfInput) {
+
+                WorkSpace->OddByte = *Input++;
+                WorkSpace->HaveOddByte = TRUE;
+                break;
+
+            } else {
+
+                break;
+            }
+
+            WorkSpace->BitBuffer |= (ULONGLONG)Word << WorkSpace->BitCount;
+            WorkSpace->BitCount += 16;
+        }
+
+        //
+        //  Once there is no more compressed data an odd byte left over is
+        //  the last byte of the stream, which is read as just 8 bits.
+        //
+
+        if ((CompressedPieceSize == 0) &&
+            WorkSpace->HaveOddByte &&
+            (WorkSpace->BitCount <= 64 - 8)) {
+
+            WorkSpace->BitBuffer |= (ULONGLONG)WorkSpace->OddByte << WorkSpace->BitCount;
+            WorkSpace->BitCount += 8;
+            WorkSpace->HaveOddByte = FALSE;
+        }
+
+        //
+        //  Decode the next token if we have all of its bits
+        //
+
+        TokenBits = MrcfDecodeToken( WorkSpace->BitBuffer, WorkSpace->BitCount, &Token );
+
+        if (TokenBits == 0) {
+
+            if (CompressedPieceSize == 0) {
+
+                Status = STATUS_BAD_COMPRESSION_BUFFER;
+            }
+
+            break;
+        }
+
+        WorkSpace->BitBuffer >>= TokenBits;
+        WorkSpace->BitCount -= TokenBits;
+
+        //
+        //  The stream is only complete if the uncompressed data is followed
+        //  by the end of chunk marker.
+        //
+
+        if (Remaining == 0) {
+
+            if (Token.Type == MRCF_TOKEN_END_OF_CHUNK) {
+
+                Status = STATUS_NO_MORE_ENTRIES;
+
+            } else {
+
+                Status = STATUS_BAD_COMPRESSION_BUFFER;
+            }
+
+            break;
+        }
+
+        switch (Token.Type) {
+
+        case MRCF_TOKEN_LITERAL:
+
+            WorkSpace->History[WorkSpace->Position & (MRCF_HISTORY_SIZE - 1)] = Token.Literal;
+            *Output++ = Token.Literal;
+
+            WorkSpace->Position += 1;
+            Remaining -= 1;
+
+            break;
+
+        case MRCF_TOKEN_MATCH:
+
+            //
+            //  Offset zero is invalid and we can't match before the start
+            //  of the uncompressed data.  The copy itself is done at the top
+            //  of the loop.
+            //
+
+            if ((Token.Offset == 0) || (Token.Offset > WorkSpace->Position)) {
+
+                Status = STATUS_BAD_COMPRESSION_BUFFER;
+                break;
+            }
+
+            WorkSpace->MatchOffset = Token.Offset;
+            WorkSpace->MatchLength = Token.Length;
+
+            break;
+
+        case MRCF_TOKEN_END_OF_CHUNK:
+
+            //
+            //  Done with a 512-byte chunk, we only stop once the caller has
+            //  all of the uncompressed data.
+            //
+
+            break;
+
+        default:
+
+            Status = STATUS_BAD_COMPRESSION_BUFFER;
+            break;
+        }
+
+        if (!NT_SUCCESS(Status)) { break; }
+    }
+
+    WorkSpace->Header.UncompressedSizeRemaining = Remaining;
+
+    *CompressedPieceUsed = Input - CompressedPiece;
+    *UncompressedPieceUsed = Output - UncompressedPiece;
+
+    return Status;
+}
+
+
 //
 //  Internal Support Routine
 //
@@ -565,7 +1011,14 @@ Return Value:
 
     case 0:
 
-        ASSERTMSG("no bits left in coded buffer!", FALSE);
+        //
+        //  We have run off the end of the coded buffer.  Hand back zero
+        //  bits, which always decode as the invalid offset zero and so
+        //  stop our caller.
+        //
+
+        BitIo->cbitsBB = 16;
+        BitIo->abitsBB = 0;
 
         break;
 
@@ -595,3 +1048,142 @@ Return Value:
     }
 }
 
+
+//
+//  Internal Support Routine
+//
+
+ULONG
+MrcfDecodeToken (
+    IN ULONGLONG BitBuffer,
+    IN ULONG BitCount,
+    OUT PMRCF_TOKEN Token
+    )
+
+/*++
+
+Routine Description:
+
+    Decode the token at the start of a stream bit buffer, without
+    consuming it.
+
+Arguments:
+
+    BitBuffer - Supplies the buffered bits, next bit in the low bit
+
+    BitCount - Supplies the number of valid bits in BitBuffer
+
+    Token - Receives the decoded token
+
+Return Value:
+
+    ULONG - Returns the number of bits in the token, or zero if BitBuffer
+        does not yet hold the whole token.
+
+--*/
+
+{
+    ULONG Used = 0;
+    ULONG x;
+    ULONG y;
+    ULONG k;
+
+    //
+    //  Take the next N bits from the bit buffer, or return zero if
+    //  the token runs past the bits we have.
+    //
+
+#define MrcfTakeBits(N,V) {                                  \
+    if (Used + (N) > BitCount) { return 0; }                 \
+    (V) = (ULONG)(BitBuffer >> Used) & ((1 << (N)) - 1);     \
+    Used += (N);                                             \
+}
+
+    MrcfTakeBits(2, y);
+
+    //
+    //  Check if next 7 bits are a byte
+    //  1 if 128..255 (0x80..0xff), 2 if 0..127 (0x00..0x7f)
+    //
+
+    if (y == 1 || y == 2) {
+
+        MrcfTakeBits(7, x);
+
+        Token->Type = MRCF_TOKEN_LITERAL;
+        Token->Literal = (UCHAR)((y == 1 ? 0x80 : 0) | x);
+
+        return Used;
+    }
+
+    //
+    //  Get the offset, a 12 bit offset of wBACKPOINTERMAX is the end
+    //  of chunk marker
+    //
+
+    if (y == 0) {
+
+        MrcfTakeBits(6, Token->Offset);
+
+    } else {
+
+        MrcfTakeBits(1, x);
+
+        if (x == 0) {
+
+            MrcfTakeBits(8, Token->Offset);
+            Token->Offset += 64;
+
+        } else {
+
+            MrcfTakeBits(12, Token->Offset);
+            Token->Offset += 320;
+
+            if (Token->Offset == wBACKPOINTERMAX) {
+
+                Token->Type = MRCF_TOKEN_END_OF_CHUNK;
+
+                return Used;
+            }
+        }
+    }
+
+    //
+    //  Get the length - logarithmically encoded
+    //
+
+    for (k = 0; TRUE; k++) {
+
+        MrcfTakeBits(1, x);
+
+        if (x != 0) { break; }
+
+        if (k == 8) {
+
+            Token->Type = MRCF_TOKEN_INVALID;
+
+            return Used;
+        }
+    }
+
+    if (k == 0) {
+
+        //
+        //  All matches at least 2 chars long
+        //
+
+        Token->Length = 2;
+
+    } else {
+
+        MrcfTakeBits(k, x);
+
+        Token->Length = (1 << k) + 1 + x;
+    }
+
+    Token->Type = MRCF_TOKEN_MATCH;
+
+    return Used;
+
+#undef MrcfTakeBits
+}
@@ -298,6 +298,41 @@ typedef NTSTATUS (*PRTL_RESERVE_CHUNK) (
     IN ULONG ChunkSize
     );
 
+//
+//  Every stream decompression work space starts with this header.  The
+//  generic routines in compress.c use it to find the format of the
+//  stream, and the format specific routines use it to track how much
+//  uncompressed data is still owed to the caller.
+//
+
+typedef struct _RTL_DECOMPRESS_STREAM_HEADER {
+
+    USHORT CompressionFormat;
+    USHORT Reserved;
+
+    ULONG UncompressedSizeRemaining;
+
+} RTL_DECOMPRESS_STREAM_HEADER, *PRTL_DECOMPRESS_STREAM_HEADER;
+
+typedef NTSTATUS (*PRTL_DECOMPRESS_STREAM_WORKSPACE_SIZE) (
+    OUT PULONG StreamWorkSpaceSize
+    );
+
+typedef NTSTATUS (*PRTL_INITIALIZE_DECOMPRESS_STREAM) (
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    );
+
+typedef NTSTATUS (*PRTL_DECOMPRESS_STREAM) (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    );
+
 //
 // Here is the declarations of the LZNT1 routines
 //
@@ -357,6 +392,63 @@ RtlReserveChunkLZNT1 (
     IN ULONG ChunkSize
     );
 
+NTSTATUS
+RtlDecompressStreamWorkSpaceSizeLZNT1 (
+    OUT PULONG StreamWorkSpaceSize
+    );
+
+NTSTATUS
+RtlInitializeDecompressStreamLZNT1 (
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    );
+
+NTSTATUS
+RtlDecompressStreamLZNT1 (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    );
+
+//
+// Here is the declarations of the MRCF routines
+//
+
+NTSTATUS
+RtlDecompressBufferMrcf (
+    OUT PUCHAR UncompressedBuffer,
+    IN ULONG UncompressedBufferSize,
+    IN PUCHAR CompressedBuffer,
+    IN ULONG CompressedBufferSize,
+    OUT PULONG FinalUncompressedSize
+    );
+
+NTSTATUS
+RtlDecompressStreamWorkSpaceSizeMrcf (
+    OUT PULONG StreamWorkSpaceSize
+    );
+
+NTSTATUS
+RtlInitializeDecompressStreamMrcf (
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    );
+
+NTSTATUS
+RtlDecompressStreamMrcf (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    );
+
 //
 // Define procedure prototypes for architecture specific debug support routines.
 //
@@ -42,9 +42,17 @@ RtlGetCallersAddress(
     )
 {
     PVOID BackTrace[ 2 ];
-#if i386 && !NTOS_KERNEL_RUNTIME
+#if i386 && (!NTOS_KERNEL_RUNTIME || !FPO)
     ULONG Hash;
 
+    //
+    // In the kernel, the stack can only be walked when it is built
+    // without frame pointer omission.  Kernel lock profiling uses the
+    // callers address to find call sites.
+    //
+
+    BackTrace[ 0 ] = NULL;
+    BackTrace[ 1 ] = NULL;
     RtlCaptureStackBackTrace( 2,
                               2,
                               BackTrace,
@@ -53,7 +61,7 @@ RtlGetCallersAddress(
 #else
     BackTrace[ 0 ] = NULL;
     BackTrace[ 1 ] = NULL;
-#endif // i386 && !NTOS_KERNEL_RUNTIME
+#endif // i386 && (!NTOS_KERNEL_RUNTIME || !FPO)
 
     if (ARGUMENT_PRESENT( CallersAddress )) {
         *CallersAddress = BackTrace[ 0 ];
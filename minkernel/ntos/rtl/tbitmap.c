@@ -8,7 +8,14 @@ Module Name:
 
 Abstract:
 
-    Test program for the Bitmap Procedures
+    Test program for the Bitmap Procedures.  Besides the fixed patterns it
+    checks the search routines, with and without a summary, against bit at
+    a time versions on random bitmaps, and then times them on a large
+    bitmap.
+
+    The program is a console program linked with bitmap.c and takes no
+    arguments.  The timings are printed in microseconds per call, for each
+    fill of the bitmap in percent of bits set.
 
 Author:
 
@@ -27,6 +34,433 @@ ULONG Buffer[512];
 RTL_BITMAP BitMapHeader;
 PRTL_BITMAP BitMap;
 
+//
+//  The random test compares the bitmap routines with the simplest possible
+//  bit at a time versions of them, over bitmaps of every size up to
+//  RANDOM_BITMAP_SIZE bits.  The benchmark times them on a bitmap the size
+//  of the ones used for large page files and volumes.
+//
+
+#define RANDOM_BITMAP_SIZE  (64*32)
+#define RANDOM_ITERATIONS   200000
+
+#define BENCH_BITMAP_SIZE   (16*1024*1024)
+#define BENCH_ITERATIONS    200
+
+ULONG RandomBuffer[RANDOM_BITMAP_SIZE / 32];
+ULONG RandomSummaryBuffer[RTL_SUMMARY_BUFFER_SIZE(RANDOM_BITMAP_SIZE) / sizeof(ULONG)];
+ULONG BenchBuffer[BENCH_BITMAP_SIZE / 32];
+ULONG BenchSummaryBuffer[RTL_SUMMARY_BUFFER_SIZE(BENCH_BITMAP_SIZE) / sizeof(ULONG)];
+ULONG Seed = 1;
+
+#define TestBit(B,I) (((B)->Buffer[(I) / 32] >> ((I) % 32)) & 1)
+
+ULONG
+RefFindClearBits (
+    PRTL_BITMAP Map,
+    ULONG NumberToFind,
+    ULONG HintIndex
+    )
+{
+    ULONG i, j;
+
+    if (HintIndex >= Map->SizeOfBitMap) { HintIndex = 0; }
+    if (NumberToFind == 0) { return HintIndex & ~7; }
+
+    for (i = HintIndex; i + NumberToFind <= Map->SizeOfBitMap; i += 1) {
+        for (j = 0; (j < NumberToFind) && !TestBit(Map, i + j); j += 1) { NOTHING; }
+        if (j == NumberToFind) { return i; }
+    }
+
+    for (i = 0; (i < HintIndex) && (i + NumberToFind <= Map->SizeOfBitMap); i += 1) {
+        for (j = 0; (j < NumberToFind) && !TestBit(Map, i + j); j += 1) { NOTHING; }
+        if (j == NumberToFind) { return i; }
+    }
+
+    return 0xffffffff;
+}
+
+ULONG
+RefFindLongestRun (
+    PRTL_BITMAP Map,
+    ULONG Value,
+    PULONG StartingIndex
+    )
+{
+    ULONG i, RunSize, LongestRunSize;
+
+    *StartingIndex = 0;
+    LongestRunSize = 0;
+    RunSize = 0;
+
+    for (i = 0; i < Map->SizeOfBitMap; i += 1) {
+        if (TestBit(Map, i) == Value) {
+            RunSize += 1;
+            if (RunSize > LongestRunSize) {
+                LongestRunSize = RunSize;
+                *StartingIndex = i + 1 - RunSize;
+            }
+        } else {
+            RunSize = 0;
+        }
+    }
+
+    return LongestRunSize;
+}
+
+ULONG
+RefNumberOfSetBits (
+    PRTL_BITMAP Map
+    )
+{
+    ULONG i, Total;
+
+    Total = 0;
+    for (i = 0; i < Map->SizeOfBitMap; i += 1) {
+        Total += TestBit(Map, i);
+    }
+
+    return Total;
+}
+
+//
+//  Fill a bitmap so that roughly Density out of 256 bits are set, in runs
+//  of random length so there are long clear and set runs to find.
+//
+
+VOID
+FillBitMap (
+    PRTL_BITMAP Map,
+    ULONG Density
+    )
+{
+    ULONG i, Run;
+
+    RtlClearAllBits( Map );
+
+    for (i = 0; i < Map->SizeOfBitMap; i += Run) {
+        Run = (RtlUniform( &Seed ) % 64) + 1;
+        if (i + Run > Map->SizeOfBitMap) {
+            Run = Map->SizeOfBitMap - i;
+        }
+        if ((RtlUniform( &Seed ) % 256) < Density) {
+            RtlSetBits( Map, i, Run );
+        }
+    }
+}
+
+BOOLEAN
+RandomBitMapTest (
+    VOID
+    )
+{
+    RTL_BITMAP Map;
+    ULONG Iteration, NumberToFind, HintIndex;
+    ULONG Result, Expected, Index, ExpectedIndex;
+
+    DbgPrint("Start RandomBitMapTest()\n");
+
+    for (Iteration = 0; Iteration < RANDOM_ITERATIONS; Iteration += 1) {
+
+        RtlInitializeBitMap( &Map, RandomBuffer, (RtlUniform( &Seed ) % RANDOM_BITMAP_SIZE) + 1 );
+        FillBitMap( &Map, RtlUniform( &Seed ) % 257 );
+
+        //
+        //  Put junk in the unused bits at the end, which must be ignored
+        //
+
+        if ((Map.SizeOfBitMap % 32) != 0) {
+            RandomBuffer[Map.SizeOfBitMap / 32] |= RtlUniform( &Seed ) << (Map.SizeOfBitMap % 32);
+        }
+
+        NumberToFind = RtlUniform( &Seed ) % ((Iteration & 3) ? 40 : 300);
+        HintIndex = RtlUniform( &Seed ) % (Map.SizeOfBitMap + 8);
+
+        Result = RtlFindClearBits( &Map, NumberToFind, HintIndex );
+        Expected = RefFindClearBits( &Map, NumberToFind, HintIndex );
+        if (Result != Expected) {
+            DbgPrint("RtlFindClearBits( %d bits, %d, %d ) Error %08lx should be %08lx\n",
+                     Map.SizeOfBitMap, NumberToFind, HintIndex, Result, Expected);
+            return FALSE;
+        }
+
+        Result = RtlFindLongestRunClear( &Map, &Index );
+        Expected = RefFindLongestRun( &Map, 0, &ExpectedIndex );
+        if ((Result != Expected) || (Index != ExpectedIndex)) {
+            DbgPrint("RtlFindLongestRunClear( %d bits ) Error %d at %d should be %d at %d\n",
+                     Map.SizeOfBitMap, Result, Index, Expected, ExpectedIndex);
+            return FALSE;
+        }
+
+        Result = RtlFindLongestRunSet( &Map, &Index );
+        Expected = RefFindLongestRun( &Map, 1, &ExpectedIndex );
+        if ((Result != Expected) || (Index != ExpectedIndex)) {
+            DbgPrint("RtlFindLongestRunSet( %d bits ) Error %d at %d should be %d at %d\n",
+                     Map.SizeOfBitMap, Result, Index, Expected, ExpectedIndex);
+            return FALSE;
+        }
+
+        Result = RtlNumberOfSetBits( &Map );
+        Expected = RefNumberOfSetBits( &Map );
+        if ((Result != Expected) ||
+            (RtlNumberOfClearBits( &Map ) != Map.SizeOfBitMap - Expected)) {
+            DbgPrint("RtlNumberOfSetBits( %d bits ) Error %d should be %d\n",
+                     Map.SizeOfBitMap, Result, Expected);
+            return FALSE;
+        }
+    }
+
+    DbgPrint("End RandomBitMapTest()\n");
+
+    return TRUE;
+}
+
+//
+//  Check that every summary bit is set exactly when the ulong it stands for
+//  is full, counting the unused bits at the end of each level as set.
+//
+
+BOOLEAN
+CheckSummary (
+    PRTL_SUMMARY_BITMAP Summary
+    )
+{
+    PRTL_BITMAP Source;
+    ULONG Level, i, Full;
+
+    Source = &Summary->BitMap;
+
+    for (Level = 0; Level < RTL_SUMMARY_LEVELS; Level += 1) {
+
+        for (i = 0; i < Summary->Summary[Level].SizeOfBitMap; i += 1) {
+
+            Full = ((Source->Buffer[i] | ((Source->SizeOfBitMap < (i + 1) * 32) ?
+                                          0xffffffff << (Source->SizeOfBitMap % 32) : 0)) == 0xffffffff);
+
+            if (TestBit(&Summary->Summary[Level], i) != Full) {
+                DbgPrint("Summary level %d bit %d Error %d should be %d\n",
+                         Level, i, !Full, Full);
+                return FALSE;
+            }
+        }
+
+        Source = &Summary->Summary[Level];
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+RandomSummaryBitMapTest (
+    VOID
+    )
+{
+    RTL_SUMMARY_BITMAP Summary;
+    ULONG Iteration, Operation, NumberToFind, HintIndex;
+    ULONG Result, Expected, Index, Length;
+
+    DbgPrint("Start RandomSummaryBitMapTest()\n");
+
+    for (Iteration = 0; Iteration < RANDOM_ITERATIONS / 16; Iteration += 1) {
+
+        RtlInitializeBitMap( &Summary.BitMap, RandomBuffer, (RtlUniform( &Seed ) % RANDOM_BITMAP_SIZE) + 1 );
+        FillBitMap( &Summary.BitMap, 192 + (RtlUniform( &Seed ) % 65) );
+
+        if ((Summary.BitMap.SizeOfBitMap % 32) != 0) {
+            RandomBuffer[Summary.BitMap.SizeOfBitMap / 32] |= RtlUniform( &Seed ) << (Summary.BitMap.SizeOfBitMap % 32);
+        }
+
+        RtlInitializeSummaryBitMap( &Summary, RandomBuffer, Summary.BitMap.SizeOfBitMap, RandomSummaryBuffer );
+
+        for (Operation = 0; Operation < 16; Operation += 1) {
+
+            if (!CheckSummary( &Summary )) {
+                return FALSE;
+            }
+
+            //
+            //  Mostly allocate, sometimes free a random range
+            //
+
+            if ((RtlUniform( &Seed ) % 4) != 0) {
+
+                NumberToFind = RtlUniform( &Seed ) % ((Operation & 1) ? 40 : 300);
+                HintIndex = RtlUniform( &Seed ) % (Summary.BitMap.SizeOfBitMap + 8);
+
+                Expected = RefFindClearBits( &Summary.BitMap, NumberToFind, HintIndex );
+                Result = RtlFindClearBitsWithSummary( &Summary, NumberToFind, HintIndex );
+                if (Result != Expected) {
+                    DbgPrint("RtlFindClearBitsWithSummary( %d bits, %d, %d ) Error %08lx should be %08lx\n",
+                             Summary.BitMap.SizeOfBitMap, NumberToFind, HintIndex, Result, Expected);
+                    return FALSE;
+                }
+
+                Result = RtlFindClearBitsAndSetWithSummary( &Summary, NumberToFind, HintIndex );
+                if ((Result != Expected) ||
+                    ((Result != 0xffffffff) && (NumberToFind != 0) &&
+                     !RtlAreBitsSet( &Summary.BitMap, Result, NumberToFind ))) {
+                    DbgPrint("RtlFindClearBitsAndSetWithSummary( %d bits, %d, %d ) Error %08lx should be %08lx\n",
+                             Summary.BitMap.SizeOfBitMap, NumberToFind, HintIndex, Result, Expected);
+                    return FALSE;
+                }
+
+            } else {
+
+                Index = RtlUniform( &Seed ) % Summary.BitMap.SizeOfBitMap;
+                Length = RtlUniform( &Seed ) % (Summary.BitMap.SizeOfBitMap - Index + 1);
+
+                if (RtlUniform( &Seed ) % 2) {
+                    RtlClearBitsWithSummary( &Summary, Index, Length );
+                } else {
+                    RtlSetBitsWithSummary( &Summary, Index, Length );
+                }
+            }
+        }
+    }
+
+    DbgPrint("End RandomSummaryBitMapTest()\n");
+
+    return TRUE;
+}
+
+//
+//  Return the time taken by the benchmark loop in microseconds per call
+//
+
+ULONG
+ElapsedPerCall (
+    PLARGE_INTEGER StartTime
+    )
+{
+    LARGE_INTEGER EndTime;
+
+    NtQuerySystemTime( &EndTime );
+
+    return (ULONG)((EndTime.QuadPart - StartTime->QuadPart) / (10 * BENCH_ITERATIONS));
+}
+
+VOID
+BitMapBenchmark (
+    VOID
+    )
+{
+    static ULONG Densities[] = { 128, 230, 250, 255 };
+
+    RTL_BITMAP Map;
+    LARGE_INTEGER StartTime;
+    ULONG i, j, Index;
+    ULONG FindClear, LongestRun, SetBits;
+
+    DbgPrint("BitMapBenchmark() %d bits, microseconds per call\n", BENCH_BITMAP_SIZE);
+    DbgPrint("   Fill   FindClearBits(64)   FindLongestRunClear   NumberOfSetBits\n");
+
+    RtlInitializeBitMap( &Map, BenchBuffer, BENCH_BITMAP_SIZE );
+
+    for (i = 0; i < sizeof(Densities) / sizeof(Densities[0]); i += 1) {
+
+        FillBitMap( &Map, Densities[i] );
+
+        NtQuerySystemTime( &StartTime );
+        for (j = 0; j < BENCH_ITERATIONS; j += 1) {
+            RtlFindClearBits( &Map, 64, RtlUniform( &Seed ) % BENCH_BITMAP_SIZE );
+        }
+        FindClear = ElapsedPerCall( &StartTime );
+
+        NtQuerySystemTime( &StartTime );
+        for (j = 0; j < BENCH_ITERATIONS; j += 1) {
+            RtlFindLongestRunClear( &Map, &Index );
+        }
+        LongestRun = ElapsedPerCall( &StartTime );
+
+        NtQuerySystemTime( &StartTime );
+        for (j = 0; j < BENCH_ITERATIONS; j += 1) {
+            RtlNumberOfSetBits( &Map );
+        }
+        SetBits = ElapsedPerCall( &StartTime );
+
+        DbgPrint("   %3d%%   %17d   %19d   %15d\n",
+                 (Densities[i] * 100) / 256, FindClear, LongestRun, SetBits);
+    }
+}
+
+//
+//  Fill a bitmap the way a nearly full allocation map looks, with every
+//  bit set except for holes of up to 16 bits that add up to roughly
+//  256 - Density out of 256 bits.
+//
+
+VOID
+FillNearlyFullBitMap (
+    PRTL_BITMAP Map,
+    ULONG Density
+    )
+{
+    ULONG Free, Index, Length;
+
+    RtlSetAllBits( Map );
+
+    for (Free = 0; Free < ((Map->SizeOfBitMap / 256) * (256 - Density)); Free += Length) {
+        Index = RtlUniform( &Seed ) % Map->SizeOfBitMap;
+        Length = (RtlUniform( &Seed ) % 16) + 1;
+        if (Index + Length > Map->SizeOfBitMap) {
+            Length = Map->SizeOfBitMap - Index;
+        }
+        RtlClearBits( Map, Index, Length );
+    }
+}
+
+//
+//  Time clear run searches on a nearly full bitmap with and without a
+//  summary.  Each search allocates the run it finds and frees it again so
+//  the fill stays the same.
+//
+
+VOID
+SummaryBitMapBenchmark (
+    VOID
+    )
+{
+    static ULONG Densities[] = { 230, 243, 250, 253, 255 };
+
+    RTL_SUMMARY_BITMAP Summary;
+    LARGE_INTEGER StartTime;
+    ULONG i, j, Index, Hint;
+    ULONG Plain, WithSummary;
+
+    DbgPrint("SummaryBitMapBenchmark() %d bits, microseconds per call\n", BENCH_BITMAP_SIZE);
+    DbgPrint("   Fill   FindClearBitsAndSet(24)   WithSummary\n");
+
+    for (i = 0; i < sizeof(Densities) / sizeof(Densities[0]); i += 1) {
+
+        RtlInitializeBitMap( &Summary.BitMap, BenchBuffer, BENCH_BITMAP_SIZE );
+        FillNearlyFullBitMap( &Summary.BitMap, Densities[i] );
+        RtlInitializeSummaryBitMap( &Summary, BenchBuffer, BENCH_BITMAP_SIZE, BenchSummaryBuffer );
+
+        Hint = Seed;
+        NtQuerySystemTime( &StartTime );
+        for (j = 0; j < BENCH_ITERATIONS; j += 1) {
+            Index = RtlFindClearBitsAndSet( &Summary.BitMap, 24, RtlUniform( &Hint ) % BENCH_BITMAP_SIZE );
+            if (Index != 0xffffffff) {
+                RtlClearBits( &Summary.BitMap, Index, 24 );
+            }
+        }
+        Plain = ElapsedPerCall( &StartTime );
+
+        Hint = Seed;
+        NtQuerySystemTime( &StartTime );
+        for (j = 0; j < BENCH_ITERATIONS; j += 1) {
+            Index = RtlFindClearBitsAndSetWithSummary( &Summary, 24, RtlUniform( &Hint ) % BENCH_BITMAP_SIZE );
+            if (Index != 0xffffffff) {
+                RtlClearBitsWithSummary( &Summary, Index, 24 );
+            }
+        }
+        WithSummary = ElapsedPerCall( &StartTime );
+
+        DbgPrint("   %3d%%   %23d   %11d\n",
+                 (Densities[i] * 100) / 256, Plain, WithSummary);
+    }
+}
+
 int
 main(
     int argc,
@@ -479,5 +913,13 @@ main(
 
     DbgPrint("End BitMapTest()\n");
 
+    if (!RandomBitMapTest() || !RandomSummaryBitMapTest()) {
+
+        return FALSE;
+    }
+
+    BitMapBenchmark();
+    SummaryBitMapBenchmark();
+
     return TRUE;
 }
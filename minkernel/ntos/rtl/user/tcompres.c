@@ -0,0 +1,997 @@
+/*++
+
+Copyright (c) 1994  Microsoft Corporation
+
+Module Name:
+
+    tcompres.c
+
+Abstract:
+
+    Test and throughput benchmark program for the Rtl compression
+    package.  A fixed corpus is built in memory, compressed with each
+    engine, serially and with RtlCompressBufferParallel over a pool of
+    worker threads, and the output is decompressed and compared against
+    the original to make sure the round trip is exact.  The output is
+    also decompressed a piece at a time with RtlDecompressStream, using
+    random piece sizes, and compared with RtlDecompressBuffer.  Finally
+    the chunk decoder is checked against the original byte at a time
+    decoder over a large number of valid and corrupted chunks.
+
+    The portable chunk decoder is built on every architecture, including
+    those that ship an assembler decoder, so that it is always the one
+    being checked.
+
+    Usage: tcompres [ NumberOfThreads [ CorpusSizeInMB ] ]
+
+Revision History:
+
+--*/
+
+#define LZNT1_PORTABLE_DECOMPRESS
+
+#include "..\compress.c"
+#include "..\lznt1.c"
+#include "..\mrcf.c"
+#include <windows.h>
+
+#include <stdlib.h>
+
+#define MAXIMUM_THREADS 32
+
+ULONG Seed = 31415;
+
+//
+//  The worker pool used by the parallel compression dispatch routine.
+//  Each dispatch releases the start semaphore once per worker, the
+//  workers pull stripes off the shared index until there are none left,
+//  and the last worker out signals the done event.
+//
+
+HANDLE WorkerThreads[ MAXIMUM_THREADS ];
+ULONG NumberOfWorkers;
+
+HANDLE StartSemaphore;
+HANDLE DoneEvent;
+
+PRTL_COMPRESS_STRIPE CurrentStripes;
+ULONG CurrentNumberOfStripes;
+LONG NextStripe;
+LONG ActiveWorkers;
+
+DWORD
+WINAPI
+CompressWorker (
+    LPVOID Parameter
+    )
+{
+    LONG i;
+
+    while (TRUE) {
+
+        WaitForSingleObject( StartSemaphore, INFINITE );
+
+        while ((i = InterlockedIncrement( &NextStripe )) < (LONG)CurrentNumberOfStripes) {
+
+            RtlCompressStripe( &CurrentStripes[i] );
+        }
+
+        if (InterlockedDecrement( &ActiveWorkers ) == 0) {
+
+            SetEvent( DoneEvent );
+        }
+    }
+
+    return 0;
+}
+
+VOID
+NTAPI
+CompressDispatch (
+    IN PRTL_COMPRESS_STRIPE Stripes,
+    IN ULONG NumberOfStripes,
+    IN PVOID DispatchContext
+    )
+{
+    CurrentStripes = Stripes;
+    CurrentNumberOfStripes = NumberOfStripes;
+    NextStripe = -1;
+    ActiveWorkers = NumberOfWorkers;
+
+    ReleaseSemaphore( StartSemaphore, NumberOfWorkers, NULL );
+    WaitForSingleObject( DoneEvent, INFINITE );
+}
+
+//
+//  The corpus is a repeatable mix of the kinds of data we see in
+//  compressed files: text, structured binary records, runs of zeros,
+//  and data that will not compress at all.
+//
+
+PCHAR CorpusWords[] = {
+    "the ", "file ", "system ", "of ", "compressed ", "data ", "and ",
+    "NTSTATUS ", "Status ", "= ", "RtlCompressBuffer( ", "); ", "\r\n",
+    "    ", "if ", "(!NT_SUCCESS(Status)) ", "return ", "chunk ", "to ",
+    "buffer ", "a ", "is ", "in ", "for ", "while ", "{ ", "} "
+};
+
+VOID
+BuildCorpus (
+    IN PUCHAR Buffer,
+    IN ULONG Size
+    )
+{
+    PUCHAR p = Buffer;
+    PUCHAR End = Buffer + Size;
+    ULONG Kind, Length, i;
+
+    while (p < End) {
+
+        Kind = RtlUniform( &Seed ) % 8;
+        Length = 0x1000 + (RtlUniform( &Seed ) % 0x8000);
+
+        if (Length > (ULONG)(End - p)) { Length = End - p; }
+
+        if (Kind < 4) {
+
+            for (i = 0; i < Length; ) {
+
+                PCHAR Word = CorpusWords[ RtlUniform( &Seed ) % (sizeof(CorpusWords) / sizeof(PCHAR)) ];
+
+                while (*Word && (i < Length)) { p[i++] = *Word++; }
+            }
+
+        } else if (Kind < 6) {
+
+            for (i = 0; i < Length; i += 1) {
+
+                p[i] = (UCHAR)(((i & 0xf) < 4) ? (i >> 4) : ((i & 0xf) < 8) ? 0 : (i & 0x7));
+            }
+
+        } else if (Kind == 6) {
+
+            RtlZeroMemory( p, Length );
+
+        } else {
+
+            for (i = 0; i < Length; i += 1) { p[i] = (UCHAR)RtlUniform( &Seed ); }
+        }
+
+        p += Length;
+    }
+}
+
+//
+//  This is the original byte at a time LZNT1 chunk decoder.  The fuzz
+//  test checks that LZNT1DecompressChunk produces exactly the same
+//  status, size and output bytes as this routine for any input.
+//
+
+NTSTATUS
+ReferenceDecompressChunk (
+    OUT PUCHAR UncompressedBuffer,
+    IN PUCHAR EndOfUncompressedBufferPlus1,
+    IN PUCHAR CompressedBuffer,
+    IN PUCHAR EndOfCompressedBufferPlus1,
+    OUT PULONG FinalUncompressedChunkSize
+    )
+{
+    PUCHAR OutputPointer = UncompressedBuffer;
+    PUCHAR InputPointer = CompressedBuffer;
+    UCHAR FlagByte;
+    ULONG FlagBit = 0;
+    ULONG Format = FORMAT412;
+
+    FlagByte = *(InputPointer++);
+
+    while ((OutputPointer < EndOfUncompressedBufferPlus1) && (InputPointer < EndOfCompressedBufferPlus1)) {
+
+        while (UncompressedBuffer + FormatMaxDisplacement[Format] < OutputPointer) { Format += 1; }
+
+        if (!FlagOn(FlagByte, (1 << FlagBit))) {
+
+            *(OutputPointer++) = *(InputPointer++);
+
+        } else {
+
+            LZNT1_COPY_TOKEN CopyToken;
+            LONG Displacement;
+            LONG Length;
+
+            if (InputPointer+1 >= EndOfCompressedBufferPlus1) {
+
+                *FinalUncompressedChunkSize = (ULONG)InputPointer;
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            }
+
+            CopyToken.Bytes[0] = *(InputPointer++);
+            CopyToken.Bytes[1] = *(InputPointer++);
+
+            Displacement = GetLZNT1Displacement(Format, CopyToken);
+            Length = GetLZNT1Length(Format, CopyToken);
+
+            if (Displacement > (OutputPointer - UncompressedBuffer)) {
+
+                *FinalUncompressedChunkSize = (ULONG)InputPointer;
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            }
+
+            if ((OutputPointer + Length) >= EndOfUncompressedBufferPlus1) {
+
+                Length = EndOfUncompressedBufferPlus1 - OutputPointer;
+            }
+
+            while (Length > 0) {
+
+                *(OutputPointer) = *(OutputPointer-Displacement);
+                Length -= 1;
+                OutputPointer += 1;
+            }
+        }
+
+        FlagBit = (FlagBit + 1) % 8;
+
+        if (!FlagBit) {
+
+            if (InputPointer >= EndOfCompressedBufferPlus1) { break; }
+
+            FlagByte = *(InputPointer++);
+        }
+    }
+
+    *FinalUncompressedChunkSize = OutputPointer - UncompressedBuffer;
+    return STATUS_SUCCESS;
+}
+
+BOOLEAN
+FuzzDecompress (
+    IN ULONG Iterations
+    )
+{
+    UCHAR Source[0x1000];
+    UCHAR Compressed[0x1000 + 0x100];
+    UCHAR Output1[0x1000];
+    UCHAR Output2[0x1000];
+    PVOID WorkSpace;
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize;
+    ULONG Iteration, Size, Period, CompressedSize, InputSize, OutputSize;
+    ULONG i, Final1, Final2;
+    NTSTATUS Status1, Status2;
+    ULONG Valid = 0;
+
+    RtlGetCompressionWorkSpaceSize( COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD,
+                                    &WorkSpaceSize,
+                                    &FragmentWorkSpaceSize );
+
+    WorkSpace = VirtualAlloc( NULL, WorkSpaceSize, MEM_COMMIT, PAGE_READWRITE );
+
+    for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+
+        //
+        //  Build a chunk with repeats at a random short period, so that
+        //  we get plenty of overlapping copies, and compress it.
+        //
+
+        Size = 1 + (RtlUniform( &Seed ) % sizeof(Source));
+        Period = 1 + (RtlUniform( &Seed ) % 20);
+
+        for (i = 0; i < Size; i += 1) {
+
+            if ((RtlUniform( &Seed ) % Period) == 0) {
+
+                Source[i] = (UCHAR)RtlUniform( &Seed );
+
+            } else {
+
+                Source[i] = (i >= Period) ? Source[i - Period] : (UCHAR)('a' + (i % 7));
+            }
+        }
+
+        if (!NT_SUCCESS( RtlCompressBuffer( COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD,
+                                            Source,
+                                            Size,
+                                            Compressed,
+                                            sizeof(Compressed),
+                                            0x1000,
+                                            &CompressedSize,
+                                            WorkSpace ))) {
+
+            continue;
+        }
+
+        //
+        //  Flip a few bits, chop off some of the input, and shorten the
+        //  output buffer, then run both decoders over the same input.
+        //
+
+        for (i = RtlUniform( &Seed ) % 4; i > 0; i -= 1) {
+
+            Compressed[2 + (RtlUniform( &Seed ) % (CompressedSize - 2))] ^= (UCHAR)(1 << (RtlUniform( &Seed ) % 8));
+        }
+
+        InputSize = CompressedSize - 2;
+
+        if ((RtlUniform( &Seed ) % 3) == 0) {
+
+            InputSize -= RtlUniform( &Seed ) % InputSize;
+        }
+
+        OutputSize = (RtlUniform( &Seed ) & 1) ? sizeof(Output1) : 1 + (RtlUniform( &Seed ) % sizeof(Output1));
+
+        RtlFillMemory( Output1, sizeof(Output1), 0xcc );
+        RtlFillMemory( Output2, sizeof(Output2), 0xcc );
+
+        Status1 = ReferenceDecompressChunk( Output1,
+                                            Output1 + OutputSize,
+                                            Compressed + 2,
+                                            Compressed + 2 + InputSize,
+                                            &Final1 );
+
+        Status2 = LZNT1DecompressChunk( Output2,
+                                        Output2 + OutputSize,
+                                        Compressed + 2,
+                                        Compressed + 2 + InputSize,
+                                        &Final2 );
+
+        if (NT_SUCCESS( Status1 )) { Valid += 1; }
+
+        if ((Status1 != Status2) ||
+            (Final1 != Final2) ||
+            (RtlCompareMemory( Output1, Output2, sizeof(Output1) ) != sizeof(Output1))) {
+
+            fprintf( stderr, "TCOMPRES: decoders differ at iteration %lu (%08lx/%08lx, %lu/%lu)\n",
+                     Iteration, Status1, Status2, Final1, Final2 );
+
+            VirtualFree( WorkSpace, 0, MEM_RELEASE );
+            return FALSE;
+        }
+    }
+
+    VirtualFree( WorkSpace, 0, MEM_RELEASE );
+
+    fprintf( stderr, "Fuzz       %lu chunks, %lu well formed, decoders identical\n", Iterations, Valid );
+
+    return TRUE;
+}
+
+double
+ElapsedSeconds (
+    IN PLARGE_INTEGER Start,
+    IN PLARGE_INTEGER Stop
+    )
+{
+    LARGE_INTEGER Frequency;
+
+    QueryPerformanceFrequency( &Frequency );
+
+    return (double)(Stop->QuadPart - Start->QuadPart) / (double)Frequency.QuadPart;
+}
+
+BOOLEAN
+VerifyRoundTrip (
+    IN PCHAR Name,
+    IN USHORT CompressionFormat,
+    IN PUCHAR Original,
+    IN ULONG OriginalSize,
+    IN PUCHAR Compressed,
+    IN ULONG CompressedSize,
+    IN PUCHAR Scratch
+    )
+{
+    NTSTATUS Status;
+    ULONG FinalSize;
+
+    Status = RtlDecompressBuffer( CompressionFormat,
+                                  Scratch,
+                                  OriginalSize,
+                                  Compressed,
+                                  CompressedSize,
+                                  &FinalSize );
+
+    if (!NT_SUCCESS( Status ) ||
+        (FinalSize != OriginalSize) ||
+        (RtlCompareMemory( Scratch, Original, OriginalSize ) != OriginalSize)) {
+
+        fprintf( stderr, "TCOMPRES: %s round trip failed (%08lx, %lu of %lu bytes)\n",
+                 Name, Status, FinalSize, OriginalSize );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+//  Decompress a buffer through RtlDecompressStream, handing in compressed
+//  pieces of 1 to MaximumInputPiece bytes and taking out uncompressed
+//  pieces of 1 to MaximumOutputPiece bytes.
+//
+
+NTSTATUS
+StreamDecompress (
+    IN USHORT CompressionFormat,
+    IN PUCHAR Compressed,
+    IN ULONG CompressedSize,
+    OUT PUCHAR Uncompressed,
+    IN ULONG UncompressedSize,
+    IN ULONG MaximumInputPiece,
+    IN ULONG MaximumOutputPiece,
+    OUT PULONG FinalUncompressedSize
+    )
+{
+    NTSTATUS Status;
+    PVOID StreamWorkSpace;
+    ULONG StreamWorkSpaceSize;
+    ULONG In = 0, Out = 0;
+    ULONG InPiece, OutPiece, InUsed, OutUsed;
+
+    *FinalUncompressedSize = 0;
+
+    Status = RtlGetDecompressStreamWorkSpaceSize( CompressionFormat, &StreamWorkSpaceSize );
+
+    if (!NT_SUCCESS( Status )) { return Status; }
+
+    StreamWorkSpace = VirtualAlloc( NULL, StreamWorkSpaceSize, MEM_COMMIT, PAGE_READWRITE );
+
+    Status = RtlInitializeDecompressStream( CompressionFormat, UncompressedSize, StreamWorkSpace );
+
+    while (NT_SUCCESS( Status )) {
+
+        InPiece = 1 + (RtlUniform( &Seed ) % MaximumInputPiece);
+        OutPiece = 1 + (RtlUniform( &Seed ) % MaximumOutputPiece);
+
+        if (InPiece > CompressedSize - In) { InPiece = CompressedSize - In; }
+        if (OutPiece > UncompressedSize - Out) { OutPiece = UncompressedSize - Out; }
+
+        Status = RtlDecompressStream( StreamWorkSpace,
+                                      Compressed + In,
+                                      InPiece,
+                                      &InUsed,
+                                      Uncompressed + Out,
+                                      OutPiece,
+                                      &OutUsed );
+
+        In += InUsed;
+        Out += OutUsed;
+
+        if (Status != STATUS_SUCCESS) { break; }
+
+        //
+        //  With data to hand in and room to take data out every call
+        //  must make some progress.
+        //
+
+        if ((InUsed == 0) && (OutUsed == 0) && (InPiece != 0) && (OutPiece != 0)) {
+
+            fprintf( stderr, "TCOMPRES: stream made no progress at %lu/%lu\n", In, Out );
+            Status = STATUS_UNSUCCESSFUL;
+        }
+    }
+
+    VirtualFree( StreamWorkSpace, 0, MEM_RELEASE );
+
+    *FinalUncompressedSize = Out;
+
+    return (Status == STATUS_NO_MORE_ENTRIES) ? STATUS_SUCCESS : Status;
+}
+
+//
+//  Check that the stream decoder produces exactly what RtlDecompressBuffer
+//  does for the same compressed data and uncompressed size, first with
+//  tiny pieces, then with pieces larger than a chunk, and report the
+//  throughput of the latter against the one shot decoder.
+//
+
+BOOLEAN
+VerifyStream (
+    IN PCHAR Name,
+    IN USHORT CompressionFormat,
+    IN PUCHAR Compressed,
+    IN ULONG CompressedSize,
+    IN ULONG UncompressedSize,
+    IN PUCHAR Scratch,
+    IN PUCHAR StreamScratch,
+    IN BOOLEAN Report
+    )
+{
+    NTSTATUS Status, StreamStatus;
+    ULONG FinalSize, StreamFinalSize;
+    LARGE_INTEGER Start, Stop;
+    double Buffer, Stream;
+    ULONG Pass;
+
+    static ULONG MaximumPieces[2][2] = { { 37, 53 }, { 0x10000, 0x10000 } };
+
+    QueryPerformanceCounter( &Start );
+
+    Status = RtlDecompressBuffer( CompressionFormat,
+                                  Scratch,
+                                  UncompressedSize,
+                                  Compressed,
+                                  CompressedSize,
+                                  &FinalSize );
+
+    QueryPerformanceCounter( &Stop );
+
+    Buffer = ElapsedSeconds( &Start, &Stop );
+
+    for (Pass = 0; Pass < 2; Pass += 1) {
+
+        QueryPerformanceCounter( &Start );
+
+        StreamStatus = StreamDecompress( CompressionFormat,
+                                         Compressed,
+                                         CompressedSize,
+                                         StreamScratch,
+                                         UncompressedSize,
+                                         MaximumPieces[Pass][0],
+                                         MaximumPieces[Pass][1],
+                                         &StreamFinalSize );
+
+        QueryPerformanceCounter( &Stop );
+
+        Stream = ElapsedSeconds( &Start, &Stop );
+
+        if ((Status != StreamStatus) ||
+            (NT_SUCCESS( Status ) &&
+             ((FinalSize != StreamFinalSize) ||
+              (RtlCompareMemory( Scratch, StreamScratch, FinalSize ) != FinalSize)))) {
+
+            fprintf( stderr, "TCOMPRES: %s stream mismatch (%08lx/%08lx, %lu/%lu bytes)\n",
+                     Name, Status, StreamStatus, FinalSize, StreamFinalSize );
+            return FALSE;
+        }
+    }
+
+    if (Report) {
+
+        fprintf( stderr, "%-10s stream %7.1f MB/s  buffer %7.1f MB/s\n",
+                 Name,
+                 (FinalSize / 1048576.0) / Stream,
+                 (FinalSize / 1048576.0) / Buffer );
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+RunEngine (
+    IN PCHAR Name,
+    IN USHORT Engine,
+    IN PUCHAR Corpus,
+    IN ULONG CorpusSize,
+    IN PUCHAR Compressed,
+    IN ULONG CompressedBufferSize,
+    IN PUCHAR Scratch
+    )
+{
+    NTSTATUS Status;
+    PVOID WorkSpace;
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize;
+    ULONG SerialSize, ParallelSize, FinalSize;
+    LARGE_INTEGER Start, Stop;
+    double Serial, Parallel;
+
+    //
+    //  Serial compression through the normal entry point.
+    //
+
+    Status = RtlGetCompressionWorkSpaceSize( COMPRESSION_FORMAT_LZNT1 | Engine,
+                                             &WorkSpaceSize,
+                                             &FragmentWorkSpaceSize );
+
+    if (!NT_SUCCESS( Status )) {
+
+        fprintf( stderr, "TCOMPRES: %s not supported (%08lx)\n", Name, Status );
+        return FALSE;
+    }
+
+    WorkSpace = VirtualAlloc( NULL, WorkSpaceSize, MEM_COMMIT, PAGE_READWRITE );
+
+    QueryPerformanceCounter( &Start );
+
+    Status = RtlCompressBuffer( COMPRESSION_FORMAT_LZNT1 | Engine,
+                                Corpus,
+                                CorpusSize,
+                                Compressed,
+                                CompressedBufferSize,
+                                0x1000,
+                                &SerialSize,
+                                WorkSpace );
+
+    QueryPerformanceCounter( &Stop );
+    VirtualFree( WorkSpace, 0, MEM_RELEASE );
+
+    if (!NT_SUCCESS( Status )) {
+
+        fprintf( stderr, "TCOMPRES: %s serial compress failed (%08lx)\n", Name, Status );
+        return FALSE;
+    }
+
+    Serial = ElapsedSeconds( &Start, &Stop );
+
+    if (!VerifyRoundTrip( Name, COMPRESSION_FORMAT_LZNT1, Corpus, CorpusSize, Compressed, SerialSize, Scratch )) {
+
+        return FALSE;
+    }
+
+    //
+    //  Parallel compression over the worker pool.
+    //
+
+    Status = RtlGetParallelCompressionWorkSpaceSize( COMPRESSION_FORMAT_LZNT1 | Engine,
+                                                     CorpusSize,
+                                                     0x1000,
+                                                     NumberOfWorkers,
+                                                     &WorkSpaceSize );
+
+    if (!NT_SUCCESS( Status )) {
+
+        fprintf( stderr, "TCOMPRES: %s parallel workspace failed (%08lx)\n", Name, Status );
+        return FALSE;
+    }
+
+    WorkSpace = VirtualAlloc( NULL, WorkSpaceSize, MEM_COMMIT, PAGE_READWRITE );
+
+    QueryPerformanceCounter( &Start );
+
+    Status = RtlCompressBufferParallel( COMPRESSION_FORMAT_LZNT1 | Engine,
+                                        Corpus,
+                                        CorpusSize,
+                                        Compressed,
+                                        CompressedBufferSize,
+                                        0x1000,
+                                        &ParallelSize,
+                                        NumberOfWorkers,
+                                        CompressDispatch,
+                                        NULL,
+                                        WorkSpace );
+
+    QueryPerformanceCounter( &Stop );
+    VirtualFree( WorkSpace, 0, MEM_RELEASE );
+
+    if (!NT_SUCCESS( Status )) {
+
+        fprintf( stderr, "TCOMPRES: %s parallel compress failed (%08lx)\n", Name, Status );
+        return FALSE;
+    }
+
+    Parallel = ElapsedSeconds( &Start, &Stop );
+
+    if (!VerifyRoundTrip( Name, COMPRESSION_FORMAT_LZNT1, Corpus, CorpusSize, Compressed, ParallelSize, Scratch )) {
+
+        return FALSE;
+    }
+
+    //
+    //  Finally time decompression of what we just produced.
+    //
+
+    QueryPerformanceCounter( &Start );
+
+    RtlDecompressBuffer( COMPRESSION_FORMAT_LZNT1,
+                         Scratch,
+                         CorpusSize,
+                         Compressed,
+                         ParallelSize,
+                         &FinalSize );
+
+    QueryPerformanceCounter( &Stop );
+
+    fprintf( stderr,
+             "%-10s ratio %5.1f%%  compress %7.1f MB/s  parallel(%2lu) %7.1f MB/s  decompress %7.1f MB/s\n",
+             Name,
+             (100.0 * SerialSize) / CorpusSize,
+             (CorpusSize / 1048576.0) / Serial,
+             NumberOfWorkers,
+             (CorpusSize / 1048576.0) / Parallel,
+             (CorpusSize / 1048576.0) / ElapsedSeconds( &Start, &Stop ) );
+
+    //
+    //  Stream the same data, both in full and stopping short of the end.
+    //
+
+    return VerifyStream( Name, COMPRESSION_FORMAT_LZNT1, Compressed, ParallelSize, CorpusSize, Scratch, Scratch + CorpusSize, TRUE ) &&
+           VerifyStream( Name, COMPRESSION_FORMAT_LZNT1, Compressed, ParallelSize, CorpusSize - 5000, Scratch, Scratch + CorpusSize, FALSE );
+}
+
+//
+//  Build a stream whose first chunk decompresses to less than a full
+//  chunk, so that decompressing it needs zero fill before the second.
+//
+
+BOOLEAN
+RunShortChunks (
+    IN PUCHAR Corpus,
+    IN PUCHAR Compressed,
+    IN PUCHAR Scratch
+    )
+{
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize;
+    PVOID WorkSpace;
+    ULONG FirstSize, SecondSize;
+    ULONG Size;
+    BOOLEAN Result = TRUE;
+
+    RtlGetCompressionWorkSpaceSize( COMPRESSION_FORMAT_LZNT1, &WorkSpaceSize, &FragmentWorkSpaceSize );
+
+    WorkSpace = VirtualAlloc( NULL, WorkSpaceSize, MEM_COMMIT, PAGE_READWRITE );
+
+    RtlCompressBuffer( COMPRESSION_FORMAT_LZNT1, Corpus, 3000, Compressed, 0x2000, 0x1000, &FirstSize, WorkSpace );
+    RtlCompressBuffer( COMPRESSION_FORMAT_LZNT1, Corpus + 0x1000, 0x2000, Compressed + FirstSize, 0x4000, 0x1000, &SecondSize, WorkSpace );
+
+    VirtualFree( WorkSpace, 0, MEM_RELEASE );
+
+    for (Size = 0x1000 - 100; Size < 0x3000 + 100; Size += 97) {
+
+        Result = Result && VerifyStream( "Short", COMPRESSION_FORMAT_LZNT1, Compressed, FirstSize + SecondSize, Size, Scratch, Scratch + 0x4000, FALSE );
+    }
+
+    return Result;
+}
+
+//
+//  There is no Mrcf compressor in the tree, so here is a simple greedy one
+//  for testing the decoders.  It ends a chunk every 512 bytes and leaves
+//  the last byte on its own when the bit stream ends in a partial byte.
+//
+
+typedef struct _BIT_WRITER {
+    PUCHAR Buffer;
+    ULONG Bytes;
+    ULONG Bits;
+    ULONG BitCount;
+} BIT_WRITER, *PBIT_WRITER;
+
+VOID
+PutBits (
+    IN PBIT_WRITER Writer,
+    IN ULONG Value,
+    IN ULONG Count
+    )
+{
+    Writer->Bits |= Value << Writer->BitCount;
+    Writer->BitCount += Count;
+
+    while (Writer->BitCount >= 16) {
+
+        Writer->Buffer[Writer->Bytes++] = (UCHAR)Writer->Bits;
+        Writer->Buffer[Writer->Bytes++] = (UCHAR)(Writer->Bits >> 8);
+        Writer->Bits >>= 16;
+        Writer->BitCount -= 16;
+    }
+}
+
+ULONG
+MrcfCompressForTest (
+    IN PUCHAR Source,
+    IN ULONG Size,
+    OUT PUCHAR Destination
+    )
+{
+    static ULONG Head[4096];
+    BIT_WRITER Writer;
+    ULONG i, Candidate, Offset, Length, Limit, k, Hash;
+    BOOLEAN EndOfChunk = FALSE;
+
+    RtlZeroMemory( Head, sizeof(Head) );
+
+    Destination[0] = 0x44;
+    Destination[1] = 0x53;
+    Destination[2] = 0x00;
+    Destination[3] = 0x02;
+
+    Writer.Buffer = Destination;
+    Writer.Bytes = 4;
+    Writer.Bits = 0;
+    Writer.BitCount = 0;
+
+    for (i = 0; i < Size; ) {
+
+        Length = 0;
+
+        if (i + 3 <= Size) {
+
+            Hash = ((Source[i] << 4) ^ (Source[i+1] << 2) ^ Source[i+2]) & 0xfff;
+            Candidate = Head[Hash];
+            Head[Hash] = i + 1;
+
+            if ((Candidate != 0) && ((Offset = i - (Candidate - 1)) < 4415)) {
+
+                Limit = Size - i;
+                if (Limit > 512) { Limit = 512; }
+
+                while ((Length < Limit) && (Source[i + Length] == Source[i + Length - Offset])) {
+
+                    Length += 1;
+                }
+            }
+        }
+
+        if (Length < 2) {
+
+            PutBits( &Writer, (Source[i] & 0x80) ? 1 : 2, 2 );
+            PutBits( &Writer, Source[i] & 0x7f, 7 );
+            i += 1;
+
+        } else {
+
+            if (Offset < 64) {
+
+                PutBits( &Writer, 0, 2 );
+                PutBits( &Writer, Offset, 6 );
+
+            } else if (Offset < 320) {
+
+                PutBits( &Writer, 3, 2 );
+                PutBits( &Writer, 0, 1 );
+                PutBits( &Writer, Offset - 64, 8 );
+
+            } else {
+
+                PutBits( &Writer, 3, 2 );
+                PutBits( &Writer, 1, 1 );
+                PutBits( &Writer, Offset - 320, 12 );
+            }
+
+            if (Length == 2) {
+
+                PutBits( &Writer, 1, 1 );
+
+            } else {
+
+                for (k = 0; (2UL << k) <= Length - 1; k += 1) { NOTHING; }
+
+                PutBits( &Writer, 0, k );
+                PutBits( &Writer, 1, 1 );
+                PutBits( &Writer, Length - 1 - (1 << k), k );
+            }
+
+            i += Length;
+        }
+
+        //
+        //  End the chunk when we cross a 512 byte boundary, and always end
+        //  the stream with an end of chunk marker.
+        //
+
+        EndOfChunk = ((i / 512) != ((i - 1) / 512)) || (i == Size);
+
+        if (EndOfChunk) {
+
+            PutBits( &Writer, 3, 2 );
+            PutBits( &Writer, 1, 1 );
+            PutBits( &Writer, 4415 - 320, 12 );
+        }
+    }
+
+    if (Writer.BitCount > 8) {
+
+        PutBits( &Writer, 0, 16 - Writer.BitCount );
+
+    } else if (Writer.BitCount > 0) {
+
+        Writer.Buffer[Writer.Bytes++] = (UCHAR)Writer.Bits;
+    }
+
+    return Writer.Bytes;
+}
+
+BOOLEAN
+RunMrcf (
+    IN PUCHAR Corpus,
+    IN ULONG CorpusSize,
+    IN PUCHAR Compressed,
+    IN PUCHAR Scratch
+    )
+{
+    ULONG CompressedSize;
+    ULONG FinalSize;
+    ULONG Size;
+    BOOLEAN Result = TRUE;
+
+    //
+    //  Try a few sizes so both the odd and even stream endings show up.
+    //
+
+    for (Size = CorpusSize - 7; (Size <= CorpusSize) && Result; Size += 1) {
+
+        CompressedSize = MrcfCompressForTest( Corpus, Size, Compressed );
+
+        if (!VerifyRoundTrip( "Mrcf", COMPRESSION_FORMAT_MRCF, Corpus, Size, Compressed, CompressedSize, Scratch )) {
+
+            return FALSE;
+        }
+
+        Result = VerifyStream( "Mrcf", COMPRESSION_FORMAT_MRCF, Compressed, CompressedSize, Size, Scratch, Scratch + CorpusSize, (BOOLEAN)(Size == CorpusSize) );
+
+        //
+        //  The last byte always holds part of the end of chunk marker, so
+        //  without it the stream must be rejected.
+        //
+
+        if (Result &&
+            (StreamDecompress( COMPRESSION_FORMAT_MRCF,
+                               Compressed,
+                               CompressedSize - 1,
+                               Scratch + CorpusSize,
+                               Size,
+                               37,
+                               53,
+                               &FinalSize ) != STATUS_BAD_COMPRESSION_BUFFER)) {
+
+            fprintf( stderr, "TCOMPRES: Mrcf stream without its end marker was accepted\n" );
+            Result = FALSE;
+        }
+    }
+
+    return Result;
+}
+
+int
+_cdecl
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    PUCHAR Corpus, Compressed, Scratch;
+    ULONG CorpusSize, CompressedBufferSize;
+    ULONG i, ThreadId;
+    BOOLEAN Result = TRUE;
+
+    NumberOfWorkers = (argc > 1) ? atoi( argv[1] ) : 4;
+    CorpusSize = ((argc > 2) ? atoi( argv[2] ) : 16) * 1024 * 1024;
+
+    if ((NumberOfWorkers == 0) || (NumberOfWorkers > MAXIMUM_THREADS)) {
+
+        fprintf( stderr, "TCOMPRES: number of threads must be 1 to %d\n", MAXIMUM_THREADS );
+        exit( 1 );
+    }
+
+    //
+    //  Worst case every chunk is stored with a two byte header, plus
+    //  the ending chunk header.
+    //
+
+    CompressedBufferSize = CorpusSize + ((CorpusSize / 0x1000) + 2) * sizeof(USHORT);
+
+    Corpus = VirtualAlloc( NULL, CorpusSize, MEM_COMMIT, PAGE_READWRITE );
+    Compressed = VirtualAlloc( NULL, CompressedBufferSize, MEM_COMMIT, PAGE_READWRITE );
+    Scratch = VirtualAlloc( NULL, 2 * CorpusSize, MEM_COMMIT, PAGE_READWRITE );
+
+    if ((Corpus == NULL) || (Compressed == NULL) || (Scratch == NULL)) {
+
+        fprintf( stderr, "TCOMPRES: Unable to allocate space.\n" );
+        exit( 1 );
+    }
+
+    StartSemaphore = CreateSemaphore( NULL, 0, MAXIMUM_THREADS, NULL );
+    DoneEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+
+    for (i = 0; i < NumberOfWorkers; i += 1) {
+
+        WorkerThreads[i] = CreateThread( NULL, 0, CompressWorker, NULL, 0, &ThreadId );
+    }
+
+    BuildCorpus( Corpus, CorpusSize );
+
+    fprintf( stderr, "TCOMPRES: %lu byte corpus, %lu worker threads\n", CorpusSize, NumberOfWorkers );
+
+    Result = Result && RunEngine( "Standard", COMPRESSION_ENGINE_STANDARD, Corpus, CorpusSize, Compressed, CompressedBufferSize, Scratch );
+    Result = Result && RunEngine( "Chained", COMPRESSION_ENGINE_CHAINED, Corpus, CorpusSize, Compressed, CompressedBufferSize, Scratch );
+
+    //
+    //  The maximum engine is far too slow to run over the whole corpus.
+    //
+
+    Result = Result && RunEngine( "Maximum", COMPRESSION_ENGINE_MAXIMUM, Corpus, 0x40000, Compressed, CompressedBufferSize, Scratch );
+
+    Result = Result && RunShortChunks( Corpus, Compressed, Scratch );
+    Result = Result && RunMrcf( Corpus, 0x100000, Compressed, Scratch );
+
+    Result = Result && FuzzDecompress( 1000000 );
+
+    fprintf( stderr, "TCOMPRES: %s\n", Result ? "passed" : "FAILED" );
+
+    return Result ? 0 : 1;
+}
@@ -0,0 +1,527 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    tgentab.c
+
+Abstract:
+
+    Test and benchmark program for the AVL generic table package.  A random
+    sequence of inserts, deletes and lookups is applied to an AVL table and
+    to a splay tree generic table, and the results are compared with each
+    other and with a simple array of the keys present.  The shape of the
+    AVL tree and the order of its elements are checked as it changes.
+
+    The benchmark then times lookups in the two tables, first from one
+    thread and then from several threads at once.  The threads share the
+    AVL table under a shared lock, but need an exclusive lock on the splay
+    table because a splay tree lookup changes the tree.
+
+    Usage: tgentab [ NumberOfThreads [ NumberOfElements ] ]
+
+    The defaults are 4 threads and 65536 elements.  The timings are printed
+    in milliseconds for 1, 2, 4 and so on threads up to NumberOfThreads.
+    For example, tgentab 1 65536 times 1000000 random lookups from one
+    thread in tables of 65536 elements.
+
+Revision History:
+
+--*/
+
+#include "..\avltable.c"
+#include <nturtl.h>
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAXIMUM_THREADS 32
+
+#define RANDOM_KEYS 2048
+#define RANDOM_ITERATIONS 200000
+
+#define LOOKUPS_PER_THREAD 1000000
+
+ULONG Seed = 4711;
+
+typedef struct _TEST_ELEMENT {
+    ULONG Key;
+    ULONG Value;
+} TEST_ELEMENT, *PTEST_ELEMENT;
+
+BOOLEAN Present[ RANDOM_KEYS ];
+ULONG InsertOrder[ RANDOM_KEYS ];
+ULONG NumberInserted;
+
+//
+//  The user routines for the two tables.  The compare routine only looks
+//  at the key, so a lookup can pass a bare ULONG.
+//
+
+RTL_GENERIC_COMPARE_RESULTS
+NTAPI
+CompareAvl (
+    PRTL_AVL_TABLE Table,
+    PVOID FirstStruct,
+    PVOID SecondStruct
+    )
+{
+    ULONG First = *(PULONG)FirstStruct;
+    ULONG Second = *(PULONG)SecondStruct;
+
+    return (First < Second) ? GenericLessThan :
+           (First > Second) ? GenericGreaterThan : GenericEqual;
+}
+
+PVOID
+NTAPI
+AllocateAvl (
+    PRTL_AVL_TABLE Table,
+    CLONG ByteSize
+    )
+{
+    return RtlAllocateHeap( RtlProcessHeap(), 0, ByteSize );
+}
+
+VOID
+NTAPI
+FreeAvl (
+    PRTL_AVL_TABLE Table,
+    PVOID Buffer
+    )
+{
+    RtlFreeHeap( RtlProcessHeap(), 0, Buffer );
+}
+
+RTL_GENERIC_COMPARE_RESULTS
+NTAPI
+CompareSplay (
+    PRTL_GENERIC_TABLE Table,
+    PVOID FirstStruct,
+    PVOID SecondStruct
+    )
+{
+    return CompareAvl( NULL, FirstStruct, SecondStruct );
+}
+
+PVOID
+NTAPI
+AllocateSplay (
+    PRTL_GENERIC_TABLE Table,
+    CLONG ByteSize
+    )
+{
+    return RtlAllocateHeap( RtlProcessHeap(), 0, ByteSize );
+}
+
+VOID
+NTAPI
+FreeSplay (
+    PRTL_GENERIC_TABLE Table,
+    PVOID Buffer
+    )
+{
+    RtlFreeHeap( RtlProcessHeap(), 0, Buffer );
+}
+
+//
+//  Check the links, balance factors and key order of a subtree, and return
+//  its height, or -1 if something is wrong.
+//
+
+LONG
+CheckSubtree (
+    PRTL_BALANCED_LINKS Links,
+    PRTL_BALANCED_LINKS Parent,
+    PULONG Count
+    )
+{
+    LONG LeftHeight, RightHeight;
+
+    if (Links == NULL) {
+        return 0;
+    }
+
+    if (Links->Parent != Parent) {
+        printf("Node %lx has the wrong parent\n", Links);
+        return -1;
+    }
+
+    if ((Links->LeftChild != NULL) &&
+        (((PTEST_ELEMENT)AvlUserData(Links->LeftChild))->Key >= ((PTEST_ELEMENT)AvlUserData(Links))->Key)) {
+        printf("Node %lx is out of order with its left child\n", Links);
+        return -1;
+    }
+
+    if ((Links->RightChild != NULL) &&
+        (((PTEST_ELEMENT)AvlUserData(Links->RightChild))->Key <= ((PTEST_ELEMENT)AvlUserData(Links))->Key)) {
+        printf("Node %lx is out of order with its right child\n", Links);
+        return -1;
+    }
+
+    LeftHeight = CheckSubtree( Links->LeftChild, Links, Count );
+    RightHeight = CheckSubtree( Links->RightChild, Links, Count );
+
+    if ((LeftHeight < 0) || (RightHeight < 0)) {
+        return -1;
+    }
+
+    if ((RightHeight - LeftHeight) != Links->Balance) {
+        printf("Node %lx has balance %d but its subtrees are %d and %d high\n",
+               Links, Links->Balance, LeftHeight, RightHeight);
+        return -1;
+    }
+
+    *Count += 1;
+
+    return ((LeftHeight > RightHeight) ? LeftHeight : RightHeight) + 1;
+}
+
+BOOLEAN
+CheckTables (
+    PRTL_AVL_TABLE AvlTable,
+    PRTL_GENERIC_TABLE SplayTable
+    )
+{
+    ULONG Count, Key, i;
+    PTEST_ELEMENT Element;
+    PVOID RestartKey;
+
+    Count = 0;
+    if (CheckSubtree( AvlTable->TableRoot, NULL, &Count ) < 0) {
+        return FALSE;
+    }
+
+    if ((Count != RtlNumberGenericTableElementsAvl( AvlTable )) ||
+        (Count != RtlNumberGenericTableElements( SplayTable )) ||
+        (Count != NumberInserted)) {
+        printf("Element counts differ, %d in the tree\n", Count);
+        return FALSE;
+    }
+
+    //
+    //  The enumeration must return exactly the keys present, in order
+    //
+
+    Key = 0;
+    RestartKey = NULL;
+    for (Element = RtlEnumerateGenericTableWithoutSplayingAvl( AvlTable, &RestartKey );
+         Element != NULL;
+         Element = RtlEnumerateGenericTableWithoutSplayingAvl( AvlTable, &RestartKey )) {
+
+        while ((Key < RANDOM_KEYS) && !Present[ Key ]) {
+            Key += 1;
+        }
+
+        if (Element->Key != Key) {
+            printf("Enumeration returned %d instead of %d\n", Element->Key, Key);
+            return FALSE;
+        }
+
+        Key += 1;
+    }
+
+    //
+    //  And the elements must come back in the order they were inserted
+    //
+
+    for (i = 0; i < NumberInserted; i += 1) {
+
+        Element = RtlGetElementGenericTableAvl( AvlTable, i );
+
+        if ((Element == NULL) ||
+            (Element->Key != InsertOrder[ i ]) ||
+            (((PTEST_ELEMENT)RtlGetElementGenericTable( SplayTable, i ))->Key != InsertOrder[ i ])) {
+            printf("Element %d in insert order is wrong\n", i);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+RandomTest (
+    VOID
+    )
+{
+    RTL_AVL_TABLE AvlTable;
+    RTL_GENERIC_TABLE SplayTable;
+    TEST_ELEMENT Buffer;
+    PTEST_ELEMENT Element;
+    BOOLEAN NewElement, SplayNewElement, Deleted;
+    ULONG Iteration, Key, i;
+
+    printf("Start RandomTest()\n");
+
+    RtlInitializeGenericTableAvl( &AvlTable, CompareAvl, AllocateAvl, FreeAvl, NULL );
+    RtlInitializeGenericTable( &SplayTable, CompareSplay, AllocateSplay, FreeSplay, NULL );
+
+    for (Iteration = 0; Iteration < RANDOM_ITERATIONS; Iteration += 1) {
+
+        //
+        //  Grow and shrink the table in phases, sometimes with runs of
+        //  ascending keys, which are the worst case for an unbalanced tree.
+        //
+
+        if ((Iteration / 5000) & 4) {
+            Key = Iteration % RANDOM_KEYS;
+        } else {
+            Key = RtlUniform( &Seed ) % RANDOM_KEYS;
+        }
+
+        switch (RtlUniform( &Seed ) % (((Iteration / 20000) & 1) ? 3 : 5)) {
+
+        case 0:
+        case 3:
+        case 4:
+            Buffer.Key = Key;
+            Buffer.Value = Iteration;
+
+            Element = RtlInsertElementGenericTableAvl( &AvlTable, &Buffer, sizeof(Buffer), &NewElement );
+            RtlInsertElementGenericTable( &SplayTable, &Buffer, sizeof(Buffer), &SplayNewElement );
+
+            if ((Element == NULL) || (Element->Key != Key) ||
+                (NewElement == Present[ Key ]) || (SplayNewElement != NewElement)) {
+                printf("Insert of %d failed\n", Key);
+                return FALSE;
+            }
+
+            if (NewElement) {
+                Present[ Key ] = TRUE;
+                InsertOrder[ NumberInserted++ ] = Key;
+            }
+            break;
+
+        case 1:
+            Deleted = RtlDeleteElementGenericTableAvl( &AvlTable, &Key );
+
+            if ((Deleted != Present[ Key ]) ||
+                (RtlDeleteElementGenericTable( &SplayTable, &Key ) != Deleted)) {
+                printf("Delete of %d failed\n", Key);
+                return FALSE;
+            }
+
+            if (Deleted) {
+                Present[ Key ] = FALSE;
+                for (i = 0; InsertOrder[ i ] != Key; i += 1) {
+                    NOTHING;
+                }
+                NumberInserted -= 1;
+                memmove( &InsertOrder[ i ], &InsertOrder[ i + 1 ], (NumberInserted - i) * sizeof(ULONG) );
+            }
+            break;
+
+        case 2:
+            Element = RtlLookupElementGenericTableAvl( &AvlTable, &Key );
+
+            if ((Element != NULL) != Present[ Key ]) {
+                printf("Lookup of %d failed\n", Key);
+                return FALSE;
+            }
+            break;
+        }
+
+        if (((Iteration % 64) == 0) && !CheckTables( &AvlTable, &SplayTable )) {
+            printf("Failed at iteration %d\n", Iteration);
+            return FALSE;
+        }
+    }
+
+    //
+    //  Empty the table through an enumeration that deletes each element as
+    //  it goes, which must still visit every element once.
+    //
+
+    i = 0;
+    for (Element = RtlEnumerateGenericTableAvl( &AvlTable, TRUE );
+         Element != NULL;
+         Element = RtlEnumerateGenericTableAvl( &AvlTable, FALSE )) {
+
+        Key = Element->Key;
+
+        if ((i & 1) && !RtlDeleteElementGenericTableAvl( &AvlTable, &Key )) {
+            printf("Delete during enumeration failed\n");
+            return FALSE;
+        }
+
+        i += 1;
+    }
+
+    if (i != NumberInserted) {
+        printf("Enumeration visited %d of %d elements\n", i, NumberInserted);
+        return FALSE;
+    }
+
+    while ((Element = RtlEnumerateGenericTableAvl( &AvlTable, TRUE )) != NULL) {
+        Key = Element->Key;
+        RtlDeleteElementGenericTableAvl( &AvlTable, &Key );
+    }
+
+    if (!RtlIsGenericTableEmptyAvl( &AvlTable )) {
+        printf("Table is not empty\n");
+        return FALSE;
+    }
+
+    while ((Element = RtlEnumerateGenericTable( &SplayTable, TRUE )) != NULL) {
+        Key = Element->Key;
+        RtlDeleteElementGenericTable( &SplayTable, &Key );
+    }
+
+    printf("End RandomTest()\n");
+
+    return TRUE;
+}
+
+//
+//  Lookup benchmark.  Every thread looks up random keys that are present,
+//  taking the table lock shared for the AVL table and exclusive for the
+//  splay table.
+//
+
+RTL_AVL_TABLE BenchAvlTable;
+RTL_GENERIC_TABLE BenchSplayTable;
+RTL_RESOURCE BenchLock;
+ULONG NumberOfElements;
+BOOLEAN BenchSplay;
+
+DWORD
+WINAPI
+LookupThread (
+    LPVOID Parameter
+    )
+{
+    ULONG ThreadSeed = (ULONG)Parameter;
+    ULONG i, Key;
+    PVOID Element;
+
+    for (i = 0; i < LOOKUPS_PER_THREAD; i += 1) {
+
+        Key = (RtlUniform( &ThreadSeed ) % NumberOfElements) * 2;
+
+        if (BenchSplay) {
+            RtlAcquireResourceExclusive( &BenchLock, TRUE );
+            Element = RtlLookupElementGenericTable( &BenchSplayTable, &Key );
+        } else {
+            RtlAcquireResourceShared( &BenchLock, TRUE );
+            Element = RtlLookupElementGenericTableAvl( &BenchAvlTable, &Key );
+        }
+
+        RtlReleaseResource( &BenchLock );
+
+        if (Element == NULL) {
+            printf("Lookup of %d failed\n", Key);
+            ExitProcess( 1 );
+        }
+    }
+
+    return 0;
+}
+
+ULONG
+RunLookups (
+    ULONG NumberOfThreads,
+    BOOLEAN Splay
+    )
+{
+    HANDLE Threads[ MAXIMUM_THREADS ];
+    ULONG i, StartTime;
+    DWORD ThreadId;
+
+    BenchSplay = Splay;
+    StartTime = GetTickCount();
+
+    for (i = 0; i < NumberOfThreads; i += 1) {
+        Threads[ i ] = CreateThread( NULL, 0, LookupThread, (LPVOID)(i + 1), 0, &ThreadId );
+    }
+
+    WaitForMultipleObjects( NumberOfThreads, Threads, TRUE, INFINITE );
+
+    for (i = 0; i < NumberOfThreads; i += 1) {
+        CloseHandle( Threads[ i ] );
+    }
+
+    return GetTickCount() - StartTime;
+}
+
+VOID
+LookupBenchmark (
+    ULONG MaxThreads
+    )
+{
+    TEST_ELEMENT Buffer;
+    PULONG Keys;
+    ULONG i, j, Threads;
+
+    RtlInitializeGenericTableAvl( &BenchAvlTable, CompareAvl, AllocateAvl, FreeAvl, NULL );
+    RtlInitializeGenericTable( &BenchSplayTable, CompareSplay, AllocateSplay, FreeSplay, NULL );
+    RtlInitializeResource( &BenchLock );
+
+    //
+    //  Insert the even keys in a random order
+    //
+
+    Keys = RtlAllocateHeap( RtlProcessHeap(), 0, NumberOfElements * sizeof(ULONG) );
+
+    for (i = 0; i < NumberOfElements; i += 1) {
+        j = RtlUniform( &Seed ) % (i + 1);
+        Keys[ i ] = Keys[ j ];
+        Keys[ j ] = i * 2;
+    }
+
+    for (i = 0; i < NumberOfElements; i += 1) {
+        Buffer.Key = Keys[ i ];
+        Buffer.Value = i;
+        RtlInsertElementGenericTableAvl( &BenchAvlTable, &Buffer, sizeof(Buffer), NULL );
+        RtlInsertElementGenericTable( &BenchSplayTable, &Buffer, sizeof(Buffer), NULL );
+    }
+
+    RtlFreeHeap( RtlProcessHeap(), 0, Keys );
+
+    printf("%d elements, %d random lookups per thread, milliseconds\n",
+           NumberOfElements, LOOKUPS_PER_THREAD);
+    printf("Threads        Splay          AVL\n");
+
+    for (Threads = 1; Threads <= MaxThreads; Threads *= 2) {
+        printf("%7d %12d %12d\n",
+               Threads,
+               RunLookups( Threads, TRUE ),
+               RunLookups( Threads, FALSE ));
+    }
+}
+
+int
+_CDECL
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    ULONG MaxThreads = 4;
+
+    NumberOfElements = 65536;
+
+    if (argc > 1) {
+        MaxThreads = atoi( argv[1] );
+        if ((MaxThreads == 0) || (MaxThreads > MAXIMUM_THREADS)) {
+            MaxThreads = MAXIMUM_THREADS;
+        }
+    }
+
+    if (argc > 2) {
+        NumberOfElements = atoi( argv[2] );
+        if (NumberOfElements == 0) {
+            NumberOfElements = 1;
+        }
+    }
+
+    if (!RandomTest()) {
+        return 1;
+    }
+
+    LookupBenchmark( MaxThreads );
+
+    return 0;
+}
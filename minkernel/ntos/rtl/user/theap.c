@@ -22,6 +22,7 @@ Revision History:
 #include "..\heap.c"
 #include "..\heapdll.c"
 #include "..\heapdbg.c"
+#include "..\heaplfh.c"
 #include "..\trace.c"
 #include <windows.h>
 
@@ -80,6 +81,194 @@ ULONG Seed = 14623;
 #define MAX_HEAP_ALLOC 0x120000
 #define REASONABLE_HEAP_ALLOC 0x200
 
+//
+// Multi-threaded allocation benchmark.  Each thread randomly allocates and
+// frees small blocks out of a private table, so the only thing the threads
+// share is the heap.  Run as "theap -mt [MaxThreads [Iterations]]".
+//
+
+#define BENCH_TABLE_SIZE 256
+#define BENCH_MAX_ALLOC 0x100
+
+typedef struct _BENCH_THREAD {
+    PVOID Heap;
+    ULONG Iterations;
+    ULONG Seed;
+    ULONG Failures;
+} BENCH_THREAD, *PBENCH_THREAD;
+
+DWORD
+WINAPI
+BenchThread(
+    LPVOID Parameter
+    )
+{
+    PBENCH_THREAD Bench = (PBENCH_THREAD)Parameter;
+    PVOID Blocks[ BENCH_TABLE_SIZE ];
+    ULONG i, j, n;
+
+    memset( Blocks, 0, sizeof( Blocks ) );
+    for (i = 0; i < Bench->Iterations; i++) {
+        j = RtlUniform( &Bench->Seed ) % BENCH_TABLE_SIZE;
+        if (Blocks[ j ] != NULL) {
+            if (!RtlFreeHeap( Bench->Heap, 0, Blocks[ j ] )) {
+                Bench->Failures += 1;
+                }
+            Blocks[ j ] = NULL;
+            }
+        else {
+            n = RtlUniform( &Bench->Seed ) % BENCH_MAX_ALLOC;
+            Blocks[ j ] = RtlAllocateHeap( Bench->Heap, 0, n );
+            if (Blocks[ j ] == NULL) {
+                Bench->Failures += 1;
+                }
+            else {
+                memset( Blocks[ j ], (UCHAR)j, n );
+                }
+            }
+        }
+
+    for (j = 0; j < BENCH_TABLE_SIZE; j++) {
+        if (Blocks[ j ] != NULL) {
+            RtlFreeHeap( Bench->Heap, 0, Blocks[ j ] );
+            }
+        }
+
+    return 0;
+}
+
+ULONG
+RunBenchmark(
+    ULONG HeapFlags,
+    ULONG ThreadCount,
+    ULONG Iterations,
+    PRTL_HEAP_COUNTERS Counters
+    )
+{
+    PVOID Heap;
+    BENCH_THREAD Bench[ MAXIMUM_WAIT_OBJECTS ];
+    HANDLE Threads[ MAXIMUM_WAIT_OBJECTS ];
+    DWORD ThreadId;
+    ULONG i, StartTime, ElapsedTime, Failures;
+
+    Heap = RtlCreateHeap( HEAP_GROWABLE | HeapFlags,
+                          NULL,
+                          0x100000,
+                          0x1000,
+                          NULL,
+                          NULL
+                        );
+    if (Heap == NULL) {
+        fprintf( stderr, "THEAP: Unable to create heap.\n" );
+        exit( 1 );
+        }
+
+    for (i = 0; i < ThreadCount; i++) {
+        Bench[ i ].Heap = Heap;
+        Bench[ i ].Iterations = Iterations;
+        Bench[ i ].Seed = Seed + i;
+        Bench[ i ].Failures = 0;
+        Threads[ i ] = CreateThread( NULL, 0, BenchThread, &Bench[ i ], CREATE_SUSPENDED, &ThreadId );
+        if (Threads[ i ] == NULL) {
+            fprintf( stderr, "THEAP: Unable to create thread.\n" );
+            exit( 1 );
+            }
+        }
+
+    StartTime = GetTickCount();
+    for (i = 0; i < ThreadCount; i++) {
+        ResumeThread( Threads[ i ] );
+        }
+    WaitForMultipleObjects( ThreadCount, Threads, TRUE, INFINITE );
+    ElapsedTime = GetTickCount() - StartTime;
+
+    Failures = 0;
+    for (i = 0; i < ThreadCount; i++) {
+        CloseHandle( Threads[ i ] );
+        Failures += Bench[ i ].Failures;
+        }
+
+    if (Failures != 0) {
+        fprintf( stderr, "THEAP: %u allocations or frees failed\n", Failures );
+        }
+
+    RtlQueryHeapInformation( Heap,
+                             HeapCounterInformation,
+                             Counters,
+                             sizeof( *Counters ),
+                             NULL
+                           );
+    RtlDestroyHeap( Heap );
+    return ElapsedTime ? ElapsedTime : 1;
+}
+
+int
+HeapBenchmark(
+    int argc,
+    char *argv[]
+    )
+{
+    ULONG MaxThreads, Iterations, ThreadCount;
+    ULONG Locked, Regular, LowFrag;
+    RTL_HEAP_COUNTERS Counters[ 3 ];
+    ULONG Allocations, i, j;
+
+    MaxThreads = argc > 2 ? atoi( argv[ 2 ] ) : 8;
+    Iterations = argc > 3 ? atoi( argv[ 3 ] ) : 1000000;
+    if (MaxThreads == 0 || MaxThreads > MAXIMUM_WAIT_OBJECTS) {
+        MaxThreads = MAXIMUM_WAIT_OBJECTS;
+        }
+
+    //
+    // The debug heap would hide the fast paths being measured.
+    //
+
+    NtGlobalFlag = 0;
+
+    fprintf( stderr, "THEAP: %u iterations per thread, blocks up to %u bytes\n",
+             Iterations,
+             BENCH_MAX_ALLOC
+           );
+    fprintf( stderr, "Threads   No cache (ops/ms)   Regular (ops/ms)   Low fragmentation (ops/ms)\n" );
+    for (ThreadCount = 1; ThreadCount <= MaxThreads; ThreadCount *= 2) {
+        Locked = RunBenchmark( HEAP_CREATE_NO_FREE_CACHE, ThreadCount, Iterations, &Counters[ 0 ] );
+        Regular = RunBenchmark( 0, ThreadCount, Iterations, &Counters[ 1 ] );
+        LowFrag = RunBenchmark( HEAP_CREATE_LOW_FRAGMENTATION, ThreadCount, Iterations, &Counters[ 2 ] );
+        fprintf( stderr, "%7u   %17u   %16u   %26u\n",
+                 ThreadCount,
+                 (ThreadCount * Iterations) / Locked,
+                 (ThreadCount * Iterations) / Regular,
+                 (ThreadCount * Iterations) / LowFrag
+               );
+        }
+
+    //
+    // Show where the allocations of the last round were satisfied from.
+    //
+
+    fprintf( stderr, "\nCounters for %u threads\n", ThreadCount / 2 );
+    fprintf( stderr, "          Allocs   Front end   List hit   List miss   Extend   Decommit   Contention\n" );
+    for (i = 0; i < 3; i++) {
+        Allocations = 0;
+        for (j = 0; j < RTL_HEAP_SIZE_CLASSES; j++) {
+            Allocations += Counters[ i ].Allocations[ j ];
+            }
+
+        fprintf( stderr, "%-8s %7u   %9u   %8u   %9u   %6u   %8u   %10u\n",
+                 i == 0 ? "No cache" : i == 1 ? "Regular" : "Low frag",
+                 Allocations,
+                 Counters[ i ].FrontEndHits,
+                 Counters[ i ].FreeListHits,
+                 Counters[ i ].FreeListMisses,
+                 Counters[ i ].ExtendCalls,
+                 Counters[ i ].DeCommitCalls,
+                 Counters[ i ].LockContentions
+               );
+        }
+
+    return 0;
+}
+
 int
 _cdecl
 main(
@@ -97,6 +286,10 @@ main(
     ULONG TagBaseIndex, Tag;
 
     RtlInitializeHeapManager();
+    if (argc > 1 && !_stricmp( argv[ 1 ], "-mt" )) {
+        return HeapBenchmark( argc, argv );
+        }
+
     memset( &Usage, 0, sizeof( Usage ) );
 
 #if 0
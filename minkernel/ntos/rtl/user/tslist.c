@@ -0,0 +1,353 @@
+/*++
+
+Copyright (c) 1996  Microsoft Corporation
+
+Module Name:
+
+    tslist.c
+
+Abstract:
+
+    Test and benchmark program for the interlocked sequenced singly linked
+    list procedures.  The user mode push, pop, and flush procedures use the
+    same cmpxchg8b algorithm as the executive sequenced lists, so this
+    program exercises the algorithm behind the lookaside lists and the
+    small pool lookaside lists.
+
+    The test has several threads pop entries from a shared list and push
+    them back, while one thread now and then flushes the whole list and
+    pushes the entries back one at a time.  Each entry records its current
+    owner, so an entry handed to two threads at once is detected.  At the
+    end the list must hold every entry exactly once and the depth must
+    match the number of entries.
+
+    The benchmark then times pop and push pairs from one thread up to the
+    maximum number of threads, first on the sequenced list and then on a
+    singly linked list protected by a critical section.
+
+    Usage: tslist [ NumberOfThreads [ NumberOfEntries ] ]
+
+Environment:
+
+    User mode, x86 processors that support cmpxchg8b.
+
+Revision History:
+
+--*/
+
+#include "ntrtlp.h"
+#include <nturtl.h>
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAXIMUM_THREADS 32
+
+#define TEST_ITERATIONS 1000000
+#define FLUSH_INTERVAL 1000
+
+#define BENCHMARK_ITERATIONS 1000000
+
+typedef struct _TEST_ENTRY {
+    SINGLE_LIST_ENTRY ListEntry;
+    ULONG Owner;
+    ULONG Uses;
+} TEST_ENTRY, *PTEST_ENTRY;
+
+SLIST_HEADER SListHead;
+SINGLE_LIST_ENTRY LockedListHead;
+RTL_CRITICAL_SECTION ListLock;
+
+PTEST_ENTRY Entries;
+ULONG NumberOfEntries;
+
+BOOLEAN BenchLocked;
+volatile BOOLEAN TestFailed;
+
+VOID
+TakeEntry (
+    PTEST_ENTRY Entry,
+    ULONG ThreadNumber
+    )
+{
+    if (InterlockedExchange( (PLONG)&Entry->Owner, ThreadNumber ) != 0) {
+        printf("Entry %lx popped by thread %d while in use\n", Entry, ThreadNumber);
+        TestFailed = TRUE;
+    }
+
+    Entry->Uses += 1;
+}
+
+VOID
+ReleaseEntry (
+    PTEST_ENTRY Entry,
+    ULONG ThreadNumber
+    )
+{
+    if (InterlockedExchange( (PLONG)&Entry->Owner, 0 ) != (LONG)ThreadNumber) {
+        printf("Entry %lx owned by another thread than %d\n", Entry, ThreadNumber);
+        TestFailed = TRUE;
+    }
+}
+
+DWORD
+WINAPI
+TestThread (
+    LPVOID Parameter
+    )
+{
+    PSINGLE_LIST_ENTRY Chain;
+    PTEST_ENTRY Entry;
+    ULONG i;
+    PSINGLE_LIST_ENTRY NextEntry;
+    ULONG ThreadNumber = (ULONG)Parameter;
+
+    for (i = 0; (i < TEST_ITERATIONS) && !TestFailed; i += 1) {
+
+        //
+        //  The first thread flushes the list now and then and gives all
+        //  of the entries back one at a time.
+        //
+
+        if ((ThreadNumber == 1) && ((i % FLUSH_INTERVAL) == 0)) {
+            Chain = RtlpInterlockedFlushSList( &SListHead );
+            while (Chain != NULL) {
+                Entry = CONTAINING_RECORD( Chain, TEST_ENTRY, ListEntry );
+                NextEntry = Chain->Next;
+                TakeEntry( Entry, ThreadNumber );
+                ReleaseEntry( Entry, ThreadNumber );
+                RtlpInterlockedPushEntrySList( &SListHead, &Entry->ListEntry );
+                Chain = NextEntry;
+            }
+
+            continue;
+        }
+
+        Chain = RtlpInterlockedPopEntrySList( &SListHead );
+        if (Chain == NULL) {
+            continue;
+        }
+
+        Entry = CONTAINING_RECORD( Chain, TEST_ENTRY, ListEntry );
+        TakeEntry( Entry, ThreadNumber );
+        ReleaseEntry( Entry, ThreadNumber );
+        RtlpInterlockedPushEntrySList( &SListHead, &Entry->ListEntry );
+    }
+
+    return 0;
+}
+
+VOID
+StartThreads (
+    ULONG NumberOfThreads,
+    LPTHREAD_START_ROUTINE StartRoutine,
+    HANDLE *Threads
+    )
+{
+    ULONG i;
+    DWORD ThreadId;
+
+    for (i = 0; i < NumberOfThreads; i += 1) {
+        Threads[ i ] = CreateThread( NULL, 0, StartRoutine, (LPVOID)(i + 1), 0, &ThreadId );
+        if (Threads[ i ] == NULL) {
+            printf("Unable to create thread, error %d\n", GetLastError());
+            ExitProcess( 1 );
+        }
+    }
+
+    WaitForMultipleObjects( NumberOfThreads, Threads, TRUE, INFINITE );
+
+    for (i = 0; i < NumberOfThreads; i += 1) {
+        CloseHandle( Threads[ i ] );
+    }
+}
+
+BOOLEAN
+SListTest (
+    ULONG NumberOfThreads
+    )
+{
+    PSINGLE_LIST_ENTRY Chain;
+    ULONG Count;
+    PTEST_ENTRY Entry;
+    ULONG i;
+    HANDLE Threads[ MAXIMUM_THREADS ];
+    ULONG TotalUses;
+
+    RtlZeroMemory( &SListHead, sizeof(SListHead) );
+    RtlZeroMemory( Entries, NumberOfEntries * sizeof(TEST_ENTRY) );
+
+    for (i = 0; i < NumberOfEntries; i += 1) {
+        RtlpInterlockedPushEntrySList( &SListHead, &Entries[ i ].ListEntry );
+    }
+
+    if (SListHead.Depth != NumberOfEntries) {
+        printf("Depth is %d after pushing %d entries\n", SListHead.Depth, NumberOfEntries);
+        return FALSE;
+    }
+
+    StartThreads( NumberOfThreads, TestThread, Threads );
+
+    if (TestFailed) {
+        return FALSE;
+    }
+
+    //
+    //  Every entry must be on the list once, and no entry may be owned.
+    //
+
+    if (SListHead.Depth != NumberOfEntries) {
+        printf("Depth is %d after the test, expected %d\n", SListHead.Depth, NumberOfEntries);
+        return FALSE;
+    }
+
+    Count = 0;
+    TotalUses = 0;
+    Chain = RtlpInterlockedFlushSList( &SListHead );
+    while (Chain != NULL) {
+        Entry = CONTAINING_RECORD( Chain, TEST_ENTRY, ListEntry );
+        if (Entry->Owner != 0) {
+            printf("Entry %lx is still owned by thread %d\n", Entry, Entry->Owner);
+            return FALSE;
+        }
+
+        TotalUses += Entry->Uses;
+        Count += 1;
+        if (Count > NumberOfEntries) {
+            printf("List holds more entries than were pushed\n");
+            return FALSE;
+        }
+
+        Chain = Chain->Next;
+    }
+
+    if ((Count != NumberOfEntries) ||
+        (SListHead.Depth != 0) ||
+        (RtlpInterlockedFlushSList( &SListHead ) != NULL)) {
+
+        printf("Flush returned %d entries, expected %d\n", Count, NumberOfEntries);
+        return FALSE;
+    }
+
+    printf("%d threads, %d entries, %d pops and flushed entries checked\n",
+           NumberOfThreads,
+           NumberOfEntries,
+           TotalUses);
+
+    return TRUE;
+}
+
+DWORD
+WINAPI
+BenchThread (
+    LPVOID Parameter
+    )
+{
+    PSINGLE_LIST_ENTRY Entry;
+    ULONG i;
+
+    for (i = 0; i < BENCHMARK_ITERATIONS; i += 1) {
+        if (BenchLocked) {
+            RtlEnterCriticalSection( &ListLock );
+            Entry = PopEntryList( &LockedListHead );
+            RtlLeaveCriticalSection( &ListLock );
+
+            if (Entry != NULL) {
+                RtlEnterCriticalSection( &ListLock );
+                PushEntryList( &LockedListHead, Entry );
+                RtlLeaveCriticalSection( &ListLock );
+            }
+
+        } else {
+            Entry = RtlpInterlockedPopEntrySList( &SListHead );
+            if (Entry != NULL) {
+                RtlpInterlockedPushEntrySList( &SListHead, Entry );
+            }
+        }
+    }
+
+    return 0;
+}
+
+ULONG
+RunBenchmark (
+    ULONG NumberOfThreads,
+    BOOLEAN Locked
+    )
+{
+    ULONG i;
+    ULONG StartTime;
+    HANDLE Threads[ MAXIMUM_THREADS ];
+
+    RtlZeroMemory( &SListHead, sizeof(SListHead) );
+    LockedListHead.Next = NULL;
+
+    for (i = 0; i < NumberOfEntries; i += 1) {
+        if (Locked) {
+            PushEntryList( &LockedListHead, &Entries[ i ].ListEntry );
+
+        } else {
+            RtlpInterlockedPushEntrySList( &SListHead, &Entries[ i ].ListEntry );
+        }
+    }
+
+    BenchLocked = Locked;
+    StartTime = GetTickCount();
+    StartThreads( NumberOfThreads, BenchThread, Threads );
+    return GetTickCount() - StartTime;
+}
+
+int
+_CDECL
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    ULONG MaxThreads = 4;
+    ULONG Threads;
+
+    NumberOfEntries = 64;
+
+    if (argc > 1) {
+        MaxThreads = atoi( argv[1] );
+        if ((MaxThreads == 0) || (MaxThreads > MAXIMUM_THREADS)) {
+            MaxThreads = MAXIMUM_THREADS;
+        }
+    }
+
+    if (argc > 2) {
+        NumberOfEntries = atoi( argv[2] );
+        if (NumberOfEntries == 0) {
+            NumberOfEntries = 1;
+        }
+    }
+
+    Entries = RtlAllocateHeap( RtlProcessHeap(), 0, NumberOfEntries * sizeof(TEST_ENTRY) );
+    if (Entries == NULL) {
+        printf("Unable to allocate entries\n");
+        return 1;
+    }
+
+    RtlInitializeCriticalSection( &ListLock );
+
+    for (Threads = 1; Threads <= MaxThreads; Threads *= 2) {
+        if (!SListTest( Threads )) {
+            printf("Sequenced list test failed\n");
+            return 1;
+        }
+    }
+
+    printf("%d pop and push pairs per thread, milliseconds\n", BENCHMARK_ITERATIONS);
+    printf("Threads        SList       Locked\n");
+
+    for (Threads = 1; Threads <= MaxThreads; Threads *= 2) {
+        printf("%7d %12d %12d\n",
+               Threads,
+               RunBenchmark( Threads, FALSE ),
+               RunBenchmark( Threads, TRUE ));
+    }
+
+    return 0;
+}
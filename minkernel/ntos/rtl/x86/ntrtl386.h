@@ -68,3 +68,23 @@ RtlpExceptionRegistrationDump(
     IN PVOID Object,
     IN ULONG Control OPTIONAL
     );
+
+//
+//  Interlocked sequenced list procedures for user mode.
+//
+
+PSINGLE_LIST_ENTRY
+RtlpInterlockedPopEntrySList (
+    IN PSLIST_HEADER ListHead
+    );
+
+PSINGLE_LIST_ENTRY
+RtlpInterlockedPushEntrySList (
+    IN PSLIST_HEADER ListHead,
+    IN PSINGLE_LIST_ENTRY ListEntry
+    );
+
+PSINGLE_LIST_ENTRY
+RtlpInterlockedFlushSList (
+    IN PSLIST_HEADER ListHead
+    );
@@ -0,0 +1,220 @@
+        title  "Interlocked Sequenced Lists"
+;++
+;
+; Copyright (c) 1996  Microsoft Corporation
+;
+; Module Name:
+;
+;    slist.asm
+;
+; Abstract:
+;
+;    This module implements the user mode versions of the interlocked
+;    sequenced singly linked list functions.  They use the same SLIST_HEADER
+;    as the executive versions, and the sequence number in the list header
+;    guarantees that a pop cannot succeed against a list that changed
+;    between the time its first entry was read and the compare exchange.
+;
+;    N.B. The cmpxchg8b instruction must be supported by the host processor.
+;
+; Environment:
+;
+;    User mode.
+;
+; Revision History:
+;
+;--
+
+.586p
+        .xlist
+include ks386.inc
+include callconv.inc            ; calling convention macros
+        .list
+
+_TEXT   SEGMENT DWORD PUBLIC 'CODE'
+        ASSUME  DS:FLAT, ES:FLAT, SS:NOTHING, FS:NOTHING, GS:NOTHING
+
+        page ,132
+        subttl  "Interlocked Pop Entry Sequenced List"
+;++
+;
+; PSINGLE_LIST_ENTRY
+; RtlpInterlockedPopEntrySList (
+;    IN PSLIST_HEADER ListHead
+;    )
+;
+; Routine Description:
+;
+;    This function removes an entry from the front of a sequenced singly
+;    linked list.  If there are no entries in the list, then a value of NULL
+;    is returned.  Otherwise, the address of the entry that is removed is
+;    returned as the function value.
+;
+;    N.B. The read of the successor link can fault if the first entry was
+;         removed and its memory released by another thread after the list
+;         head was read.  Callers that can hit this case must call this
+;         function inside a try and treat an exception as an empty list.
+;
+; Arguments:
+;
+;    (TOS+4) = ListHead - Supplies a pointer to the sequenced listhead from
+;         which an entry is to be removed.
+;
+; Return Value:
+;
+;    The address of the entry removed from the list, or NULL if the list is
+;    empty.
+;
+;--
+
+cPublicProc _RtlpInterlockedPopEntrySList ,1
+cPublicFpo 1,2
+
+;
+; Save nonvolatile registers and read the listhead sequence number followed
+; by the listhead next link.
+;
+; N.B. These two dwords MUST be read exactly in this order.
+;
+
+        push    ebx                     ; save nonvolatile registers
+        push    ebp                     ;
+        mov     ebp,[esp]+12            ; get listhead address
+        mov     edx,[ebp] + 4           ; get current sequence number
+        mov     eax,[ebp] + 0           ; get current next link
+
+;
+; If the list is empty, then there is nothing that can be removed.
+;
+
+Rpop10: or      eax, eax                ; check if list is empty
+        jz      short Rpop20            ; if z set, list is empty
+        mov     ecx, edx                ; copy sequence number and depth
+        add     ecx, 0FFFFH             ; adjust sequence number and depth
+        mov     ebx, [eax]              ; get address of successor entry
+   lock cmpxchg8b qword ptr [ebp]       ; compare and exchange
+        jnz     short Rpop10            ; if z clear, exchange failed
+
+;
+; Restore nonvolatile registers and return result.
+;
+
+Rpop20: pop     ebp                     ; restore nonvolatile registers
+        pop     ebx                     ;
+        stdRET  _RtlpInterlockedPopEntrySList
+
+stdENDP _RtlpInterlockedPopEntrySList
+
+        page ,132
+        subttl  "Interlocked Push Entry Sequenced List"
+;++
+;
+; PSINGLE_LIST_ENTRY
+; RtlpInterlockedPushEntrySList (
+;    IN PSLIST_HEADER ListHead,
+;    IN PSINGLE_LIST_ENTRY ListEntry
+;    )
+;
+; Routine Description:
+;
+;    This function inserts an entry at the head of a sequenced singly linked
+;    list.
+;
+; Arguments:
+;
+;    (TOS+4) = ListHead - Supplies a pointer to the sequenced listhead into
+;         which an entry is to be inserted.
+;
+;    (TOS+8) = ListEntry - Supplies a pointer to the entry to be inserted at
+;         the head of the list.
+;
+; Return Value:
+;
+;    Previous contents of ListHead.  NULL implies list went from empty
+;       to not empty.
+;
+;--
+
+cPublicProc _RtlpInterlockedPushEntrySList ,2
+cPublicFpo 2,2
+
+;
+; Save nonvolatile registers and read the listhead sequence number followed
+; by the listhead next link.
+;
+; N.B. These two dwords MUST be read exactly in this order.
+;
+
+        push    ebx                     ; save nonvolatile registers
+        push    ebp                     ;
+        mov     ebp,[esp]+12            ; get listhead address
+        mov     ebx,[esp]+16            ; get list entry address
+        mov     edx,[ebp] + 4           ; get current sequence number
+        mov     eax,[ebp] + 0           ; get current next link
+Rpsh10: mov     [ebx], eax              ; set next link in new first entry
+        mov     ecx, edx                ; copy sequence number
+        add     ecx, 010001H            ; increment sequence number and depth
+   lock cmpxchg8b qword ptr [ebp]       ; compare and exchange
+        jnz     short Rpsh10            ; if z clear, exchange failed
+
+;
+; Restore nonvolatile registers and return result.
+;
+
+        pop     ebp                     ; restore nonvolatile registers
+        pop     ebx                     ;
+        stdRET  _RtlpInterlockedPushEntrySList
+
+stdENDP _RtlpInterlockedPushEntrySList
+
+        page ,132
+        subttl  "Interlocked Flush Sequenced List"
+;++
+;
+; PSINGLE_LIST_ENTRY
+; RtlpInterlockedFlushSList (
+;    IN PSLIST_HEADER ListHead
+;    )
+;
+; Routine Description:
+;
+;    This function removes all entries from a sequenced singly linked list
+;    and returns them as a NULL terminated chain.
+;
+; Arguments:
+;
+;    (TOS+4) = ListHead - Supplies a pointer to the sequenced listhead to
+;         flush.
+;
+; Return Value:
+;
+;    The address of the first entry that was in the list, or NULL if the
+;    list was empty.
+;
+;--
+
+cPublicProc _RtlpInterlockedFlushSList ,1
+cPublicFpo 1,2
+
+        push    ebx                     ; save nonvolatile registers
+        push    ebp                     ;
+        mov     ebp,[esp]+12            ; get listhead address
+        mov     edx,[ebp] + 4           ; get current sequence number
+        mov     eax,[ebp] + 0           ; get current next link
+
+Rfls10: or      eax, eax                ; check if list is empty
+        jz      short Rfls20            ; if z set, list is empty
+        xor     ebx, ebx                ; set empty next link
+        mov     ecx, edx                ; copy sequence number
+        and     ecx, 0FFFF0000H         ; clear depth
+   lock cmpxchg8b qword ptr [ebp]       ; compare and exchange
+        jnz     short Rfls10            ; if z clear, exchange failed
+
+Rfls20: pop     ebp                     ; restore nonvolatile registers
+        pop     ebx                     ;
+        stdRET  _RtlpInterlockedFlushSList
+
+stdENDP _RtlpInterlockedFlushSList
+
+_TEXT   ends
+        end
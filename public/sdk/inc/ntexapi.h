@@ -699,7 +699,14 @@ typedef enum _SYSTEM_INFORMATION_CLASS {
     SystemPowerInformation,
     SystemProcessorSpeedInformation,
     SystemCurrentTimeZoneInformation,
-    SystemLookasideInformation
+    SystemLookasideInformation,
+    SystemWorkerQueueInformation,
+    SystemLockProfileInformation,
+    SystemCompressedStoreInformation,
+    SystemZeroPageInformation,
+    SystemPageFileWriteInformation,
+    SystemTbFlushInformation,
+    SystemWaitSpinInformation
 } SYSTEM_INFORMATION_CLASS;
 
 //
@@ -1097,6 +1104,62 @@ typedef struct _SYSTEM_PAGEFILE_INFORMATION {
     UNICODE_STRING PageFileName;
 } SYSTEM_PAGEFILE_INFORMATION, *PSYSTEM_PAGEFILE_INFORMATION;
 
+//
+// Paging file write information, one entry per paging file in the same
+// order as the paging file information. Latencies are in milliseconds and
+// the cluster size is the number of pages the next write tries to cluster.
+//
+
+typedef struct _SYSTEM_PAGEFILE_WRITE_INFORMATION {
+    ULONG WriteClusterSize;
+    ULONG WritesInProgress;
+    ULONG WriteCount;
+    ULONG PagesWritten;
+    ULONG WriteErrors;
+    ULONG TotalWriteLatency;
+    ULONG MaximumWriteLatency;
+    ULONG ClusterGrows;
+    ULONG ClusterShrinks;
+} SYSTEM_PAGEFILE_WRITE_INFORMATION, *PSYSTEM_PAGEFILE_WRITE_INFORMATION;
+
+//
+// Translation buffer flush information. The flush counts are the requests
+// made on multiprocessor systems, IpisSent counts the requests that had to
+// interrupt other processors, and PagesFlushed counts the pages in those
+// single and multiple page requests. The stall time is in processor cycles
+// spent waiting for the other processors to flush.
+//
+
+typedef struct _SYSTEM_TB_FLUSH_INFORMATION {
+    ULONG FlushSingleCount;
+    ULONG FlushMultipleCount;
+    ULONG FlushEntireCount;
+    ULONG IpisSent;
+    ULONG PagesFlushed;
+    LARGE_INTEGER StallTime;
+} SYSTEM_TB_FLUSH_INFORMATION, *PSYSTEM_TB_FLUSH_INFORMATION;
+
+//
+// Adaptive wait spin information. SpinWaits counts the waits that spun
+// before blocking and SpinAcquired counts those that were satisfied without
+// blocking. The latency histograms are collected when enabled and count
+// waits satisfied by spinning and waits that blocked. Bucket N counts the
+// latencies from 2**N up to 2**(N + 1) performance counter ticks, where the
+// first and last buckets also count the shorter and longer latencies. The
+// frequency of the performance counter is returned by
+// NtQueryPerformanceCounter.
+//
+
+#define WAIT_LATENCY_BUCKETS 16
+
+typedef struct _SYSTEM_WAIT_SPIN_INFORMATION {
+    ULONG SpinLimit;
+    ULONG SpinWaits;
+    ULONG SpinAcquired;
+    ULONG SpinLatency[WAIT_LATENCY_BUCKETS];
+    ULONG BlockLatency[WAIT_LATENCY_BUCKETS];
+} SYSTEM_WAIT_SPIN_INFORMATION, *PSYSTEM_WAIT_SPIN_INFORMATION;
+
 typedef struct _SYSTEM_FILECACHE_INFORMATION {
     ULONG CurrentSize;
     ULONG PeakSize;
@@ -1214,6 +1277,107 @@ typedef struct _SYSTEM_LOOKASIDE_INFORMATION {
     ULONG Size;
 } SYSTEM_LOOKASIDE_INFORMATION, *PSYSTEM_LOOKASIDE_INFORMATION;
 
+//
+// The delay of a work queue is the number of seconds the work item at the
+// head of the queue has waited without being removed, sampled once a
+// second.
+//
+
+typedef struct _SYSTEM_WORKER_QUEUE_INFORMATION {
+    ULONG QueueType;
+    ULONG WorkerThreads;
+    ULONG DynamicThreads;
+    ULONG DynamicThreadsCreated;
+    ULONG WorkItemsProcessed;
+    ULONG QueueDepth;
+    ULONG MaximumQueueDepth;
+    ULONG CurrentDelay;
+    ULONG MaximumDelay;
+} SYSTEM_WORKER_QUEUE_INFORMATION, *PSYSTEM_WORKER_QUEUE_INFORMATION;
+
+//
+// Lock profiling information. Each lock that was acquired while profiling
+// was enabled is described by one entry, which holds the totals for the
+// lock and the call sites with the most contention. Wait and hold times
+// are in units of the performance counter frequency. Hold times are only
+// recorded for exclusive acquires.
+//
+
+#define LOCK_PROFILE_RESOURCE   0
+#define LOCK_PROFILE_FAST_MUTEX 1
+#define LOCK_PROFILE_SPIN_LOCK  2
+
+#define LOCK_PROFILE_CALL_SITES 4
+
+typedef struct _SYSTEM_LOCK_PROFILE_CALL_SITE {
+    PVOID CallSite;
+    ULONG AcquireCount;
+    ULONG ContentionCount;
+    LARGE_INTEGER WaitTime;
+    LARGE_INTEGER HoldTime;
+} SYSTEM_LOCK_PROFILE_CALL_SITE, *PSYSTEM_LOCK_PROFILE_CALL_SITE;
+
+typedef struct _SYSTEM_LOCK_PROFILE_ENTRY {
+    PVOID Address;
+    ULONG Type;
+    ULONG NumberOfCallSites;
+    ULONG AcquireCount;
+    ULONG ContentionCount;
+    LARGE_INTEGER WaitTime;
+    LARGE_INTEGER HoldTime;
+    SYSTEM_LOCK_PROFILE_CALL_SITE CallSites[LOCK_PROFILE_CALL_SITES];
+} SYSTEM_LOCK_PROFILE_ENTRY, *PSYSTEM_LOCK_PROFILE_ENTRY;
+
+typedef struct _SYSTEM_LOCK_PROFILE_INFORMATION {
+    BOOLEAN Enabled;
+    ULONG NumberOfLocks;
+    ULONG DroppedAcquires;
+    LARGE_INTEGER Frequency;
+    SYSTEM_LOCK_PROFILE_ENTRY Locks[1];
+} SYSTEM_LOCK_PROFILE_INFORMATION, *PSYSTEM_LOCK_PROFILE_INFORMATION;
+
+//
+// Setting lock profiling information with Enable TRUE discards the
+// current statistics and starts profiling. Setting it with Enable FALSE
+// stops profiling and keeps the statistics for query.
+//
+
+typedef struct _SYSTEM_LOCK_PROFILE_CONTROL {
+    BOOLEAN Enable;
+} SYSTEM_LOCK_PROFILE_CONTROL, *PSYSTEM_LOCK_PROFILE_CONTROL;
+
+//
+// Compressed page store information. Sizes are in bytes of nonpaged pool
+// and include the per page overhead, so the compression ratio is
+// CurrentSize / (NumberOfPages * PAGE_SIZE). Hits and misses count the
+// paging file reads that were and were not satisfied from the store.
+//
+
+typedef struct _SYSTEM_COMPRESSED_STORE_INFORMATION {
+    ULONG MaximumSize;
+    ULONG CurrentSize;
+    ULONG NumberOfPages;
+    ULONG PagesCompressed;
+    ULONG PagesRejected;
+    ULONG Hits;
+    ULONG Misses;
+    ULONG Evictions;
+    ULONG Invalidations;
+} SYSTEM_COMPRESSED_STORE_INFORMATION, *PSYSTEM_COMPRESSED_STORE_INFORMATION;
+
+//
+// Zero page thread information. Hits and misses count the requests for a
+// zeroed page that were satisfied from the zeroed page list and the ones
+// that had to zero a free or standby page.
+//
+
+typedef struct _SYSTEM_ZERO_PAGE_INFORMATION {
+    ULONG ZeroingThreads;
+    ULONG PagesZeroed;
+    ULONG ZeroPageHits;
+    ULONG ZeroPageMisses;
+} SYSTEM_ZERO_PAGE_INFORMATION, *PSYSTEM_ZERO_PAGE_INFORMATION;
+
 // begin_winnt
 
 #define PROCESSOR_INTEL_386     386
@@ -751,6 +751,148 @@ RtlIsGenericTableEmpty (
     PRTL_GENERIC_TABLE Table
     );
 
+//
+//  Define the AVL generic table package.  It has the same routines and the
+//  same user supplied compare, allocate and free routines as the generic
+//  table package above, with Avl appended to each name, but it keeps the
+//  tree balanced by height instead of splaying it.  This means lookups and
+//  RtlEnumerateGenericTableWithoutSplayingAvl never change the table, so
+//  any number of them can run at the same time under a shared lock.  The
+//  other routines still need exclusive access to the table.
+//
+//  Each element is allocated with RTL_BALANCED_LINKS and a LIST_ENTRY in
+//  front of the user data, and as before the free routine is passed a
+//  pointer to the start of the allocation.
+//
+
+typedef struct _RTL_BALANCED_LINKS {
+    struct _RTL_BALANCED_LINKS *Parent;
+    struct _RTL_BALANCED_LINKS *LeftChild;
+    struct _RTL_BALANCED_LINKS *RightChild;
+    CHAR Balance;
+    UCHAR Reserved[3];
+} RTL_BALANCED_LINKS;
+typedef RTL_BALANCED_LINKS *PRTL_BALANCED_LINKS;
+
+struct _RTL_AVL_TABLE;
+
+typedef
+RTL_GENERIC_COMPARE_RESULTS
+(NTAPI *PRTL_AVL_COMPARE_ROUTINE) (
+    struct _RTL_AVL_TABLE *Table,
+    PVOID FirstStruct,
+    PVOID SecondStruct
+    );
+
+typedef
+PVOID
+(NTAPI *PRTL_AVL_ALLOCATE_ROUTINE) (
+    struct _RTL_AVL_TABLE *Table,
+    CLONG ByteSize
+    );
+
+typedef
+VOID
+(NTAPI *PRTL_AVL_FREE_ROUTINE) (
+    struct _RTL_AVL_TABLE *Table,
+    PVOID Buffer
+    );
+
+typedef struct _RTL_AVL_TABLE {
+    PRTL_BALANCED_LINKS TableRoot;
+    LIST_ENTRY InsertOrderList;
+    PLIST_ENTRY OrderedPointer;
+    ULONG WhichOrderedElement;
+    ULONG NumberGenericTableElements;
+    PRTL_BALANCED_LINKS RestartKey;
+    PRTL_AVL_COMPARE_ROUTINE CompareRoutine;
+    PRTL_AVL_ALLOCATE_ROUTINE AllocateRoutine;
+    PRTL_AVL_FREE_ROUTINE FreeRoutine;
+    PVOID TableContext;
+} RTL_AVL_TABLE;
+typedef RTL_AVL_TABLE *PRTL_AVL_TABLE;
+
+NTSYSAPI
+VOID
+NTAPI
+RtlInitializeGenericTableAvl (
+    PRTL_AVL_TABLE Table,
+    PRTL_AVL_COMPARE_ROUTINE CompareRoutine,
+    PRTL_AVL_ALLOCATE_ROUTINE AllocateRoutine,
+    PRTL_AVL_FREE_ROUTINE FreeRoutine,
+    PVOID TableContext
+    );
+
+NTSYSAPI
+PVOID
+NTAPI
+RtlInsertElementGenericTableAvl (
+    PRTL_AVL_TABLE Table,
+    PVOID Buffer,
+    CLONG BufferSize,
+    PBOOLEAN NewElement
+    );
+
+NTSYSAPI
+BOOLEAN
+NTAPI
+RtlDeleteElementGenericTableAvl (
+    PRTL_AVL_TABLE Table,
+    PVOID Buffer
+    );
+
+NTSYSAPI
+PVOID
+NTAPI
+RtlLookupElementGenericTableAvl (
+    PRTL_AVL_TABLE Table,
+    PVOID Buffer
+    );
+
+//
+//  RtlEnumerateGenericTableAvl keeps its position in the table.  If the
+//  element it last returned is deleted, the next call returns the element
+//  that followed it.
+//
+
+NTSYSAPI
+PVOID
+NTAPI
+RtlEnumerateGenericTableAvl (
+    PRTL_AVL_TABLE Table,
+    BOOLEAN Restart
+    );
+
+NTSYSAPI
+PVOID
+NTAPI
+RtlEnumerateGenericTableWithoutSplayingAvl (
+    PRTL_AVL_TABLE Table,
+    PVOID *RestartKey
+    );
+
+NTSYSAPI
+PVOID
+NTAPI
+RtlGetElementGenericTableAvl (
+    PRTL_AVL_TABLE Table,
+    ULONG I
+    );
+
+NTSYSAPI
+ULONG
+NTAPI
+RtlNumberGenericTableElementsAvl (
+    PRTL_AVL_TABLE Table
+    );
+
+NTSYSAPI
+BOOLEAN
+NTAPI
+RtlIsGenericTableEmptyAvl (
+    PRTL_AVL_TABLE Table
+    );
+
 
 //
 //  Heap Allocator
@@ -812,6 +954,8 @@ RtlCreateHeap(
 
 #define HEAP_CREATE_ALIGN_16            0x00010000      // winnt Create heap with 16 byte alignment
 #define HEAP_CREATE_ENABLE_TRACING      0x00020000      // winnt Create heap call tracing enabled
+#define HEAP_CREATE_LOW_FRAGMENTATION   0x00040000      // winnt Create heap with a low fragmentation front end
+#define HEAP_CREATE_NO_FREE_CACHE       0x00080000      // winnt Create heap without a free cache
 
 #define HEAP_SETTABLE_USER_VALUE        0x00000100
 #define HEAP_SETTABLE_USER_FLAG1        0x00000200
@@ -847,7 +991,9 @@ RtlCreateHeap(
                                         HEAP_DISABLE_COALESCE_ON_FREE | \
                                         HEAP_CLASS_MASK |               \
                                         HEAP_CREATE_ALIGN_16 |          \
-                                        HEAP_CREATE_ENABLE_TRACING)
+                                        HEAP_CREATE_ENABLE_TRACING |    \
+                                        HEAP_CREATE_LOW_FRAGMENTATION | \
+                                        HEAP_CREATE_NO_FREE_CACHE)
 
 NTSYSAPI
 PVOID
@@ -884,6 +1030,47 @@ RtlProtectHeap(
     IN BOOLEAN MakeReadOnly
     );
 
+//
+// Counters kept by every heap.  Allocations are counted in size classes of
+// the block size including its header: class 0 holds blocks of 16 bytes,
+// and each following class holds blocks up to twice as large as the one
+// before it, except the last, which holds everything above 1024 bytes.
+//
+// The counters are not updated with interlocked operations, so counts
+// taken outside of the heap lock can occasionally be lost when threads
+// race on them.
+//
+
+typedef enum _HEAP_INFORMATION_CLASS {
+    HeapCounterInformation
+} HEAP_INFORMATION_CLASS;
+
+#define RTL_HEAP_SIZE_CLASSES 8
+
+typedef struct _RTL_HEAP_COUNTERS {
+    ULONG Allocations[ RTL_HEAP_SIZE_CLASSES ];
+    ULONG Frees;
+    ULONG FrontEndHits;         // served without the heap lock
+    ULONG FreeListHits;         // exact fit from a dedicated free list
+    ULONG FreeListMisses;       // had to split or search for a block
+    ULONG CoalescedBlocks;
+    ULONG ExtendCalls;
+    ULONG DeCommitCalls;
+    ULONG LockContentions;
+    ULONG TotalFreeSize;        // in bytes
+} RTL_HEAP_COUNTERS, *PRTL_HEAP_COUNTERS;
+
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlQueryHeapInformation(
+    IN PVOID HeapHandle,
+    IN HEAP_INFORMATION_CLASS HeapInformationClass,
+    OUT PVOID HeapInformation,
+    IN ULONG HeapInformationLength,
+    OUT PULONG ReturnLength OPTIONAL
+    );
+
 //
 // See NTURTL.H for remaining, user mode only heap functions.
 //
@@ -2246,9 +2433,11 @@ RtlNextUnicodePrefix (
 #define COMPRESSION_FORMAT_NONE          (0x0000)   // winnt
 #define COMPRESSION_FORMAT_DEFAULT       (0x0001)   // winnt
 #define COMPRESSION_FORMAT_LZNT1         (0x0002)   // winnt
+#define COMPRESSION_FORMAT_MRCF          (0x0003)
 
 #define COMPRESSION_ENGINE_STANDARD      (0x0000)   // winnt
 #define COMPRESSION_ENGINE_MAXIMUM       (0x0100)   // winnt
+#define COMPRESSION_ENGINE_CHAINED       (0x0200)   // winnt
 
 //
 //  Compressed Data Information structure.  This structure is
@@ -2409,6 +2598,130 @@ RtlCompressChunks (
     IN PVOID WorkSpace
     );
 
+//
+//  Parallel compression support.  The uncompressed buffer is divided
+//  into stripes of whole chunks.  Each stripe is compressed on its own
+//  by a call to RtlCompressStripe, and because chunks never reference
+//  data outside of themselves the stripes are then packed back together
+//  into the same compressed stream RtlCompressBuffer would produce.
+//
+//  The caller supplies the dispatch routine that runs the stripes, for
+//  example by handing them to a set of worker threads.  The dispatch
+//  routine must call RtlCompressStripe exactly once for every stripe
+//  and must not return until all of the stripes have been compressed.
+//
+
+typedef struct _RTL_COMPRESS_STRIPE {
+
+    USHORT CompressionFormatAndEngine;
+    USHORT Reserved;
+
+    PUCHAR UncompressedBuffer;
+    ULONG UncompressedBufferSize;
+
+    PUCHAR CompressedBuffer;
+    ULONG CompressedBufferSize;
+
+    PVOID WorkSpace;
+
+    //
+    //  Filled in by RtlCompressStripe.
+    //
+
+    ULONG FinalCompressedSize;
+    NTSTATUS Status;
+
+} RTL_COMPRESS_STRIPE;
+typedef RTL_COMPRESS_STRIPE *PRTL_COMPRESS_STRIPE;
+
+typedef
+VOID
+(NTAPI *PRTL_COMPRESS_STRIPE_DISPATCH) (
+    IN PRTL_COMPRESS_STRIPE Stripes,
+    IN ULONG NumberOfStripes,
+    IN PVOID DispatchContext
+    );
+
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlGetParallelCompressionWorkSpaceSize (
+    IN USHORT CompressionFormatAndEngine,
+    IN ULONG UncompressedBufferSize,
+    IN ULONG UncompressedChunkSize,
+    IN ULONG NumberOfStripes,
+    OUT PULONG ParallelWorkSpaceSize
+    );
+
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlCompressBufferParallel (
+    IN USHORT CompressionFormatAndEngine,
+    IN PUCHAR UncompressedBuffer,
+    IN ULONG UncompressedBufferSize,
+    OUT PUCHAR CompressedBuffer,
+    IN ULONG CompressedBufferSize,
+    IN ULONG UncompressedChunkSize,
+    OUT PULONG FinalCompressedSize,
+    IN ULONG NumberOfStripes,
+    IN PRTL_COMPRESS_STRIPE_DISPATCH DispatchRoutine OPTIONAL,
+    IN PVOID DispatchContext OPTIONAL,
+    IN PVOID WorkSpace
+    );
+
+NTSYSAPI
+VOID
+NTAPI
+RtlCompressStripe (
+    IN OUT PRTL_COMPRESS_STRIPE Stripe
+    );
+
+//
+//  Stream decompression.  A caller that receives compressed data a piece
+//  at a time, for example from the network or a paged read, initializes
+//  a stream work space once and then repeatedly calls RtlDecompressStream
+//  handing in whatever compressed bytes it has and taking out whatever
+//  uncompressed bytes fit in its output piece.  The stream remembers any
+//  partial chunk or partial token that straddles two compressed pieces,
+//  and any uncompressed data that did not fit in the last output piece.
+//
+//  A compressed piece size of zero tells the stream that there is no more
+//  compressed data.  RtlDecompressStream returns STATUS_SUCCESS while the
+//  caller should keep going, and STATUS_NO_MORE_ENTRIES once the stream
+//  has returned all of its uncompressed data.
+//
+
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlGetDecompressStreamWorkSpaceSize (
+    IN USHORT CompressionFormat,
+    OUT PULONG StreamWorkSpaceSize
+    );
+
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlInitializeDecompressStream (
+    IN USHORT CompressionFormat,
+    IN ULONG UncompressedSize,
+    OUT PVOID StreamWorkSpace
+    );
+
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlDecompressStream (
+    IN OUT PVOID StreamWorkSpace,
+    IN PUCHAR CompressedPiece,
+    IN ULONG CompressedPieceSize,
+    OUT PULONG CompressedPieceUsed,
+    OUT PUCHAR UncompressedPiece,
+    IN ULONG UncompressedPieceSize,
+    OUT PULONG UncompressedPieceUsed
+    );
+
 // end_ntifs
 
 //
@@ -4159,6 +4472,94 @@ RtlAreBitsSet (
     ULONG Length
     );
 
+//
+//  A summary bitmap is a bitmap together with two levels of summary bits
+//  that let searches for clear bits pass over the parts of a large, nearly
+//  full bitmap that have no clear bits at all.  The first summary level has
+//  one bit for each ulong of the bitmap, and the second level has one bit
+//  for each ulong of the first level.  A summary bit is set only when every
+//  bit of the ulong it stands for is set.
+//
+//  The summary is kept up to date by the routines below.  The bitmap may
+//  still be read with the ordinary bitmap routines, but once it has been
+//  initialized as a summary bitmap its bits must only be set or cleared
+//  through the routines below.  The summary buffer is supplied by the
+//  caller and must be RTL_SUMMARY_BUFFER_SIZE bytes long.
+//
+
+#define RTL_SUMMARY_LEVELS 2
+
+typedef struct _RTL_SUMMARY_BITMAP {
+    RTL_BITMAP BitMap;                      // The bitmap being summarized
+    RTL_BITMAP Summary[RTL_SUMMARY_LEVELS]; // Full ulong bits for each level
+} RTL_SUMMARY_BITMAP;
+typedef RTL_SUMMARY_BITMAP *PRTL_SUMMARY_BITMAP;
+
+#define RTL_SUMMARY_ULONGS(Bits) (((Bits) + 31) / 32)
+
+#define RTL_SUMMARY_BUFFER_SIZE(SizeOfBitMap) (                                       \
+    (RTL_SUMMARY_ULONGS(RTL_SUMMARY_ULONGS(SizeOfBitMap)) +                           \
+     RTL_SUMMARY_ULONGS(RTL_SUMMARY_ULONGS(RTL_SUMMARY_ULONGS(SizeOfBitMap)))) *      \
+    sizeof(ULONG))
+
+//
+//  The following routine initializes a summary bitmap and builds its
+//  summary from the current contents of the bitmap.  Like
+//  RtlInitializeBitMap it does not alter the bitmap itself.
+//
+
+NTSYSAPI
+VOID
+NTAPI
+RtlInitializeSummaryBitMap (
+    PRTL_SUMMARY_BITMAP SummaryBitMap,
+    PULONG BitMapBuffer,
+    ULONG SizeOfBitMap,
+    PULONG SummaryBuffer
+    );
+
+//
+//  The following routines are the summary bitmap versions of
+//  RtlFindClearBits, RtlFindClearBitsAndSet, RtlClearBits and RtlSetBits.
+//  They return the same results as the ordinary routines.
+//
+
+NTSYSAPI
+ULONG
+NTAPI
+RtlFindClearBitsWithSummary (
+    PRTL_SUMMARY_BITMAP SummaryBitMap,
+    ULONG NumberToFind,
+    ULONG HintIndex
+    );
+
+NTSYSAPI
+ULONG
+NTAPI
+RtlFindClearBitsAndSetWithSummary (
+    PRTL_SUMMARY_BITMAP SummaryBitMap,
+    ULONG NumberToFind,
+    ULONG HintIndex
+    );
+
+NTSYSAPI
+VOID
+NTAPI
+RtlClearBitsWithSummary (
+    PRTL_SUMMARY_BITMAP SummaryBitMap,
+    ULONG StartingIndex,
+    ULONG NumberToClear
+    );
+
+NTSYSAPI
+VOID
+NTAPI
+RtlSetBitsWithSummary (
+    PRTL_SUMMARY_BITMAP SummaryBitMap,
+    ULONG StartingIndex,
+    ULONG NumberToSet
+    );
+
 // end_nthal end_ntifs
 
 // begin_ntsrv
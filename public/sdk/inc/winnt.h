@@ -4627,6 +4627,8 @@ typedef struct _IMAGE_SEPARATE_DEBUG_HEADER {
 #define HEAP_DISABLE_COALESCE_ON_FREE   0x00000080      
 #define HEAP_CREATE_ALIGN_16            0x00010000      
 #define HEAP_CREATE_ENABLE_TRACING      0x00020000      
+#define HEAP_CREATE_LOW_FRAGMENTATION   0x00040000      
+#define HEAP_CREATE_NO_FREE_CACHE       0x00080000      
 #define HEAP_MAXIMUM_TAG                0x0FFF              
 #define HEAP_PSEUDO_TAG_FLAG            0x8000              
 #define HEAP_TAG_SHIFT                  16                  
@@ -4659,6 +4661,7 @@ typedef struct _IMAGE_SEPARATE_DEBUG_HEADER {
 #define COMPRESSION_FORMAT_LZNT1         (0x0002)   
 #define COMPRESSION_ENGINE_STANDARD      (0x0000)   
 #define COMPRESSION_ENGINE_MAXIMUM       (0x0100)   
+#define COMPRESSION_ENGINE_CHAINED       (0x0200)   
 #if defined(_M_IX86) || defined(_M_MRX000) || defined(_M_ALPHA)
 
 #if defined(_M_MRX000)